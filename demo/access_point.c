@@ -8,11 +8,13 @@
 #include "settings.h"
 #include <signal.h>
 #include <string.h>
+#include "energy.h"
 #include "leds.h"
 #include "oscillator.h"
 #include "uart.h"
 #include "timers.h"
 #include "radio.h"
+#include "command.h"
 
 uint8_t tx_buffer[PACKET_LEN+1];
 
@@ -28,6 +30,7 @@ typedef struct
 
 typedef struct
 {
+  uint8_t sequence;
   uint8_t samples[ADC_MAX_SAMPLES];
 } packet_data_t;
 
@@ -39,6 +42,16 @@ typedef struct
 
 uint8_t send_sync_message();
 uint8_t process_rx( uint8_t*, uint8_t );
+uint8_t slot_timing_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+uint8_t sample_rate_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+uint8_t stats_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+
+// Current schedule, sent to the end devices with every sync message
+schedule_t schedule = { SAMPLE_RATE, REST_TIME, MINOR_CYCLE };
+volatile uint8_t schedule_changed = 0;
+
+uint16_t sync_count = 0;
+uint16_t forwarded_count = 0;
 
 int main( void )
 {
@@ -51,22 +64,30 @@ int main( void )
   header = (packet_header_t*)tx_buffer;
   
   // Initialize Tx Buffer
-  header->length = sizeof(packet_header_t) - 1;
+  header->length = sizeof(packet_header_t) + sizeof(schedule_t) - 1;
   header->source = DEVICE_ADDRESS;
   header->type = 0x66; // Sync message
   header->flags = 0xAA;
+  memcpy( tx_buffer + sizeof(packet_header_t), &schedule, sizeof(schedule_t) );
   
   // Make sure processor is running at 12MHz
   setup_oscillator();
   
-  // Initialize UART for communications at 115200baud
-  setup_uart();
+  // Initialize UART for communications with the host
+  setup_uart( HOST_BAUD, SMCLK_FREQUENCY );
+  uart_set_framing( HOST_FRAMING );
+  
+  // Accept commands from the host
+  setup_command();
+  register_command_callback( slot_timing_command, CMD_SET_SLOT_TIMING );
+  register_command_callback( sample_rate_command, CMD_SET_SAMPLE_RATE );
+  register_command_callback( stats_command, CMD_GET_STATS );
    
   // Initialize LEDs
   setup_leds();
   
   // Initialize timer
-  set_ccr( 0, TIMER_LIMIT );
+  set_ccr( 0, SCHEDULE_TIMER_LIMIT( schedule ) );
   setup_timer_a(MODE_UP);
   
   // Send sync message
@@ -75,15 +96,24 @@ int main( void )
   // Initialize radio and enable receive callback function
   setup_radio( process_rx );
   
+#ifdef ENERGY_PROFILE
+  setup_timer_a1( MODE_CONTINUOUS );
+  energy_start( ENERGY_ROLE_AP, ENERGY_REPORT_TICKS );
+#endif
+  
   // Enable interrupts, otherwise nothing will work
   eint();
    
   while (1)
   {
     // Enter sleep mode
+    ENERGY_OFF( ENERGY_CPU );
     __bis_SR_register( LPM0_bits + GIE );
     __no_operation();
-        
+    ENERGY_ON( ENERGY_CPU );
+    
+    // Woken up by a sync, a packet or a command frame from the host
+    command_process();
   }
   
   return 0;
@@ -95,8 +125,18 @@ int main( void )
  * ****************************************************************************/
 uint8_t send_sync_message()
 {
+  // Timer just wrapped, so this is the place to switch to a new schedule
+  if( schedule_changed )
+  {
+    memcpy( tx_buffer + sizeof(packet_header_t), &schedule, 
+                                                        sizeof(schedule_t) );
+    TA0CCR0 = SCHEDULE_TIMER_LIMIT( schedule );
+    schedule_changed = 0;
+  }
+  
   // Send sync message
-  radio_tx( tx_buffer, sizeof(packet_header_t) );
+  radio_tx( tx_buffer, sizeof(packet_header_t) + sizeof(schedule_t) );
+  sync_count++;
   led2_toggle();
   
   return 1;
@@ -116,8 +156,12 @@ uint8_t process_rx( uint8_t* buffer, uint8_t size )
   // Add one to account for the byte with the packet length
   //footer = (packet_footer_t*)(buffer + header->length + 1 );
 
-  //uart_write( , 1 );
-  uart_write_escaped( buffer, header->length + 1 );  
+  // Runs inside the radio ISR, so only queue the frame. It is sent from the
+  // UART TX interrupt, or dropped (and counted) if the host link falls behind.
+  if( uart_queue_frame( buffer, header->length + 1 ) )
+  {
+    forwarded_count++;
+  }
   
   // Erase buffer just for fun
   memset( buffer, 0x00, size );
@@ -126,3 +170,89 @@ uint8_t process_rx( uint8_t* buffer, uint8_t size )
   return 1;
 }
 
+
+/*******************************************************************************
+ * @fn     uint8_t slot_timing_command( ... )
+ * @brief  CMD_SET_SLOT_TIMING, [rest time L,H] [slot length L,H]. Applied at
+ *         the next sync message, every slot has to fit in a major cycle.
+ * ****************************************************************************/
+uint8_t slot_timing_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  uint16_t rest_time;
+  uint16_t minor_cycle;
+  
+  if( length != 4 )
+  {
+    return CMD_ERROR_LENGTH;
+  }
+  
+  rest_time = arguments[0] | ((uint16_t)arguments[1] << 8);
+  minor_cycle = arguments[2] | ((uint16_t)arguments[3] << 8);
+  
+  if( (0 == minor_cycle) || ((uint32_t)minor_cycle * MAX_DEVICES + 
+                        rest_time > SCHEDULE_MAJOR_CYCLE( schedule )) )
+  {
+    return CMD_ERROR_VALUE;
+  }
+  
+  // Sync could go out half way through the update
+  dint();
+  schedule.rest_time = rest_time;
+  schedule.minor_cycle = minor_cycle;
+  schedule_changed = 1;
+  eint();
+  
+  return CMD_OK;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t sample_rate_command( ... )
+ * @brief  CMD_SET_SAMPLE_RATE, [ticks per sample L,H]. Applied at the next
+ *         sync message, the current slots have to fit in the new major cycle.
+ * ****************************************************************************/
+uint8_t sample_rate_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  uint16_t sample_rate;
+  
+  if( length != 2 )
+  {
+    return CMD_ERROR_LENGTH;
+  }
+  
+  sample_rate = arguments[0] | ((uint16_t)arguments[1] << 8);
+  
+  if( (0 == sample_rate) || (sample_rate > SCHEDULE_MAX_SAMPLE_RATE) ||
+      ((uint32_t)schedule.minor_cycle * MAX_DEVICES + schedule.rest_time > 
+                                  (uint32_t)sample_rate * ADC_MAX_SAMPLES) )
+  {
+    return CMD_ERROR_VALUE;
+  }
+  
+  dint();
+  schedule.sample_rate = sample_rate;
+  schedule_changed = 1;
+  eint();
+  
+  return CMD_OK;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t stats_command( ... )
+ * @brief  CMD_GET_STATS, UART counters followed by 
+ *         [syncs sent L,H] [frames forwarded L,H]
+ * ****************************************************************************/
+uint8_t stats_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  uint8_t size = command_uart_stats( reply );
+  
+  reply[size++] = (uint8_t)sync_count;
+  reply[size++] = (uint8_t)(sync_count >> 8);
+  reply[size++] = (uint8_t)forwarded_count;
+  reply[size++] = (uint8_t)(forwarded_count >> 8);
+  *reply_length = size;
+  
+  return CMD_OK;
+}
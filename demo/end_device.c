@@ -7,15 +7,16 @@
 */
 #include <signal.h>
 #include <string.h>
+#include "energy.h"
 #include "leds.h"
 #include "oscillator.h"
 #include "uart.h"
 #include "timers.h"
 #include "radio.h"
+#include "codec.h"
+#include "pipeline.h"
 #include "settings.h"
 
-uint8_t tx_buffer[PACKET_LEN+1];
-
 uint8_t print_buffer[200];
 
 typedef struct
@@ -28,6 +29,7 @@ typedef struct
 
 typedef struct
 {
+  uint8_t sequence;
   uint8_t samples[ADC_MAX_SAMPLES];
 } packet_data_t;
 
@@ -37,15 +39,25 @@ typedef struct
   uint8_t lqi_crcok;
 } packet_footer_t;
 
+// Large enough for a full sample packet (PACKET_LEN only covers short ones)
+uint8_t tx_buffer[sizeof(packet_header_t) + sizeof(packet_data_t)];
+
 uint8_t start_sample();
 uint8_t process_rx( uint8_t*, uint8_t );
 uint8_t send_samples();
 void setup_adc();
 
 
-uint8_t sample_buffer[ADC_MAX_SAMPLES * 2];
-uint8_t buffer_index = 0;
-uint8_t current_buffer = 0;
+// Sample blocks shared between the ADC ISR and send_samples
+uint16_t sample_buffer[ADC_BLOCKS * ADC_MAX_SAMPLES];
+pipeline_t sample_pipeline;
+
+// Schedule in use, updated by the sync messages from the access point
+schedule_t schedule = { SAMPLE_RATE, REST_TIME, MINOR_CYCLE };
+uint16_t timer_limit = TIMER_LIMIT;
+
+// Compression ratio (x100) of the last block sent
+uint16_t last_block_ratio = 0;
 
 int main( void )
 {
@@ -61,13 +73,15 @@ int main( void )
   header->length = sizeof(packet_header_t) + sizeof(packet_data_t) - 1;
   header->source = DEVICE_ADDRESS;
   header->type = 0xAA; // Samples
-  header->flags = 0x00;
+  header->flags = 0x00; // Codec block descriptor, filled in by send_samples
+  
+  pipeline_init( &sample_pipeline, sample_buffer, ADC_BLOCKS, ADC_MAX_SAMPLES );
   
   // Make sure processor is running at 12MHz
   setup_oscillator();
   
   // Initialize UART for communications at 115200baud
-  //setup_uart();
+  //setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
   
   setup_adc();
    
@@ -75,15 +89,15 @@ int main( void )
   setup_leds();
   
   // Initialize timer
-  set_ccr( 0, TIMER_LIMIT );
+  set_ccr( 0, timer_limit );
   setup_timer_a(MODE_UP);
   
   // Send sync message
   register_timer_callback( start_sample, 1 );
-  set_ccr( 1, SAMPLE_RATE );
+  set_ccr( 1, schedule.sample_rate );
   
   register_timer_callback( send_samples, 2 );
-  set_ccr( 2, (( REST_TIME/2) + MINOR_CYCLE * (DEVICE_ADDRESS - 1) ) );
+  set_ccr( 2, SCHEDULE_SLOT( schedule, DEVICE_ADDRESS ) );
     
   // Initialize radio and enable receive callback function
   setup_radio( process_rx );
@@ -94,14 +108,23 @@ int main( void )
   // Full Power
   //WriteSinglePATable(0xC0);
   
+#ifdef ENERGY_PROFILE
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+  uart_set_framing( UART_FRAMING_COBS );
+  setup_timer_a1( MODE_CONTINUOUS );
+  energy_start( ENERGY_ROLE_END_DEVICE, ENERGY_REPORT_TICKS );
+#endif
+  
   // Enable interrupts, otherwise nothing will work
   eint();
    
   while (1)
   {
     // Enter sleep mode
+    ENERGY_OFF( ENERGY_CPU );
     __bis_SR_register( LPM3_bits + GIE );
     __no_operation();
+    ENERGY_ON( ENERGY_CPU );
     //led2_toggle();
   }
   
@@ -119,11 +142,12 @@ uint8_t start_sample()
   
   // Queue ADC conversion
 	ADC12CTL0 |= ADC12SC;
+  ENERGY_ON( ENERGY_ADC );
   
-  TA0CCR1 += SAMPLE_RATE;
-  if (TA0CCR1 > TIMER_LIMIT)
+  TA0CCR1 += schedule.sample_rate;
+  if (TA0CCR1 > timer_limit)
   {
-    TA0CCR1 -= TIMER_LIMIT;
+    TA0CCR1 -= timer_limit;
   }
     
   led1_on();
@@ -142,9 +166,21 @@ uint8_t process_rx( uint8_t* buffer, uint8_t size )
   
   if( header->type == 0x66 )
   {
+    // Pick up schedule changes made on the access point
+    if( header->length >= (sizeof(packet_header_t) + sizeof(schedule_t) - 1) &&
+        memcmp( &schedule, buffer + sizeof(packet_header_t), 
+                                                    sizeof(schedule_t) ) )
+    {
+      memcpy( &schedule, buffer + sizeof(packet_header_t), 
+                                                    sizeof(schedule_t) );
+      timer_limit = SCHEDULE_TIMER_LIMIT( schedule );
+      TA0CCR0 = timer_limit;
+      TA0CCR2 = SCHEDULE_SLOT( schedule, DEVICE_ADDRESS );
+    }
+    
     // TODO: save current timer value here
     clear_timer();
-    TA0CCR1 = SAMPLE_RATE;
+    TA0CCR1 = schedule.sample_rate;
     led1_off();
   }
   
@@ -166,26 +202,50 @@ uint8_t process_rx( uint8_t* buffer, uint8_t size )
  * ****************************************************************************/
 uint8_t send_samples()
 { 
+  packet_header_t* header;
   packet_data_t* data;
+  uint16_t* block;
+  uint8_t encoded_size;
   
   led2_toggle();
   
-  if( TA0CCR2 > MAJOR_CYCLE_LOOP )
+  // Last slot before the timer wraps, go back to the first one
+  if( TA0CCR2 > (timer_limit - SCHEDULE_MAJOR_CYCLE( schedule )) )
   {
-    TA0CCR2 = ( REST_TIME/2 ) + MINOR_CYCLE * (DEVICE_ADDRESS - 1);
+    TA0CCR2 = SCHEDULE_SLOT( schedule, DEVICE_ADDRESS );
   }
   else
   {
-    TA0CCR2 += ( MAJOR_CYCLE );
+    TA0CCR2 += SCHEDULE_MAJOR_CYCLE( schedule );
   }
   
   
+  header = (packet_header_t*)tx_buffer;
   data = (packet_data_t*)(tx_buffer + sizeof(packet_header_t));
   
-  memcpy( data->samples, &sample_buffer[ current_buffer * ADC_MAX_SAMPLES ], 
-  ( sizeof(sample_buffer) / 2 ) );
+  // Oldest complete block, nothing to send (underrun) if the ADC hasn't
+  // finished one since the last slot
+  block = pipeline_acquire( &sample_pipeline, &data->sequence );
+  if( 0 == block )
+  {
+    return 0;
+  }
+  
+  // Compress the block in place straight into the packet. The codec drops
+  // resolution only when the block doesn't fit in the payload.
+  encoded_size = codec_encode( data->samples, sizeof(data->samples), block,
+                                          ADC_MAX_SAMPLES, &header->flags );
+  
+  last_block_ratio = codec_ratio( ADC_MAX_SAMPLES, encoded_size );
+  
+  // Only send the bytes used, compressible blocks take less airtime
+  header->length = sizeof(packet_header_t) + 
+                                      sizeof(data->sequence) + encoded_size - 1;
   
-  radio_tx( tx_buffer, sizeof(packet_header_t) + sizeof(packet_data_t) );
+  radio_tx( tx_buffer, header->length + 1 );
+  
+  // Packet is in the radio FIFO, block can be refilled
+  pipeline_release( &sample_pipeline );
   
   return 0;
 }
@@ -218,21 +278,10 @@ wakeup interrupt (ADC12_VECTOR) ADC12ISR(void) 	// CHANGE
 	switch(ADC12IV)
 	{
 	case  6:	// Vector  6:  ADC12IFG0
+    ENERGY_OFF( ENERGY_ADC );
 
-    // This will be in ADC ISR, just testing for now
-    sample_buffer[buffer_index] = (uint8_t)(ADC12MEM0>>4);       
-    buffer_index++;
-    
-     if ( (ADC_MAX_SAMPLES) == buffer_index )
-    {      
-        current_buffer = 0;
-        
-    }
-    else if( (2*ADC_MAX_SAMPLES) == buffer_index )
-    {
-        buffer_index = 0;
-        current_buffer = 1;       
-    }
+    // Full blocks are handed to send_samples, overruns are counted there
+    pipeline_put( &sample_pipeline, ADC12MEM0 );
 
 		led1_off();
 		break;
@@ -8,10 +8,18 @@
 #include "settings.h"
 #include <signal.h>
 #include <string.h>
+#include "energy.h"
 #include "leds.h"
 #include "oscillator.h"
 #include "timers.h"
+#include "vtimer.h"
+#include "uart.h"
 #include "radio.h"
+#include "event.h"
+#include "task.h"
+
+// Wait before forwarding a packet, about as long as the old delay loop
+#define RELAY_DELAY (1200)
 
 typedef struct
 {
@@ -23,6 +31,7 @@ typedef struct
 
 typedef struct
 {
+  uint8_t sequence;
   uint8_t samples[ADC_MAX_SAMPLES];
 } packet_data_t;
 
@@ -34,9 +43,11 @@ typedef struct
 
 uint8_t heartbeat();
 uint8_t process_rx( uint8_t*, uint8_t );
+uint8_t relay( task_t* );
 
 uint8_t tx_buffer[256];
 volatile uint8_t new_message = 0;
+task_t relay_task;
 
 int main( void )
 {
@@ -53,6 +64,7 @@ int main( void )
   // Initialize timer
   set_ccr( 0, TIMER_LIMIT );
   setup_timer_a(MODE_UP);
+  vtimer_init();
   
   set_ccr( 2, 10 );
   register_timer_callback( heartbeat, 2 );
@@ -63,33 +75,41 @@ int main( void )
   // Full Power
   WriteSinglePATable(0xC0);
   
-  // Enable interrupts, otherwise nothing will work
-  eint();
-   
-  while (1)
+  task_start( &relay_task, relay );
+  
+#ifdef ENERGY_PROFILE
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+  uart_set_framing( UART_FRAMING_COBS );
+  energy_start( ENERGY_ROLE_RELAY, ENERGY_REPORT_TICKS );
+#endif
+  
+  // Sleeps in LPM3 until a packet comes in
+  event_loop();
+  
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t relay( task_t* task )
+ * @brief  forward packets from end devices after a short wait
+ * ****************************************************************************/
+uint8_t relay( task_t* task )
+{
+  TASK_BEGIN( task );
+  
+  for(;;)
   {
-    // Enter sleep mode
-    __bis_SR_register( LPM3_bits + GIE );
-    __no_operation();
+    TASK_WAIT_UNTIL( task, new_message );
+    TASK_SLEEP( task, RELAY_DELAY );
     
-    if ( new_message )
-    {
-      volatile uint16_t delay;
-      
-      for( delay=0x9fff; delay > 0; delay-- )
-      {
-        __no_operation();
-      }
-      
-      radio_tx( tx_buffer, sizeof(packet_header_t) + sizeof(packet_data_t) );
-      led2_toggle();    
-    }
+    // Sample packets are variable length now that blocks are compressed
+    radio_tx( tx_buffer, ((packet_header_t*)tx_buffer)->length + 1 );
+    led2_toggle();
     
     new_message = 0;
-        
   }
   
-  return 0;
+  TASK_END( task );
 }
 
 /*******************************************************************************
@@ -123,7 +143,7 @@ uint8_t process_rx( uint8_t* buffer, uint8_t size )
   led3_toggle();
   if( header->type == 0xAA )
   {
-    memcpy( tx_buffer, buffer, sizeof(packet_header_t) + sizeof(packet_data_t) );  
+    memcpy( tx_buffer, buffer, header->length + 1 );  
     new_message = 1;
   }
   
@@ -11,8 +11,17 @@
 
 #define ADC_MAX_SAMPLES (50)
 
+// Sample blocks buffered between the ADC and the radio
+#define ADC_BLOCKS (4)
+
 #define MAX_DEVICES (5)
 
+// Access point to host serial link
+#define HOST_BAUD (460800)
+
+// UART_FRAMING_COBS (sequence numbers and CRC) or UART_FRAMING_ESCAPED
+#define HOST_FRAMING (UART_FRAMING_COBS)
+
 #define TIMER_LIMIT (65400)
 
 #define SAMPLE_RATE (109)
@@ -23,7 +32,32 @@
 
 #define MINOR_CYCLE (495)
 
-#define MAJOR_CYCLE_LOOP (60000)
+// Major cycles (one slot for every device) between sync messages
+#define SYNC_MAJOR_CYCLES (12)
+
+// Schedule sent by the access point with every sync message, so slot timing
+// and sample rate can be changed at run time. Defaults are the values above.
+typedef struct
+{
+  uint16_t sample_rate; // Timer ticks between samples
+  uint16_t rest_time;   // Slots start at rest_time/2 into the major cycle
+  uint16_t minor_cycle; // Slot length
+} schedule_t;
+
+// One block of samples per major cycle
+#define SCHEDULE_MAJOR_CYCLE( schedule ) \
+  ( (uint16_t)ADC_MAX_SAMPLES * (schedule).sample_rate )
+
+#define SCHEDULE_TIMER_LIMIT( schedule ) \
+  ( SYNC_MAJOR_CYCLES * SCHEDULE_MAJOR_CYCLE( schedule ) )
+
+// Start of a device's slot in each major cycle
+#define SCHEDULE_SLOT( schedule, address ) \
+  ( ((schedule).rest_time / 2) + (schedule).minor_cycle * ((address) - 1) )
+
+// Slowest sample rate that keeps the timer limit within 16 bits
+#define SCHEDULE_MAX_SAMPLE_RATE \
+  ( 0xFFFF / (SYNC_MAJOR_CYCLES * ADC_MAX_SAMPLES) )
 
 
 #endif /* _SETTINGS_H */\
@@ -0,0 +1,256 @@
+/** @file apcommand.c
+*
+* @brief Send a command to an access point and print the reply
+*
+*   usage: apcommand [-b baud] [-e] device command [arguments]
+*     ping [bytes...]          check the link
+*     channel <n>              radio channel (CHANNR)
+*     patable <value>          tx power, e.g. 0x51 for 0 dBm
+*     slot <rest> <length>     slot timing in timer ticks
+*     rate <ticks>             timer ticks between samples
+*     stats                    counters
+*
+*   Data frames forwarded by the access point are skipped while waiting for
+*   the reply. Replies are expected in COBS framing, -e reads the older escaped
+*   framing instead. Commands are always sent escaped.
+*
+* @author Alvaro Prieto
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include "command.h"
+#include "frame.h"
+#include "serial.h"
+
+#define REPLY_TIMEOUT_MS (1000)
+
+static const char* status_names[] = { "ok", "unknown command", "bad length",
+                                      "bad value", "busy" };
+
+/*******************************************************************************
+ * @fn     int send_frame( int fd, uint8_t* buffer, uint8_t length )
+ * @brief  send buffer with the same framing as uart_write_escaped
+ * ****************************************************************************/
+static int send_frame( int fd, uint8_t* buffer, uint8_t length )
+{
+  uint8_t frame[2 * COMMAND_MAX_SIZE + 2];
+  uint8_t size = 0;
+  uint8_t index;
+
+  frame[size++] = FRAME_FLAG;
+  for( index = 0; index < length; index++ )
+  {
+    if( (FRAME_FLAG == buffer[index]) || (FRAME_ESCAPE == buffer[index]) )
+    {
+      frame[size++] = FRAME_ESCAPE;
+      frame[size++] = buffer[index] ^ FRAME_ESCAPE_XOR;
+    }
+    else
+    {
+      frame[size++] = buffer[index];
+    }
+  }
+  frame[size++] = FRAME_FLAG;
+
+  return ( write( fd, frame, size ) == size ) ? 0 : -1;
+}
+
+/*******************************************************************************
+ * @fn     int wait_reply( int fd, uint8_t opcode, frame_decoder_t* decoder )
+ * @brief  read until the reply to [opcode] arrives or the timeout expires
+ * @return 0 with the reply in decoder->buffer, -1 on timeout
+ * ****************************************************************************/
+static int wait_reply( int fd, uint8_t opcode, frame_decoder_t* decoder )
+{
+  struct timeval timeout = { REPLY_TIMEOUT_MS / 1000,
+                             (REPLY_TIMEOUT_MS % 1000) * 1000 };
+  uint8_t buffer[256];
+  fd_set read_set;
+  ssize_t received;
+  ssize_t index;
+
+  for(;;)
+  {
+    FD_ZERO( &read_set );
+    FD_SET( fd, &read_set );
+
+    // Linux updates timeout with the time left
+    if( select( fd + 1, &read_set, 0, 0, &timeout ) <= 0 )
+    {
+      return -1;
+    }
+
+    received = read( fd, buffer, sizeof(buffer) );
+    if( received <= 0 )
+    {
+      return -1;
+    }
+
+    for( index = 0; index < received; index++ )
+    {
+      if( frame_push( decoder, buffer[index] ) &&
+          (decoder->length >= 2) &&
+          (decoder->buffer[0] == (opcode | COMMAND_REPLY)) )
+      {
+        return 0;
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint16_t get16( uint8_t* buffer )
+ * @brief  little endian 16-bit value
+ * ****************************************************************************/
+static uint16_t get16( uint8_t* buffer )
+{
+  return buffer[0] | ((uint16_t)buffer[1] << 8);
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-b baud] [-e] device command [arguments]\n"
+    "  ping [bytes...] | channel <n> | patable <value> |\n"
+    "  slot <rest> <length> | rate <ticks> | stats\n", name );
+}
+
+int main( int argc, char** argv )
+{
+  frame_decoder_t decoder;
+  uint8_t command[COMMAND_MAX_SIZE];
+  uint8_t length = 0;
+  uint8_t status;
+  uint8_t* data;
+  uint16_t data_length;
+  long baud = SERIAL_DEFAULT_BAUD;
+  uint8_t mode = FRAME_MODE_COBS;
+  const char* device;
+  const char* name;
+  long value;
+  int option;
+  int index;
+  int fd;
+
+  while( (option = getopt( argc, argv, "b:e" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'b': baud = atol( optarg ); break;
+      case 'e': mode = FRAME_MODE_ESCAPED; break;
+      default: usage( argv[0] ); return 1;
+    }
+  }
+
+  if( argc - optind < 2 )
+  {
+    usage( argv[0] );
+    return 1;
+  }
+
+  device = argv[optind];
+  name = argv[optind + 1];
+  argc -= optind + 2;
+  argv += optind + 2;
+
+  if( 0 == strcmp( name, "ping" ) && argc < COMMAND_MAX_SIZE - 2 )
+  {
+    command[length++] = CMD_PING;
+    for( index = 0; index < argc; index++ )
+    {
+      command[length++] = (uint8_t)strtol( argv[index], 0, 0 );
+    }
+  }
+  else if( 0 == strcmp( name, "channel" ) && 1 == argc )
+  {
+    command[length++] = CMD_SET_CHANNEL;
+    command[length++] = (uint8_t)strtol( argv[0], 0, 0 );
+  }
+  else if( 0 == strcmp( name, "patable" ) && 1 == argc )
+  {
+    command[length++] = CMD_SET_PATABLE;
+    command[length++] = (uint8_t)strtol( argv[0], 0, 0 );
+  }
+  else if( 0 == strcmp( name, "slot" ) && 2 == argc )
+  {
+    command[length++] = CMD_SET_SLOT_TIMING;
+    for( index = 0; index < 2; index++ )
+    {
+      value = strtol( argv[index], 0, 0 );
+      command[length++] = (uint8_t)value;
+      command[length++] = (uint8_t)(value >> 8);
+    }
+  }
+  else if( 0 == strcmp( name, "rate" ) && 1 == argc )
+  {
+    value = strtol( argv[0], 0, 0 );
+    command[length++] = CMD_SET_SAMPLE_RATE;
+    command[length++] = (uint8_t)value;
+    command[length++] = (uint8_t)(value >> 8);
+  }
+  else if( 0 == strcmp( name, "stats" ) && 0 == argc )
+  {
+    command[length++] = CMD_GET_STATS;
+  }
+  else
+  {
+    fprintf( stderr, "Bad command or arguments: %s\n", name );
+    return 1;
+  }
+
+  fd = serial_open( device, baud );
+  if( fd < 0 )
+  {
+    return 1;
+  }
+
+  frame_init( &decoder, mode );
+
+  if( send_frame( fd, command, length ) < 0 )
+  {
+    perror( "write" );
+    return 1;
+  }
+
+  if( wait_reply( fd, command[0], &decoder ) < 0 )
+  {
+    fprintf( stderr, "No reply\n" );
+    return 1;
+  }
+
+  status = decoder.buffer[1];
+  data = &decoder.buffer[2];
+  data_length = decoder.length - 2;
+
+  if( status < sizeof(status_names) / sizeof(status_names[0]) )
+  {
+    printf( "%s\n", status_names[status] );
+  }
+  else
+  {
+    printf( "status 0x%02x\n", status );
+  }
+
+  if( CMD_GET_STATS == command[0] && data_length >= COMMAND_UART_STATS_SIZE )
+  {
+    printf( "uart tx dropped frames: %u\n", get16( &data[0] ) );
+    printf( "uart tx dropped bytes: %u\n", get16( &data[2] ) );
+    printf( "uart tx high water: %u\n", data[4] );
+    printf( "uart rx dropped: %u\n", get16( &data[5] ) );
+    data += COMMAND_UART_STATS_SIZE;
+    data_length -= COMMAND_UART_STATS_SIZE;
+  }
+
+  // Anything else (ping echo, application stats) in hex
+  if( data_length )
+  {
+    for( index = 0; index < data_length; index++ )
+    {
+      printf( "%02x%s", data[index], (index + 1 < data_length) ? " " : "\n" );
+    }
+  }
+
+  return (CMD_OK == status) ? 0 : 2;
+}
@@ -0,0 +1,323 @@
+/** @file colstore.c
+*
+* @brief Memory mapped, append only sample storage, one set of files per
+*        end device
+*
+*   Each device gets two files in the store directory:
+*     XX.idx - colstore_header_t followed by one colstore_block_t per block
+*     XX.smp - every sample, uint16_t, in arrival order
+*   Both are mapped, so appending is a copy into memory and readers get
+*   random access without any parsing: block n starts at
+*   samples[blocks[n].first_sample]. The files grow COLSTORE_GROW_BLOCKS
+*   at a time, so the collector rarely makes a system call per block.
+*
+*   Values are stored in host byte order.
+*
+* @author Alvaro Prieto
+*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "colstore.h"
+
+static int map_file( int, void**, size_t, size_t, int );
+static int grow( colstore_t*, uint64_t, uint64_t );
+
+/*******************************************************************************
+ * @fn     size_t index_size( size_t blocks )
+ * @brief  index file size for [blocks] entries
+ * ****************************************************************************/
+static size_t index_size( size_t blocks )
+{
+  return sizeof(colstore_header_t) + blocks * sizeof(colstore_block_t);
+}
+
+/*******************************************************************************
+ * @fn     int colstore_open( colstore_t* store, const char* directory,
+ *                            uint8_t source, uint32_t samples_per_block,
+ *                            int writable )
+ * @brief  open (or for writers, create) the files for [source]. Writers
+ *         continue after the last complete block.
+ * @return 0 on success, -1 on error
+ * ****************************************************************************/
+int colstore_open( colstore_t* store, const char* directory, uint8_t source,
+                                  uint32_t samples_per_block, int writable )
+{
+  char path[4096];
+  struct stat status;
+  int flags = writable ? (O_RDWR | O_CREAT) : O_RDONLY;
+  int created;
+
+  memset( store, 0, sizeof(colstore_t) );
+  store->index_fd = -1;
+  store->sample_fd = -1;
+  store->writable = writable;
+
+  snprintf( path, sizeof(path), "%s/%02x.idx", directory, source );
+  store->index_fd = open( path, flags, 0644 );
+  if( store->index_fd < 0 || fstat( store->index_fd, &status ) < 0 )
+  {
+    perror( path );
+    colstore_close( store );
+    return -1;
+  }
+  created = ( 0 == status.st_size );
+
+  if( !created && (size_t)status.st_size < sizeof(colstore_header_t) )
+  {
+    fprintf( stderr, "%s: truncated\n", path );
+    colstore_close( store );
+    return -1;
+  }
+
+  if( created && !writable )
+  {
+    fprintf( stderr, "%s: empty\n", path );
+    colstore_close( store );
+    return -1;
+  }
+
+  store->block_capacity = created ? COLSTORE_GROW_BLOCKS :
+    (status.st_size - sizeof(colstore_header_t)) / sizeof(colstore_block_t);
+
+  if( map_file( store->index_fd, (void**)&store->header, 0,
+                      index_size( store->block_capacity ), writable ) < 0 )
+  {
+    perror( path );
+    colstore_close( store );
+    return -1;
+  }
+  store->blocks = (colstore_block_t*)( store->header + 1 );
+
+  if( created )
+  {
+    memcpy( store->header->magic, COLSTORE_MAGIC, 8 );
+    store->header->version = COLSTORE_VERSION;
+    store->header->source = source;
+    store->header->samples_per_block = samples_per_block;
+  }
+  else if( memcmp( store->header->magic, COLSTORE_MAGIC, 8 ) ||
+           COLSTORE_VERSION != store->header->version )
+  {
+    fprintf( stderr, "%s: not a sample store\n", path );
+    colstore_close( store );
+    return -1;
+  }
+
+  snprintf( path, sizeof(path), "%s/%02x.smp", directory, source );
+  store->sample_fd = open( path, flags, 0644 );
+  if( store->sample_fd < 0 || fstat( store->sample_fd, &status ) < 0 )
+  {
+    perror( path );
+    colstore_close( store );
+    return -1;
+  }
+
+  store->sample_capacity = status.st_size / sizeof(uint16_t);
+  if( writable && store->sample_capacity < store->block_capacity *
+                                          store->header->samples_per_block )
+  {
+    store->sample_capacity = store->block_capacity *
+                                          store->header->samples_per_block;
+  }
+
+  if( store->sample_capacity && map_file( store->sample_fd,
+        (void**)&store->samples, 0,
+        store->sample_capacity * sizeof(uint16_t), writable ) < 0 )
+  {
+    perror( path );
+    colstore_close( store );
+    return -1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int colstore_append( colstore_t* store, uint8_t sequence,
+ *                              uint8_t shift, uint64_t time_ns,
+ *                              uint16_t* samples, uint16_t count )
+ * @brief  add one block. The 8-bit sequence number from the packet is
+ *         extended from the previous block, gaps are counted as missing.
+ * @return Blocks missing before this one, -1 on error
+ * ****************************************************************************/
+int colstore_append( colstore_t* store, uint8_t sequence, uint8_t shift,
+                          uint64_t time_ns, uint16_t* samples, uint16_t count )
+{
+  colstore_header_t* header = store->header;
+  colstore_block_t* block;
+  uint8_t missed = 0;
+  uint32_t extended = sequence;
+
+  if( (header->blocks + 1 > store->block_capacity) ||
+      (header->samples + count > store->sample_capacity) )
+  {
+    if( grow( store, header->blocks + 1, header->samples + count ) < 0 )
+    {
+      return -1;
+    }
+    header = store->header;
+  }
+
+  if( header->blocks )
+  {
+    block = &store->blocks[header->blocks - 1];
+    missed = (uint8_t)( sequence - (uint8_t)block->sequence - 1 );
+    extended = block->sequence + 1 + missed;
+  }
+
+  block = &store->blocks[header->blocks];
+  block->time_ns = time_ns;
+  block->first_sample = header->samples;
+  block->sequence = extended;
+  block->count = count;
+  block->shift = shift;
+  block->missing_before = missed;
+
+  memcpy( &store->samples[header->samples], samples,
+                                              count * sizeof(uint16_t) );
+
+  // Data first, then the counts readers go by
+  __atomic_store_n( &header->samples, header->samples + count,
+                                                        __ATOMIC_RELEASE );
+  header->missing += missed;
+  __atomic_store_n( &header->blocks, header->blocks + 1, __ATOMIC_RELEASE );
+
+  return missed;
+}
+
+/*******************************************************************************
+ * @fn     void colstore_close( colstore_t* store )
+ * @brief  unmap and close. Writers trim the files to the data written.
+ * ****************************************************************************/
+void colstore_close( colstore_t* store )
+{
+  uint64_t blocks = 0;
+  uint64_t samples = 0;
+
+  if( store->header )
+  {
+    blocks = store->header->blocks;
+    samples = store->header->samples;
+    munmap( store->header, index_size( store->block_capacity ) );
+  }
+  if( store->samples )
+  {
+    munmap( store->samples, store->sample_capacity * sizeof(uint16_t) );
+  }
+
+  if( store->writable && store->header )
+  {
+    if( ftruncate( store->index_fd, index_size( blocks ) ) < 0 ||
+        ftruncate( store->sample_fd, samples * sizeof(uint16_t) ) < 0 )
+    {
+      perror( "ftruncate" );
+    }
+  }
+
+  if( store->index_fd >= 0 )
+  {
+    close( store->index_fd );
+  }
+  if( store->sample_fd >= 0 )
+  {
+    close( store->sample_fd );
+  }
+
+  memset( store, 0, sizeof(colstore_t) );
+  store->index_fd = -1;
+  store->sample_fd = -1;
+}
+
+/*******************************************************************************
+ * @fn     int grow( colstore_t* store, uint64_t blocks, uint64_t samples )
+ * @brief  make room for [blocks] index entries and [samples] samples
+ * ****************************************************************************/
+static int grow( colstore_t* store, uint64_t blocks, uint64_t samples )
+{
+  size_t block_capacity = store->block_capacity;
+  size_t sample_capacity = store->sample_capacity;
+  size_t step = COLSTORE_GROW_BLOCKS * store->header->samples_per_block;
+
+  if( !store->writable )
+  {
+    errno = EROFS;
+    return -1;
+  }
+
+  while( block_capacity < blocks )
+  {
+    block_capacity += COLSTORE_GROW_BLOCKS;
+  }
+  while( sample_capacity < samples )
+  {
+    sample_capacity += step ? step : COLSTORE_GROW_BLOCKS;
+  }
+
+  if( block_capacity != store->block_capacity )
+  {
+    if( map_file( store->index_fd, (void**)&store->header,
+                  index_size( store->block_capacity ),
+                  index_size( block_capacity ), 1 ) < 0 )
+    {
+      perror( "index" );
+      return -1;
+    }
+    store->blocks = (colstore_block_t*)( store->header + 1 );
+    store->block_capacity = block_capacity;
+  }
+
+  if( sample_capacity != store->sample_capacity )
+  {
+    if( map_file( store->sample_fd, (void**)&store->samples,
+                  store->sample_capacity * sizeof(uint16_t),
+                  sample_capacity * sizeof(uint16_t), 1 ) < 0 )
+    {
+      perror( "samples" );
+      return -1;
+    }
+    store->sample_capacity = sample_capacity;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int map_file( int fd, void** map, size_t old_size, size_t size,
+ *                                                        int writable )
+ * @brief  map [size] bytes of a file, or resize an existing mapping of
+ *         [old_size] bytes. Writers extend the file first.
+ * ****************************************************************************/
+static int map_file( int fd, void** map, size_t old_size, size_t size,
+                                                              int writable )
+{
+  void* result;
+
+  if( writable && ftruncate( fd, size ) < 0 )
+  {
+    return -1;
+  }
+
+  if( *map && old_size )
+  {
+    result = mremap( *map, old_size, size, MREMAP_MAYMOVE );
+  }
+  else
+  {
+    result = mmap( 0, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                                                      MAP_SHARED, fd, 0 );
+  }
+
+  if( MAP_FAILED == result )
+  {
+    return -1;
+  }
+
+  *map = result;
+  return 0;
+}
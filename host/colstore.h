@@ -0,0 +1,63 @@
+/** @file colstore.h
+*
+* @brief Memory mapped, append only sample storage, one set of files per
+*        end device
+*
+* @author Alvaro Prieto
+*/
+#ifndef _COLSTORE_H
+#define _COLSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COLSTORE_MAGIC "CC430COL"
+#define COLSTORE_VERSION (1)
+
+// Files grow by this many blocks (and samples per block) at a time
+#define COLSTORE_GROW_BLOCKS (4096)
+
+// Start of the index file. Counts only cover complete blocks, readers can
+// use everything below them while the collector keeps appending.
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t source;
+  uint32_t samples_per_block;
+  uint32_t reserved;
+  uint64_t blocks;          // Blocks in the index
+  uint64_t samples;         // Samples in the sample file
+  uint64_t missing;         // Blocks lost, from sequence gaps
+} colstore_header_t;
+
+// One index entry per block, followed by the header in the index file
+typedef struct
+{
+  uint64_t time_ns;         // Host receive time, CLOCK_REALTIME
+  uint64_t first_sample;    // Position of the block in the sample file
+  uint32_t sequence;        // Block sequence number, extended past 8 bits
+  uint16_t count;           // Samples in the block
+  uint8_t shift;            // LSBs dropped by the end device
+  uint8_t missing_before;   // Blocks lost just before this one
+} colstore_block_t;
+
+typedef struct
+{
+  int index_fd;
+  int sample_fd;
+  int writable;
+  colstore_header_t* header;  // Index file mapping
+  colstore_block_t* blocks;   // Entries after the header
+  uint16_t* samples;          // Sample file mapping, 12-bit samples
+  size_t block_capacity;
+  size_t sample_capacity;
+} colstore_t;
+
+int colstore_open( colstore_t*, const char*, uint8_t, uint32_t, int );
+int colstore_append( colstore_t*, uint8_t, uint8_t, uint64_t, uint16_t*,
+                                                                  uint16_t );
+void colstore_close( colstore_t* );
+
+#endif /* _COLSTORE_H */\
+
@@ -0,0 +1,311 @@
+/** @file energyest.c
+*
+* @brief Average current and battery life from the energy summaries sent by
+*        firmware built with ENERGY_PROFILE
+*
+*   Reads the framed stream (device, file or stdin) and prints one CSV line
+*   per summary:
+*     address,role,seconds,cpu%,rx%,tx%,adc%,uart%,wakeups_per_s,ma,days
+*   At the end of the stream the totals per node and per role go to stderr.
+*
+*   The current drawn by each subsystem while it is on comes from the CC430
+*   and CC1101 datasheet figures below, the rest of the time the device is
+*   asleep: in LPM0 for the access point, whose main loop keeps SMCLK for the
+*   UART, and in LPM3 for everything else. The UART adds what keeping SMCLK
+*   on costs over LPM3. TX current depends on the PA setting, -t sets it
+*   (17mA is 0dBm, about 33mA for the +10dBm PATABLE_VAL_10DBM).
+*
+*   usage: energyest [-b baud] [-e] [-c mAh] [-t tx_mA] [device|file|-]
+*     -e  escaped framing instead of COBS
+*     -c  battery capacity, default BATTERY_MAH
+*
+* @author Alvaro Prieto
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "energy.h"
+#include "frame.h"
+#include "serial.h"
+
+#define MAX_NODES (256)
+
+// Supply current in mA, 3V, 12MHz MCLK at PMMCOREV 2
+#define CURRENT_ACTIVE (2.6)
+#define CURRENT_LPM0 (0.085)
+#define CURRENT_LPM3 (0.002)
+#define CURRENT_RX (16.0)
+#define CURRENT_TX (17.0)
+#define CURRENT_ADC (0.2)
+
+// Two AA cells
+#define BATTERY_MAH (2000.0)
+
+typedef struct
+{
+  uint32_t summaries;       // 0 until the node has reported
+  uint8_t role;
+  uint64_t interval;
+  uint64_t active[ENERGY_SUBSYSTEMS];
+  uint64_t wakeups;
+} node_t;
+
+typedef struct
+{
+  double capacity;
+  double tx_current;
+} model_t;
+
+static const char* role_names[ENERGY_ROLES] =
+{
+  "ap", "end_device", "relay", "beacon"
+};
+
+static node_t nodes[MAX_NODES];
+
+/*******************************************************************************
+ * @fn     uint32_t get_le( uint8_t* buffer, uint8_t size )
+ * @return the [size] byte little endian value at [buffer]
+ * ****************************************************************************/
+static uint32_t get_le( uint8_t* buffer, uint8_t size )
+{
+  uint32_t value = 0;
+
+  while( size-- )
+  {
+    value = ( value << 8 ) | buffer[size];
+  }
+
+  return value;
+}
+
+/*******************************************************************************
+ * @fn     const char* role_name( uint8_t role )
+ * @return printable name of [role]
+ * ****************************************************************************/
+static const char* role_name( uint8_t role )
+{
+  return ( role < ENERGY_ROLES ) ? role_names[role] : "unknown";
+}
+
+/*******************************************************************************
+ * @fn     double average_current( model_t* model, uint8_t role,
+ *                                 uint64_t interval, uint64_t* active )
+ * @brief  average supply current over [interval] ticks, [active] ticks of
+ *         it for each subsystem
+ * @return Current in mA
+ * ****************************************************************************/
+static double average_current( model_t* model, uint8_t role,
+                               uint64_t interval, uint64_t* active )
+{
+  double duty[ENERGY_SUBSYSTEMS];
+  double sleep = ( ENERGY_ROLE_AP == role ) ? CURRENT_LPM0 : CURRENT_LPM3;
+  uint8_t index;
+
+  for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+  {
+    duty[index] = (double)active[index] / interval;
+    if( duty[index] > 1.0 )
+    {
+      duty[index] = 1.0;
+    }
+  }
+
+  return sleep + duty[ENERGY_CPU] * ( CURRENT_ACTIVE - sleep ) +
+         duty[ENERGY_RADIO_RX] * CURRENT_RX +
+         duty[ENERGY_RADIO_TX] * model->tx_current +
+         duty[ENERGY_ADC] * CURRENT_ADC +
+         duty[ENERGY_UART] * ( CURRENT_LPM0 - sleep );
+}
+
+/*******************************************************************************
+ * @fn     void print_line( model_t* model, uint8_t address, uint8_t role,
+ *                          uint64_t interval, uint64_t* active,
+ *                          uint64_t wakeups, FILE* file )
+ * @brief  one CSV line with the duty cycles, current and battery life
+ * ****************************************************************************/
+static void print_line( model_t* model, uint8_t address, uint8_t role,
+                        uint64_t interval, uint64_t* active, uint64_t wakeups,
+                        FILE* file )
+{
+  double seconds = (double)interval / ENERGY_TICK_FREQUENCY;
+  double current = average_current( model, role, interval, active );
+  uint8_t index;
+
+  fprintf( file, "%02X,%s,%.1f", address, role_name( role ), seconds );
+  for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+  {
+    fprintf( file, ",%.3f", 100.0 * active[index] / interval );
+  }
+  fprintf( file, ",%.2f,%.4f,%.1f\n", wakeups / seconds, current,
+           model->capacity / current / 24 );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t process_summary( model_t* model, uint8_t* frame,
+ *                                                          uint16_t size )
+ * @brief  print a summary frame and add it to the node totals
+ * @return 1 if the frame was a summary
+ * ****************************************************************************/
+static uint8_t process_summary( model_t* model, uint8_t* frame, uint16_t size )
+{
+  uint64_t active[ENERGY_SUBSYSTEMS];
+  node_t* node;
+  uint32_t interval;
+  uint16_t wakeups;
+  uint8_t index;
+
+  if( ( size < ENERGY_SUMMARY_SIZE ) || ( ENERGY_SUMMARY_TYPE != frame[0] ) )
+  {
+    return 0;
+  }
+
+  interval = get_le( &frame[3], 4 );
+  for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+  {
+    active[index] = get_le( &frame[7 + 4 * index], 4 );
+  }
+  wakeups = get_le( &frame[7 + 4 * ENERGY_SUBSYSTEMS], 2 );
+
+  if( 0 == interval )
+  {
+    return 0;
+  }
+
+  print_line( model, frame[2], frame[1], interval, active, wakeups, stdout );
+
+  node = &nodes[frame[2]];
+  node->summaries++;
+  node->role = frame[1];
+  node->interval += interval;
+  for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+  {
+    node->active[index] += active[index];
+  }
+  node->wakeups += wakeups;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     void print_totals( model_t* model )
+ * @brief  whole stream averages per node, then the mean current and battery
+ *         life of the nodes in each role
+ * ****************************************************************************/
+static void print_totals( model_t* model )
+{
+  double role_current[ENERGY_ROLES];
+  uint32_t role_nodes[ENERGY_ROLES];
+  double current;
+  uint32_t address;
+  uint8_t role;
+
+  memset( role_current, 0, sizeof(role_current) );
+  memset( role_nodes, 0, sizeof(role_nodes) );
+
+  fprintf( stderr, "address,role,seconds,cpu%%,rx%%,tx%%,adc%%,uart%%,"
+           "wakeups_per_s,ma,days\n" );
+  for( address = 0; address < MAX_NODES; address++ )
+  {
+    if( !nodes[address].summaries )
+    {
+      continue;
+    }
+
+    role = nodes[address].role;
+    print_line( model, address, role, nodes[address].interval,
+                nodes[address].active, nodes[address].wakeups, stderr );
+
+    if( role < ENERGY_ROLES )
+    {
+      role_current[role] += average_current( model, role,
+                              nodes[address].interval, nodes[address].active );
+      role_nodes[role]++;
+    }
+  }
+
+  for( role = 0; role < ENERGY_ROLES; role++ )
+  {
+    if( role_nodes[role] )
+    {
+      current = role_current[role] / role_nodes[role];
+      fprintf( stderr, "%s: %u nodes, %.4f mA, %.1f days on %.0f mAh\n",
+               role_names[role], role_nodes[role], current,
+               model->capacity / current / 24, model->capacity );
+    }
+  }
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-b baud] [-e] [-c mAh] [-t tx_mA] [device]\n",
+           name );
+}
+
+int main( int argc, char** argv )
+{
+  frame_decoder_t decoder;
+  model_t model = { BATTERY_MAH, CURRENT_TX };
+  uint8_t buffer[256];
+  uint8_t mode = FRAME_MODE_COBS;
+  long baud = SERIAL_DEFAULT_BAUD;
+  const char* path = "-";
+  uint32_t summaries = 0;
+  ssize_t received;
+  ssize_t index;
+  int option;
+  int fd;
+
+  while( (option = getopt( argc, argv, "b:ec:t:" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'b': baud = atol( optarg ); break;
+      case 'e': mode = FRAME_MODE_ESCAPED; break;
+      case 'c': model.capacity = atof( optarg ); break;
+      case 't': model.tx_current = atof( optarg ); break;
+      default: usage( argv[0] ); return 1;
+    }
+  }
+
+  if( optind < argc )
+  {
+    path = argv[optind];
+  }
+
+  if( model.capacity <= 0 || model.tx_current < 0 )
+  {
+    usage( argv[0] );
+    return 1;
+  }
+
+  fd = serial_open( path, baud );
+  if( fd < 0 )
+  {
+    return 1;
+  }
+
+  frame_init( &decoder, mode );
+
+  while( (received = read( fd, buffer, sizeof(buffer) )) > 0 )
+  {
+    for( index = 0; index < received; index++ )
+    {
+      if( frame_push( &decoder, buffer[index] ) )
+      {
+        summaries += process_summary( &model, decoder.buffer,
+                                                      decoder.length );
+      }
+    }
+    fflush( stdout );
+  }
+
+  print_totals( &model );
+
+  fprintf( stderr, "%u summaries in %u frames, %u bad, %u bad CRC, "
+    "%u missing\n", summaries, decoder.frames, decoder.errors,
+    decoder.crc_errors, decoder.missing );
+
+  return 0;
+}
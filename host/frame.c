@@ -0,0 +1,208 @@
+/** @file frame.c
+*
+* @brief Host side decoding of the framed serial stream sent by access points
+*
+*   Handles both formats produced by uart_queue_frame. Escaped frames are
+*   returned as they are. COBS frames are decoded, checked against their
+*   CRC-16 and returned without the sequence number and CRC. Sequence number
+*   gaps are counted in decoder->missing, this includes frames the access
+*   point dropped because its UART ring was full.
+*
+* @author Alvaro Prieto
+*/
+#include <string.h>
+#include "crc.h"
+#include "frame.h"
+
+static int escaped_push( frame_decoder_t*, uint8_t );
+static int cobs_push( frame_decoder_t*, uint8_t );
+static int cobs_frame( frame_decoder_t* );
+
+/*******************************************************************************
+ * @fn     void frame_init( frame_decoder_t* decoder, uint8_t mode )
+ * @brief  reset decoder state and counters, mode is FRAME_MODE_ESCAPED or
+ *         FRAME_MODE_COBS
+ * ****************************************************************************/
+void frame_init( frame_decoder_t* decoder, uint8_t mode )
+{
+  memset( decoder, 0, sizeof(frame_decoder_t) );
+  decoder->mode = mode;
+}
+
+/*******************************************************************************
+ * @fn     int frame_push( frame_decoder_t* decoder, uint8_t byte )
+ * @brief  feed one received byte to the decoder
+ * @return 1 when decoder->buffer holds a complete frame of decoder->length
+ *         bytes. The frame stays valid until the next call.
+ * ****************************************************************************/
+int frame_push( frame_decoder_t* decoder, uint8_t byte )
+{
+  // Previous call returned a frame, start a new one
+  if( decoder->ready )
+  {
+    decoder->ready = 0;
+    decoder->length = 0;
+  }
+
+  if( FRAME_MODE_COBS == decoder->mode )
+  {
+    return cobs_push( decoder, byte );
+  }
+
+  return escaped_push( decoder, byte );
+}
+
+/*******************************************************************************
+ * @fn     int escaped_push( frame_decoder_t* decoder, uint8_t byte )
+ * @brief  0x7e delimited, 0x7d escaped frames (uart_write_escaped)
+ * ****************************************************************************/
+static int escaped_push( frame_decoder_t* decoder, uint8_t byte )
+{
+  // A flag both ends the current frame and starts the next one
+  if( FRAME_FLAG == byte )
+  {
+    if( decoder->overflow || decoder->escaped )
+    {
+      decoder->errors++;
+      decoder->length = 0;
+    }
+    else if( decoder->length > 0 )
+    {
+      decoder->frames++;
+      decoder->ready = 1;
+    }
+
+    decoder->escaped = 0;
+    decoder->overflow = 0;
+
+    return decoder->ready;
+  }
+
+  if( FRAME_ESCAPE == byte )
+  {
+    decoder->escaped = 1;
+    return 0;
+  }
+
+  if( decoder->escaped )
+  {
+    byte ^= FRAME_ESCAPE_XOR;
+    decoder->escaped = 0;
+  }
+
+  if( decoder->length < FRAME_MAX_SIZE )
+  {
+    decoder->buffer[decoder->length++] = byte;
+  }
+  else
+  {
+    decoder->overflow = 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int cobs_push( frame_decoder_t* decoder, uint8_t byte )
+ * @brief  0x00 delimited COBS frames (uart_queue_cobs). Bytes are collected
+ *         as they arrive and decoded in place at the delimiter.
+ * ****************************************************************************/
+static int cobs_push( frame_decoder_t* decoder, uint8_t byte )
+{
+  if( 0x00 == byte )
+  {
+    if( decoder->overflow )
+    {
+      decoder->errors++;
+    }
+    else if( decoder->length > 0 )
+    {
+      decoder->ready = cobs_frame( decoder );
+    }
+
+    if( !decoder->ready )
+    {
+      decoder->length = 0;
+    }
+    decoder->overflow = 0;
+
+    return decoder->ready;
+  }
+
+  if( decoder->length < FRAME_MAX_SIZE )
+  {
+    decoder->buffer[decoder->length++] = byte;
+  }
+  else
+  {
+    decoder->overflow = 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int cobs_frame( frame_decoder_t* decoder )
+ * @brief  decode the COBS frame in decoder->buffer, check the CRC and strip
+ *         the sequence number and CRC
+ * @return 1 if the frame is good
+ * ****************************************************************************/
+static int cobs_frame( frame_decoder_t* decoder )
+{
+  uint8_t* buffer = decoder->buffer;
+  uint16_t in = 0;
+  uint16_t out = 0;
+  uint8_t code;
+  uint8_t count;
+  uint8_t missed;
+
+  // Decoded data is never longer than the encoded data, so decode in place
+  while( in < decoder->length )
+  {
+    code = buffer[in++];
+
+    if( (in + code - 1) > decoder->length )
+    {
+      decoder->errors++;
+      return 0;
+    }
+
+    for( count = 1; count < code; count++ )
+    {
+      buffer[out++] = buffer[in++];
+    }
+
+    // Blocks shorter than 254 bytes stand for a zero, except the last one
+    if( (code < 0xFF) && (in < decoder->length) )
+    {
+      buffer[out++] = 0x00;
+    }
+  }
+
+  // Sequence number and CRC at least
+  if( out < 3 )
+  {
+    decoder->errors++;
+    return 0;
+  }
+
+  if( 0 != crc16( CRC16_INIT, buffer, out ) )
+  {
+    decoder->crc_errors++;
+    return 0;
+  }
+
+  if( decoder->synced )
+  {
+    missed = (uint8_t)( buffer[0] - decoder->sequence - 1 );
+    decoder->missing += missed;
+  }
+  decoder->sequence = buffer[0];
+  decoder->synced = 1;
+  decoder->frames++;
+
+  decoder->length = out - 3;
+  memmove( buffer, &buffer[1], decoder->length );
+
+  return 1;
+}
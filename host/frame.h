@@ -0,0 +1,43 @@
+/** @file frame.h
+*
+* @brief Host side decoding of the framed serial stream sent by access points
+*
+* @author Alvaro Prieto
+*/
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include <stdint.h>
+
+#define FRAME_MAX_SIZE (512)
+
+// Framing used by uart_write_escaped
+#define FRAME_FLAG (0x7e)
+#define FRAME_ESCAPE (0x7d)
+#define FRAME_ESCAPE_XOR (0x20)
+
+// Stream formats, see uart_queue_frame
+#define FRAME_MODE_ESCAPED (0)
+#define FRAME_MODE_COBS (1)
+
+typedef struct
+{
+  uint8_t buffer[FRAME_MAX_SIZE];
+  uint16_t length;
+  uint8_t mode;
+  uint8_t escaped;
+  uint8_t overflow;
+  uint8_t ready;
+  uint8_t sequence;       // Sequence number of the last COBS frame
+  uint8_t synced;         // Set once a COBS frame has been received
+  uint32_t frames;
+  uint32_t errors;        // Malformed or truncated frames
+  uint32_t crc_errors;    // COBS frames that failed the CRC check
+  uint32_t missing;       // COBS frames lost, from sequence number gaps
+} frame_decoder_t;
+
+void frame_init( frame_decoder_t*, uint8_t );
+int frame_push( frame_decoder_t*, uint8_t );
+
+#endif /* _FRAME_H */\
+
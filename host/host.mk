@@ -0,0 +1,226 @@
+# Host tools
+# Built with the native compiler, e.g. 'make sampledecode'
+# Binaries are placed in $(BUILD_DIR)/host
+
+HOSTCC = gcc
+HOST_DIR = $(BUILD_DIR)/host
+
+HOSTCFLAGS += \
+	-O2 -Wall -g \
+	-I"host" \
+	-I"lib" \
+
+SAMPLEDECODE_SOURCE += \
+	lib/codec.c \
+	lib/crc.c \
+	host/frame.c \
+	host/packet.c \
+	host/serial.c \
+	host/sampledecode.c
+
+sampledecode: $(SAMPLEDECODE_SOURCE)
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(SAMPLEDECODE_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, sampledecode) $(HOSTLFLAGS)
+	@echo
+	@echo Sample decoder build complete
+
+APCOMMAND_SOURCE += \
+	lib/crc.c \
+	host/frame.c \
+	host/serial.c \
+	host/apcommand.c
+
+apcommand: $(APCOMMAND_SOURCE)
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(APCOMMAND_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, apcommand) $(HOSTLFLAGS)
+	@echo
+	@echo Access point command tool build complete
+
+RSSIDECODE_SOURCE += \
+	lib/crc.c \
+	lib/format.c \
+	host/frame.c \
+	host/serial.c \
+	host/rssidecode.c
+
+rssidecode: $(RSSIDECODE_SOURCE)
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(RSSIDECODE_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, rssidecode) $(HOSTLFLAGS)
+	@echo
+	@echo RSSI decoder build complete
+
+ENERGYEST_SOURCE += \
+	lib/crc.c \
+	host/frame.c \
+	host/serial.c \
+	host/energyest.c
+
+energyest: $(ENERGYEST_SOURCE) lib/energy.h
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(ENERGYEST_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, energyest) $(HOSTLFLAGS)
+	@echo
+	@echo Energy estimator build complete
+
+SAMPLECOLLECT_SOURCE += \
+	lib/codec.c \
+	lib/crc.c \
+	host/colstore.c \
+	host/frame.c \
+	host/packet.c \
+	host/serial.c \
+	host/samplecollect.c
+
+samplecollect: $(SAMPLECOLLECT_SOURCE)
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(SAMPLECOLLECT_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, samplecollect) $(HOSTLFLAGS)
+	@echo
+	@echo Sample collector build complete
+
+RSSILOCATE_SOURCE += \
+	host/rssilocate.c
+
+rssilocate: $(RSSILOCATE_SOURCE)
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(RSSILOCATE_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, rssilocate) $(HOSTLFLAGS) -lm
+	@echo
+	@echo RSSI locator build complete
+
+# 200 tags heard by 4 access points for 6 packets, -t prints the latency
+# of each packet across all the tags
+RSSILOCATE_FIXTURE = host/fixtures/rssi_200tags.csv
+RSSILOCATE_APS = host/fixtures/rssi_aps.cfg
+
+rssilocate-bench: rssilocate
+	$(HOST_DIR)/rssilocate -t -c $(RSSILOCATE_APS) $(RSSILOCATE_FIXTURE) \
+		> /dev/null
+
+# lib/ built for the host against the peripheral model in lib/hal_host.c,
+# for host programs that run firmware code. Old style inline semantics and
+# common tentative definitions to match mspgcc.
+HOSTLIB_CFLAGS += \
+	$(HOSTCFLAGS) \
+	-std=gnu99 -fgnu89-inline -fcommon -fPIC -Wno-pointer-sign \
+	-DHOST_BUILD \
+	-DMHZ_915_CUSTOM \
+	-I"." \
+
+HOSTLIB_SOURCE = $(wildcard lib/*.c)
+
+HOSTLIB_OBJS = $(patsubst lib/%.c, $(HOST_DIR)/lib/%.o, $(HOSTLIB_SOURCE))
+
+$(HOST_DIR)/lib/%.o: lib/%.c lib/*.h
+	@mkdir -p $(HOST_DIR)/lib
+	$(HOSTCC) $(HOSTLIB_CFLAGS) -DDEVICE_ADDRESS=$(ADDRESS) -c $< -o $@
+
+hostlib: $(HOSTLIB_OBJS)
+	ar rcs $(addprefix $(HOST_DIR)/, libcc430.a) $(HOSTLIB_OBJS)
+	@echo
+	@echo Host library build complete
+
+# Unit tests of lib/ against the peripheral model, one program per file in
+# host/test, linked with the host library. Stops at the first one that fails.
+HOSTTEST_DIR = $(HOST_DIR)/test
+
+HOSTTESTS = test_delay test_format test_radio test_timers test_uart test_vtimer
+
+HOSTTEST_SOURCE += \
+	host/frame.c
+
+$(HOSTTEST_DIR)/%: host/test/%.c host/test/test.h $(HOSTTEST_SOURCE) \
+		$(HOSTLIB_OBJS) | hostlib
+	@mkdir -p $(HOSTTEST_DIR)
+	$(HOSTCC) $(HOSTLIB_CFLAGS) -DDEVICE_ADDRESS=$(ADDRESS) $< \
+		$(HOSTTEST_SOURCE) $(addprefix $(HOST_DIR)/, libcc430.a) -o $@ \
+		$(HOSTLFLAGS)
+
+hosttest: $(addprefix $(HOSTTEST_DIR)/, $(HOSTTESTS))
+	@for test in $(HOSTTESTS); do \
+		$(HOSTTEST_DIR)/$$test || exit 1; \
+	done
+	@echo
+	@echo Host tests passed
+
+# samplecollect reading a recorded access point stream from a pty, see
+# host/test/test_samplecollect.c
+SAMPLECOLLECT_TEST_SOURCE += \
+	lib/codec.c \
+	lib/crc.c \
+	host/colstore.c \
+	host/frame.c \
+	host/packet.c \
+	host/test/test_samplecollect.c
+
+SAMPLECOLLECT_FIXTURE = host/fixtures/samples_escaped.bin
+SAMPLECOLLECT_TEST_DIR = $(HOSTTEST_DIR)/samplecollect
+
+samplecollect-test: samplecollect $(SAMPLECOLLECT_TEST_SOURCE) host/test/test.h
+	@mkdir -p $(HOSTTEST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) $(SAMPLECOLLECT_TEST_SOURCE) -o \
+		$(addprefix $(HOSTTEST_DIR)/, test_samplecollect) $(HOSTLFLAGS)
+	@rm -rf $(SAMPLECOLLECT_TEST_DIR)
+	@mkdir -p $(SAMPLECOLLECT_TEST_DIR)
+	$(HOSTTEST_DIR)/test_samplecollect $(HOST_DIR)/samplecollect \
+		$(SAMPLECOLLECT_FIXTURE) $(SAMPLECOLLECT_TEST_DIR)
+
+# Network simulator. Each application is built as a shared object that
+# netsim loads once per node, with the device address set at run time.
+# Applications are instrumented so busy loops take simulated CPU time, the
+# peripheral model isn't.
+SIM_DIR = $(HOST_DIR)/sim
+
+SIM_CFLAGS += \
+	$(HOSTLIB_CFLAGS) \
+	-DDEVICE_ADDRESS=hal_host_address \
+
+SIM_LIB_SOURCE = $(filter-out lib/hal_host.c, $(wildcard lib/*.c))
+
+SIM_NODES = demoap demoed demore rssiwban rssitest
+
+$(SIM_DIR)/demoap.so: demo/access_point.c
+$(SIM_DIR)/demoed.so: demo/end_device.c
+$(SIM_DIR)/demore.so: demo/relay.c
+$(SIM_DIR)/rssiwban.so: rssiwban/rssiwban.c
+$(SIM_DIR)/rssitest.so: rssitest/rssitest.c
+
+$(SIM_DIR)/hal_host.o: lib/hal_host.c lib/hal_host.h
+	@mkdir -p $(SIM_DIR)
+	$(HOSTCC) $(SIM_CFLAGS) -c lib/hal_host.c -o $@
+
+$(SIM_DIR)/%.so: $(SIM_LIB_SOURCE) $(SIM_DIR)/hal_host.o lib/*.h
+	$(HOSTCC) $(SIM_CFLAGS) -fsanitize-coverage=trace-pc -shared \
+		-Wl,-Bsymbolic $(filter %.c, $^) $(SIM_DIR)/hal_host.o -o $@
+
+NETSIM_SOURCE += \
+	host/netsim.c
+
+netsim: $(NETSIM_SOURCE) $(addprefix $(SIM_DIR)/, $(addsuffix .so, $(SIM_NODES)))
+	$(HOSTCC) $(HOSTCFLAGS) $(NETSIM_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, netsim) $(HOSTLFLAGS) -rdynamic -ldl -lm
+	@echo
+	@echo Network simulator build complete
+
+# Every scenario in host/scenarios, stops at the first one netsim rejects
+NETSIM_SCENARIOS = $(wildcard host/scenarios/*.scn)
+
+netsim-scenarios: netsim
+	@for scenario in $(NETSIM_SCENARIOS); do \
+		echo "== $$scenario"; \
+		$(HOST_DIR)/netsim -l $(SIM_DIR) $$scenario || exit 1; \
+		echo; \
+	done
+
+PERFCOMPARE_SOURCE += \
+	host/perfcompare.c
+
+perfcompare: $(PERFCOMPARE_SOURCE) perfbench/perfbench.h
+	@mkdir -p $(HOST_DIR)
+	$(HOSTCC) $(HOSTCFLAGS) -I"perfbench" $(PERFCOMPARE_SOURCE) -o \
+		$(addprefix $(HOST_DIR)/, perfcompare) $(HOSTLFLAGS)
+	@echo
+	@echo Benchmark comparison tool build complete
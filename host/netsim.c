@@ -0,0 +1,1318 @@
+/** @file netsim.c
+*
+* @brief Discrete event simulation of a network of devices running the
+*        unmodified firmware
+*
+*   Each node loads its own copy of an application built with 'make netsim'
+*   (the application and lib/ linked against the peripheral model in
+*   lib/hal_host.c) and runs its main() on a separate stack. Nodes take turns
+*   in simulated time order:
+*     - CPU time comes from the basic blocks the firmware executes, counted
+*       through -fsanitize-coverage=trace-pc. A busy node gives way every
+*       SLICE_BLOCKS blocks.
+*     - A node in a low power mode sleeps until its next Timer0_A event or
+*       until the radio channel has something for it.
+*     - Timer0_A runs from ACLK, each node's crystal is off by a random error
+*       of up to +/- the given ppm.
+*     - The ADC sees a sine wave with a random phase per node.
+*     - UART output is counted, and written to a file per node with -o.
+*
+*   Transmissions occupy the channel for their airtime, worked out from the
+*   data rate, preamble, sync word and CRC settings. When one ends, every
+*   node on the same channel that hears it above the sensitivity gets the
+*   packet with the received power as RSSI. The CRC fails if overlapping
+*   transmissions leave the signal less than the capture margin above their
+*   combined power. Nodes that were transmitting, or whose radio wasn't in
+*   RX, miss the packet.
+*     received dBm = tx dBm - loss at 1 m - 10 n log10( d / 1m )
+*
+*   Packets are identified by their contents. One counts as delivered when a
+*   sink first receives it with a good CRC, relays forwarding it unchanged
+*   don't make it a new packet. Loss, throughput and latency are for packets
+*   sent by nodes other than sinks.
+*
+*   The scenario file has one directive per line, # starts a comment:
+*     duration <s>                          simulated time, default 10
+*     channel <loss> <n> <sensitivity> <capture>
+*                                           dB at 1 m, path loss exponent,
+*                                           dBm and dB (40 3.0 -100 6)
+*     node <app> <address> <x> <y> [sink]   app is one of the .so names,
+*                                           address in hex, x/y in m
+*
+*   usage: netsim [-l libdir] [-o outdir] [-s seed] [-p ppm] scenario
+*
+* @author Alvaro Prieto
+*/
+#include <dlfcn.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "hal_host.h"
+
+#define MAX_NODES (1024)
+#define STACK_SIZE (256 * 1024)
+#define SLICE_BLOCKS (1024)
+#define DEFAULT_LIBDIR "build/host/sim"
+#define DEFAULT_DURATION (10.0)
+#define DEFAULT_PPM (20.0)
+#define DEFAULT_LOSS (40.0)
+#define DEFAULT_EXPONENT (3.0)
+#define DEFAULT_SENSITIVITY (-100.0)
+#define DEFAULT_CAPTURE (6.0)
+#define DEFAULT_TX_DBM (0.0)
+#define MAX_BOOT_DELAY (0.1)
+#define ACLK_HZ (32768.0)
+#define XOSC_HZ (26000000.0)
+#define MCLK_HZ (12000000.0)
+#define CYCLES_PER_BLOCK (4.0)
+#define BLOCK_TIME (CYCLES_PER_BLOCK / MCLK_HZ)
+#define ADC_SIGNAL_HZ (5.0)
+#define HISTORY_SPAN (1.0)
+#define ORIGIN_WINDOW (2.0)
+#define PACKET_SIZE (64)
+#define NO_TRANSMISSION (0xFFFFFFFF)
+
+#define CHANNEL_PENDING() ( &history[channel_pending & ( history_size - 1 )] )
+
+typedef struct event
+{
+  struct event* next;
+  double time;
+  uint8_t tx_done;
+  uint8_t rssi;
+  uint8_t crc_ok;
+  uint8_t packet[PACKET_SIZE];
+} event_t;
+
+typedef struct
+{
+  uint32_t sender;
+  uint8_t channel;
+  uint8_t resolved;
+  double start;
+  double end;
+  double dbm;
+  uint8_t packet[PACKET_SIZE];
+} transmission_t;
+
+typedef struct
+{
+  uint64_t hash;
+  double first;
+  uint8_t used;
+  uint8_t delivered;
+} origin_t;
+
+typedef struct
+{
+  // Scenario
+  char app[32];
+  uint8_t address;
+  double x;
+  double y;
+  uint8_t sink;
+
+  // Firmware and model entry points in this node's copy of the application
+  void* handle;
+  int (*main)( void );
+  void (*service)( void );
+  void (*timer_advance)( uint32_t );
+  uint32_t (*timer_next)( void );
+  void (*adc_input)( uint16_t );
+  uint8_t (*radio_receive)( uint8_t*, uint8_t, uint8_t );
+  void (*radio_tx_done)( void );
+  uint8_t (*radio_register)( uint8_t );
+  volatile uint16_t* sr;
+
+  // Model hooks, checked after every slice in case the firmware overwrote
+  // them with a stray write
+  uint8_t (**idle)( void );
+  void (**radio_tx)( uint8_t*, uint8_t );
+  void (**uart_tx)( uint8_t );
+
+  ucontext_t context;
+  void* stack;
+  uint8_t started;
+  uint8_t sleeping;
+  uint8_t syncing;
+  uint8_t channel;
+
+  // Time the node has run up to, and when it next needs to run if asleep
+  double time;
+  double wake;
+  double boot;
+  double rate;              // ACLK ticks per second
+  double phase;
+  uint64_t ticks;
+  uint32_t blocks;
+  uint32_t slot;            // Position in queue
+
+  event_t* inbox_head;
+  event_t* inbox_tail;
+  FILE* uart;
+
+  // Statistics
+  uint32_t tx;
+  double airtime;
+  double busy;
+  uint32_t rx_ok;
+  uint32_t rx_bad;
+  uint32_t rx_missed;
+  uint32_t uart_bytes;
+} node_t;
+
+static node_t nodes[MAX_NODES];
+static uint32_t total_nodes = 0;
+static uint32_t queue[MAX_NODES];     // Heap of node indices by node_next
+static uint32_t queue_size = 0;
+static node_t* current = 0;
+static ucontext_t scheduler;
+
+static transmission_t* history = 0;
+static uint32_t history_size = 0;
+static uint32_t history_head = 0;
+static uint32_t history_tail = 0;
+static uint32_t channel_pending = NO_TRANSMISSION;
+
+static origin_t* origins = 0;
+static uint32_t origins_size = 0;
+static uint32_t origins_used = 0;
+
+static struct
+{
+  double duration;
+  double loss;
+  double exponent;
+  double sensitivity;
+  double capture;
+} scenario = { DEFAULT_DURATION, DEFAULT_LOSS, DEFAULT_EXPONENT,
+               DEFAULT_SENSITIVITY, DEFAULT_CAPTURE };
+
+static struct
+{
+  uint32_t packets;
+  uint32_t delivered;
+  uint64_t delivered_bytes;
+  double latency_sum;
+  double latency_min;
+  double latency_max;
+  uint32_t transmissions;
+  uint32_t collisions;
+} totals;
+
+static void node_sync( node_t* );
+static void node_deliver( node_t*, event_t* );
+static void node_radio_tx( uint8_t*, uint8_t );
+static void node_uart_tx( uint8_t );
+
+//
+// Scheduling
+//
+
+/*******************************************************************************
+ * @fn     double node_now( node_t* node )
+ * @brief  simulated time, including the blocks run since the last slice
+ * ****************************************************************************/
+static double node_now( node_t* node )
+{
+  return node->time + node->blocks * BLOCK_TIME;
+}
+
+/*******************************************************************************
+ * @fn     void node_account( node_t* node )
+ * @brief  move the blocks run so far into the node's time
+ * ****************************************************************************/
+static void node_account( node_t* node )
+{
+  node->time += node->blocks * BLOCK_TIME;
+  node->busy += node->blocks * BLOCK_TIME;
+  node->blocks = 0;
+}
+
+/*******************************************************************************
+ * @fn     void node_yield( node_t* node )
+ * @brief  give the CPU back to the scheduler, returns when the node runs again
+ * ****************************************************************************/
+static void node_yield( node_t* node )
+{
+  node->channel = node->radio_register( CHANNR );
+  swapcontext( &node->context, &scheduler );
+}
+
+/*******************************************************************************
+ * @fn     void __sanitizer_cov_trace_pc( void )
+ * @brief  called by the instrumented firmware at every basic block
+ * ****************************************************************************/
+void __sanitizer_cov_trace_pc( void )
+{
+  node_t* node = current;
+
+  if( node && ++node->blocks >= SLICE_BLOCKS )
+  {
+    node_account( node );
+    node_yield( node );
+    node_sync( node );
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint64_t node_ticks( node_t* node, double time )
+ * @brief  ACLK ticks counted by [node] at [time]
+ * ****************************************************************************/
+static uint64_t node_ticks( node_t* node, double time )
+{
+  if( time <= node->boot )
+  {
+    return 0;
+  }
+
+  return (uint64_t)floor( (time - node->boot) * node->rate + 1e-6 );
+}
+
+/*******************************************************************************
+ * @fn     void node_advance( node_t* node, double time )
+ * @brief  run Timer0_A and the ADC input up to [time]
+ * ****************************************************************************/
+static void node_advance( node_t* node, double time )
+{
+  uint64_t target = node_ticks( node, time );
+  uint64_t ticks;
+
+  node->adc_input( (uint16_t)( 2048 + 1800 *
+                   sin( 2 * M_PI * ADC_SIGNAL_HZ * time + node->phase ) ) );
+
+  // Handlers may run the node past [time], nothing is lost by catching up
+  while( node->ticks < target )
+  {
+    ticks = target - node->ticks;
+    if( ticks > 0xFFFFFFFF )
+    {
+      ticks = 0xFFFFFFFF;
+    }
+    node->ticks += ticks;
+    node->timer_advance( (uint32_t)ticks );
+  }
+}
+
+/*******************************************************************************
+ * @fn     void node_sync( node_t* node )
+ * @brief  bring the peripherals up to the node's time, delivering channel
+ *         events in order. Handlers run from here as they would have fired.
+ * ****************************************************************************/
+static void node_sync( node_t* node )
+{
+  event_t* event;
+
+  // Handlers called from here can yield, don't start over when they resume
+  if( node->syncing )
+  {
+    return;
+  }
+  node->syncing = 1;
+
+  while( node->inbox_head && node->inbox_head->time <= node_now( node ) )
+  {
+    event = node->inbox_head;
+    node->inbox_head = event->next;
+    if( !node->inbox_head )
+    {
+      node->inbox_tail = 0;
+    }
+
+    node_advance( node, event->time );
+    node_deliver( node, event );
+    free( event );
+  }
+
+  node_advance( node, node_now( node ) );
+
+  node->syncing = 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t node_idle( void )
+ * @brief  hal_host_idle hook, sleep until the next timer or channel event
+ * ****************************************************************************/
+static uint8_t node_idle( void )
+{
+  node_t* node = current;
+  uint32_t next;
+
+  node_sync( node );
+  if( !(*node->sr & CPUOFF) )
+  {
+    return 1;
+  }
+
+  node_account( node );
+
+  next = node->timer_next();
+  node->wake = next ? node->boot + (node->ticks + next) / node->rate
+                    : INFINITY;
+  if( node->inbox_head && node->inbox_head->time < node->wake )
+  {
+    node->wake = node->inbox_head->time;
+  }
+  if( node->wake < node->time )
+  {
+    node->wake = node->time;
+  }
+
+  node->sleeping = 1;
+  node_yield( node );
+  node->sleeping = 0;
+
+  node_sync( node );
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     void node_entry( void )
+ * @brief  first function on each node's stack
+ * ****************************************************************************/
+static void node_entry( void )
+{
+  node_t* node = current;
+
+  node->main();
+
+  // Returning from main stops the CPU for good
+  node_account( node );
+  node->sleeping = 1;
+  node->wake = INFINITY;
+  node_yield( node );
+}
+
+/*******************************************************************************
+ * @fn     double node_next( node_t* node )
+ * @brief  time the node needs the CPU next
+ * ****************************************************************************/
+static double node_next( node_t* node )
+{
+  if( !node->started )
+  {
+    return node->boot;
+  }
+
+  return node->sleeping ? node->wake : node->time;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t queue_before( uint32_t first, uint32_t second )
+ * @brief  compare two queue slots, node index breaks ties
+ * ****************************************************************************/
+static uint8_t queue_before( uint32_t first, uint32_t second )
+{
+  double first_next = node_next( &nodes[queue[first]] );
+  double second_next = node_next( &nodes[queue[second]] );
+
+  return ( first_next < second_next ) ||
+         ( first_next == second_next && queue[first] < queue[second] );
+}
+
+/*******************************************************************************
+ * @fn     void queue_swap( uint32_t first, uint32_t second )
+ * @brief  exchange two queue slots
+ * ****************************************************************************/
+static void queue_swap( uint32_t first, uint32_t second )
+{
+  uint32_t index = queue[first];
+
+  queue[first] = queue[second];
+  queue[second] = index;
+  nodes[queue[first]].slot = first;
+  nodes[queue[second]].slot = second;
+}
+
+/*******************************************************************************
+ * @fn     void queue_update( node_t* node )
+ * @brief  restore the heap order after the node's next time changed
+ * ****************************************************************************/
+static void queue_update( node_t* node )
+{
+  uint32_t slot = node->slot;
+  uint32_t child;
+
+  while( slot && queue_before( slot, ( slot - 1 ) / 2 ) )
+  {
+    queue_swap( slot, ( slot - 1 ) / 2 );
+    slot = ( slot - 1 ) / 2;
+  }
+
+  for(;;)
+  {
+    child = 2 * slot + 1;
+    if( child >= queue_size )
+    {
+      break;
+    }
+    if( child + 1 < queue_size && queue_before( child + 1, child ) )
+    {
+      child++;
+    }
+    if( !queue_before( child, slot ) )
+    {
+      break;
+    }
+    queue_swap( slot, child );
+    slot = child;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void node_resume( node_t* node, double now )
+ * @brief  run [node] from [now] until it yields
+ * ****************************************************************************/
+static void node_resume( node_t* node, double now )
+{
+  if( node->time < now )
+  {
+    node->time = now;
+  }
+
+  current = node;
+  if( !node->started )
+  {
+    node->started = 1;
+    getcontext( &node->context );
+    node->context.uc_stack.ss_sp = node->stack;
+    node->context.uc_stack.ss_size = STACK_SIZE;
+    node->context.uc_link = &scheduler;
+    makecontext( &node->context, node_entry, 0 );
+  }
+  swapcontext( &scheduler, &node->context );
+  current = 0;
+
+  // A node with broken hooks would spin or stay silent, and the results
+  // would still look plausible
+  if( *node->idle != node_idle || *node->radio_tx != node_radio_tx ||
+      *node->uart_tx != node_uart_tx )
+  {
+    fprintf( stderr, "node %u (%s %02X): firmware overwrote the model hooks, "
+             "stopping\n", (unsigned)( node - nodes ), node->app,
+             node->address );
+    exit( 2 );
+  }
+
+  queue_update( node );
+}
+
+//
+// Radio channel
+//
+
+/*******************************************************************************
+ * @fn     uint64_t packet_hash( uint8_t* packet )
+ * @brief  FNV-1a of the length byte and payload
+ * ****************************************************************************/
+static uint64_t packet_hash( uint8_t* packet )
+{
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  uint16_t index;
+
+  for( index = 0; index <= packet[0]; index++ )
+  {
+    hash = ( hash ^ packet[index] ) * 0x100000001B3ULL;
+  }
+
+  return hash;
+}
+
+/*******************************************************************************
+ * @fn     origin_t* origin_find( uint64_t hash )
+ * @brief  entry for [hash], a free slot if it isn't there
+ * ****************************************************************************/
+static origin_t* origin_find( uint64_t hash )
+{
+  uint32_t index = (uint32_t)hash & ( origins_size - 1 );
+
+  while( origins[index].used && origins[index].hash != hash )
+  {
+    index = ( index + 1 ) & ( origins_size - 1 );
+  }
+
+  return &origins[index];
+}
+
+/*******************************************************************************
+ * @fn     void origin_sent( uint8_t* packet, double time )
+ * @brief  note when a packet was first sent
+ * ****************************************************************************/
+static void origin_sent( uint8_t* packet, double time )
+{
+  uint64_t hash = packet_hash( packet );
+  origin_t* previous = origins;
+  uint32_t previous_size = origins_size;
+  origin_t* origin;
+  uint32_t index;
+
+  // Keep the table at most half full
+  if( 2 * ( origins_used + 1 ) > origins_size )
+  {
+    origins_size = origins_size ? 2 * origins_size : 4096;
+    origins = calloc( origins_size, sizeof(origin_t) );
+    for( index = 0; index < previous_size; index++ )
+    {
+      if( previous[index].used )
+      {
+        *origin_find( previous[index].hash ) = previous[index];
+      }
+    }
+    free( previous );
+  }
+
+  origin = origin_find( hash );
+  if( origin->used && ( time - origin->first ) < ORIGIN_WINDOW )
+  {
+    // Forwarded or resent
+    return;
+  }
+
+  if( !origin->used )
+  {
+    origins_used++;
+  }
+  origin->used = 1;
+  origin->hash = hash;
+  origin->first = time;
+  origin->delivered = 0;
+  totals.packets++;
+}
+
+/*******************************************************************************
+ * @fn     void origin_delivered( uint8_t* packet, double time )
+ * @brief  a sink got [packet] with a good CRC
+ * ****************************************************************************/
+static void origin_delivered( uint8_t* packet, double time )
+{
+  origin_t* origin;
+  double latency;
+
+  if( !origins_size )
+  {
+    return;
+  }
+
+  origin = origin_find( packet_hash( packet ) );
+  if( !origin->used || origin->delivered )
+  {
+    return;
+  }
+
+  origin->delivered = 1;
+  latency = time - origin->first;
+
+  if( 0 == totals.delivered || latency < totals.latency_min )
+  {
+    totals.latency_min = latency;
+  }
+  if( latency > totals.latency_max )
+  {
+    totals.latency_max = latency;
+  }
+  totals.latency_sum += latency;
+  totals.delivered++;
+  totals.delivered_bytes += packet[0];
+}
+
+/*******************************************************************************
+ * @fn     double radio_airtime( node_t* node, uint8_t length )
+ * @brief  seconds on air for [length] FIFO bytes with the node's settings
+ * ****************************************************************************/
+static double radio_airtime( node_t* node, uint8_t length )
+{
+  static const uint8_t preambles[] = { 2, 3, 4, 6, 8, 12, 16, 24 };
+  uint8_t mdmcfg4 = node->radio_register( MDMCFG4 );
+  uint8_t mdmcfg2 = node->radio_register( MDMCFG2 );
+  uint8_t sync_mode = mdmcfg2 & 0x07;
+  double baud;
+  double bits;
+
+  baud = ( 256.0 + node->radio_register( MDMCFG3 ) ) *
+         ldexp( 1.0, mdmcfg4 & 0x0F ) * XOSC_HZ / ldexp( 1.0, 28 );
+
+  bits = 8.0 * preambles[( node->radio_register( MDMCFG1 ) >> 4 ) & 0x07];
+  if( sync_mode )
+  {
+    bits += ( 3 == sync_mode || 7 == sync_mode ) ? 32 : 16;
+  }
+  bits += 8.0 * length;
+  if( node->radio_register( PKTCTRL0 ) & BIT2 )
+  {
+    bits += 16;
+  }
+
+  // Manchester coding
+  if( mdmcfg2 & BIT3 )
+  {
+    bits *= 2;
+  }
+
+  return bits / baud;
+}
+
+/*******************************************************************************
+ * @fn     double radio_power( uint8_t patable )
+ * @brief  output power in dBm for the PATABLE values the firmware uses
+ * ****************************************************************************/
+static double radio_power( uint8_t patable )
+{
+  static const struct { uint8_t value; int8_t dbm; } levels[] =
+  {
+    { 0x03, -30 }, { 0x0D, -15 }, { 0x25, -6 }, { 0x51, 0 },
+    { 0x85, 5 }, { 0xC7, 7 }, { 0xC0, 10 },
+  };
+  uint8_t index;
+
+  for( index = 0; index < sizeof(levels) / sizeof(levels[0]); index++ )
+  {
+    if( levels[index].value == patable )
+    {
+      return levels[index].dbm;
+    }
+  }
+
+  return DEFAULT_TX_DBM;
+}
+
+/*******************************************************************************
+ * @fn     void node_radio_tx( uint8_t* packet, uint8_t size )
+ * @brief  hal_host_radio_tx hook, put the packet on the air
+ * ****************************************************************************/
+static void node_radio_tx( uint8_t* packet, uint8_t size )
+{
+  node_t* node = current;
+  transmission_t* transmission;
+  transmission_t* previous = history;
+  uint32_t index;
+
+  if( !size || packet[0] >= PACKET_SIZE || packet[0] >= size )
+  {
+    node->radio_tx_done();
+    return;
+  }
+
+  if( history_head - history_tail == history_size )
+  {
+    history_size = history_size ? 2 * history_size : 1024;
+    history = malloc( history_size * sizeof(transmission_t) );
+    for( index = history_tail; index != history_head; index++ )
+    {
+      history[index & ( history_size - 1 )] =
+                          previous[index & ( history_size / 2 - 1 )];
+    }
+    free( previous );
+  }
+
+  transmission = &history[history_head & ( history_size - 1 )];
+  transmission->sender = node - nodes;
+  transmission->channel = node->radio_register( CHANNR );
+  transmission->resolved = 0;
+  transmission->start = node_now( node );
+  transmission->end = transmission->start +
+                      radio_airtime( node, packet[0] + 1 );
+  transmission->dbm = radio_power( node->radio_register( PATABLE ) );
+  memcpy( transmission->packet, packet, packet[0] + 1 );
+
+  if( NO_TRANSMISSION == channel_pending ||
+      transmission->end < CHANNEL_PENDING()->end )
+  {
+    channel_pending = history_head;
+  }
+  history_head++;
+
+  node->tx++;
+  node->airtime += transmission->end - transmission->start;
+  totals.transmissions++;
+
+  if( !node->sink )
+  {
+    origin_sent( packet, transmission->start );
+  }
+}
+
+/*******************************************************************************
+ * @fn     void node_uart_tx( uint8_t character )
+ * @brief  hal_host_uart_tx hook
+ * ****************************************************************************/
+static void node_uart_tx( uint8_t character )
+{
+  node_t* node = current;
+
+  node->uart_bytes++;
+  if( node->uart )
+  {
+    fputc( character, node->uart );
+  }
+}
+
+/*******************************************************************************
+ * @fn     void node_deliver( node_t* node, event_t* event )
+ * @brief  hand a channel event to the radio model
+ * ****************************************************************************/
+static void node_deliver( node_t* node, event_t* event )
+{
+  if( event->tx_done )
+  {
+    node->radio_tx_done();
+    node->service();
+    return;
+  }
+
+  if( !node->radio_receive( event->packet, event->rssi, event->crc_ok ) )
+  {
+    node->rx_missed++;
+  }
+  else if( !event->crc_ok )
+  {
+    node->rx_bad++;
+  }
+  else
+  {
+    node->rx_ok++;
+    if( node->sink )
+    {
+      origin_delivered( event->packet, event->time );
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     void node_post( node_t* node, event_t* event )
+ * @brief  queue a channel event, waking the node for it if asleep
+ * ****************************************************************************/
+static void node_post( node_t* node, event_t* event )
+{
+  event->next = 0;
+  if( node->inbox_tail )
+  {
+    node->inbox_tail->next = event;
+  }
+  else
+  {
+    node->inbox_head = event;
+  }
+  node->inbox_tail = event;
+
+  if( node->sleeping && event->time < node->wake )
+  {
+    node->wake = event->time;
+    queue_update( node );
+  }
+}
+
+/*******************************************************************************
+ * @fn     double path_dbm( transmission_t* transmission, node_t* node )
+ * @brief  power received by [node]
+ * ****************************************************************************/
+static double path_dbm( transmission_t* transmission, node_t* node )
+{
+  node_t* sender = &nodes[transmission->sender];
+  double distance = hypot( sender->x - node->x, sender->y - node->y );
+
+  if( distance < 1.0 )
+  {
+    distance = 1.0;
+  }
+
+  return transmission->dbm - scenario.loss -
+         10.0 * scenario.exponent * log10( distance );
+}
+
+/*******************************************************************************
+ * @fn     void channel_resolve( transmission_t* transmission )
+ * @brief  a transmission ended, work out who got it
+ * ****************************************************************************/
+static void channel_resolve( transmission_t* transmission )
+{
+  static transmission_t** overlaps = 0;
+  static uint32_t overlaps_size = 0;
+  uint32_t total_overlaps = 0;
+  transmission_t* other;
+  node_t* node;
+  event_t* event;
+  double signal;
+  double interference;
+  uint8_t busy;
+  uint32_t index;
+  uint32_t scan;
+  int rssi;
+
+  transmission->resolved = 1;
+
+  // Everything else on the air at the same time
+  for( scan = history_tail; scan != history_head; scan++ )
+  {
+    other = &history[scan & ( history_size - 1 )];
+    if( other == transmission || other->channel != transmission->channel ||
+        other->start >= transmission->end ||
+        other->end <= transmission->start )
+    {
+      continue;
+    }
+
+    if( total_overlaps == overlaps_size )
+    {
+      overlaps_size = overlaps_size ? 2 * overlaps_size : 64;
+      overlaps = realloc( overlaps, overlaps_size * sizeof(transmission_t*) );
+    }
+    overlaps[total_overlaps++] = other;
+  }
+
+  for( index = 0; index < total_nodes; index++ )
+  {
+    node = &nodes[index];
+    if( index == transmission->sender ||
+        node->channel != transmission->channel )
+    {
+      continue;
+    }
+
+    signal = path_dbm( transmission, node );
+    if( signal < scenario.sensitivity )
+    {
+      continue;
+    }
+
+    interference = 0;
+    busy = 0;
+    for( scan = 0; scan < total_overlaps; scan++ )
+    {
+      if( overlaps[scan]->sender == index )
+      {
+        busy = 1;
+        break;
+      }
+
+      interference += pow( 10.0, path_dbm( overlaps[scan], node ) / 10.0 );
+    }
+
+    if( busy )
+    {
+      node->rx_missed++;
+      continue;
+    }
+
+    event = malloc( sizeof(event_t) );
+    event->time = transmission->end;
+    event->tx_done = 0;
+    event->crc_ok = ( 0 == interference ) ||
+                    ( signal - 10.0 * log10( interference ) >= scenario.capture );
+    memcpy( event->packet, transmission->packet, transmission->packet[0] + 1 );
+
+    // Register format, half dB steps from -74 dBm
+    rssi = (int)lround( ( signal + 74.0 ) * 2.0 );
+    event->rssi = (uint8_t)( rssi > 127 ? 127 : rssi < -128 ? -128 : rssi );
+
+    if( !event->crc_ok )
+    {
+      totals.collisions++;
+    }
+
+    node_post( node, event );
+  }
+
+  event = malloc( sizeof(event_t) );
+  event->time = transmission->end;
+  event->tx_done = 1;
+  node_post( &nodes[transmission->sender], event );
+}
+
+/*******************************************************************************
+ * @fn     void channel_update( double now )
+ * @brief  find the unresolved transmission that ends first, dropping old
+ *         history
+ * ****************************************************************************/
+static void channel_update( double now )
+{
+  transmission_t* transmission;
+  uint32_t index;
+
+  while( history_tail != history_head )
+  {
+    transmission = &history[history_tail & ( history_size - 1 )];
+    if( !transmission->resolved || transmission->end > now - HISTORY_SPAN )
+    {
+      break;
+    }
+    history_tail++;
+  }
+
+  channel_pending = NO_TRANSMISSION;
+  for( index = history_tail; index != history_head; index++ )
+  {
+    transmission = &history[index & ( history_size - 1 )];
+    if( !transmission->resolved && ( NO_TRANSMISSION == channel_pending ||
+        transmission->end < CHANNEL_PENDING()->end ) )
+    {
+      channel_pending = index;
+    }
+  }
+}
+
+//
+// Setup and reporting
+//
+
+/*******************************************************************************
+ * @fn     void* load_symbol( node_t* node, const char* name )
+ * @brief  dlsym that gives up on missing symbols
+ * ****************************************************************************/
+static void* load_symbol( node_t* node, const char* name )
+{
+  void* symbol = dlsym( node->handle, name );
+
+  if( !symbol )
+  {
+    fprintf( stderr, "%s: missing %s\n", node->app, name );
+    exit( 1 );
+  }
+
+  return symbol;
+}
+
+/*******************************************************************************
+ * @fn     int copy_file( const char* from, const char* to )
+ * @brief  copy [from] to [to]
+ * @return 0 on success
+ * ****************************************************************************/
+static int copy_file( const char* from, const char* to )
+{
+  char buffer[65536];
+  FILE* in = fopen( from, "rb" );
+  FILE* out;
+  size_t size;
+  int result = 0;
+
+  if( !in )
+  {
+    return -1;
+  }
+
+  out = fopen( to, "wb" );
+  if( !out )
+  {
+    fclose( in );
+    return -1;
+  }
+
+  while( ( size = fread( buffer, 1, sizeof(buffer), in ) ) > 0 )
+  {
+    if( fwrite( buffer, 1, size, out ) != size )
+    {
+      result = -1;
+      break;
+    }
+  }
+
+  fclose( in );
+  if( fclose( out ) )
+  {
+    result = -1;
+  }
+
+  return result;
+}
+
+/*******************************************************************************
+ * @fn     void node_load( node_t* node, const char* libdir, const char* tmpdir,
+ *                         const char* outdir, double ppm )
+ * @brief  load a private copy of the node's application and hook up the model
+ * ****************************************************************************/
+static void node_load( node_t* node, const char* libdir, const char* tmpdir,
+                       const char* outdir, double ppm )
+{
+  char library[512];
+  char copy[512];
+  char output[512];
+  uint32_t index = node - nodes;
+
+  // dlopen returns the same handle for the same file, so each node gets a
+  // copy of its own and with it a separate set of globals
+  snprintf( library, sizeof(library), "%s/%s.so", libdir, node->app );
+  snprintf( copy, sizeof(copy), "%s/node%u.so", tmpdir, index );
+  if( copy_file( library, copy ) )
+  {
+    fprintf( stderr, "Can't copy %s: %s\n", library, strerror( errno ) );
+    exit( 1 );
+  }
+
+  node->handle = dlopen( copy, RTLD_NOW | RTLD_LOCAL );
+  unlink( copy );
+  if( !node->handle )
+  {
+    fprintf( stderr, "%s\n", dlerror() );
+    exit( 1 );
+  }
+
+  node->main = load_symbol( node, "main" );
+  node->service = load_symbol( node, "hal_host_service" );
+  node->timer_advance = load_symbol( node, "hal_host_timer_advance" );
+  node->timer_next = load_symbol( node, "hal_host_timer_next" );
+  node->adc_input = load_symbol( node, "hal_host_adc_input" );
+  node->radio_receive = load_symbol( node, "hal_host_radio_receive" );
+  node->radio_tx_done = load_symbol( node, "hal_host_radio_tx_done" );
+  node->radio_register = load_symbol( node, "hal_host_radio_register" );
+  node->sr = load_symbol( node, "hal_host_sr" );
+
+  node->idle = load_symbol( node, "hal_host_idle" );
+  node->radio_tx = load_symbol( node, "hal_host_radio_tx" );
+  node->uart_tx = load_symbol( node, "hal_host_uart_tx" );
+  *node->idle = node_idle;
+  *node->radio_tx = node_radio_tx;
+  *node->uart_tx = node_uart_tx;
+  *(uint8_t*)load_symbol( node, "hal_host_address" ) = node->address;
+  *(int32_t*)load_symbol( node, "hal_host_node" ) = index;
+
+  if( outdir )
+  {
+    snprintf( output, sizeof(output), "%s/node%u.uart", outdir, index );
+    node->uart = fopen( output, "wb" );
+    if( !node->uart )
+    {
+      fprintf( stderr, "Can't open %s: %s\n", output, strerror( errno ) );
+      exit( 1 );
+    }
+  }
+
+  node->stack = malloc( STACK_SIZE );
+  node->boot = drand48() * MAX_BOOT_DELAY;
+  node->time = node->boot;
+  node->rate = ACLK_HZ * ( 1.0 + ( 2.0 * drand48() - 1.0 ) * ppm * 1e-6 );
+  node->phase = 2 * M_PI * drand48();
+}
+
+/*******************************************************************************
+ * @fn     int load_scenario( const char* path )
+ * @brief  read the scenario file
+ * @return 0 on success
+ * ****************************************************************************/
+static int load_scenario( const char* path )
+{
+  FILE* file = fopen( path, "r" );
+  char line[256];
+  char sink[16];
+  node_t* node;
+  unsigned address;
+  uint32_t number = 0;
+  int fields;
+
+  if( !file )
+  {
+    perror( path );
+    return -1;
+  }
+
+  while( fgets( line, sizeof(line), file ) )
+  {
+    number++;
+    if( '#' == line[strspn( line, " \t" )] ||
+        strspn( line, " \t\r\n" ) == strlen( line ) )
+    {
+      continue;
+    }
+
+    if( 1 == sscanf( line, " duration %lf", &scenario.duration ) )
+    {
+      continue;
+    }
+
+    if( 4 == sscanf( line, " channel %lf %lf %lf %lf", &scenario.loss,
+                     &scenario.exponent, &scenario.sensitivity,
+                     &scenario.capture ) )
+    {
+      continue;
+    }
+
+    if( total_nodes < MAX_NODES )
+    {
+      node = &nodes[total_nodes];
+      sink[0] = 0;
+      fields = sscanf( line, " node %31s %x %lf %lf %15s", node->app,
+                       &address, &node->x, &node->y, sink );
+      if( fields >= 4 && address <= 0xFF &&
+          ( 4 == fields || 0 == strcmp( sink, "sink" ) ) )
+      {
+        node->address = address;
+        node->sink = ( 5 == fields );
+        total_nodes++;
+        continue;
+      }
+    }
+
+    fprintf( stderr, "%s:%u: bad line\n", path, number );
+    fclose( file );
+    return -1;
+  }
+
+  fclose( file );
+
+  if( !total_nodes )
+  {
+    fprintf( stderr, "%s: no nodes\n", path );
+    return -1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     void report( double now, double wall )
+ * @brief  print per node and network statistics
+ * ****************************************************************************/
+static void report( double now, double wall )
+{
+  node_t* node;
+  uint32_t index;
+
+  printf( "node app        addr sink     tx  air%%   rx ok  rx bad  missed"
+          "    uart  cpu%%\n" );
+  for( index = 0; index < total_nodes; index++ )
+  {
+    node = &nodes[index];
+    printf( "%4u %-10s  0x%02x %4s %6u %5.1f %7u %7u %7u %7u %5.1f\n",
+            index, node->app, node->address, node->sink ? "yes" : "",
+            node->tx, 100.0 * node->airtime / now, node->rx_ok,
+            node->rx_bad, node->rx_missed, node->uart_bytes,
+            100.0 * node->busy / now );
+  }
+
+  printf( "\nsimulated %.3f s in %.3f s (%.1fx real time)\n", now, wall,
+          wall > 0 ? now / wall : 0 );
+  printf( "transmissions: %u, corrupted receptions: %u\n",
+          totals.transmissions, totals.collisions );
+  printf( "packets sent: %u, delivered to a sink: %u, loss: %.1f%%\n",
+          totals.packets, totals.delivered, totals.packets ?
+          100.0 * ( totals.packets - totals.delivered ) / totals.packets : 0 );
+  printf( "throughput: %.1f bytes/s\n", totals.delivered_bytes / now );
+  if( totals.delivered )
+  {
+    printf( "latency: min %.2f ms, mean %.2f ms, max %.2f ms\n",
+            1e3 * totals.latency_min,
+            1e3 * totals.latency_sum / totals.delivered,
+            1e3 * totals.latency_max );
+  }
+}
+
+static double wall_time( void )
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-l libdir] [-o outdir] [-s seed] [-p ppm] "
+           "scenario\n", name );
+}
+
+int main( int argc, char** argv )
+{
+  const char* libdir = DEFAULT_LIBDIR;
+  const char* outdir = 0;
+  char tmpdir[] = "/tmp/netsimXXXXXX";
+  double ppm = DEFAULT_PPM;
+  long seed = 1;
+  transmission_t* transmission;
+  node_t* next;
+  double next_time;
+  double now = 0;
+  double start;
+  uint32_t index;
+  int option;
+
+  while( (option = getopt( argc, argv, "l:o:s:p:" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'l': libdir = optarg; break;
+      case 'o': outdir = optarg; break;
+      case 's': seed = atol( optarg ); break;
+      case 'p': ppm = atof( optarg ); break;
+      default: usage( argv[0] ); return 1;
+    }
+  }
+
+  if( argc - optind != 1 )
+  {
+    usage( argv[0] );
+    return 1;
+  }
+
+  if( load_scenario( argv[optind] ) )
+  {
+    return 1;
+  }
+
+  if( !mkdtemp( tmpdir ) )
+  {
+    perror( "mkdtemp" );
+    return 1;
+  }
+
+  srand48( seed );
+  for( index = 0; index < total_nodes; index++ )
+  {
+    node_load( &nodes[index], libdir, tmpdir, outdir, ppm );
+  }
+  for( index = 0; index < total_nodes; index++ )
+  {
+    queue[queue_size] = index;
+    nodes[index].slot = queue_size++;
+    queue_update( &nodes[index] );
+  }
+  rmdir( tmpdir );
+
+  start = wall_time();
+
+  for(;;)
+  {
+    next = &nodes[queue[0]];
+    next_time = node_next( next );
+
+    // Channel first, so a node running at the same time sees the result
+    if( NO_TRANSMISSION != channel_pending &&
+        CHANNEL_PENDING()->end <= next_time )
+    {
+      transmission = CHANNEL_PENDING();
+      if( transmission->end > scenario.duration )
+      {
+        break;
+      }
+      now = transmission->end;
+      channel_resolve( transmission );
+      channel_update( now );
+      continue;
+    }
+
+    if( next_time > scenario.duration )
+    {
+      break;
+    }
+
+    now = next_time;
+    node_resume( next, now );
+  }
+
+  for( index = 0; index < total_nodes; index++ )
+  {
+    if( nodes[index].uart )
+    {
+      fclose( nodes[index].uart );
+    }
+  }
+
+  report( scenario.duration, wall_time() - start );
+
+  return 0;
+}
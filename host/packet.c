@@ -0,0 +1,61 @@
+/** @file packet.c
+*
+* @brief Host side decoding of the demo sample packets
+*
+* @author Alvaro Prieto
+*/
+#include "codec.h"
+#include "packet.h"
+
+/*******************************************************************************
+ * @fn     int packet_samples( uint8_t* frame, uint16_t size,
+ *                             uint8_t sample_count, sample_block_t* block,
+ *                             uint16_t* samples )
+ * @brief  decode the sample block in a frame forwarded by the access point.
+ *         Samples are returned at 12-bit scale.
+ * @return PACKET_OK, PACKET_OTHER if the frame isn't a sample packet or
+ *         PACKET_BAD if the block couldn't be decoded. block is filled in for
+ *         PACKET_OK and PACKET_BAD.
+ * ****************************************************************************/
+int packet_samples( uint8_t* frame, uint16_t size, uint8_t sample_count,
+                                  sample_block_t* block, uint16_t* samples )
+{
+  uint8_t* payload;
+  uint8_t index;
+
+  if( size < (PACKET_HEADER_SIZE + PACKET_SEQUENCE_SIZE) ||
+      frame[2] != PACKET_SAMPLE_TYPE )
+  {
+    return PACKET_OTHER;
+  }
+
+  block->source = frame[1];
+  block->flags = frame[3];
+  block->sequence = frame[PACKET_HEADER_SIZE];
+  block->payload_size = size - PACKET_HEADER_SIZE - PACKET_SEQUENCE_SIZE;
+  payload = &frame[PACKET_HEADER_SIZE + PACKET_SEQUENCE_SIZE];
+
+  if( block->flags & CODEC_FLAG_ENCODED )
+  {
+    block->shift = CODEC_SHIFT( block->flags );
+    if( codec_decode( samples, sample_count, payload, block->payload_size,
+                                              block->flags ) != sample_count )
+    {
+      return PACKET_BAD;
+    }
+    return PACKET_OK;
+  }
+
+  // Legacy packets carry the top 8 bits of each sample
+  block->shift = 4;
+  if( block->payload_size < sample_count )
+  {
+    return PACKET_BAD;
+  }
+  for( index = 0; index < sample_count; index++ )
+  {
+    samples[index] = (uint16_t)payload[index] << 4;
+  }
+
+  return PACKET_OK;
+}
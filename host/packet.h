@@ -0,0 +1,36 @@
+/** @file packet.h
+*
+* @brief Host side decoding of the demo sample packets
+*
+* @author Alvaro Prieto
+*/
+#ifndef _PACKET_H
+#define _PACKET_H
+
+#include <stdint.h>
+
+// Must match the demo settings.h and packet layout
+#define PACKET_DEFAULT_SAMPLES (50)
+#define PACKET_MAX_SAMPLES (255)
+#define PACKET_SAMPLE_TYPE (0xAA)
+#define PACKET_HEADER_SIZE (4)
+#define PACKET_SEQUENCE_SIZE (1)
+
+typedef struct
+{
+  uint8_t source;
+  uint8_t sequence;
+  uint8_t flags;
+  uint8_t shift;        // LSBs dropped by the end device, 4 for 8-bit packets
+  uint8_t payload_size; // Encoded size of the samples
+} sample_block_t;
+
+// packet_samples results
+#define PACKET_OK (1)
+#define PACKET_OTHER (0)
+#define PACKET_BAD (-1)
+
+int packet_samples( uint8_t*, uint16_t, uint8_t, sample_block_t*, uint16_t* );
+
+#endif /* _PACKET_H */\
+
@@ -0,0 +1,327 @@
+/** @file perfcompare.c
+*
+* @brief Compare perfbench results with a stored baseline
+*
+*   usage: perfcompare [-b baseline] [-w baseline] [-t percent] log symbols
+*     log       mspdebug output of perfbench/perfbench.sim, the md dump of
+*               perfbench_cycles is used
+*     symbols   'msp430-nm -S' output of the perfbench program, for code size
+*     -b        baseline to compare with, lines of "routine cycles size".
+*               Without it the results are only printed.
+*     -w        write the results as a new baseline
+*     -t        allowed growth in percent before a routine counts as slower
+*               or bigger, default 0
+*
+*   Prints cycles and code size per routine next to the baseline. Exits with
+*   2 if any routine got slower or bigger than allowed.
+*
+* @author Alvaro Prieto
+*/
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "perfbench.h"
+
+#define NOT_FOUND (-1L)
+
+typedef struct
+{
+  const char* name;
+  long cycles;
+  long size;
+  long base_cycles;
+  long base_size;
+} routine_t;
+
+static routine_t routines[] =
+{
+#define PERFBENCH( name ) { #name, NOT_FOUND, NOT_FOUND, NOT_FOUND, NOT_FOUND },
+  PERFBENCH_ROUTINES
+#undef PERFBENCH
+};
+
+#define TOTAL_ROUTINES ( sizeof(routines) / sizeof(routines[0]) )
+
+/*******************************************************************************
+ * @fn     routine_t* find_routine( const char* name )
+ * @brief  routine called [name], 0 if it isn't benchmarked
+ * ****************************************************************************/
+static routine_t* find_routine( const char* name )
+{
+  uint32_t index;
+
+  for( index = 0; index < TOTAL_ROUTINES; index++ )
+  {
+    if( 0 == strcmp( routines[index].name, name ) )
+    {
+      return &routines[index];
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int read_log( const char* path )
+ * @brief  take the cycle counts from the memory dump in the mspdebug output.
+ *         Dump lines look like "    0x1c00: 9a 01 2e 00 ... |......|", the
+ *         ASCII column tells them apart from disassembly.
+ * @return 0 if every routine has a result
+ * ****************************************************************************/
+static int read_log( const char* path )
+{
+  FILE* file = fopen( path, "r" );
+  uint8_t bytes[2 * TOTAL_ROUTINES];
+  uint32_t total = 0;
+  char line[256];
+  char* cursor;
+  char* end;
+  uint32_t index;
+
+  if( !file )
+  {
+    perror( path );
+    return -1;
+  }
+
+  while( fgets( line, sizeof(line), file ) && total < sizeof(bytes) )
+  {
+    cursor = line + strspn( line, " \t" );
+    strtoul( cursor, &end, 16 );
+    if( end == cursor || ':' != *end || !strchr( end, '|' ) )
+    {
+      continue;
+    }
+
+    cursor = end + 1;
+    for(;;)
+    {
+      cursor += strspn( cursor, " " );
+      if( !isxdigit( (unsigned char)cursor[0] ) ||
+          !isxdigit( (unsigned char)cursor[1] ) ||
+          ' ' != cursor[2] || total == sizeof(bytes) )
+      {
+        break;
+      }
+      bytes[total++] = (uint8_t)strtoul( cursor, 0, 16 );
+      cursor += 2;
+    }
+  }
+
+  fclose( file );
+
+  if( total < sizeof(bytes) )
+  {
+    fprintf( stderr, "%s: no dump of perfbench_cycles\n", path );
+    return -1;
+  }
+
+  // Little endian words
+  for( index = 0; index < TOTAL_ROUTINES; index++ )
+  {
+    routines[index].cycles = bytes[2 * index] | (bytes[2 * index + 1] << 8);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int read_symbols( const char* path )
+ * @brief  code sizes from "address size type name" lines
+ * @return 0 on success
+ * ****************************************************************************/
+static int read_symbols( const char* path )
+{
+  FILE* file = fopen( path, "r" );
+  routine_t* routine;
+  char line[256];
+  char name[128];
+  unsigned long address;
+  unsigned long size;
+  char type;
+
+  if( !file )
+  {
+    perror( path );
+    return -1;
+  }
+
+  while( fgets( line, sizeof(line), file ) )
+  {
+    if( 4 == sscanf( line, "%lx %lx %c %127s", &address, &size, &type, name ) &&
+        ( 't' == tolower( (unsigned char)type ) ) &&
+        ( routine = find_routine( name ) ) )
+    {
+      routine->size = size;
+    }
+  }
+
+  fclose( file );
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int read_baseline( const char* path )
+ * @brief  load "routine cycles size" lines
+ * @return 0 on success
+ * ****************************************************************************/
+static int read_baseline( const char* path )
+{
+  FILE* file = fopen( path, "r" );
+  routine_t* routine;
+  char line[256];
+  char name[128];
+  long cycles;
+  long size;
+
+  if( !file )
+  {
+    perror( path );
+    return -1;
+  }
+
+  while( fgets( line, sizeof(line), file ) )
+  {
+    if( '#' != line[0] &&
+        3 == sscanf( line, "%127s %ld %ld", name, &cycles, &size ) &&
+        ( routine = find_routine( name ) ) )
+    {
+      routine->base_cycles = cycles;
+      routine->base_size = size;
+    }
+  }
+
+  fclose( file );
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int write_baseline( const char* path )
+ * @brief  save the results as the new baseline
+ * @return 0 on success
+ * ****************************************************************************/
+static int write_baseline( const char* path )
+{
+  FILE* file = fopen( path, "w" );
+  uint32_t index;
+
+  if( !file )
+  {
+    perror( path );
+    return -1;
+  }
+
+  fprintf( file, "# perfbench baseline: routine cycles size\n" );
+  for( index = 0; index < TOTAL_ROUTINES; index++ )
+  {
+    fprintf( file, "%s %ld %ld\n", routines[index].name,
+             routines[index].cycles, routines[index].size );
+  }
+
+  return fclose( file ) ? -1 : 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t print_change( long value, long base, double limit )
+ * @brief  value, baseline and change columns
+ * @return 1 if value grew more than [limit] percent
+ * ****************************************************************************/
+static uint8_t print_change( long value, long base, double limit )
+{
+  double change;
+
+  if( NOT_FOUND == value )
+  {
+    printf( " %7s", "-" );
+  }
+  else
+  {
+    printf( " %7ld", value );
+  }
+
+  if( NOT_FOUND == base || NOT_FOUND == value )
+  {
+    printf( " %7s %8s", "-", "" );
+    return 0;
+  }
+
+  change = base ? 100.0 * ( value - base ) / base : ( value ? 100.0 : 0 );
+  printf( " %7ld %+7.1f%%", base, change );
+
+  return change > limit;
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-b baseline] [-w baseline] [-t percent] "
+           "log symbols\n", name );
+}
+
+int main( int argc, char** argv )
+{
+  const char* baseline = 0;
+  const char* output = 0;
+  double limit = 0;
+  uint8_t worse = 0;
+  uint8_t slower;
+  uint8_t bigger;
+  uint32_t index;
+  int option;
+
+  while( (option = getopt( argc, argv, "b:w:t:" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'b': baseline = optarg; break;
+      case 'w': output = optarg; break;
+      case 't': limit = atof( optarg ); break;
+      default: usage( argv[0] ); return 1;
+    }
+  }
+
+  if( argc - optind != 2 )
+  {
+    usage( argv[0] );
+    return 1;
+  }
+
+  if( read_log( argv[optind] ) || read_symbols( argv[optind + 1] ) )
+  {
+    return 1;
+  }
+
+  if( baseline && read_baseline( baseline ) )
+  {
+    return 1;
+  }
+
+  if( !baseline )
+  {
+    printf( "No baseline, results only\n\n" );
+  }
+
+  printf( "%-20s %7s %7s %8s %7s %7s %8s\n", "routine", "cycles", "base",
+          "change", "bytes", "base", "change" );
+  for( index = 0; index < TOTAL_ROUTINES; index++ )
+  {
+    printf( "%-20s", routines[index].name );
+    slower = print_change( routines[index].cycles,
+                           routines[index].base_cycles, limit );
+    bigger = print_change( routines[index].size,
+                           routines[index].base_size, limit );
+    printf( "%s\n", ( slower || bigger ) ? "  <--" : "" );
+    worse |= slower | bigger;
+  }
+
+  if( output && write_baseline( output ) )
+  {
+    return 1;
+  }
+
+  return worse ? 2 : 0;
+}
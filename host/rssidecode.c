@@ -0,0 +1,132 @@
+/** @file rssidecode.c
+*
+* @brief Host decoder for the binary RSSI records sent by rssitest
+*
+*   Reads the COBS framed bursts produced with RSSI_OUTPUT_BINARY and prints
+*   the same CSV lines as the CSV output mode:
+*     group+id,receiver,rssi_dbm
+*   -s adds the device that sent the packet as a fourth column. Bursts lost
+*   on the serial link are reported on stderr.
+*
+*   usage: rssidecode [-b baud] [-s] [device|file|-]
+*
+* @author Alvaro Prieto
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "format.h"
+#include "frame.h"
+#include "serial.h"
+
+// Must match lib/radio_ext.h
+#define RSSI_BURST_TYPE (0xB5)
+#define RSSI_RECORD_SIZE (5)
+#define RSSI_OFFSET (74)
+
+/*******************************************************************************
+ * @fn     uint32_t process_burst( uint8_t* frame, uint16_t size,
+ *                                                    int with_source )
+ * @brief  print every record in a burst
+ * @return Number of records printed
+ * ****************************************************************************/
+static uint32_t process_burst( uint8_t* frame, uint16_t size, int with_source )
+{
+  uint8_t line[32];
+  uint8_t* record;
+  uint8_t length;
+  uint8_t index;
+
+  if( (size < 2) || (RSSI_BURST_TYPE != frame[0]) ||
+      (size < 2 + frame[1] * RSSI_RECORD_SIZE) )
+  {
+    return 0;
+  }
+
+  for( index = 0; index < frame[1]; index++ )
+  {
+    record = &frame[2 + index * RSSI_RECORD_SIZE];
+
+    // [group][id][receiver][source][rssi], same text as print_rssi_csv
+    length = format_hex( line, &record[0], 2 );
+    line[length++] = ',';
+    length += format_hex( &line[length], &record[2], 1 );
+    line[length++] = ',';
+    length += format_dbm( &line[length], record[4], RSSI_OFFSET );
+    if( with_source )
+    {
+      line[length++] = ',';
+      length += format_hex( &line[length], &record[3], 1 );
+    }
+    line[length++] = '\n';
+
+    fwrite( line, 1, length, stdout );
+  }
+
+  return frame[1];
+}
+
+int main( int argc, char** argv )
+{
+  frame_decoder_t decoder;
+  uint8_t buffer[256];
+  long baud = SERIAL_DEFAULT_BAUD;
+  const char* path = "-";
+  uint32_t records = 0;
+  uint32_t missing = 0;
+  int with_source = 0;
+  ssize_t received;
+  ssize_t index;
+  int option;
+  int fd;
+
+  while( (option = getopt( argc, argv, "b:s" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'b': baud = atol( optarg ); break;
+      case 's': with_source = 1; break;
+      default:
+        fprintf( stderr, "usage: %s [-b baud] [-s] [device]\n", argv[0] );
+        return 1;
+    }
+  }
+
+  if( optind < argc )
+  {
+    path = argv[optind];
+  }
+
+  fd = serial_open( path, baud );
+  if( fd < 0 )
+  {
+    return 1;
+  }
+
+  frame_init( &decoder, FRAME_MODE_COBS );
+
+  while( (received = read( fd, buffer, sizeof(buffer) )) > 0 )
+  {
+    for( index = 0; index < received; index++ )
+    {
+      if( frame_push( &decoder, buffer[index] ) )
+      {
+        records += process_burst( decoder.buffer, decoder.length,
+                                                            with_source );
+      }
+    }
+
+    if( decoder.missing != missing )
+    {
+      fprintf( stderr, "%u bursts missing\n", decoder.missing - missing );
+      missing = decoder.missing;
+    }
+    fflush( stdout );
+  }
+
+  fprintf( stderr, "%u records in %u bursts, %u bad, %u bad CRC, "
+    "%u missing\n", records, decoder.frames, decoder.errors,
+    decoder.crc_errors, decoder.missing );
+
+  return 0;
+}
@@ -0,0 +1,663 @@
+/** @file rssilocate.c
+*
+* @brief Estimate tag positions from the RSSI CSV produced by rssitest
+*
+*   Reads CSV lines (from rssitest directly or from rssidecode):
+*     group+id,receiver,rssi_dbm[,source]
+*   Lines for the same packet (and source, when the column is there) seen by
+*   different access points are grouped. A group is solved when every access
+*   point has reported it, or when it is older than the window, and one
+*   position is printed per group:
+*     group+id,source,x,y,rms_error,access_points
+*
+*   Each RSSI is turned into a distance with the log-distance path loss model
+*     rssi = P0 - 10 n log10( d / 1m )
+*   and the position minimising the weighted squared range errors is found
+*   with Gauss-Newton, starting from the weighted centroid. Distant access
+*   points get less weight since their RSSI is less reliable.
+*
+*   The configuration file lists the access points and the model:
+*     ap <receiver> <x> <y>        receiver in hex as in the CSV, x/y in m
+*     model <P0> <n>               dBm at 1 m and path loss exponent
+*   Lines starting with # are ignored.
+*
+*   usage: rssilocate -c config [-w window_ms] [-t] [csv file|-]
+*     -t prints solver and end to end latency statistics on stderr, and the
+*        latency of each epoch as it ends
+*
+*   An epoch is every group with the same packet number, one per source
+*   (tag). Its latency runs from the first report of the packet to the last
+*   of its groups being solved. It ends when the last of its groups leaves
+*   the window, so packet numbers can wrap.
+*
+* @author Alvaro Prieto
+*/
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_APS (32)
+#define MAX_PENDING (4096)
+#define MAX_EPOCHS (0x10000)
+#define HASH_SIZE (4096)
+#define NO_SOURCE (0x100)
+#define DEFAULT_WINDOW_MS (250)
+#define DEFAULT_P0 (-45.0)
+#define DEFAULT_EXPONENT (2.5)
+#define MAX_ITERATIONS (20)
+
+typedef struct
+{
+  double x;
+  double y;
+} point_t;
+
+typedef struct
+{
+  uint32_t key;             // source << 16 | group << 8 | id
+  uint8_t live;
+  uint8_t solved;
+  uint8_t count;
+  int32_t next;             // Hash chain
+  uint64_t first_ns;
+  uint8_t receiver[MAX_APS];
+  double rssi[MAX_APS];
+  uint8_t samples[MAX_APS];
+} group_t;
+
+typedef struct
+{
+  uint8_t receiver[MAX_APS];
+  point_t position[MAX_APS];
+  int ap_count;
+  double p0;
+  double exponent;
+} model_t;
+
+typedef struct
+{
+  uint64_t first_ns;        // First report of the packet, from any source
+  uint64_t last_ns;         // Last group solved
+  uint32_t sources;         // Groups in the epoch, 0 when it isn't open
+  uint32_t positions;
+  uint32_t live;            // Groups still pending
+} epoch_t;
+
+typedef struct
+{
+  uint64_t solved;
+  uint64_t skipped;         // Fewer than 3 access points
+  uint64_t forced;          // Solved early because the pending ring was full
+  double solve_total;
+  double solve_max;
+  double delay_total;
+  double delay_max;
+  uint64_t epochs;
+  double epoch_total;
+  double epoch_max;
+} timing_t;
+
+static group_t pending[MAX_PENDING];
+static epoch_t epochs[MAX_EPOCHS];
+static int32_t buckets[HASH_SIZE];
+static uint32_t pending_head = 0;
+static uint32_t pending_tail = 0;
+static model_t model;
+static timing_t timing;
+static int print_timing = 0;
+
+/*******************************************************************************
+ * @fn     uint64_t now_ns( void )
+ * @brief  monotonic time in nanoseconds
+ * ****************************************************************************/
+static uint64_t now_ns( void )
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/*******************************************************************************
+ * @fn     int load_model( const char* path )
+ * @brief  read access point positions and path loss parameters
+ * ****************************************************************************/
+static int load_model( const char* path )
+{
+  char line[256];
+  unsigned receiver;
+  double x;
+  double y;
+  FILE* file;
+
+  model.p0 = DEFAULT_P0;
+  model.exponent = DEFAULT_EXPONENT;
+
+  file = fopen( path, "r" );
+  if( 0 == file )
+  {
+    perror( path );
+    return -1;
+  }
+
+  while( fgets( line, sizeof(line), file ) )
+  {
+    if( 3 == sscanf( line, "ap %x %lf %lf", &receiver, &x, &y ) )
+    {
+      if( model.ap_count == MAX_APS )
+      {
+        fprintf( stderr, "More than %d access points\n", MAX_APS );
+        break;
+      }
+      model.receiver[model.ap_count] = (uint8_t)receiver;
+      model.position[model.ap_count].x = x;
+      model.position[model.ap_count].y = y;
+      model.ap_count++;
+    }
+    else if( 2 == sscanf( line, "model %lf %lf", &x, &y ) )
+    {
+      model.p0 = x;
+      model.exponent = y;
+    }
+  }
+
+  fclose( file );
+
+  if( model.ap_count < 3 )
+  {
+    fprintf( stderr, "%s: at least 3 access points are needed\n", path );
+    return -1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int find_ap( uint8_t receiver )
+ * @brief  index of an access point in the model, -1 if unknown
+ * ****************************************************************************/
+static int find_ap( uint8_t receiver )
+{
+  int index;
+
+  for( index = 0; index < model.ap_count; index++ )
+  {
+    if( model.receiver[index] == receiver )
+    {
+      return index;
+    }
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+ * @fn     double solve( point_t* anchors, double* ranges, double* weights,
+ *                                          int count, point_t* estimate )
+ * @brief  weighted least squares position from ranges to known points
+ * @return RMS range error in m
+ * ****************************************************************************/
+static double solve( point_t* anchors, double* ranges, double* weights,
+                                              int count, point_t* estimate )
+{
+  double total = 0;
+  double error = 0;
+  int iteration;
+  int index;
+
+  // Weighted centroid as the starting point
+  estimate->x = 0;
+  estimate->y = 0;
+  for( index = 0; index < count; index++ )
+  {
+    estimate->x += weights[index] * anchors[index].x;
+    estimate->y += weights[index] * anchors[index].y;
+    total += weights[index];
+  }
+  estimate->x /= total;
+  estimate->y /= total;
+
+  for( iteration = 0; iteration < MAX_ITERATIONS; iteration++ )
+  {
+    // Normal equations J'WJ step = -J'Wr for r_i = |p - a_i| - d_i
+    double a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+    double determinant;
+    double step_x;
+    double step_y;
+
+    for( index = 0; index < count; index++ )
+    {
+      double dx = estimate->x - anchors[index].x;
+      double dy = estimate->y - anchors[index].y;
+      double distance = sqrt( dx * dx + dy * dy );
+      double residual;
+      double jx;
+      double jy;
+
+      if( distance < 1e-6 )
+      {
+        distance = 1e-6;
+      }
+      jx = dx / distance;
+      jy = dy / distance;
+      residual = distance - ranges[index];
+
+      a11 += weights[index] * jx * jx;
+      a12 += weights[index] * jx * jy;
+      a22 += weights[index] * jy * jy;
+      b1 -= weights[index] * jx * residual;
+      b2 -= weights[index] * jy * residual;
+    }
+
+    // A little damping keeps collinear layouts from blowing up
+    a11 += 1e-9 * total;
+    a22 += 1e-9 * total;
+    determinant = a11 * a22 - a12 * a12;
+    if( fabs( determinant ) < 1e-18 )
+    {
+      break;
+    }
+
+    step_x = ( a22 * b1 - a12 * b2) / determinant;
+    step_y = (-a12 * b1 + a11 * b2) / determinant;
+    estimate->x += step_x;
+    estimate->y += step_y;
+
+    if( step_x * step_x + step_y * step_y < 1e-8 )
+    {
+      break;
+    }
+  }
+
+  for( index = 0; index < count; index++ )
+  {
+    double dx = estimate->x - anchors[index].x;
+    double dy = estimate->y - anchors[index].y;
+    double residual = sqrt( dx * dx + dy * dy ) - ranges[index];
+    error += residual * residual;
+  }
+
+  return sqrt( error / count );
+}
+
+/*******************************************************************************
+ * @fn     void close_epoch( uint16_t packet )
+ * @brief  add the epoch of [packet] to the statistics
+ * ****************************************************************************/
+static void close_epoch( uint16_t packet )
+{
+  epoch_t* epoch = &epochs[packet];
+  double latency = (epoch->last_ns - epoch->first_ns) * 1e-9;
+
+  if( 0 == epoch->sources )
+  {
+    return;
+  }
+
+  timing.epochs++;
+  timing.epoch_total += latency;
+  if( latency > timing.epoch_max )
+  {
+    timing.epoch_max = latency;
+  }
+
+  if( print_timing )
+  {
+    fprintf( stderr, "epoch %04x: %u sources, %u positions, %.2f ms\n",
+             packet, epoch->sources, epoch->positions, 1e3 * latency );
+  }
+
+  epoch->sources = 0;
+}
+
+/*******************************************************************************
+ * @fn     void finish_group( group_t* group )
+ * @brief  solve and print a group
+ * ****************************************************************************/
+static void finish_group( group_t* group )
+{
+  point_t anchors[MAX_APS];
+  point_t estimate;
+  double ranges[MAX_APS];
+  double weights[MAX_APS];
+  double error;
+  uint64_t start;
+  uint64_t end;
+  int count = 0;
+  int index;
+  int ap;
+
+  epoch_t* epoch = &epochs[group->key & 0xFFFF];
+
+  group->solved = 1;
+
+  if( group->count < 3 )
+  {
+    timing.skipped++;
+    epoch->last_ns = now_ns();
+    return;
+  }
+
+  start = now_ns();
+
+  for( index = 0; index < group->count; index++ )
+  {
+    ap = find_ap( group->receiver[index] );
+    anchors[count] = model.position[ap];
+    ranges[count] = pow( 10.0, (model.p0 - group->rssi[index] /
+                        group->samples[index]) / (10.0 * model.exponent) );
+    weights[count] = 1.0 / (ranges[count] * ranges[count]);
+    count++;
+  }
+
+  error = solve( anchors, ranges, weights, count, &estimate );
+
+  end = now_ns();
+
+  epoch->last_ns = end;
+  epoch->positions++;
+
+  timing.solved++;
+  timing.solve_total += (end - start) * 1e-9;
+  if( (end - start) * 1e-9 > timing.solve_max )
+  {
+    timing.solve_max = (end - start) * 1e-9;
+  }
+  timing.delay_total += (end - group->first_ns) * 1e-9;
+  if( (end - group->first_ns) * 1e-9 > timing.delay_max )
+  {
+    timing.delay_max = (end - group->first_ns) * 1e-9;
+  }
+
+  if( (group->key >> 16) == NO_SOURCE )
+  {
+    printf( "%04x,,%.2f,%.2f,%.2f,%d\n", group->key & 0xFFFF, estimate.x,
+                                              estimate.y, error, count );
+  }
+  else
+  {
+    printf( "%04x,%02x,%.2f,%.2f,%.2f,%d\n", group->key & 0xFFFF,
+                    group->key >> 16, estimate.x, estimate.y, error, count );
+  }
+}
+
+/*******************************************************************************
+ * @fn     void retire_oldest( void )
+ * @brief  solve the oldest pending group if needed and free its slot
+ * ****************************************************************************/
+static void retire_oldest( void )
+{
+  group_t* group = &pending[pending_head % MAX_PENDING];
+  int32_t* link = &buckets[group->key % HASH_SIZE];
+  epoch_t* epoch = &epochs[group->key & 0xFFFF];
+
+  if( !group->solved )
+  {
+    finish_group( group );
+  }
+
+  // Unlink from its hash chain
+  while( *link >= 0 )
+  {
+    if( &pending[*link] == group )
+    {
+      *link = group->next;
+      break;
+    }
+    link = &pending[*link].next;
+  }
+
+  group->live = 0;
+  pending_head++;
+
+  if( 0 == --epoch->live )
+  {
+    close_epoch( group->key & 0xFFFF );
+  }
+}
+
+/*******************************************************************************
+ * @fn     void expire( uint64_t now, uint64_t window )
+ * @brief  solve groups older than the window. Groups are kept in arrival
+ *         order, so only the oldest ones need checking.
+ * ****************************************************************************/
+static void expire( uint64_t now, uint64_t window )
+{
+  while( (pending_head != pending_tail) &&
+         (now - pending[pending_head % MAX_PENDING].first_ns >= window) )
+  {
+    retire_oldest();
+  }
+}
+
+/*******************************************************************************
+ * @fn     void observe( uint32_t key, uint8_t receiver, double rssi,
+ *                                                    uint64_t now )
+ * @brief  add one observation to its group
+ * ****************************************************************************/
+static void observe( uint32_t key, uint8_t receiver, double rssi, uint64_t now )
+{
+  epoch_t* epoch = &epochs[key & 0xFFFF];
+  group_t* group = 0;
+  int32_t slot;
+  int index;
+
+  if( find_ap( receiver ) < 0 )
+  {
+    return;
+  }
+
+  for( slot = buckets[key % HASH_SIZE]; slot >= 0; slot = pending[slot].next )
+  {
+    if( pending[slot].key == key )
+    {
+      group = &pending[slot];
+      break;
+    }
+  }
+
+  if( 0 == group )
+  {
+    if( pending_tail - pending_head == MAX_PENDING )
+    {
+      timing.forced++;
+      retire_oldest();
+    }
+
+    slot = pending_tail % MAX_PENDING;
+    pending_tail++;
+
+    group = &pending[slot];
+    group->key = key;
+    group->live = 1;
+    group->solved = 0;
+    group->count = 0;
+    group->first_ns = now;
+    group->next = buckets[key % HASH_SIZE];
+    buckets[key % HASH_SIZE] = slot;
+
+    if( 0 == epoch->sources )
+    {
+      epoch->first_ns = now;
+      epoch->last_ns = now;
+      epoch->positions = 0;
+    }
+    epoch->sources++;
+    epoch->live++;
+  }
+
+  // Late report for a group that has already been solved
+  if( group->solved )
+  {
+    return;
+  }
+
+  // The same access point can report a packet more than once (directly and
+  // relayed), average those
+  for( index = 0; index < group->count; index++ )
+  {
+    if( group->receiver[index] == receiver )
+    {
+      break;
+    }
+  }
+  if( index == group->count )
+  {
+    group->receiver[index] = receiver;
+    group->rssi[index] = 0;
+    group->samples[index] = 0;
+    group->count++;
+  }
+  group->rssi[index] += rssi;
+  group->samples[index]++;
+
+  if( group->count == model.ap_count )
+  {
+    finish_group( group );
+  }
+}
+
+/*******************************************************************************
+ * @fn     void parse_line( char* line, uint64_t now )
+ * @brief  group+id,receiver,rssi_dbm[,source]
+ * ****************************************************************************/
+static void parse_line( char* line, uint64_t now )
+{
+  unsigned packet;
+  unsigned receiver;
+  unsigned source = NO_SOURCE;
+  int rssi;
+  int fields;
+
+  fields = sscanf( line, "%x,%x,%d,%x", &packet, &receiver, &rssi, &source );
+  if( fields < 3 )
+  {
+    return;
+  }
+  if( fields == 3 )
+  {
+    source = NO_SOURCE;
+  }
+
+  observe( (source << 16) | (packet & 0xFFFF), (uint8_t)receiver, rssi, now );
+}
+
+int main( int argc, char** argv )
+{
+  char buffer[65536];
+  const char* config = 0;
+  uint64_t window = DEFAULT_WINDOW_MS * 1000000ull;
+  size_t used = 0;
+  struct timeval timeout;
+  fd_set read_set;
+  ssize_t received;
+  char* line;
+  char* end;
+  int option;
+  int fd = STDIN_FILENO;
+
+  while( (option = getopt( argc, argv, "c:w:t" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'c': config = optarg; break;
+      case 'w': window = strtoull( optarg, 0, 0 ) * 1000000ull; break;
+      case 't': print_timing = 1; break;
+      default:
+        fprintf( stderr, "usage: %s -c config [-w window_ms] [-t] [file]\n",
+                                                                    argv[0] );
+        return 1;
+    }
+  }
+
+  if( (0 == config) || (load_model( config ) < 0) )
+  {
+    fprintf( stderr, "An access point configuration is needed (-c)\n" );
+    return 1;
+  }
+
+  if( (optind < argc) && strcmp( argv[optind], "-" ) )
+  {
+    fd = open( argv[optind], O_RDONLY );
+    if( fd < 0 )
+    {
+      perror( argv[optind] );
+      return 1;
+    }
+  }
+
+  memset( buckets, 0xFF, sizeof(buckets) );
+
+  for(;;)
+  {
+    // Wake up at least every window so groups get solved when input stops
+    FD_ZERO( &read_set );
+    FD_SET( fd, &read_set );
+    timeout.tv_sec = window / 1000000000ull;
+    timeout.tv_usec = (window % 1000000000ull) / 1000;
+
+    if( select( fd + 1, &read_set, 0, 0, &timeout ) > 0 )
+    {
+      received = read( fd, buffer + used, sizeof(buffer) - 1 - used );
+      if( received <= 0 )
+      {
+        break;
+      }
+      used += received;
+      buffer[used] = 0;
+
+      line = buffer;
+      while( (end = strchr( line, '\n' )) )
+      {
+        *end = 0;
+        parse_line( line, now_ns() );
+        line = end + 1;
+      }
+
+      used -= line - buffer;
+      memmove( buffer, line, used );
+      if( used == sizeof(buffer) - 1 )
+      {
+        used = 0;   // No newline in a full buffer, drop it
+      }
+    }
+
+    expire( now_ns(), window );
+    fflush( stdout );
+  }
+
+  // End of input, solve whatever is left
+  while( pending_head != pending_tail )
+  {
+    retire_oldest();
+  }
+
+  if( print_timing )
+  {
+    fprintf( stderr, "%llu positions, %llu groups with under 3 access points, "
+      "%llu solved early\n", (unsigned long long)timing.solved,
+      (unsigned long long)timing.skipped, (unsigned long long)timing.forced );
+    if( timing.solved )
+    {
+      fprintf( stderr, "solver: mean %.2f us, max %.2f us\n",
+        1e6 * timing.solve_total / timing.solved, 1e6 * timing.solve_max );
+      fprintf( stderr, "first report to position: mean %.2f ms, "
+        "max %.2f ms\n", 1e3 * timing.delay_total / timing.solved,
+        1e3 * timing.delay_max );
+    }
+    if( timing.epochs )
+    {
+      fprintf( stderr, "%llu epochs, first report to last position: "
+        "mean %.2f ms, max %.2f ms\n", (unsigned long long)timing.epochs,
+        1e3 * timing.epoch_total / timing.epochs, 1e3 * timing.epoch_max );
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,260 @@
+/** @file samplecollect.c
+*
+* @brief Collect sample blocks from an access point into per device stores
+*
+*   Reads the framed stream from a serial port, pty, file or stdin, decodes
+*   every sample packet and appends it to the store of its end device (see
+*   colstore.c). Sequence gaps are recorded in the store and reported on
+*   stderr. Stop with Ctrl-C, the stores are trimmed and closed on the way
+*   out and can be reopened to continue.
+*
+*   usage: samplecollect [-b baud] [-n samples_per_block] [-e] [-d directory]
+*                        [device|file|-]
+*          samplecollect -r source [-d directory] [-s first] [-c count]
+*
+*   -r reads a store back and prints blocks as CSV:
+*     block,sequence,time_ns,missing_before,shift,sample0,sample1,...
+*
+* @author Alvaro Prieto
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "colstore.h"
+#include "frame.h"
+#include "packet.h"
+#include "serial.h"
+
+#define MAX_SOURCES (256)
+#define READ_SIZE (4096)
+
+static colstore_t stores[MAX_SOURCES];
+static uint8_t store_open[MAX_SOURCES];
+static volatile sig_atomic_t running = 1;
+
+/*******************************************************************************
+ * @fn     void stop( int signal_number )
+ * @brief  SIGINT/SIGTERM handler, the read loop exits and stores are closed
+ * ****************************************************************************/
+static void stop( int signal_number )
+{
+  running = 0;
+}
+
+/*******************************************************************************
+ * @fn     uint64_t now_ns( void )
+ * @brief  wall clock time in nanoseconds
+ * ****************************************************************************/
+static uint64_t now_ns( void )
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_REALTIME, &now );
+  return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/*******************************************************************************
+ * @fn     void process_frame( uint8_t* frame, uint16_t size,
+ *                  uint8_t sample_count, const char* directory,
+ *                  uint64_t time_ns )
+ * @brief  store one sample packet
+ * ****************************************************************************/
+static void process_frame( uint8_t* frame, uint16_t size, uint8_t sample_count,
+                                  const char* directory, uint64_t time_ns )
+{
+  uint16_t samples[PACKET_MAX_SAMPLES];
+  sample_block_t block;
+  int missed;
+
+  if( PACKET_OK != packet_samples( frame, size, sample_count, &block,
+                                                                samples ) )
+  {
+    return;
+  }
+
+  if( !store_open[block.source] )
+  {
+    if( colstore_open( &stores[block.source], directory, block.source,
+                                                      sample_count, 1 ) < 0 )
+    {
+      return;
+    }
+    store_open[block.source] = 1;
+  }
+
+  missed = colstore_append( &stores[block.source], block.sequence,
+                                block.shift, time_ns, samples, sample_count );
+  if( missed > 0 )
+  {
+    fprintf( stderr, "%02x: %d blocks missing before %u\n", block.source,
+                                                      missed, block.sequence );
+  }
+}
+
+/*******************************************************************************
+ * @fn     int collect( int fd, uint8_t mode, uint8_t sample_count,
+ *                                              const char* directory )
+ * @brief  read and store until the input ends or a signal arrives
+ * ****************************************************************************/
+static int collect( int fd, uint8_t mode, uint8_t sample_count,
+                                                    const char* directory )
+{
+  frame_decoder_t decoder;
+  uint8_t buffer[READ_SIZE];
+  uint64_t time_ns;
+  ssize_t received;
+  ssize_t index;
+  int source;
+
+  frame_init( &decoder, mode );
+
+  while( running && (received = read( fd, buffer, sizeof(buffer) )) > 0 )
+  {
+    // One timestamp per read, frames in it arrived within a few ms
+    time_ns = now_ns();
+
+    for( index = 0; index < received; index++ )
+    {
+      if( frame_push( &decoder, buffer[index] ) )
+      {
+        process_frame( decoder.buffer, decoder.length, sample_count,
+                                                        directory, time_ns );
+      }
+    }
+  }
+
+  fprintf( stderr, "serial: %u frames, %u bad, %u bad CRC, %u missing\n",
+    decoder.frames, decoder.errors, decoder.crc_errors, decoder.missing );
+
+  for( source = 0; source < MAX_SOURCES; source++ )
+  {
+    if( store_open[source] )
+    {
+      fprintf( stderr, "%02x: %llu blocks, %llu missing\n", source,
+               (unsigned long long)stores[source].header->blocks,
+               (unsigned long long)stores[source].header->missing );
+      colstore_close( &stores[source] );
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     int dump( const char* directory, uint8_t source, uint64_t first,
+ *                                                      uint64_t count )
+ * @brief  print blocks [first, first + count) of a store straight from the
+ *         mapped files
+ * ****************************************************************************/
+static int dump( const char* directory, uint8_t source, uint64_t first,
+                                                            uint64_t count )
+{
+  colstore_t store;
+  colstore_block_t* block;
+  uint64_t blocks;
+  uint64_t index;
+  uint16_t sample;
+
+  if( colstore_open( &store, directory, source, 0, 0 ) < 0 )
+  {
+    return 1;
+  }
+
+  // Only what was complete, and mapped, when the store was opened
+  blocks = __atomic_load_n( &store.header->blocks, __ATOMIC_ACQUIRE );
+  if( blocks > store.block_capacity )
+  {
+    blocks = store.block_capacity;
+  }
+
+  for( index = first; (index < blocks) && (index - first < count); index++ )
+  {
+    block = &store.blocks[index];
+    if( block->first_sample + block->count > store.sample_capacity )
+    {
+      break;
+    }
+
+    printf( "%llu,%u,%llu,%u,%u", (unsigned long long)index, block->sequence,
+            (unsigned long long)block->time_ns, block->missing_before,
+            block->shift );
+    for( sample = 0; sample < block->count; sample++ )
+    {
+      printf( ",%u", store.samples[block->first_sample + sample] );
+    }
+    printf( "\n" );
+  }
+
+  colstore_close( &store );
+  return 0;
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-b baud] [-n samples] [-e] [-d directory] "
+    "[device]\n       %s -r source [-d directory] [-s first] [-c count]\n",
+    name, name );
+}
+
+int main( int argc, char** argv )
+{
+  struct sigaction action;
+  long baud = SERIAL_DEFAULT_BAUD;
+  int sample_count = PACKET_DEFAULT_SAMPLES;
+  uint8_t mode = FRAME_MODE_COBS;
+  const char* directory = ".";
+  const char* path = "-";
+  uint64_t first = 0;
+  uint64_t count = (uint64_t)-1;
+  int source = -1;
+  int option;
+  int fd;
+
+  while( (option = getopt( argc, argv, "b:n:ed:r:s:c:" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'b': baud = atol( optarg ); break;
+      case 'n': sample_count = atoi( optarg ); break;
+      case 'e': mode = FRAME_MODE_ESCAPED; break;
+      case 'd': directory = optarg; break;
+      case 'r': source = (int)strtol( optarg, 0, 16 ) & 0xFF; break;
+      case 's': first = strtoull( optarg, 0, 0 ); break;
+      case 'c': count = strtoull( optarg, 0, 0 ); break;
+      default: usage( argv[0] ); return 1;
+    }
+  }
+
+  if( source >= 0 )
+  {
+    return dump( directory, (uint8_t)source, first, count );
+  }
+
+  if( optind < argc )
+  {
+    path = argv[optind];
+  }
+
+  if( sample_count < 1 || sample_count > PACKET_MAX_SAMPLES )
+  {
+    fprintf( stderr, "Samples per block must be 1-%d\n", PACKET_MAX_SAMPLES );
+    return 1;
+  }
+
+  fd = serial_open( path, baud );
+  if( fd < 0 )
+  {
+    return 1;
+  }
+
+  // No SA_RESTART, so a signal also breaks out of a blocked read
+  action.sa_handler = stop;
+  action.sa_flags = 0;
+  sigemptyset( &action.sa_mask );
+  sigaction( SIGINT, &action, 0 );
+  sigaction( SIGTERM, &action, 0 );
+
+  return collect( fd, mode, (uint8_t)sample_count, directory );
+}
@@ -0,0 +1,171 @@
+/** @file sampledecode.c
+*
+* @brief Host decoder for the sample packets forwarded by the demo access point
+*
+*   Reads the framed stream from a serial port (or file, or stdin) and prints
+*   one CSV line per sample block:
+*     source,sequence,shift,bytes,ratio,sample0,sample1,...
+*   Samples are printed at 12-bit scale. shift is the number of LSBs the end
+*   device had to drop to fit the block (0 for lossless blocks, 4 for legacy
+*   8-bit packets). Gaps in the block sequence numbers (blocks dropped by the
+*   end device or lost on the air) are reported on stderr.
+*
+*   The stream is expected in COBS framing (HOST_FRAMING in demo/settings.h),
+*   -e reads the older escaped framing instead.
+*
+*   usage: sampledecode [-b baud] [-n samples_per_block] [-e] [device|file|-]
+*
+* @author Alvaro Prieto
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "codec.h"
+#include "frame.h"
+#include "packet.h"
+#include "serial.h"
+
+#define MAX_SOURCES (256)
+
+typedef struct
+{
+  uint32_t blocks;
+  uint32_t bytes;
+  uint32_t errors;
+  uint32_t missing;
+  uint8_t last_sequence;
+} source_stats_t;
+
+static source_stats_t stats[MAX_SOURCES];
+
+/*******************************************************************************
+ * @fn     void process_frame( uint8_t* frame, uint16_t size,
+ *                                                  uint8_t sample_count )
+ * @brief  decode one sample packet and print it
+ * ****************************************************************************/
+static void process_frame( uint8_t* frame, uint16_t size, uint8_t sample_count )
+{
+  uint16_t samples[PACKET_MAX_SAMPLES];
+  sample_block_t block;
+  source_stats_t* source;
+  uint8_t missed;
+  uint8_t index;
+  int result;
+
+  result = packet_samples( frame, size, sample_count, &block, samples );
+  if( PACKET_OTHER == result )
+  {
+    return;
+  }
+
+  source = &stats[block.source];
+
+  if( source->blocks )
+  {
+    missed = (uint8_t)( block.sequence - source->last_sequence - 1 );
+    if( missed )
+    {
+      source->missing += missed;
+      fprintf( stderr, "%02x: %u blocks missing before %u\n", block.source,
+                                                    missed, block.sequence );
+    }
+  }
+  source->last_sequence = block.sequence;
+
+  if( PACKET_BAD == result )
+  {
+    source->errors++;
+    fprintf( stderr, "Bad block from %02x\n", block.source );
+    return;
+  }
+
+  printf( "%02x,%u,%u,%u,%u.%02u", block.source, block.sequence, block.shift,
+          block.payload_size,
+          codec_ratio( sample_count, block.payload_size ) / 100,
+          codec_ratio( sample_count, block.payload_size ) % 100 );
+  for( index = 0; index < sample_count; index++ )
+  {
+    printf( ",%u", samples[index] );
+  }
+  printf( "\n" );
+
+  source->blocks++;
+  source->bytes += block.payload_size;
+}
+
+int main( int argc, char** argv )
+{
+  frame_decoder_t decoder;
+  uint8_t buffer[256];
+  long baud = SERIAL_DEFAULT_BAUD;
+  int sample_count = PACKET_DEFAULT_SAMPLES;
+  uint8_t mode = FRAME_MODE_COBS;
+  const char* path = "-";
+  ssize_t received;
+  ssize_t index;
+  int option;
+  int fd;
+
+  while( (option = getopt( argc, argv, "b:n:e" )) != -1 )
+  {
+    switch( option )
+    {
+      case 'b': baud = atol( optarg ); break;
+      case 'n': sample_count = atoi( optarg ); break;
+      case 'e': mode = FRAME_MODE_ESCAPED; break;
+      default:
+        fprintf( stderr, "usage: %s [-b baud] [-n samples] [-e] [device]\n",
+                                                                    argv[0] );
+        return 1;
+    }
+  }
+
+  if( optind < argc )
+  {
+    path = argv[optind];
+  }
+
+  if( sample_count < 1 || sample_count > PACKET_MAX_SAMPLES )
+  {
+    fprintf( stderr, "Samples per block must be 1-%d\n", PACKET_MAX_SAMPLES );
+    return 1;
+  }
+
+  fd = serial_open( path, baud );
+  if( fd < 0 )
+  {
+    return 1;
+  }
+
+  frame_init( &decoder, mode );
+
+  while( (received = read( fd, buffer, sizeof(buffer) )) > 0 )
+  {
+    for( index = 0; index < received; index++ )
+    {
+      if( frame_push( &decoder, buffer[index] ) )
+      {
+        process_frame( decoder.buffer, decoder.length, sample_count );
+      }
+    }
+    fflush( stdout );
+  }
+
+  fprintf( stderr, "serial: %u frames, %u bad, %u bad CRC, %u missing\n",
+    decoder.frames, decoder.errors, decoder.crc_errors, decoder.missing );
+
+  // Per source summary
+  for( index = 0; index < MAX_SOURCES; index++ )
+  {
+    if( stats[index].blocks || stats[index].errors )
+    {
+      fprintf( stderr, "%02x: %u blocks, %u missing, %u bad, "
+        "mean ratio %.2f\n", (unsigned)index, stats[index].blocks,
+        stats[index].missing, stats[index].errors,
+        stats[index].bytes ? (1.5 * sample_count * stats[index].blocks) /
+                                                  stats[index].bytes : 0.0 );
+    }
+  }
+
+  return 0;
+}
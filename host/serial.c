@@ -0,0 +1,108 @@
+/** @file serial.c
+*
+* @brief Host side serial port helpers
+*
+* @author Alvaro Prieto
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "serial.h"
+
+/*******************************************************************************
+ * @fn     speed_t baud_to_speed( long baud )
+ * @brief  map a numeric baud rate to the termios constant
+ * ****************************************************************************/
+static speed_t baud_to_speed( long baud )
+{
+  switch( baud )
+  {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B500000
+    case 500000: return B500000;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+#ifdef B1000000
+    case 1000000: return B1000000;
+#endif
+    default: return 0;
+  }
+}
+
+/*******************************************************************************
+ * @fn     int serial_open( const char* path, long baud )
+ * @brief  open a serial device, pty or plain file for reading. "-" is stdin.
+ *         Terminals are put in raw mode at the given baud rate.
+ * @return File descriptor, or -1 on error
+ * ****************************************************************************/
+int serial_open( const char* path, long baud )
+{
+  struct termios tty;
+  speed_t speed;
+  int fd;
+
+  if( 0 == strcmp( path, "-" ) )
+  {
+    return STDIN_FILENO;
+  }
+
+  fd = open( path, O_RDWR | O_NOCTTY );
+  if( fd < 0 )
+  {
+    fd = open( path, O_RDONLY );
+  }
+  if( fd < 0 )
+  {
+    perror( path );
+    return -1;
+  }
+
+  // Regular files and pipes don't need any configuration
+  if( !isatty( fd ) )
+  {
+    return fd;
+  }
+
+  if( tcgetattr( fd, &tty ) < 0 )
+  {
+    perror( "tcgetattr" );
+    close( fd );
+    return -1;
+  }
+
+  cfmakeraw( &tty );
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cc[VMIN] = 1;
+  tty.c_cc[VTIME] = 0;
+
+  speed = baud_to_speed( baud );
+  if( 0 == speed )
+  {
+    fprintf( stderr, "Unsupported baud rate %ld\n", baud );
+    close( fd );
+    return -1;
+  }
+  cfsetispeed( &tty, speed );
+  cfsetospeed( &tty, speed );
+
+  if( tcsetattr( fd, TCSANOW, &tty ) < 0 )
+  {
+    perror( "tcsetattr" );
+    close( fd );
+    return -1;
+  }
+
+  return fd;
+}
@@ -0,0 +1,15 @@
+/** @file serial.h
+*
+* @brief Host side serial port helpers
+*
+* @author Alvaro Prieto
+*/
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#define SERIAL_DEFAULT_BAUD (115200)
+
+int serial_open( const char*, long );
+
+#endif /* _SERIAL_H */\
+
@@ -0,0 +1,81 @@
+/** @file test.h
+*
+* @brief Checks shared by the host tests that 'make hosttest' runs
+*
+*   Each test is a program of its own. A failed check prints where it is and
+*   the test carries on, test_result at the end of main sets the exit status.
+*
+* @author Alvaro Prieto
+*/
+#ifndef _TEST_H
+#define _TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+static uint32_t test_checks;
+static uint32_t test_failures;
+
+#define CHECK( condition ) \
+  test_check( (condition) ? 1 : 0, #condition, __FILE__, __LINE__ )
+
+#define CHECK_EQUAL( actual, expected ) \
+  test_check_equal( (long)(actual), (long)(expected), #actual, \
+                    __FILE__, __LINE__ )
+
+/*******************************************************************************
+ * @fn     int test_check( int passed, const char* text, const char* file,
+ *                         int line )
+ * @brief  count a check, print it if it failed
+ * @return [passed]
+ * ****************************************************************************/
+static inline int test_check( int passed, const char* text,
+                              const char* file, int line )
+{
+  test_checks++;
+
+  if( !passed )
+  {
+    test_failures++;
+    fprintf( stderr, "%s:%d: check failed: %s\n", file, line, text );
+  }
+
+  return passed;
+}
+
+/*******************************************************************************
+ * @fn     int test_check_equal( long actual, long expected, const char* text,
+ *                               const char* file, int line )
+ * @brief  count a check that [text] evaluated to [expected]
+ * @return 1 if it did
+ * ****************************************************************************/
+static inline int test_check_equal( long actual, long expected,
+                                    const char* text, const char* file,
+                                    int line )
+{
+  test_checks++;
+
+  if( actual != expected )
+  {
+    test_failures++;
+    fprintf( stderr, "%s:%d: %s is %ld, expected %ld\n", file, line, text,
+             actual, expected );
+  }
+
+  return ( actual == expected );
+}
+
+/*******************************************************************************
+ * @fn     int test_result( const char* name )
+ * @brief  print the totals for test [name]
+ * @return exit status, 0 if every check passed
+ * ****************************************************************************/
+static inline int test_result( const char* name )
+{
+  printf( "%s: %u checks, %u failed\n", name, test_checks, test_failures );
+
+  return test_failures ? 1 : 0;
+}
+
+#endif /* _TEST_H */\
+
@@ -0,0 +1,96 @@
+/** @file test_delay.c
+*
+* @brief Cycle counts of delay_cycles and delay_us on the host model of the
+*        busy waits: delay_cycles has to come out exact for short delays,
+*        around DELAY_LOOP_MAX loops and across several outer loops, and
+*        delay_us must never be short
+*
+* @author Alvaro Prieto
+*/
+#include "delay.h"
+#include "oscillator.h"
+#include "test.h"
+
+#define OUTER_CYCLES ( DELAY_LOOP_MAX * DELAY_LOOP_CYCLES + 2 )
+
+/*******************************************************************************
+ * @fn     uint32_t cycles_of( uint32_t cycles )
+ * @return cycles delay_cycles( [cycles] ) takes
+ * ****************************************************************************/
+static uint32_t cycles_of( uint32_t cycles )
+{
+  uint32_t start = hal_host_delay_cycles;
+
+  delay_cycles( cycles );
+
+  return hal_host_delay_cycles - start;
+}
+
+/*******************************************************************************
+ * @fn     void check_range( uint32_t first, uint32_t last )
+ * @brief  delay_cycles is exact for every count from [first] to [last]
+ * ****************************************************************************/
+static void check_range( uint32_t first, uint32_t last )
+{
+  uint32_t cycles;
+  uint32_t taken;
+  uint32_t failures = 0;
+
+  for( cycles = first; cycles <= last; cycles++ )
+  {
+    taken = cycles_of( cycles );
+    if( taken != cycles )
+    {
+      if( !failures )
+      {
+        fprintf( stderr, "delay_cycles( %u ) took %u cycles\n", cycles,
+                 taken );
+      }
+      failures++;
+    }
+  }
+
+  CHECK_EQUAL( failures, 0 );
+}
+
+static void test_delay_us( void )
+{
+  uint32_t us;
+  uint32_t start;
+  uint32_t taken;
+  uint32_t failures = 0;
+
+  for( us = 0; us <= 5000; us++ )
+  {
+    start = hal_host_delay_cycles;
+    delay_us( us );
+    taken = hal_host_delay_cycles - start + DELAY_US_OVERHEAD;
+
+    if( (uint64_t)taken * 1000000 < (uint64_t)us * SMCLK_FREQUENCY )
+    {
+      if( !failures )
+      {
+        fprintf( stderr, "delay_us( %u ) took %u cycles\n", us, taken );
+      }
+      failures++;
+    }
+  }
+
+  CHECK_EQUAL( failures, 0 );
+}
+
+int main( void )
+{
+  // Short delays, where the loop count used to come out as 0 for 4 cycles
+  check_range( 0, 20 );
+
+  // The longest single loop and the first outer loop
+  check_range( DELAY_LOOP_MAX * DELAY_LOOP_CYCLES - 20, OUTER_CYCLES + 20 );
+
+  // Several outer loops
+  check_range( 3 * OUTER_CYCLES - 20, 3 * OUTER_CYCLES + 20 );
+
+  test_delay_us();
+
+  return test_result( "delay" );
+}
@@ -0,0 +1,192 @@
+/** @file test_format.c
+*
+* @brief lib/format.c against snprintf over every input: format_hex for each
+*        byte, format_uint for each value and width, format_int, format_dbm
+*        for each raw RSSI and offset, and rssi_to_string compared with the
+*        sprintf code it replaced
+*
+* @author Alvaro Prieto
+*/
+#include <stdio.h>
+#include <string.h>
+#include "format.h"
+#include "radio_ext.h"
+#include "test.h"
+
+/*******************************************************************************
+ * @fn     int compare( uint8_t* output, uint8_t length, const char* expected )
+ * @brief  check that [length] characters at [output] spell [expected]
+ * @return 1 if they do
+ * ****************************************************************************/
+static int compare( uint8_t* output, uint8_t length, const char* expected )
+{
+  return ( strlen( expected ) == length ) &&
+         ( 0 == memcmp( output, expected, length ) );
+}
+
+/*******************************************************************************
+ * @fn     int reference_dbm( uint8_t rssi_raw, uint8_t offset )
+ * @brief  dBm the way radio_ext.c worked it out before format.c
+ * ****************************************************************************/
+static int reference_dbm( uint8_t rssi_raw, uint8_t offset )
+{
+  int value = rssi_raw;
+
+  if( value >= 128 )
+  {
+    value -= 256;
+  }
+
+  return value / 2 - offset;
+}
+
+static void test_hex( void )
+{
+  uint8_t bytes[256];
+  uint8_t output[2 * 256];
+  char expected[2 * 256 + 1];
+  uint16_t value;
+  uint32_t failures = 0;
+
+  for( value = 0; value < 256; value++ )
+  {
+    bytes[value] = (uint8_t)value;
+    snprintf( &expected[2 * value], 3, "%02x", value );
+
+    if( !compare( output, format_hex( output, &bytes[value], 1 ),
+                  &expected[2 * value] ) )
+    {
+      failures++;
+    }
+  }
+  CHECK_EQUAL( failures, 0 );
+
+  // All of them in one call, the length comes back as a uint8_t
+  memset( output, 0, sizeof(output) );
+  CHECK_EQUAL( format_hex( output, bytes, 127 ), 254 );
+  CHECK( 0 == memcmp( output, expected, 254 ) );
+}
+
+static void test_uint( void )
+{
+  uint8_t output[FORMAT_INT_MAX];
+  char expected[FORMAT_INT_MAX + 1];
+  uint32_t value;
+  uint8_t width;
+  uint32_t failures;
+
+  for( width = 0; width <= 5; width++ )
+  {
+    failures = 0;
+    for( value = 0; value <= 0xFFFF; value++ )
+    {
+      snprintf( expected, sizeof(expected), "%0*u", width, value );
+      if( !compare( output, format_uint( output, value, width ), expected ) )
+      {
+        if( !failures )
+        {
+          fprintf( stderr, "format_uint( %u, %u ) isn't %s\n", value, width,
+                   expected );
+        }
+        failures++;
+      }
+    }
+    CHECK_EQUAL( failures, 0 );
+  }
+}
+
+static void test_int( void )
+{
+  uint8_t output[FORMAT_INT_MAX];
+  char expected[FORMAT_INT_MAX + 1];
+  int32_t value;
+  uint32_t failures = 0;
+
+  for( value = -32768; value <= 32767; value++ )
+  {
+    snprintf( expected, sizeof(expected), "%d", value );
+    if( !compare( output, format_int( output, value ), expected ) )
+    {
+      if( !failures )
+      {
+        fprintf( stderr, "format_int( %d ) isn't %s\n", value, expected );
+      }
+      failures++;
+    }
+  }
+  CHECK_EQUAL( failures, 0 );
+}
+
+static void test_dbm( void )
+{
+  uint8_t output[FORMAT_INT_MAX];
+  char expected[FORMAT_INT_MAX + 1];
+  uint16_t rssi_raw;
+  uint16_t offset;
+  uint32_t failures = 0;
+
+  for( offset = 0; offset < 256; offset++ )
+  {
+    for( rssi_raw = 0; rssi_raw < 256; rssi_raw++ )
+    {
+      snprintf( expected, sizeof(expected), "%d",
+                reference_dbm( rssi_raw, offset ) );
+      if( ( format_rssi_dbm( rssi_raw, offset ) !=
+            reference_dbm( rssi_raw, offset ) ) ||
+          !compare( output, format_dbm( output, rssi_raw, offset ),
+                    expected ) )
+      {
+        if( !failures )
+        {
+          fprintf( stderr, "format_dbm( %u, %u ) isn't %s\n", rssi_raw,
+                   offset, expected );
+        }
+        failures++;
+      }
+    }
+  }
+  CHECK_EQUAL( failures, 0 );
+}
+
+static void test_rssi_to_string( void )
+{
+  uint8_t raw[50];
+  uint8_t output[50 * 4];
+  char expected[50 * 4 + 1];
+  uint16_t first;
+  uint16_t length;
+  uint8_t index;
+  uint32_t failures = 0;
+
+  // Runs of 50 raw values, as many as fit in a uint8_t length, starting at
+  // each value
+  for( first = 0; first < 256; first++ )
+  {
+    length = 0;
+    for( index = 0; index < sizeof(raw); index++ )
+    {
+      raw[index] = (uint8_t)( first + index );
+      length += snprintf( &expected[length], sizeof(expected) - length, "%d",
+                          reference_dbm( raw[index],
+                                         RADIO_RSSI_OFFSET_868MHZ ) );
+    }
+
+    if( !compare( output, rssi_to_string( output, raw, sizeof(raw) ),
+                  expected ) )
+    {
+      failures++;
+    }
+  }
+  CHECK_EQUAL( failures, 0 );
+}
+
+int main( void )
+{
+  test_hex();
+  test_uint();
+  test_int();
+  test_dbm();
+  test_rssi_to_string();
+
+  return test_result( "format" );
+}
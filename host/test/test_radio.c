@@ -0,0 +1,147 @@
+/** @file test_radio.c
+*
+* @brief radio_isr against the radio model in hal_host.c: packets with a good
+*        CRC reach the callback, packets with a bad CRC are dropped, and the
+*        radio is back in RX after either and after a transmission
+*
+* @author Alvaro Prieto
+*/
+#include <string.h>
+#include "radio.h"
+#include "test.h"
+
+static uint8_t received[RX_BUFFER_SIZE];
+static uint8_t received_size;
+static uint32_t callbacks;
+static uint8_t wake;
+
+static uint8_t sent[64];
+static uint8_t sent_size;
+
+/*******************************************************************************
+ * @fn     uint8_t rx_callback( uint8_t* buffer, uint8_t size )
+ * @brief  keep a copy of the packet
+ * @return [wake], 1 to leave the low power mode
+ * ****************************************************************************/
+static uint8_t rx_callback( uint8_t* buffer, uint8_t size )
+{
+  memcpy( received, buffer, size );
+  received_size = size;
+  callbacks++;
+
+  return wake;
+}
+
+/*******************************************************************************
+ * @fn     void radio_tx_hook( uint8_t* packet, uint8_t size )
+ * @brief  keep a copy of the TX FIFO, the transmission ends when the test
+ *         calls hal_host_radio_tx_done
+ * ****************************************************************************/
+static void radio_tx_hook( uint8_t* packet, uint8_t size )
+{
+  memcpy( sent, packet, size );
+  sent_size = size;
+}
+
+static void test_good_crc( void )
+{
+  uint8_t packet[] = { 5, 0x10, 0x7e, 0x00, 0xff, 0x42 };
+  uint8_t rx_count = radio_rx_count;
+
+  callbacks = 0;
+  wake = 0;
+  CHECK( hal_host_radio_receive( packet, 0xC8, 1 ) );
+
+  CHECK_EQUAL( callbacks, 1 );
+  CHECK_EQUAL( (uint8_t)( radio_rx_count - rx_count ), 1 );
+
+  // Length byte, payload, then the appended RSSI and CRC_OK/LQI
+  CHECK_EQUAL( received_size, sizeof(packet) + 2 );
+  CHECK( 0 == memcmp( received, packet, sizeof(packet) ) );
+  CHECK_EQUAL( received[received_size + RSSI_IDX_OFFSET], 0xC8 );
+  CHECK( received[received_size + CRC_LQI_IDX_OFFSET] & CRC_OK );
+
+  CHECK_EQUAL( hal_host_radio_state(), HAL_HOST_RADIO_RX );
+}
+
+static void test_bad_crc( void )
+{
+  uint8_t bad[] = { 3, 0x01, 0x02, 0x03 };
+  uint8_t good[] = { 2, 0xAA, 0x55 };
+  uint8_t rx_count = radio_rx_count;
+
+  callbacks = 0;
+  CHECK( hal_host_radio_receive( bad, 0x80, 0 ) );
+
+  CHECK_EQUAL( callbacks, 0 );
+  CHECK_EQUAL( radio_rx_count, rx_count );
+  CHECK_EQUAL( hal_host_radio_state(), HAL_HOST_RADIO_RX );
+
+  // The FIFO was flushed, the next packet starts at its length byte
+  CHECK( hal_host_radio_receive( good, 0x80, 1 ) );
+  CHECK_EQUAL( callbacks, 1 );
+  CHECK_EQUAL( received_size, sizeof(good) + 2 );
+  CHECK( 0 == memcmp( received, good, sizeof(good) ) );
+}
+
+static void test_wake( void )
+{
+  uint8_t packet[] = { 1, 0x33 };
+
+  // The ISR runs on top of LPM3, the callback decides if it ends
+  wake = 0;
+  hal_host_sr |= LPM3_bits;
+  CHECK( hal_host_radio_receive( packet, 0x80, 1 ) );
+  CHECK( hal_host_sr & CPUOFF );
+
+  wake = 1;
+  CHECK( hal_host_radio_receive( packet, 0x80, 1 ) );
+  CHECK( !( hal_host_sr & CPUOFF ) );
+
+  // Bad packets never wake it
+  hal_host_sr |= LPM3_bits;
+  CHECK( hal_host_radio_receive( packet, 0x80, 0 ) );
+  CHECK( hal_host_sr & CPUOFF );
+
+  hal_host_sr &= ~LPM4_bits;
+  wake = 0;
+}
+
+static void test_tx( void )
+{
+  uint8_t packet[] = { 4, 0x01, 0x02, 0x03, 0x04 };
+  uint8_t tx_count = radio_tx_count;
+
+  hal_host_radio_tx = radio_tx_hook;
+  radio_tx( packet, sizeof(packet) );
+
+  CHECK_EQUAL( hal_host_radio_state(), HAL_HOST_RADIO_TX );
+  CHECK_EQUAL( sent_size, sizeof(packet) );
+  CHECK( 0 == memcmp( sent, packet, sizeof(packet) ) );
+
+  // Nothing is received while transmitting
+  CHECK( !hal_host_radio_receive( packet, 0x80, 1 ) );
+
+  hal_host_radio_tx_done();
+  hal_host_service();
+
+  CHECK_EQUAL( (uint8_t)( radio_tx_count - tx_count ), 1 );
+  CHECK_EQUAL( hal_host_radio_state(), HAL_HOST_RADIO_RX );
+
+  hal_host_radio_tx = 0;
+}
+
+int main( void )
+{
+  setup_radio( rx_callback );
+  eint();
+
+  CHECK_EQUAL( hal_host_radio_state(), HAL_HOST_RADIO_RX );
+
+  test_good_crc();
+  test_bad_crc();
+  test_wake();
+  test_tx();
+
+  return test_result( "radio" );
+}
@@ -0,0 +1,339 @@
+/** @file test_samplecollect.c
+*
+* @brief samplecollect end to end: a recorded access point stream is written
+*        to a pty the way a serial port would deliver it, then the stores
+*        samplecollect leaves behind are checked block by block
+*
+*   host/fixtures/samples_escaped.bin is the UART output of demoap in netsim
+*   (demo_star with two end devices, HOST_FRAMING set to escaped), with the
+*   blocks 0x10 and 0x11 of device 02 cut out so that its store has a gap.
+*
+*   usage: test_samplecollect samplecollect fixture directory
+*
+* @author Alvaro Prieto
+*/
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "colstore.h"
+#include "frame.h"
+#include "packet.h"
+#include "test.h"
+
+// Bytes per write to the pty, and the pause between writes
+#define CHUNK_SIZE (64)
+#define CHUNK_US (2000)
+
+// How long samplecollect gets to store everything
+#define TIMEOUT_MS (5000)
+
+#define FIXTURE_MAX (65536)
+#define BLOCKS_MAX (64)
+
+typedef struct
+{
+  uint8_t source;
+  uint64_t blocks;
+  uint64_t missing;
+  uint8_t first_sequence;
+  uint8_t gap_block;        // Block with missing_before set
+  uint8_t gap;
+} expected_t;
+
+static const expected_t expected[] =
+{
+  { 0x01, 20, 0, 0x0b, 0, 0 },
+  { 0x02, 18, 2, 0x0b, 5, 2 },
+};
+
+#define SOURCES ( sizeof(expected) / sizeof(expected[0]) )
+
+// The fixture decoded here, to compare the stored samples with
+static uint16_t samples[SOURCES][BLOCKS_MAX][PACKET_DEFAULT_SAMPLES];
+static uint8_t shifts[SOURCES][BLOCKS_MAX];
+static uint32_t decoded[SOURCES];
+
+/*******************************************************************************
+ * @fn     size_t read_fixture( const char* path, uint8_t* buffer )
+ * @return size of the fixture, 0 if it couldn't be read
+ * ****************************************************************************/
+static size_t read_fixture( const char* path, uint8_t* buffer )
+{
+  FILE* file = fopen( path, "rb" );
+  size_t size;
+
+  if( !file )
+  {
+    perror( path );
+    return 0;
+  }
+
+  size = fread( buffer, 1, FIXTURE_MAX, file );
+  fclose( file );
+
+  return size;
+}
+
+/*******************************************************************************
+ * @fn     void decode_fixture( uint8_t* stream, size_t size )
+ * @brief  the blocks the stores should end up with, per source
+ * ****************************************************************************/
+static void decode_fixture( uint8_t* stream, size_t size )
+{
+  frame_decoder_t decoder;
+  sample_block_t block;
+  size_t index;
+  uint8_t source;
+
+  frame_init( &decoder, FRAME_MODE_ESCAPED );
+
+  for( index = 0; index < size; index++ )
+  {
+    if( !frame_push( &decoder, stream[index] ) )
+    {
+      continue;
+    }
+
+    for( source = 0; source < SOURCES; source++ )
+    {
+      if( ( decoder.length > 1 ) &&
+          ( decoder.buffer[1] == expected[source].source ) &&
+          ( decoded[source] < BLOCKS_MAX ) )
+      {
+        break;
+      }
+    }
+
+    if( ( source < SOURCES ) &&
+        ( PACKET_OK == packet_samples( decoder.buffer, decoder.length,
+                                       PACKET_DEFAULT_SAMPLES, &block,
+                                       samples[source][decoded[source]] ) ) )
+    {
+      shifts[source][decoded[source]++] = block.shift;
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     int open_pty( char* slave_path, size_t size )
+ * @brief  pty for samplecollect to read from, raw from the start so nothing
+ *         written before samplecollect opens it goes through the line
+ *         discipline
+ * @return master file descriptor, -1 on error
+ * ****************************************************************************/
+static int open_pty( char* slave_path, size_t size )
+{
+  struct termios tty;
+  int master = posix_openpt( O_RDWR | O_NOCTTY );
+  int slave;
+
+  if( master < 0 || grantpt( master ) < 0 || unlockpt( master ) < 0 )
+  {
+    perror( "pty" );
+    return -1;
+  }
+
+  snprintf( slave_path, size, "%s", ptsname( master ) );
+
+  slave = open( slave_path, O_RDWR | O_NOCTTY );
+  if( slave < 0 || tcgetattr( slave, &tty ) < 0 )
+  {
+    perror( slave_path );
+    return -1;
+  }
+  cfmakeraw( &tty );
+  tcsetattr( slave, TCSANOW, &tty );
+  close( slave );
+
+  return master;
+}
+
+/*******************************************************************************
+ * @fn     uint64_t stored_blocks( const char* directory )
+ * @brief  blocks samplecollect has stored so far, over every source
+ * ****************************************************************************/
+static uint64_t stored_blocks( const char* directory )
+{
+  colstore_header_t header;
+  char path[4096];
+  uint64_t total = 0;
+  uint8_t source;
+  FILE* file;
+
+  for( source = 0; source < SOURCES; source++ )
+  {
+    snprintf( path, sizeof(path), "%s/%02x.idx", directory,
+              expected[source].source );
+    file = fopen( path, "rb" );
+    if( file )
+    {
+      if( 1 == fread( &header, sizeof(header), 1, file ) )
+      {
+        total += header.blocks;
+      }
+      fclose( file );
+    }
+  }
+
+  return total;
+}
+
+/*******************************************************************************
+ * @fn     void check_store( const char* directory, uint8_t source )
+ * @brief  index header, every block and its samples, and the file sizes
+ * ****************************************************************************/
+static void check_store( const char* directory, uint8_t source )
+{
+  const expected_t* expect = &expected[source];
+  colstore_t store;
+  colstore_block_t* block;
+  struct stat status;
+  char path[4096];
+  uint64_t previous_time = 0;
+  uint32_t sequence = expect->first_sequence;
+  uint64_t index;
+
+  if( !CHECK( 0 == colstore_open( &store, directory, expect->source, 0,
+                                  0 ) ) )
+  {
+    return;
+  }
+
+  CHECK( 0 == memcmp( store.header->magic, COLSTORE_MAGIC, 8 ) );
+  CHECK_EQUAL( store.header->source, expect->source );
+  CHECK_EQUAL( store.header->samples_per_block, PACKET_DEFAULT_SAMPLES );
+  CHECK_EQUAL( store.header->blocks, expect->blocks );
+  CHECK_EQUAL( store.header->missing, expect->missing );
+  CHECK_EQUAL( store.header->samples, expect->blocks * PACKET_DEFAULT_SAMPLES );
+  CHECK_EQUAL( decoded[source], expect->blocks );
+
+  for( index = 0; ( index < store.header->blocks ) &&
+                  ( index < decoded[source] ); index++ )
+  {
+    block = &store.blocks[index];
+
+    if( expect->gap && ( index == expect->gap_block ) )
+    {
+      CHECK_EQUAL( block->missing_before, expect->gap );
+      sequence += expect->gap;
+    }
+    else
+    {
+      CHECK_EQUAL( block->missing_before, 0 );
+    }
+
+    CHECK_EQUAL( block->sequence, sequence++ );
+    CHECK_EQUAL( block->first_sample, index * PACKET_DEFAULT_SAMPLES );
+    CHECK_EQUAL( block->count, PACKET_DEFAULT_SAMPLES );
+    CHECK_EQUAL( block->shift, shifts[source][index] );
+    CHECK( block->time_ns >= previous_time );
+    previous_time = block->time_ns;
+
+    CHECK( 0 == memcmp( &store.samples[block->first_sample],
+                        samples[source][index],
+                        sizeof(samples[source][index]) ) );
+  }
+
+  // Trimmed to what was written when samplecollect closed them
+  snprintf( path, sizeof(path), "%s/%02x.idx", directory, expect->source );
+  CHECK( 0 == stat( path, &status ) );
+  CHECK_EQUAL( status.st_size, sizeof(colstore_header_t) +
+                               expect->blocks * sizeof(colstore_block_t) );
+
+  snprintf( path, sizeof(path), "%s/%02x.smp", directory, expect->source );
+  CHECK( 0 == stat( path, &status ) );
+  CHECK_EQUAL( status.st_size, expect->blocks * PACKET_DEFAULT_SAMPLES *
+                               sizeof(uint16_t) );
+
+  colstore_close( &store );
+}
+
+int main( int argc, char** argv )
+{
+  static uint8_t stream[FIXTURE_MAX];
+  struct timespec pause = { 0, CHUNK_US * 1000 };
+  char slave_path[256];
+  size_t size;
+  size_t offset;
+  size_t chunk;
+  uint64_t total = 0;
+  uint32_t waited;
+  uint8_t source;
+  pid_t pid;
+  int status;
+  int master;
+
+  if( argc != 4 )
+  {
+    fprintf( stderr, "usage: %s samplecollect fixture directory\n", argv[0] );
+    return 1;
+  }
+
+  size = read_fixture( argv[2], stream );
+  if( !size )
+  {
+    return 1;
+  }
+  decode_fixture( stream, size );
+
+  master = open_pty( slave_path, sizeof(slave_path) );
+  if( master < 0 )
+  {
+    return 1;
+  }
+
+  pid = fork();
+  if( 0 == pid )
+  {
+    execl( argv[1], argv[1], "-e", "-d", argv[3], slave_path, (char*)0 );
+    perror( argv[1] );
+    _exit( 1 );
+  }
+
+  // A few frames per write, as they would come from the access point
+  for( offset = 0; offset < size; offset += chunk )
+  {
+    chunk = ( size - offset < CHUNK_SIZE ) ? size - offset : CHUNK_SIZE;
+    if( write( master, &stream[offset], chunk ) != (ssize_t)chunk )
+    {
+      perror( "write" );
+      break;
+    }
+    nanosleep( &pause, 0 );
+  }
+
+  for( source = 0; source < SOURCES; source++ )
+  {
+    total += expected[source].blocks;
+  }
+
+  for( waited = 0; waited < TIMEOUT_MS; waited += CHUNK_US / 1000 )
+  {
+    if( stored_blocks( argv[3] ) >= total )
+    {
+      break;
+    }
+    nanosleep( &pause, 0 );
+  }
+
+  // Stores are trimmed and closed on the way out
+  kill( pid, SIGINT );
+  CHECK( pid == waitpid( pid, &status, 0 ) );
+  CHECK( WIFEXITED( status ) && 0 == WEXITSTATUS( status ) );
+  close( master );
+
+  for( source = 0; source < SOURCES; source++ )
+  {
+    check_store( argv[3], source );
+  }
+
+  return test_result( "samplecollect" );
+}
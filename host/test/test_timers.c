@@ -0,0 +1,235 @@
+/** @file test_timers.c
+*
+* @brief Timer0_A and Timer1_A interrupt dispatch: each TAxIV value reaches
+*        the callback registered for it, CCR1-4 in priority order, and the
+*        callback's return value decides whether LPM3 ends
+*
+* @author Alvaro Prieto
+*/
+#include <string.h>
+#include "timers.h"
+#include "test.h"
+
+// Handlers are plain functions in the host build
+void timerA0Interrupt( void );
+void timerA1Interrupt( void );
+void timer1A0Interrupt( void );
+void timer1A1Interrupt( void );
+
+#define LOG_SIZE (16)
+
+// Callbacks log their number, Timer1_A ones add TA1_BASE
+#define TA1_BASE (10)
+#define OVERFLOW (TOTAL_CCRS)
+
+static uint8_t log_entries[LOG_SIZE];
+static uint8_t log_length;
+static uint8_t wake;
+
+static void log_clear( void )
+{
+  log_length = 0;
+  memset( log_entries, 0xFF, sizeof(log_entries) );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t log_callback( uint8_t number )
+ * @brief  note that callback [number] ran
+ * @return [wake]
+ * ****************************************************************************/
+static uint8_t log_callback( uint8_t number )
+{
+  if( log_length < LOG_SIZE )
+  {
+    log_entries[log_length++] = number;
+  }
+
+  return wake;
+}
+
+static uint8_t ccr0_callback( void ) { return log_callback( 0 ); }
+static uint8_t ccr1_callback( void ) { return log_callback( 1 ); }
+static uint8_t ccr2_callback( void ) { return log_callback( 2 ); }
+static uint8_t ccr3_callback( void ) { return log_callback( 3 ); }
+static uint8_t ccr4_callback( void ) { return log_callback( 4 ); }
+static uint8_t overflow_callback( void ) { return log_callback( OVERFLOW ); }
+
+static uint8_t ta1_ccr0_callback( void )
+{
+  return log_callback( TA1_BASE + 0 );
+}
+
+static uint8_t ta1_ccr1_callback( void )
+{
+  return log_callback( TA1_BASE + 1 );
+}
+
+static uint8_t ta1_ccr2_callback( void )
+{
+  return log_callback( TA1_BASE + 2 );
+}
+
+static uint8_t ta1_overflow_callback( void )
+{
+  return log_callback( TA1_BASE + TOTAL_TA1_CCRS );
+}
+
+static void test_ta0_vectors( void )
+{
+  uint8_t index;
+
+  // Raised together while interrupts are off, served lowest TA0IV first
+  dint();
+  log_clear();
+  TA0CCTL4 = CCIE | CCIFG;
+  TA0CCTL1 = CCIE | CCIFG;
+  TA0CCTL3 = CCIE | CCIFG;
+  eint();
+
+  CHECK_EQUAL( log_length, 3 );
+  CHECK_EQUAL( log_entries[0], 1 );
+  CHECK_EQUAL( log_entries[1], 3 );
+  CHECK_EQUAL( log_entries[2], 4 );
+  CHECK( !( TA0CCTL1 & CCIFG ) );
+  CHECK( !( TA0CCTL3 & CCIFG ) );
+  CHECK( !( TA0CCTL4 & CCIFG ) );
+
+  // CCR0 has its own, higher priority vector
+  dint();
+  log_clear();
+  TA0CCTL2 = CCIE | CCIFG;
+  TA0CCTL0 = CCIE | CCIFG;
+  eint();
+
+  CHECK_EQUAL( log_length, 2 );
+  CHECK_EQUAL( log_entries[0], 0 );
+  CHECK_EQUAL( log_entries[1], 2 );
+  CHECK( !( TA0CCTL0 & CCIFG ) );
+
+  // A flag without CCIE stays pending and calls nothing
+  log_clear();
+  TA0CCTL2 = CCIFG;
+  hal_host_service();
+  CHECK_EQUAL( log_length, 0 );
+  CHECK( TA0CCTL2 & CCIFG );
+
+  // CCIE stays set on the rest, they would all match when TA0R wraps to 0
+  for( index = 0; index < TOTAL_CCRS; index++ )
+  {
+    clear_ccr( index );
+  }
+  TA0CCTL2 = 0;
+}
+
+static void test_ta0_counting( void )
+{
+  uint64_t before = timebase_now64();
+  uint32_t to_overflow;
+
+  // A compare reached by counting
+  log_clear();
+  set_ccr( 2, TA0R + 100 );
+  hal_host_timer_advance( 99 );
+  CHECK_EQUAL( log_length, 0 );
+  hal_host_timer_advance( 1 );
+  CHECK_EQUAL( log_length, 1 );
+  CHECK_EQUAL( log_entries[0], 2 );
+  clear_ccr( 2 );
+
+  // The overflow goes to its callback and into the timebase
+  log_clear();
+  to_overflow = 0x10000 - TA0R;
+  hal_host_timer_advance( to_overflow );
+  CHECK_EQUAL( log_length, 1 );
+  CHECK_EQUAL( log_entries[0], OVERFLOW );
+  CHECK_EQUAL( TA0R, 0 );
+  CHECK_EQUAL( timebase_now64() - before, 100 + to_overflow );
+}
+
+static void test_ta0_wake( void )
+{
+  dint();
+  wake = 0;
+  hal_host_sr |= LPM3_bits;
+  TA0CCTL1 = CCIE | CCIFG;
+  eint();
+  CHECK( hal_host_sr & CPUOFF );
+
+  dint();
+  wake = 1;
+  TA0CCTL1 = CCIE | CCIFG;
+  eint();
+  CHECK( !( hal_host_sr & CPUOFF ) );
+
+  hal_host_sr &= ~LPM4_bits;
+  wake = 0;
+  TA0CCTL1 = 0;
+}
+
+static void test_ta1_vectors( void )
+{
+  static const uint16_t vectors[] =
+  {
+    TIV_CCR1, TIV_CCR2, TIV_OVERFLOW
+  };
+  static const uint8_t expected[] =
+  {
+    TA1_BASE + 1, TA1_BASE + 2, TA1_BASE + TOTAL_TA1_CCRS
+  };
+  uint8_t index;
+
+  // Timer1_A doesn't count in the model, the handlers are called directly
+  // with the vector it would have read
+  for( index = 0; index < sizeof(vectors) / sizeof(vectors[0]); index++ )
+  {
+    log_clear();
+    TA1IV = vectors[index];
+    timer1A1Interrupt();
+    CHECK_EQUAL( log_length, 1 );
+    CHECK_EQUAL( log_entries[0], expected[index] );
+  }
+
+  log_clear();
+  TA1IV = 0;
+  timer1A1Interrupt();
+  CHECK_EQUAL( log_length, 0 );
+
+  log_clear();
+  timer1A0Interrupt();
+  CHECK_EQUAL( log_length, 1 );
+  CHECK_EQUAL( log_entries[0], TA1_BASE + 0 );
+
+  // The wake up applies to the status register the handler returns to
+  wake = 1;
+  hal_host_sr |= LPM3_bits;
+  TA1IV = TIV_CCR2;
+  timer1A1Interrupt();
+  CHECK( !( hal_host_sr & CPUOFF ) );
+  wake = 0;
+}
+
+int main( void )
+{
+  setup_timer_a( MODE_CONTINUOUS );
+  register_timer_callback( ccr0_callback, 0 );
+  register_timer_callback( ccr1_callback, 1 );
+  register_timer_callback( ccr2_callback, 2 );
+  register_timer_callback( ccr3_callback, 3 );
+  register_timer_callback( ccr4_callback, 4 );
+  register_timer_callback( overflow_callback, OVERFLOW );
+
+  setup_timer_a1( MODE_CONTINUOUS );
+  register_timer_a1_callback( ta1_ccr0_callback, 0 );
+  register_timer_a1_callback( ta1_ccr1_callback, 1 );
+  register_timer_a1_callback( ta1_ccr2_callback, 2 );
+  register_timer_a1_callback( ta1_overflow_callback, TOTAL_TA1_CCRS );
+
+  eint();
+
+  test_ta0_vectors();
+  test_ta0_counting();
+  test_ta0_wake();
+  test_ta1_vectors();
+
+  return test_result( "timers" );
+}
@@ -0,0 +1,204 @@
+/** @file test_uart.c
+*
+* @brief uart_queue_escaped and uart_queue_cobs round trips: what the TX
+*        interrupt sends through the UART model is decoded with host/frame.c
+*        and has to come back as the buffer that was queued
+*
+* @author Alvaro Prieto
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "frame.h"
+#include "oscillator.h"
+#include "uart.h"
+#include "test.h"
+
+// Largest frames that fit in an empty ring, worst case for the escaped one
+#define ESCAPED_MAX ( ( UART_TX_RING_SIZE - 1 - 2 ) / 2 )
+#define COBS_MAX ( UART_TX_RING_SIZE - 1 - UART_COBS_OVERHEAD )
+
+static frame_decoder_t decoder;
+static uint32_t decoded;
+
+/*******************************************************************************
+ * @fn     void fill( uint8_t* buffer, uint16_t length )
+ * @brief  random bytes, with plenty of the ones framing has to deal with
+ * ****************************************************************************/
+static void fill( uint8_t* buffer, uint16_t length )
+{
+  static const uint8_t special[] = { 0x00, 0x7d, 0x7e, 0xff };
+  uint16_t index;
+
+  for( index = 0; index < length; index++ )
+  {
+    if( rand() & 1 )
+    {
+      buffer[index] = special[rand() % sizeof(special)];
+    }
+    else
+    {
+      buffer[index] = (uint8_t)rand();
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t decode_output( void )
+ * @brief  feed everything the UART sent to the decoder
+ * @return 1 if exactly one frame was complete, it is in decoder.buffer
+ * ****************************************************************************/
+static uint8_t decode_output( void )
+{
+  uint8_t output[1024];
+  uint16_t size;
+  uint16_t index;
+  uint8_t frames = 0;
+
+  size = hal_host_uart_output( output, sizeof(output) );
+
+  for( index = 0; index < size; index++ )
+  {
+    if( frame_push( &decoder, output[index] ) )
+    {
+      frames++;
+      decoded++;
+
+      // The frame only stays in the buffer until the next byte
+      if( index + 1 < size )
+      {
+        return 0;
+      }
+    }
+  }
+
+  return ( 1 == frames );
+}
+
+/*******************************************************************************
+ * @fn     void round_trip( uint8_t framing, uint8_t* buffer, uint16_t length )
+ * @brief  queue [buffer] and check what the decoder gets back
+ * ****************************************************************************/
+static void round_trip( uint8_t framing, uint8_t* buffer, uint16_t length )
+{
+  uint8_t queued;
+
+  if( UART_FRAMING_COBS == framing )
+  {
+    queued = uart_queue_cobs( buffer, length );
+  }
+  else
+  {
+    queued = uart_queue_escaped( buffer, length );
+  }
+
+  // The model sends each character as soon as it is written, so the ring
+  // has drained by the time the queue function returns
+  CHECK( queued );
+  CHECK_EQUAL( uart_tx_pending(), 0 );
+
+  if( CHECK( decode_output() ) )
+  {
+    CHECK_EQUAL( decoder.length, length );
+    CHECK( 0 == memcmp( decoder.buffer, buffer, length ) );
+  }
+}
+
+static void test_escaped( void )
+{
+  uint8_t buffer[ESCAPED_MAX];
+  uint16_t length;
+
+  frame_init( &decoder, FRAME_MODE_ESCAPED );
+
+  // Empty escaped frames look like two flags and aren't returned
+  for( length = 1; length <= ESCAPED_MAX; length++ )
+  {
+    fill( buffer, length );
+    round_trip( UART_FRAMING_ESCAPED, buffer, length );
+  }
+
+  // Nothing but bytes that need escaping
+  memset( buffer, 0x7e, ESCAPED_MAX );
+  round_trip( UART_FRAMING_ESCAPED, buffer, ESCAPED_MAX );
+  memset( buffer, 0x7d, ESCAPED_MAX );
+  round_trip( UART_FRAMING_ESCAPED, buffer, ESCAPED_MAX );
+
+  CHECK_EQUAL( decoder.errors, 0 );
+}
+
+static void test_cobs( void )
+{
+  uint8_t buffer[COBS_MAX];
+  uint16_t length;
+
+  frame_init( &decoder, FRAME_MODE_COBS );
+
+  for( length = 0; length <= COBS_MAX; length++ )
+  {
+    fill( buffer, length );
+    round_trip( UART_FRAMING_COBS, buffer, length );
+  }
+
+  // No zeros at all, one long COBS block
+  memset( buffer, 0x55, COBS_MAX );
+  round_trip( UART_FRAMING_COBS, buffer, COBS_MAX );
+  memset( buffer, 0x00, COBS_MAX );
+  round_trip( UART_FRAMING_COBS, buffer, COBS_MAX );
+
+  CHECK_EQUAL( decoder.errors, 0 );
+  CHECK_EQUAL( decoder.crc_errors, 0 );
+  CHECK_EQUAL( decoder.missing, 0 );
+}
+
+static void test_cobs_drop( void )
+{
+  uint8_t buffer[COBS_MAX];
+  uint16_t dropped = uart_tx_stats.dropped_frames;
+
+  fill( buffer, COBS_MAX );
+
+  // With interrupts off the ring can't drain, the second frame doesn't fit.
+  // It still takes a sequence number, which shows up as a gap.
+  dint();
+  CHECK( uart_queue_cobs( buffer, COBS_MAX ) );
+  CHECK( !uart_queue_cobs( buffer, COBS_MAX ) );
+  eint();
+
+  CHECK_EQUAL( uart_tx_stats.dropped_frames - dropped, 1 );
+  CHECK( decode_output() );
+  CHECK_EQUAL( decoder.missing, 0 );
+
+  round_trip( UART_FRAMING_COBS, buffer, 1 );
+  CHECK_EQUAL( decoder.missing, 1 );
+  CHECK_EQUAL( decoder.crc_errors, 0 );
+}
+
+static void test_baud( void )
+{
+  // 12 MHz oversampled, 1 MHz low frequency mode
+  CHECK_EQUAL( uart_set_baud( 115200, 12000000 ), 15 );
+  CHECK_EQUAL( uart_set_baud( 460800, 1048576 ), 113 );
+
+  // Faster than SMCLK can go
+  CHECK_EQUAL( uart_set_baud( 2000000, 1048576 ), UART_BAUD_UNREACHABLE );
+  CHECK_EQUAL( uart_set_baud( 0, 1048576 ), UART_BAUD_UNREACHABLE );
+
+  uart_set_baud( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+}
+
+int main( void )
+{
+  srand( 1 );
+
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+  eint();
+
+  test_escaped();
+  test_cobs();
+  test_cobs_drop();
+  test_baud();
+
+  printf( "uart: %u frames decoded\n", decoded );
+
+  return test_result( "uart" );
+}
@@ -0,0 +1,171 @@
+/** @file test_vtimer.c
+*
+* @brief Virtual timers on the Timer0_A model: each one runs at its
+*        deadline, in deadline order, whatever order they were started in,
+*        and starting one only moves the compare register earlier
+*
+* @author Alvaro Prieto
+*/
+#include <string.h>
+#include "timers.h"
+#include "vtimer.h"
+#include "test.h"
+
+#define LOG_SIZE (16)
+
+typedef struct
+{
+  uint8_t timer;
+  uint32_t time;
+} entry_t;
+
+static entry_t log_entries[LOG_SIZE];
+static uint8_t log_length;
+
+static vtimer_t timers[3];
+
+static void log_clear( void )
+{
+  log_length = 0;
+  memset( log_entries, 0, sizeof(log_entries) );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t log_callback( uint8_t timer )
+ * @brief  note that [timer] ran, and when
+ * @return 0
+ * ****************************************************************************/
+static uint8_t log_callback( uint8_t timer )
+{
+  if( log_length < LOG_SIZE )
+  {
+    log_entries[log_length].timer = timer;
+    log_entries[log_length].time = timebase_now();
+    log_length++;
+  }
+
+  return 0;
+}
+
+static uint8_t timer0_callback( void ) { return log_callback( 0 ); }
+static uint8_t timer1_callback( void ) { return log_callback( 1 ); }
+static uint8_t timer2_callback( void ) { return log_callback( 2 ); }
+
+static void test_order( void )
+{
+  uint32_t start = timebase_now();
+  uint16_t armed;
+
+  log_clear();
+
+  vtimer_start( &timers[0], 1000, 0, timer0_callback );
+  CHECK_EQUAL( TA0CCR4, (uint16_t)( start + 1000 ) );
+
+  // Earlier, the compare moves
+  vtimer_start( &timers[1], 300, 0, timer1_callback );
+  CHECK_EQUAL( TA0CCR4, (uint16_t)( start + 300 ) );
+  armed = TA0CCR4;
+
+  // Later, the compare stays where it is
+  vtimer_start( &timers[2], 5000, 0, timer2_callback );
+  CHECK_EQUAL( TA0CCR4, armed );
+
+  hal_host_timer_advance( 6000 );
+
+  CHECK_EQUAL( log_length, 3 );
+  CHECK_EQUAL( log_entries[0].timer, 1 );
+  CHECK_EQUAL( log_entries[0].time - start, 300 );
+  CHECK_EQUAL( log_entries[1].timer, 0 );
+  CHECK_EQUAL( log_entries[1].time - start, 1000 );
+  CHECK_EQUAL( log_entries[2].timer, 2 );
+  CHECK_EQUAL( log_entries[2].time - start, 5000 );
+
+  // Nothing left, the interrupt is off
+  CHECK( !( TA0CCTL4 & CCIE ) );
+}
+
+static void test_far( void )
+{
+  uint32_t start = timebase_now();
+
+  log_clear();
+
+  // Further than a revolution of the wheel and a timer period
+  vtimer_start( &timers[0], 100000, 0, timer0_callback );
+  vtimer_start( &timers[1], 20000, 0, timer1_callback );
+
+  hal_host_timer_advance( 110000 );
+
+  CHECK_EQUAL( log_length, 2 );
+  CHECK_EQUAL( log_entries[0].timer, 1 );
+  CHECK_EQUAL( log_entries[0].time - start, 20000 );
+  CHECK_EQUAL( log_entries[1].timer, 0 );
+  CHECK_EQUAL( log_entries[1].time - start, 100000 );
+}
+
+static void test_stop_restart( void )
+{
+  uint32_t start = timebase_now();
+
+  log_clear();
+
+  // The compare is left early for both, the interrupt finds nothing due
+  // and arms the next deadline
+  vtimer_start( &timers[0], 500, 0, timer0_callback );
+  vtimer_start( &timers[1], 200, 0, timer1_callback );
+  vtimer_stop( &timers[0] );
+  vtimer_start( &timers[1], 700, 0, timer1_callback );
+  vtimer_start( &timers[2], 900, 0, timer2_callback );
+
+  hal_host_timer_advance( 1000 );
+
+  CHECK_EQUAL( log_length, 2 );
+  CHECK_EQUAL( log_entries[0].timer, 1 );
+  CHECK_EQUAL( log_entries[0].time - start, 700 );
+  CHECK_EQUAL( log_entries[1].timer, 2 );
+  CHECK_EQUAL( log_entries[1].time - start, 900 );
+  CHECK( !vtimer_active( &timers[0] ) );
+}
+
+static void test_periodic( void )
+{
+  uint32_t start = timebase_now();
+  uint8_t index;
+
+  log_clear();
+
+  vtimer_start( &timers[0], 100, 250, timer0_callback );
+  vtimer_start( &timers[1], 700, 0, timer1_callback );
+
+  hal_host_timer_advance( 1100 );
+  vtimer_stop( &timers[0] );
+
+  // 100, 350, 600, the one-shot at 700, 850, 1100
+  CHECK_EQUAL( log_length, 6 );
+  CHECK_EQUAL( log_entries[3].timer, 1 );
+  CHECK_EQUAL( log_entries[3].time - start, 700 );
+  for( index = 0; index < log_length; index++ )
+  {
+    if( 3 != index )
+    {
+      CHECK_EQUAL( log_entries[index].timer, 0 );
+      CHECK_EQUAL( log_entries[index].time - start,
+                   100 + 250 * ( index - ( index > 3 ) ) );
+    }
+  }
+}
+
+int main( void )
+{
+  setup_timer_a( MODE_CONTINUOUS );
+  vtimer_init();
+
+  eint();
+
+  test_order();
+  test_far();
+  test_stop_restart();
+  test_periodic();
+
+  return test_result( "vtimer" );
+}
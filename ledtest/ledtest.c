@@ -8,12 +8,16 @@
 #include "intrinsics.h"
 #include "leds.h"
 #include "timers.h"
+#include "vtimer.h"
 #include <signal.h>
 
+#define BLINK_PERIOD (10900)
+
+static vtimer_t blink_timer;
+
 uint8_t blink_led1 (void)
 {
   led1_toggle();
-  increment_ccr( 1, 10900 );
   
   return 1;
 }
@@ -26,10 +30,9 @@ int main( void )
   // Initialize LEDs
   setup_leds();
   setup_timer_a(MODE_CONTINUOUS);
+  vtimer_init();
   
-  register_timer_callback( blink_led1, 1 );
-
-  set_ccr( 1, 10900);
+  vtimer_start( &blink_timer, BLINK_PERIOD, BLINK_PERIOD, blink_led1 );
   
   
   eint();
@@ -6,6 +6,7 @@
 * modified by Alvaro Prieto  
 */
 #include "RF1A.h"
+#include "delay.h"
 #include "intrinsics.h"
 
 // *****************************************************************************
@@ -41,8 +42,8 @@ uint8_t Strobe(uint8_t strobe)
         else  	
         {
           while ((RF1AIN&0x04)== 0x04);     // chip-ready ?
-          // Delay for ~810usec at 1.05MHz CPU clock, see erratum RF1A7
-          __delay_cycles(850);	            
+          // Delay for ~810usec, see erratum RF1A7
+          delay_us(810);	            
         }
       }
       WriteSingleReg(IOCFG2, gdo_state);    // restore IOCFG2 setting
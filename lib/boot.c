@@ -0,0 +1,62 @@
+/** @file boot.c
+*
+* @brief Boot stage timing, how long each part of start-up took
+*
+*   setup_oscillator starts Timer0_A from ACLK before anything else, and
+*   the slow parts of start-up mark when they are done. setup_timer_a takes
+*   the count over into the timebase, so timestamps carry on from boot.
+*
+* @author Alvaro Prieto
+*/
+#include "boot.h"
+
+boot_stats_t boot_stats;
+
+/*******************************************************************************
+ * @fn     void boot_start( void )
+ * @brief  count ACLK on Timer0_A from 0, without interrupts
+ * ****************************************************************************/
+void boot_start( void )
+{
+  uint8_t stage;
+
+  for( stage = 0; stage < BOOT_STAGES; stage++ )
+  {
+    boot_stats.ready[stage] = 0;
+  }
+  boot_stats.reached = 0;
+  boot_stats.clock_faults = 0;
+
+  TA0CTL = TASSEL__ACLK + MC_2 + TACLR;
+}
+
+/*******************************************************************************
+ * @fn     uint16_t boot_now( void )
+ * @return ACLK ticks since boot_start. TA0R runs from ACLK, it is read until
+ *         two reads agree.
+ * ****************************************************************************/
+uint16_t boot_now( void )
+{
+  uint16_t tar;
+
+  do
+  {
+    tar = TA0R;
+  } while( tar != TA0R );
+
+  return tar;
+}
+
+/*******************************************************************************
+ * @fn     void boot_mark( uint8_t stage )
+ * @brief  record the time [stage] finished. Only the first time counts, the
+ *         same setup functions may run again later.
+ * ****************************************************************************/
+void boot_mark( uint8_t stage )
+{
+  if( ( stage < BOOT_STAGES ) && !( boot_stats.reached & ( 1 << stage ) ) )
+  {
+    boot_stats.ready[stage] = boot_now();
+    boot_stats.reached |= ( 1 << stage );
+  }
+}
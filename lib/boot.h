@@ -0,0 +1,37 @@
+/** @file boot.h
+*
+* @brief Boot stage timing, how long each part of start-up took
+*
+* @author Alvaro Prieto
+*/
+#ifndef _BOOT_H
+#define _BOOT_H
+
+#include "common.h"
+
+// Stages in the order they finish
+#define BOOT_VCORE (0)    // Core voltage up for 12MHz and the radio
+#define BOOT_DCO (1)      // DCO out of its fault state at 12MHz
+#define BOOT_XT1 (2)      // 32kHz crystal running, or given up on
+#define BOOT_RADIO (3)    // Radio core out of reset and configured
+#define BOOT_STAGES (4)
+
+// How long setup_oscillator waits for the crystal, in ACLK ticks. ACLK runs
+// from REFO until the crystal starts.
+#define BOOT_XT1_TIMEOUT (16384)
+
+typedef struct
+{
+  uint16_t ready[BOOT_STAGES];  // ACLK ticks from boot_start to each stage
+  uint8_t reached;              // Bit per stage that has finished
+  uint16_t clock_faults;        // UCSCTL7 flags still set after the timeout
+} boot_stats_t;
+
+extern boot_stats_t boot_stats;
+
+void boot_start( void );
+uint16_t boot_now( void );
+void boot_mark( uint8_t );
+
+#endif /* _BOOT_H */\
+
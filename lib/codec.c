@@ -0,0 +1,348 @@
+/** @file codec.c
+*
+* @brief Sample block codec
+*
+*   Each block starts with the first sample written at full width. The
+*   remaining samples are sent as zig-zag mapped deltas using a Rice code
+*   whose parameter is picked per block. When a block does not fit in the
+*   space available, low order bits are dropped (one at a time, up to
+*   CODEC_MAX_SHIFT) and the block is coded again. At CODEC_MAX_SHIFT a
+*   bit-packed block of N samples takes exactly N bytes, so a block always
+*   fits wherever the old 8-bit samples did.
+*
+* @author Alvaro Prieto
+*/
+#include "codec.h"
+
+typedef struct
+{
+  uint8_t* buffer;
+  uint16_t bit_index;
+} bit_stream_t;
+
+static void put_bits( bit_stream_t*, uint16_t, uint8_t );
+static uint16_t get_bits( bit_stream_t*, uint8_t );
+static uint32_t rice_size( uint16_t*, uint8_t, uint8_t, uint8_t );
+static uint8_t rice_parameter( uint16_t*, uint8_t, uint8_t, uint32_t* );
+
+/*******************************************************************************
+ * @fn     uint16_t zigzag( int16_t delta )
+ * @brief  map signed delta to unsigned value (0,-1,1,-2,... -> 0,1,2,3,...)
+ * ****************************************************************************/
+static inline uint16_t zigzag( int16_t delta )
+{
+  return (uint16_t)( (delta << 1) ^ (delta >> 15) );
+}
+
+/*******************************************************************************
+ * @fn     int16_t unzigzag( uint16_t value )
+ * @brief  inverse of zigzag()
+ * ****************************************************************************/
+static inline int16_t unzigzag( uint16_t value )
+{
+  return (int16_t)( (value >> 1) ^ (-(int16_t)(value & 1)) );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t codec_encode( uint8_t* buffer_out, uint8_t buffer_out_size,
+ *                        uint16_t* samples, uint8_t sample_count,
+ *                        uint8_t* flags )
+ * @brief  encode a block of 12-bit samples into at most buffer_out_size bytes
+ * @return Number of bytes used in buffer_out, 0 if the block can't fit. The
+ *         block descriptor is written to flags.
+ * ****************************************************************************/
+uint8_t codec_encode( uint8_t* buffer_out, uint8_t buffer_out_size,
+                      uint16_t* samples, uint8_t sample_count,
+                      uint8_t* flags )
+{
+  bit_stream_t stream;
+  uint32_t rice_bits;
+  uint32_t raw_bits;
+  uint32_t budget = (uint32_t)buffer_out_size * 8;
+  uint16_t previous;
+  uint8_t shift;
+  uint8_t width;
+  uint8_t param;
+  uint8_t index;
+
+  if( 0 == sample_count )
+  {
+    return 0;
+  }
+
+  stream.buffer = buffer_out;
+
+  for( shift = 0; shift <= CODEC_MAX_SHIFT; shift++ )
+  {
+    width = CODEC_SAMPLE_BITS - shift;
+    raw_bits = (uint32_t)sample_count * width;
+    param = rice_parameter( samples, sample_count, shift, &rice_bits );
+
+    stream.bit_index = 0;
+
+    if( (rice_bits < raw_bits) && (rice_bits <= budget) )
+    {
+      previous = samples[0] >> shift;
+      put_bits( &stream, previous, width );
+
+      for( index = 1; index < sample_count; index++ )
+      {
+        uint16_t current = samples[index] >> shift;
+        uint16_t value = zigzag( (int16_t)(current - previous) );
+        uint16_t quotient = value >> param;
+
+        // Unary quotient, terminated by a zero
+        while( quotient-- )
+        {
+          put_bits( &stream, 1, 1 );
+        }
+        put_bits( &stream, 0, 1 );
+        put_bits( &stream, value, param );
+
+        previous = current;
+      }
+
+      *flags = CODEC_FLAGS( shift, param );
+      return (uint8_t)( (stream.bit_index + 7) >> 3 );
+    }
+    else if( raw_bits <= budget )
+    {
+      for( index = 0; index < sample_count; index++ )
+      {
+        put_bits( &stream, samples[index] >> shift, width );
+      }
+
+      *flags = CODEC_FLAGS( shift, CODEC_PARAM_RAW );
+      return (uint8_t)( (stream.bit_index + 7) >> 3 );
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t codec_decode( uint16_t* samples, uint8_t sample_count,
+ *                        uint8_t* buffer_in, uint8_t buffer_in_size,
+ *                        uint8_t flags )
+ * @brief  decode a block produced by codec_encode. Samples are returned
+ *         scaled to 12 bits.
+ * @return Number of samples decoded, 0 if the block is malformed
+ * ****************************************************************************/
+uint8_t codec_decode( uint16_t* samples, uint8_t sample_count,
+                      uint8_t* buffer_in, uint8_t buffer_in_size,
+                      uint8_t flags )
+{
+  bit_stream_t stream;
+  uint16_t limit = (uint16_t)buffer_in_size * 8;
+  uint8_t shift = CODEC_SHIFT( flags );
+  uint8_t param = CODEC_PARAM( flags );
+  uint8_t width;
+  uint16_t mask;
+  uint16_t current;
+  uint8_t index;
+
+  if( !(flags & CODEC_FLAG_ENCODED) || (shift > CODEC_MAX_SHIFT) )
+  {
+    return 0;
+  }
+
+  width = CODEC_SAMPLE_BITS - shift;
+  mask = (1 << width) - 1;
+
+  stream.buffer = buffer_in;
+  stream.bit_index = 0;
+
+  if( CODEC_PARAM_RAW == param )
+  {
+    if( (uint16_t)sample_count * width > limit )
+    {
+      return 0;
+    }
+
+    for( index = 0; index < sample_count; index++ )
+    {
+      samples[index] = get_bits( &stream, width ) << shift;
+    }
+
+    return sample_count;
+  }
+
+  if( (param > width) || (width > limit) )
+  {
+    return 0;
+  }
+
+  current = get_bits( &stream, width );
+  samples[0] = current << shift;
+
+  for( index = 1; index < sample_count; index++ )
+  {
+    uint16_t quotient = 0;
+
+    // Unary quotient
+    for(;;)
+    {
+      if( stream.bit_index >= limit )
+      {
+        return 0;
+      }
+      if( 0 == get_bits( &stream, 1 ) )
+      {
+        break;
+      }
+      quotient++;
+    }
+
+    if( (stream.bit_index + param) > limit )
+    {
+      return 0;
+    }
+
+    current += unzigzag( (quotient << param) | get_bits( &stream, param ) );
+    current &= mask;
+    samples[index] = current << shift;
+  }
+
+  return sample_count;
+}
+
+/*******************************************************************************
+ * @fn     uint16_t codec_ratio( uint8_t sample_count, uint8_t encoded_size )
+ * @brief  compression ratio of a block against 12-bit packed samples
+ * @return Ratio multiplied by 100 (150 means the block is 1.5x smaller)
+ * ****************************************************************************/
+uint16_t codec_ratio( uint8_t sample_count, uint8_t encoded_size )
+{
+  if( 0 == encoded_size )
+  {
+    return 0;
+  }
+
+  // (sample_count * 12 bits * 100) / (encoded_size * 8 bits)
+  return (uint16_t)( ((uint32_t)sample_count * 150) / encoded_size );
+}
+
+/*******************************************************************************
+ * @fn     uint32_t rice_size( uint16_t* samples, uint8_t sample_count,
+ *                                          uint8_t shift, uint8_t param )
+ * @brief  size in bits of a Rice coded block with parameter param
+ * ****************************************************************************/
+static uint32_t rice_size( uint16_t* samples, uint8_t sample_count,
+                                            uint8_t shift, uint8_t param )
+{
+  uint32_t bits = CODEC_SAMPLE_BITS - shift;
+  uint16_t previous = samples[0] >> shift;
+  uint8_t index;
+
+  for( index = 1; index < sample_count; index++ )
+  {
+    uint16_t current = samples[index] >> shift;
+    bits += ( zigzag( (int16_t)(current - previous) ) >> param ) + 1 + param;
+    previous = current;
+  }
+
+  return bits;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t rice_parameter( uint16_t* samples, uint8_t sample_count,
+ *                                          uint8_t shift, uint32_t* bits )
+ * @brief  pick the Rice parameter for a block. The mean delta gives a first
+ *         guess, and its neighbours are checked for the smallest exact size.
+ * ****************************************************************************/
+static uint8_t rice_parameter( uint16_t* samples, uint8_t sample_count,
+                                            uint8_t shift, uint32_t* bits )
+{
+  uint32_t sum = 0;
+  uint32_t size;
+  uint16_t previous = samples[0] >> shift;
+  uint16_t mean;
+  uint8_t width = CODEC_SAMPLE_BITS - shift;
+  uint8_t guess = 0;
+  uint8_t param;
+  uint8_t best;
+  uint8_t index;
+
+  for( index = 1; index < sample_count; index++ )
+  {
+    uint16_t current = samples[index] >> shift;
+    sum += zigzag( (int16_t)(current - previous) );
+    previous = current;
+  }
+
+  if( sample_count > 1 )
+  {
+    mean = (uint16_t)( sum / (sample_count - 1) );
+    while( (guess < width) && ((mean >> (guess + 1)) != 0) )
+    {
+      guess++;
+    }
+  }
+
+  best = guess;
+  *bits = rice_size( samples, sample_count, shift, guess );
+
+  for( param = (guess > 0) ? (guess - 1) : 0; param <= guess + 1; param++ )
+  {
+    if( (param == guess) || (param > width) )
+    {
+      continue;
+    }
+
+    size = rice_size( samples, sample_count, shift, param );
+    if( size < *bits )
+    {
+      *bits = size;
+      best = param;
+    }
+  }
+
+  return best;
+}
+
+/*******************************************************************************
+ * @fn     void put_bits( bit_stream_t* stream, uint16_t value, uint8_t bits )
+ * @brief  append the low [bits] bits of value to the stream, MSB first
+ * ****************************************************************************/
+static void put_bits( bit_stream_t* stream, uint16_t value, uint8_t bits )
+{
+  while( bits-- )
+  {
+    uint8_t* byte = &stream->buffer[stream->bit_index >> 3];
+    uint8_t mask = 0x80 >> (stream->bit_index & 0x07);
+
+    if( 0x80 == mask )
+    {
+      *byte = 0;
+    }
+
+    if( value & (1 << bits) )
+    {
+      *byte |= mask;
+    }
+
+    stream->bit_index++;
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint16_t get_bits( bit_stream_t* stream, uint8_t bits )
+ * @brief  read [bits] bits from the stream, MSB first
+ * ****************************************************************************/
+static uint16_t get_bits( bit_stream_t* stream, uint8_t bits )
+{
+  uint16_t value = 0;
+
+  while( bits-- )
+  {
+    value <<= 1;
+    if( stream->buffer[stream->bit_index >> 3] &
+                                      (0x80 >> (stream->bit_index & 0x07)) )
+    {
+      value |= 1;
+    }
+    stream->bit_index++;
+  }
+
+  return value;
+}
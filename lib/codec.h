@@ -0,0 +1,39 @@
+/** @file codec.h
+*
+* @brief Sample block codec (delta + Rice coding of 12-bit ADC samples)
+*
+* @author Alvaro Prieto
+*/
+#ifndef _CODEC_H
+#define _CODEC_H
+
+// Only stdint is needed so the same codec can be built into host tools
+#include <stdint.h>
+
+#define CODEC_SAMPLE_BITS (12)
+
+// Block descriptor, carried in the packet header flags byte
+//   bit 7    - block is encoded (legacy packets carry 0x00, 8-bit samples)
+//   bits 6:4 - number of LSBs dropped before coding (0 means lossless)
+//   bits 3:0 - Rice parameter k, or CODEC_PARAM_RAW for bit-packed samples
+#define CODEC_FLAG_ENCODED (0x80)
+#define CODEC_PARAM_RAW (0x0F)
+#define CODEC_MAX_SHIFT (4)
+
+#define CODEC_FLAGS( shift, param ) \
+  ( CODEC_FLAG_ENCODED | ((shift) << 4) | (param) )
+#define CODEC_SHIFT( flags ) ( ((flags) >> 4) & 0x07 )
+#define CODEC_PARAM( flags ) ( (flags) & 0x0F )
+
+uint8_t codec_encode( uint8_t* buffer_out, uint8_t buffer_out_size,
+                      uint16_t* samples, uint8_t sample_count,
+                      uint8_t* flags );
+
+uint8_t codec_decode( uint16_t* samples, uint8_t sample_count,
+                      uint8_t* buffer_in, uint8_t buffer_in_size,
+                      uint8_t flags );
+
+uint16_t codec_ratio( uint8_t sample_count, uint8_t encoded_size );
+
+#endif /* _CODEC_H */\
+
@@ -0,0 +1,239 @@
+/** @file command.c
+*
+* @brief Host command interpreter over the UART
+*
+*   Commands use the same framing as uart_write_escaped (0x7e delimited,
+*   0x7d escaped). A command frame is [opcode][arguments...] and every command
+*   gets a reply frame [opcode | COMMAND_REPLY][status][data...], queued with
+*   uart_queue_frame (in the format picked with uart_set_framing) so nothing
+*   waits on the serial port.
+*
+*   The UART RX interrupt only fills the receive ring and wakes up the main
+*   loop at frame boundaries. Commands run from command_process, called from
+*   the main loop, never at interrupt level.
+*
+*   Handlers are registered per opcode, same as timer callbacks. A handler
+*   gets the arguments and a buffer for reply data, and returns the status:
+*     uint8_t handler( uint8_t* arguments, uint8_t length,
+*                      uint8_t* reply, uint8_t* reply_length )
+*
+* @author Alvaro Prieto
+*/
+#include "command.h"
+#include "uart.h"
+#include "radio.h"
+
+static uint8_t ping_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+static uint8_t channel_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+static uint8_t patable_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+static uint8_t stats_command( uint8_t*, uint8_t, uint8_t*, uint8_t* );
+static void execute( void );
+
+// Holds pointers to all command handlers, 0 for unknown opcodes
+static uint8_t (*command_callbacks[COMMAND_TOTAL])( uint8_t*, uint8_t,
+                                                          uint8_t*, uint8_t* );
+
+// Command being received
+static uint8_t command_buffer[COMMAND_MAX_SIZE];
+static uint8_t command_length;
+static uint8_t command_escaped;
+static uint8_t command_overflow;
+
+static uint8_t reply_buffer[COMMAND_MAX_SIZE];
+
+/*******************************************************************************
+ * @fn     void setup_command( void )
+ * @brief  Clear receive state and register the built-in commands. The UART
+ *         must be set up separately.
+ * ****************************************************************************/
+void setup_command( void )
+{
+  uint8_t index;
+
+  for( index = 0; index < COMMAND_TOTAL; index++ )
+  {
+    command_callbacks[index] = 0;
+  }
+
+  command_length = 0;
+  command_escaped = 0;
+  command_overflow = 0;
+
+  register_command_callback( ping_command, CMD_PING );
+  register_command_callback( channel_command, CMD_SET_CHANNEL );
+  register_command_callback( patable_command, CMD_SET_PATABLE );
+  register_command_callback( stats_command, CMD_GET_STATS );
+}
+
+/*******************************************************************************
+ * @fn     register_command_callback( handler, uint8_t opcode )
+ * @brief  add (or replace) the handler for [opcode]
+ * ****************************************************************************/
+void register_command_callback( uint8_t (*callback)(uint8_t*, uint8_t,
+                                       uint8_t*, uint8_t*), uint8_t opcode )
+{
+  if( opcode < COMMAND_TOTAL )
+  {
+    command_callbacks[opcode] = callback;
+  }
+  return;
+}
+
+/*******************************************************************************
+ * @fn     void command_process( void )
+ * @brief  Decode everything waiting in the UART receive ring and run any
+ *         complete commands. Call from the main loop.
+ * ****************************************************************************/
+void command_process( void )
+{
+  uint8_t character;
+
+  while( uart_read( &character ) )
+  {
+    if( 0x7e == character )
+    {
+      // Frame delimiter, drop frames that were too long or cut short
+      if( command_length && !command_overflow && !command_escaped )
+      {
+        execute();
+      }
+      command_length = 0;
+      command_escaped = 0;
+      command_overflow = 0;
+    }
+    else if( 0x7d == character )
+    {
+      command_escaped = 1;
+    }
+    else
+    {
+      if( command_escaped )
+      {
+        character ^= 0x20;
+        command_escaped = 0;
+      }
+
+      if( command_length < COMMAND_MAX_SIZE )
+      {
+        command_buffer[command_length++] = character;
+      }
+      else
+      {
+        command_overflow = 1;
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     void execute( void )
+ * @brief  Run the command in command_buffer and queue the reply
+ * ****************************************************************************/
+static void execute( void )
+{
+  uint8_t opcode = command_buffer[0];
+  uint8_t reply_length = 0;
+
+  if( (opcode < COMMAND_TOTAL) && command_callbacks[opcode] )
+  {
+    reply_buffer[1] = command_callbacks[opcode]( &command_buffer[1],
+                  command_length - 1, &reply_buffer[2], &reply_length );
+  }
+  else
+  {
+    reply_buffer[1] = CMD_ERROR_UNKNOWN;
+  }
+
+  if( reply_length > (COMMAND_MAX_SIZE - 2) )
+  {
+    reply_length = COMMAND_MAX_SIZE - 2;
+  }
+
+  reply_buffer[0] = opcode | COMMAND_REPLY;
+  uart_queue_frame( reply_buffer, reply_length + 2 );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t ping_command( ... )
+ * @brief  Echo arguments back, used to check the link
+ * ****************************************************************************/
+static uint8_t ping_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  uint8_t index;
+
+  if( length > (COMMAND_MAX_SIZE - 2) )
+  {
+    return CMD_ERROR_LENGTH;
+  }
+
+  for( index = 0; index < length; index++ )
+  {
+    reply[index] = arguments[index];
+  }
+  *reply_length = length;
+
+  return CMD_OK;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t channel_command( ... )
+ * @brief  Set radio channel (CHANNR)
+ * ****************************************************************************/
+static uint8_t channel_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  if( length != 1 )
+  {
+    return CMD_ERROR_LENGTH;
+  }
+
+  return radio_set_channel( arguments[0] ) ? CMD_OK : CMD_ERROR_BUSY;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t patable_command( ... )
+ * @brief  Set tx power (PATABLE value)
+ * ****************************************************************************/
+static uint8_t patable_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  if( length != 1 )
+  {
+    return CMD_ERROR_LENGTH;
+  }
+
+  return radio_set_power( arguments[0] ) ? CMD_OK : CMD_ERROR_BUSY;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t stats_command( ... )
+ * @brief  Default statistics, only the UART counters
+ * ****************************************************************************/
+static uint8_t stats_command( uint8_t* arguments, uint8_t length,
+                                      uint8_t* reply, uint8_t* reply_length )
+{
+  *reply_length = command_uart_stats( reply );
+
+  return CMD_OK;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t command_uart_stats( uint8_t* reply )
+ * @brief  Write UART counters to a reply, little endian. Applications that
+ *         replace CMD_GET_STATS can start their reply with this.
+ *         [tx dropped frames][tx dropped bytes][tx high water][rx dropped]
+ * @return Number of bytes written (COMMAND_UART_STATS_SIZE)
+ * ****************************************************************************/
+uint8_t command_uart_stats( uint8_t* reply )
+{
+  reply[0] = (uint8_t)uart_tx_stats.dropped_frames;
+  reply[1] = (uint8_t)(uart_tx_stats.dropped_frames >> 8);
+  reply[2] = (uint8_t)uart_tx_stats.dropped_bytes;
+  reply[3] = (uint8_t)(uart_tx_stats.dropped_bytes >> 8);
+  reply[4] = uart_tx_stats.high_water;
+  reply[5] = (uint8_t)uart_rx_dropped;
+  reply[6] = (uint8_t)(uart_rx_dropped >> 8);
+
+  return COMMAND_UART_STATS_SIZE;
+}
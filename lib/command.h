@@ -0,0 +1,44 @@
+/** @file command.h
+*
+* @brief Host command interpreter over the UART
+*
+* @author Alvaro Prieto
+*/
+#ifndef _COMMAND_H
+#define _COMMAND_H
+
+// Only stdint is needed so host tools can share the opcodes
+#include <stdint.h>
+
+// Largest command or reply, excluding framing
+#define COMMAND_MAX_SIZE (32)
+#define COMMAND_TOTAL (0x30)
+#define COMMAND_UART_STATS_SIZE (7)
+
+// Replies echo the opcode with this bit set. Data frames forwarded to the host
+// start with a radio length byte, which is always below 0x80.
+#define COMMAND_REPLY (0x80)
+
+// Opcodes
+#define CMD_PING (0x01)             // [data...] -> [data...]
+#define CMD_SET_CHANNEL (0x10)      // [channel]
+#define CMD_SET_PATABLE (0x11)      // [patable value]
+#define CMD_SET_SLOT_TIMING (0x12)  // [rest time L,H] [slot length L,H]
+#define CMD_SET_SAMPLE_RATE (0x13)  // [ticks per sample L,H]
+#define CMD_GET_STATS (0x20)        // -> application defined
+
+// Reply status
+#define CMD_OK (0x00)
+#define CMD_ERROR_UNKNOWN (0x01)
+#define CMD_ERROR_LENGTH (0x02)
+#define CMD_ERROR_VALUE (0x03)
+#define CMD_ERROR_BUSY (0x04)
+
+void setup_command( void );
+void register_command_callback( uint8_t (*)(uint8_t*, uint8_t, uint8_t*,
+                                                          uint8_t*), uint8_t );
+void command_process( void );
+uint8_t command_uart_stats( uint8_t* );
+
+#endif /* _COMMAND_H */\
+
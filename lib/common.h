@@ -7,7 +7,13 @@
 #ifndef _COMMON_H
 #define _COMMON_H
 
+// HOST_BUILD compiles lib/ for a development machine against the
+// peripheral model in hal_host.c instead of the CC430 registers
+#ifdef HOST_BUILD
+#include "hal_host.h"
+#else
 #include <io.h>
+#endif
 #include <stdint.h>
 
 
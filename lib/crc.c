@@ -0,0 +1,62 @@
+/** @file crc.c
+*
+* @brief CRC-16-CCITT (polynomial 0x1021, MSB first)
+*
+*   Uses the CRC16 module when the device has one. Bytes are written through
+*   CRCDIRB (bit reversed input) and the result is read from CRCINIRES, which
+*   gives the MSB first CCITT CRC. Everything else, host tools included, uses
+*   the software version, which produces the same result.
+*   crc16( CRC16_INIT, "123456789", 9 ) is 0x29B1 in both cases.
+*
+*   Appending the CRC to the data, high byte first, makes the CRC of the whole
+*   thing 0, which is how receivers check it.
+*
+* @author Alvaro Prieto
+*/
+#include "crc.h"
+
+#ifdef __MSP430__
+#include <io.h>
+#endif
+
+/*******************************************************************************
+ * @fn     uint16_t crc16( uint16_t crc, uint8_t* buffer, uint16_t length )
+ * @brief  continue the CRC [crc] over buffer. Start with CRC16_INIT.
+ * ****************************************************************************/
+#ifdef CRCINIRES_
+uint16_t crc16( uint16_t crc, uint8_t* buffer, uint16_t length )
+{
+  // The module only holds one CRC, don't let an ISR use it in the middle
+  uint16_t interrupt_state = READ_SR & GIE;
+
+  dint();
+
+  CRCINIRES = crc;
+  while( length-- )
+  {
+    CRCDIRB_L = *buffer++;
+  }
+  crc = CRCINIRES;
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+
+  return crc;
+}
+#else
+uint16_t crc16( uint16_t crc, uint8_t* buffer, uint16_t length )
+{
+  while( length-- )
+  {
+    crc = (crc >> 8) | (crc << 8);
+    crc ^= *buffer++;
+    crc ^= (crc & 0xff) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xff) << 5;
+  }
+
+  return crc;
+}
+#endif
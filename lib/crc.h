@@ -0,0 +1,18 @@
+/** @file crc.h
+*
+* @brief CRC-16-CCITT (polynomial 0x1021, MSB first)
+*
+* @author Alvaro Prieto
+*/
+#ifndef _CRC_H
+#define _CRC_H
+
+// Only stdint is needed so host tools can check the same CRC
+#include <stdint.h>
+
+#define CRC16_INIT (0xFFFF)
+
+uint16_t crc16( uint16_t, uint8_t*, uint16_t );
+
+#endif /* _CRC_H */\
+
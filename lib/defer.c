@@ -0,0 +1,137 @@
+/** @file defer.c
+*
+* @brief Deferred work, interrupt handlers queue functions that run later in
+*        main context
+*
+*   Each priority has a ring of function and context pairs. As with the UART
+*   transmit ring, the head is only moved by defer and the tail only by
+*   defer_run, so the consumer never has to disable interrupts. Interrupt
+*   handlers don't nest, defer only turns them off when it is called from
+*   main context.
+*
+*   An interrupt callback that queues work should return 1 so the main loop
+*   wakes up. event_loop runs the queue after every round of events.
+*
+* @author Alvaro Prieto
+*/
+#include "defer.h"
+#include "intrinsics.h"
+
+#define DEFER_QUEUE_MASK (DEFER_QUEUE_SIZE - 1)
+
+typedef struct
+{
+  void (*work)( void* );
+  void* context;
+} defer_entry_t;
+
+static defer_entry_t queues[DEFER_PRIORITIES][DEFER_QUEUE_SIZE];
+static volatile uint8_t heads[DEFER_PRIORITIES];
+static volatile uint8_t tails[DEFER_PRIORITIES];
+
+volatile defer_stats_t defer_stats;
+
+/*******************************************************************************
+ * @fn     uint8_t defer( uint8_t priority, void (*work)( void* ),
+ *                                                          void* context )
+ * @brief  call work( context ) from defer_run. Safe from interrupt handlers
+ *         and main context.
+ * @return 1 if queued, 0 if the queue for [priority] was full (counted in
+ *         defer_stats)
+ * ****************************************************************************/
+uint8_t defer( uint8_t priority, void (*work)( void* ), void* context )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint8_t head;
+  uint8_t waiting;
+
+  if( priority >= DEFER_PRIORITIES )
+  {
+    priority = DEFER_LOW;
+  }
+
+  dint();
+
+  head = heads[priority];
+  waiting = ( head - tails[priority] ) & DEFER_QUEUE_MASK;
+
+  if( waiting == DEFER_QUEUE_MASK )
+  {
+    defer_stats.dropped++;
+
+    if( interrupt_state )
+    {
+      eint();
+    }
+    return 0;
+  }
+
+  queues[priority][head].work = work;
+  queues[priority][head].context = context;
+  heads[priority] = ( head + 1 ) & DEFER_QUEUE_MASK;
+
+  if( ++waiting > defer_stats.high_water[priority] )
+  {
+    defer_stats.high_water[priority] = waiting;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t defer_pending( void )
+ * @return 1 if any work is waiting
+ * ****************************************************************************/
+uint8_t defer_pending( void )
+{
+  uint8_t priority;
+
+  for( priority = 0; priority < DEFER_PRIORITIES; priority++ )
+  {
+    if( heads[priority] != tails[priority] )
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t defer_run( void )
+ * @brief  run queued work until none is left, main context only. Priorities
+ *         are checked again after every entry, so urgent work queued in the
+ *         meantime goes first.
+ * @return number of entries run
+ * ****************************************************************************/
+uint8_t defer_run( void )
+{
+  defer_entry_t entry;
+  uint8_t priority = 0;
+  uint8_t tail;
+  uint8_t count = 0;
+
+  while( priority < DEFER_PRIORITIES )
+  {
+    tail = tails[priority];
+    if( heads[priority] == tail )
+    {
+      priority++;
+      continue;
+    }
+
+    // Copy before the slot is handed back to defer
+    entry = queues[priority][tail];
+    tails[priority] = ( tail + 1 ) & DEFER_QUEUE_MASK;
+
+    entry.work( entry.context );
+    count++;
+    priority = 0;
+  }
+
+  return count;
+}
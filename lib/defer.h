@@ -0,0 +1,36 @@
+/** @file defer.h
+*
+* @brief Deferred work, interrupt handlers queue functions that run later in
+*        main context
+*
+* @author Alvaro Prieto
+*/
+#ifndef _DEFER_H
+#define _DEFER_H
+
+#include "common.h"
+
+// Priorities, every DEFER_HIGH entry runs before any DEFER_NORMAL one
+#define DEFER_HIGH (0)
+#define DEFER_NORMAL (1)
+#define DEFER_LOW (2)
+#define DEFER_PRIORITIES (3)
+
+// Entries per priority, must be a power of two no larger than 256. One is
+// always kept empty.
+#define DEFER_QUEUE_SIZE (8)
+
+typedef struct
+{
+  uint16_t dropped;                       // Work rejected, queue was full
+  uint8_t high_water[DEFER_PRIORITIES];   // Most entries ever waiting
+} defer_stats_t;
+
+extern volatile defer_stats_t defer_stats;
+
+uint8_t defer( uint8_t, void (*)( void* ), void* );
+uint8_t defer_pending( void );
+uint8_t defer_run( void );
+
+#endif /* _DEFER_H */\
+
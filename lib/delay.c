@@ -0,0 +1,70 @@
+/** @file delay.c
+*
+* @brief Busy wait delays, in cycles or in time at the current MCLK
+*
+*   delay_us and delay_ms work out the loop count from the MCLK frequency
+*   set by clock_set, which calls delay_calibrate on every change. Until
+*   then they assume SMCLK_FREQUENCY, what setup_oscillator sets.
+*
+*   These keep the CPU busy. Anything longer than a few hundred
+*   microseconds is better done with a timer and a low power mode.
+*
+* @author Alvaro Prieto
+*/
+#include "delay.h"
+#include "oscillator.h"
+
+// delay_loop passes per microsecond, in 1/256ths, and per millisecond
+#define LOOPS_PER_US_Q8( mclk ) \
+  ( ( (mclk) * 4 + 46874 ) / 46875 )
+#define LOOPS_PER_MS( mclk ) \
+  ( ( (mclk) + 1000 * DELAY_LOOP_CYCLES - 1 ) / ( 1000 * DELAY_LOOP_CYCLES ) )
+
+static uint16_t loops_per_us_q8 = LOOPS_PER_US_Q8( SMCLK_FREQUENCY );
+static uint16_t loops_per_ms = LOOPS_PER_MS( SMCLK_FREQUENCY );
+
+/*******************************************************************************
+ * @fn     void delay_calibrate( uint32_t mclk )
+ * @brief  scale delay_us and delay_ms for an MCLK of [mclk] Hz
+ * ****************************************************************************/
+void delay_calibrate( uint32_t mclk )
+{
+  loops_per_us_q8 = LOOPS_PER_US_Q8( mclk );
+  loops_per_ms = LOOPS_PER_MS( mclk );
+}
+
+/*******************************************************************************
+ * @fn     void delay_us( uint16_t us )
+ * @brief  busy wait for [us] microseconds, never less. At 1MHz the call
+ *         alone takes longer than a few microseconds.
+ * ****************************************************************************/
+void delay_us( uint16_t us )
+{
+  uint32_t loops = ( (uint32_t)us * loops_per_us_q8 + 255 ) >> 8;
+
+  if( loops <= ( DELAY_US_OVERHEAD / DELAY_LOOP_CYCLES ) )
+  {
+    return;
+  }
+  loops -= DELAY_US_OVERHEAD / DELAY_LOOP_CYCLES;
+
+  while( loops > DELAY_LOOP_MAX )
+  {
+    delay_loop( DELAY_LOOP_MAX );
+    loops -= DELAY_LOOP_MAX;
+  }
+
+  delay_loop( loops );
+}
+
+/*******************************************************************************
+ * @fn     void delay_ms( uint16_t ms )
+ * @brief  busy wait for [ms] milliseconds
+ * ****************************************************************************/
+void delay_ms( uint16_t ms )
+{
+  while( ms-- )
+  {
+    delay_loop( loops_per_ms );
+  }
+}
@@ -0,0 +1,99 @@
+/** @file delay.h
+*
+* @brief Busy wait delays, in cycles or in time at the current MCLK
+*
+* @author Alvaro Prieto
+*/
+#ifndef _DELAY_H
+#define _DELAY_H
+
+#include "common.h"
+
+// One pass of delay_loop, dec (1 cycle) and jnz (2 cycles)
+#define DELAY_LOOP_CYCLES (3)
+
+// Longest single loop, 0xFFFF would be loaded from the constant generator
+#define DELAY_LOOP_MAX (0xFFFE)
+
+// Cycles to load the loop count with 'mov #n, rx', 1 for the values the
+// constant generator has
+#define DELAY_LOAD_CYCLES( loops ) \
+  ( ( 1 == (loops) || 2 == (loops) || 4 == (loops) || 8 == (loops) ) ? 1 : 2 )
+
+// Cycles delay_us spends on the call and the arithmetic
+#define DELAY_US_OVERHEAD (30)
+
+// The host build counts the cycles the CC430 would take instead of waiting
+#ifndef HOST_BUILD
+#define DELAY_JMP() __asm__ __volatile__( "jmp 1f \n1:" )
+#define DELAY_NOP() __asm__ __volatile__( "nop" )
+#else
+#define DELAY_JMP() ( hal_host_delay_cycles += 2 )
+#define DELAY_NOP() ( hal_host_delay_cycles += 1 )
+#endif
+
+/*******************************************************************************
+ * @fn     void delay_loop( uint16_t loops )
+ * @brief  [loops] x DELAY_LOOP_CYCLES cycles, [loops] can't be 0 (it would
+ *         run 0x10000 passes)
+ * ****************************************************************************/
+static inline void delay_loop( uint16_t loops )
+{
+#ifndef HOST_BUILD
+  __asm__ __volatile__( "1: dec %0 \n\t jnz 1b" : "+r" ( loops ) );
+#else
+  hal_host_delay_cycles += DELAY_LOAD_CYCLES( loops ) +
+                           ( loops ? loops : 0x10000UL ) * DELAY_LOOP_CYCLES;
+#endif
+}
+
+/*******************************************************************************
+ * @fn     void delay_cycles( uint32_t cycles )
+ * @brief  busy wait for [cycles] MCLK cycles. Meant for constants, the
+ *         arithmetic then happens at compile time and the delay is exact up
+ *         to DELAY_LOOP_MAX loops. Longer delays lose a few cycles each
+ *         DELAY_LOOP_MAX loops to the outer loop.
+ * ****************************************************************************/
+static inline __attribute__((always_inline)) void delay_cycles( uint32_t cycles )
+{
+  uint16_t loops;
+
+  while( cycles > ( DELAY_LOOP_MAX * DELAY_LOOP_CYCLES + 2 ) )
+  {
+    delay_loop( DELAY_LOOP_MAX );
+    cycles -= DELAY_LOOP_MAX * DELAY_LOOP_CYCLES + 2;
+  }
+
+  // At least one loop, (cycles - 2) / DELAY_LOOP_CYCLES is 0 below this
+  if( cycles >= DELAY_LOOP_CYCLES + 2 )
+  {
+    loops = ( cycles - 2 ) / DELAY_LOOP_CYCLES;
+    delay_loop( loops );
+    cycles -= loops * DELAY_LOOP_CYCLES + DELAY_LOAD_CYCLES( loops );
+  }
+
+  // What is left is up to 4 cycles, less than a loop and its load
+  if( cycles >= 2 )
+  {
+    DELAY_JMP();
+    cycles -= 2;
+  }
+
+  if( cycles >= 2 )
+  {
+    DELAY_JMP();
+    cycles -= 2;
+  }
+
+  if( cycles )
+  {
+    DELAY_NOP();
+  }
+}
+
+void delay_calibrate( uint32_t );
+void delay_us( uint16_t );
+void delay_ms( uint16_t );
+
+#endif /* _DELAY_H */\
+
@@ -0,0 +1,227 @@
+/** @file energy.c
+*
+* @brief Per subsystem active time, reported to the host for battery life
+*        estimates
+*
+*   Subsystems are switched on and off with ENERGY_ON and ENERGY_OFF where
+*   lib/ starts and stops them: the CPU around the sleep in the main loops,
+*   the radio around RX and TX, the UART while the transmit ring drains and
+*   the ADC during a conversion. Each switch takes a timebase_now timestamp
+*   and adds the time spent on to that subsystem. Switching on something
+*   already on, or off something already off, does nothing.
+*
+*   Every CPU switch on after a sleep counts as a wakeup. Interrupt handlers
+*   that don't wake up the main loop aren't counted as CPU time, they are
+*   short next to the work done in main context.
+*
+*   energy_start sends a summary frame every period (see energy.h for the
+*   layout) and starts the next interval from zero. host/energyest turns
+*   the summaries into average current and battery life.
+*
+* @author Alvaro Prieto
+*/
+#include "energy.h"
+#include "common.h"
+#include "intrinsics.h"
+#include "periodic.h"
+#include "timers.h"
+#include "uart.h"
+
+static uint32_t active_ticks[ENERGY_SUBSYSTEMS];
+static uint32_t switched_on[ENERGY_SUBSYSTEMS];
+static uint32_t interval_start;
+static uint16_t wakeups;
+static uint8_t active;
+static uint8_t role;
+static uint8_t report_handle = PERIODIC_NONE;
+
+/*******************************************************************************
+ * @fn     void energy_on( uint8_t subsystem )
+ * @brief  [subsystem] starts drawing current now
+ * ****************************************************************************/
+void energy_on( uint8_t subsystem )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+
+  if( subsystem >= ENERGY_SUBSYSTEMS )
+  {
+    return;
+  }
+
+  dint();
+
+  if( !( active & ( 1 << subsystem ) ) )
+  {
+    switched_on[subsystem] = timebase_now();
+    active |= ( 1 << subsystem );
+
+    if( ENERGY_CPU == subsystem )
+    {
+      wakeups++;
+    }
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     void energy_off( uint8_t subsystem )
+ * @brief  [subsystem] stops drawing current now
+ * ****************************************************************************/
+void energy_off( uint8_t subsystem )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+
+  if( subsystem >= ENERGY_SUBSYSTEMS )
+  {
+    return;
+  }
+
+  dint();
+
+  if( active & ( 1 << subsystem ) )
+  {
+    active_ticks[subsystem] += timebase_now() - switched_on[subsystem];
+    active &= ~( 1 << subsystem );
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t put_le( uint8_t* buffer, uint32_t value, uint8_t size )
+ * @brief  write the low [size] bytes of [value] to [buffer], little endian
+ * @return Number of bytes written
+ * ****************************************************************************/
+static uint8_t put_le( uint8_t* buffer, uint32_t value, uint8_t size )
+{
+  uint8_t index;
+
+  for( index = 0; index < size; index++ )
+  {
+    buffer[index] = (uint8_t)value;
+    value >>= 8;
+  }
+
+  return size;
+}
+
+/*******************************************************************************
+ * @fn     void energy_report( void )
+ * @brief  send the summary of the interval since the last report and start
+ *         a new one. Subsystems that are on carry over into the new interval.
+ * ****************************************************************************/
+void energy_report( void )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint8_t frame[ENERGY_SUMMARY_SIZE];
+  uint8_t length = 0;
+  uint32_t now;
+  uint8_t index;
+
+  dint();
+
+  now = timebase_now();
+
+  frame[length++] = ENERGY_SUMMARY_TYPE;
+  frame[length++] = role;
+  frame[length++] = DEVICE_ADDRESS;
+  length += put_le( &frame[length], now - interval_start, 4 );
+
+  for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+  {
+    if( active & ( 1 << index ) )
+    {
+      active_ticks[index] += now - switched_on[index];
+      switched_on[index] = now;
+    }
+
+    length += put_le( &frame[length], active_ticks[index], 4 );
+  }
+
+  length += put_le( &frame[length], wakeups, 2 );
+
+  // A full ring drops this summary, the next one covers a longer interval
+  if( uart_queue_frame( frame, length ) )
+  {
+    for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+    {
+      active_ticks[index] = 0;
+    }
+    wakeups = 0;
+    interval_start = now;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t report_callback( void )
+ * @brief  periodic callback, sends the summary from the interrupt so it
+ *         doesn't depend on the main loop of the application
+ * ****************************************************************************/
+static uint8_t report_callback( void )
+{
+  energy_report();
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t energy_start( uint8_t device_role, uint32_t period )
+ * @brief  clear the counters and send a summary every [period] ticks, with
+ *         [device_role] in it. The CPU counts as on. The UART has to be set
+ *         up, and a timer for periodic_start to use (setup_timer_a1 in
+ *         continuous mode or vtimer_init).
+ * @return 1 if reports are scheduled, 0 if no periodic timer was free
+ * ****************************************************************************/
+uint8_t energy_start( uint8_t device_role, uint32_t period )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint8_t index;
+
+  energy_stop();
+
+  dint();
+
+  role = device_role;
+  interval_start = timebase_now();
+  for( index = 0; index < ENERGY_SUBSYSTEMS; index++ )
+  {
+    active_ticks[index] = 0;
+    switched_on[index] = interval_start;
+  }
+  active |= ( 1 << ENERGY_CPU );
+  wakeups = 0;
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+
+  report_handle = periodic_start( period, report_callback );
+
+  return ( PERIODIC_NONE != report_handle );
+}
+
+/*******************************************************************************
+ * @fn     void energy_stop( void )
+ * @brief  stop the periodic summaries, energy_report still sends one
+ * ****************************************************************************/
+void energy_stop( void )
+{
+  if( PERIODIC_NONE != report_handle )
+  {
+    periodic_stop( report_handle );
+    report_handle = PERIODIC_NONE;
+  }
+}
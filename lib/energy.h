@@ -0,0 +1,55 @@
+/** @file energy.h
+*
+* @brief Per subsystem active time, reported to the host for battery life
+*        estimates
+*
+* @author Alvaro Prieto
+*/
+#ifndef _ENERGY_H
+#define _ENERGY_H
+
+// Only stdint is needed so host tools can share the frame layout
+#include <stdint.h>
+
+// Parts of the system whose active time is measured
+#define ENERGY_CPU (0)
+#define ENERGY_RADIO_RX (1)
+#define ENERGY_RADIO_TX (2)
+#define ENERGY_ADC (3)
+#define ENERGY_UART (4)
+#define ENERGY_SUBSYSTEMS (5)
+
+// What the device does in the network, decides the sleep mode on the host
+#define ENERGY_ROLE_AP (0)
+#define ENERGY_ROLE_END_DEVICE (1)
+#define ENERGY_ROLE_RELAY (2)
+#define ENERGY_ROLE_BEACON (3)
+#define ENERGY_ROLES (4)
+
+// Times are timebase_now ticks, must match TIMER_FREQUENCY
+#define ENERGY_TICK_FREQUENCY (32768UL)
+#define ENERGY_REPORT_TICKS ( 10 * ENERGY_TICK_FREQUENCY )
+
+// Summary frame, sent with uart_queue_frame, multi-byte fields little endian:
+// [ENERGY_SUMMARY_TYPE][role][address][interval ticks, 4]
+// [active ticks, 4 per subsystem][wakeups, 2]
+#define ENERGY_SUMMARY_TYPE (0xE5)
+#define ENERGY_SUMMARY_SIZE ( 7 + 4 * ENERGY_SUBSYSTEMS + 2 )
+
+// The hooks in lib/ only cost something when built with -DENERGY_PROFILE
+#ifdef ENERGY_PROFILE
+#define ENERGY_ON( subsystem ) energy_on( subsystem )
+#define ENERGY_OFF( subsystem ) energy_off( subsystem )
+#else
+#define ENERGY_ON( subsystem )
+#define ENERGY_OFF( subsystem )
+#endif
+
+void energy_on( uint8_t );
+void energy_off( uint8_t );
+uint8_t energy_start( uint8_t, uint32_t );
+void energy_stop( void );
+void energy_report( void );
+
+#endif /* _ENERGY_H */\
+
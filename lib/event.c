@@ -0,0 +1,132 @@
+/** @file event.c
+*
+* @brief Event loop, interrupt handlers post events and the main loop sleeps
+*        until there is something to do
+*
+*   Interrupt callbacks call event_post and return 1, which is what makes
+*   timers.c and radio.c wake the CPU up. event_loop then runs the handler
+*   registered for each posted event in main context and goes back to sleep
+*   when none are left. Posting an event that is already pending does
+*   nothing, the handler runs once. Work queued with defer runs after the
+*   handlers.
+*
+*   The CPU sleeps in LPM3 unless something needs SMCLK: the UART while it
+*   is sending queued data, or whoever called event_hold_smclk (to receive
+*   on the UART, for example). Then it only goes down to LPM0.
+*
+* @author Alvaro Prieto
+*/
+#include "event.h"
+#include "defer.h"
+#include "energy.h"
+#include "intrinsics.h"
+#include "uart.h"
+
+static volatile uint16_t event_pending;
+static void (*event_handlers[EVENT_MAX])( void );
+static uint8_t smclk_holds;
+
+/*******************************************************************************
+ * @fn     void event_register( uint8_t event, void (*handler)( void ) )
+ * @brief  run [handler] from the event loop whenever [event] is posted
+ * ****************************************************************************/
+void event_register( uint8_t event, void (*handler)( void ) )
+{
+  if( event < EVENT_MAX )
+  {
+    event_handlers[event] = handler;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void event_post( uint8_t event )
+ * @brief  mark [event] as pending, safe from interrupts and main context
+ * ****************************************************************************/
+void event_post( uint8_t event )
+{
+  // A single bis instruction, can't be split by an interrupt
+  event_pending |= ( 1u << event );
+}
+
+/*******************************************************************************
+ * @fn     void event_hold_smclk( void )
+ * @brief  keep SMCLK running while sleeping until event_release_smclk
+ * ****************************************************************************/
+void event_hold_smclk( void )
+{
+  smclk_holds++;
+}
+
+/*******************************************************************************
+ * @fn     void event_release_smclk( void )
+ * @brief  undo one event_hold_smclk
+ * ****************************************************************************/
+void event_release_smclk( void )
+{
+  if( smclk_holds )
+  {
+    smclk_holds--;
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t event_dispatch( void )
+ * @brief  run the handlers of every pending event, lowest number first
+ * @return 1 if any event was pending
+ * ****************************************************************************/
+uint8_t event_dispatch( void )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint16_t events;
+  uint8_t event;
+
+  dint();
+  events = event_pending;
+  event_pending = 0;
+  if( interrupt_state )
+  {
+    eint();
+  }
+
+  for( event = 0; events; event++, events >>= 1 )
+  {
+    if( ( events & 1u ) && event_handlers[event] )
+    {
+      event_handlers[event]();
+    }
+  }
+
+  return ( event > 0 );
+}
+
+/*******************************************************************************
+ * @fn     void event_loop( void )
+ * @brief  dispatch events and deferred work forever, sleeping in between.
+ *         Enables interrupts.
+ * ****************************************************************************/
+void event_loop( void )
+{
+  for(;;)
+  {
+    // Nothing can be posted between the check and going to sleep, GIE is set
+    // by the same instruction that stops the CPU
+    dint();
+    if( 0 == event_pending && !defer_pending() )
+    {
+      ENERGY_OFF( ENERGY_CPU );
+      if( smclk_holds || uart_tx_pending() || ( UCA0STAT & UCBUSY ) )
+      {
+        __bis_SR_register( LPM0_bits + GIE );
+      }
+      else
+      {
+        __bis_SR_register( LPM3_bits + GIE );
+      }
+      ENERGY_ON( ENERGY_CPU );
+    }
+    eint();
+
+    event_dispatch();
+    defer_run();
+  }
+}
@@ -0,0 +1,27 @@
+/** @file event.h
+*
+* @brief Event loop, interrupt handlers post events and the main loop sleeps
+*        until there is something to do
+*
+* @author Alvaro Prieto
+*/
+#ifndef _EVENT_H
+#define _EVENT_H
+
+#include "common.h"
+
+// One bit per event in a 16 bit word, lower numbers are handled first
+#define EVENT_MAX (16)
+
+// Used by task.c, applications number their own events from 0
+#define EVENT_TASKS (EVENT_MAX - 1)
+
+void event_register( uint8_t, void (*)( void ) );
+void event_post( uint8_t );
+void event_hold_smclk( void );
+void event_release_smclk( void );
+uint8_t event_dispatch( void );
+void event_loop( void );
+
+#endif /* _EVENT_H */\
+
@@ -0,0 +1,133 @@
+/** @file format.c
+*
+* @brief Number to text conversion without printf
+*
+*   Every function writes at the start of buffer_out, doesn't add a \0 and
+*   returns the number of characters written, so calls can be chained to
+*   build a line:
+*     buffer += format_hex( buffer, &id, 1 );
+*     *buffer++ = ',';
+*     buffer += format_dbm( buffer, rssi, RADIO_RSSI_OFFSET_868MHZ );
+*
+*   The MSP430 has no divide instruction and only shifts one bit at a time,
+*   so hex output comes from a 256 entry table (one lookup per byte, no
+*   shifts) and decimal output subtracts powers of ten instead of dividing.
+*
+* @author Alvaro Prieto
+*/
+#include "format.h"
+
+#define HEX_ROW( high ) \
+  {high,'0'}, {high,'1'}, {high,'2'}, {high,'3'}, \
+  {high,'4'}, {high,'5'}, {high,'6'}, {high,'7'}, \
+  {high,'8'}, {high,'9'}, {high,'a'}, {high,'b'}, \
+  {high,'c'}, {high,'d'}, {high,'e'}, {high,'f'}
+
+// Both characters for every byte value
+static const uint8_t hex_pairs[256][2] = {
+  HEX_ROW('0'), HEX_ROW('1'), HEX_ROW('2'), HEX_ROW('3'),
+  HEX_ROW('4'), HEX_ROW('5'), HEX_ROW('6'), HEX_ROW('7'),
+  HEX_ROW('8'), HEX_ROW('9'), HEX_ROW('a'), HEX_ROW('b'),
+  HEX_ROW('c'), HEX_ROW('d'), HEX_ROW('e'), HEX_ROW('f')
+};
+
+static const uint16_t powers_of_ten[] = { 10000, 1000, 100, 10 };
+
+/*******************************************************************************
+ * @fn     uint8_t format_hex( uint8_t* buffer_out, uint8_t* buffer_in,
+ *                                          uint8_t buffer_in_size )
+ * @brief  write buffer_in as lowercase hex, two characters per byte
+ * @return Number of characters written (buffer_in_size * 2)
+ * ****************************************************************************/
+uint8_t format_hex( uint8_t* buffer_out, uint8_t* buffer_in,
+                                          uint8_t buffer_in_size )
+{
+  uint8_t index;
+
+  for( index = 0; index < buffer_in_size; index++ )
+  {
+    *buffer_out++ = hex_pairs[buffer_in[index]][0];
+    *buffer_out++ = hex_pairs[buffer_in[index]][1];
+  }
+
+  return buffer_in_size << 1;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t format_uint( uint8_t* buffer_out, uint16_t value,
+ *                                                    uint8_t width )
+ * @brief  write value in decimal, zero padded to at least [width] digits
+ *         (0 or 1 for no padding, at most 5)
+ * @return Number of characters written
+ * ****************************************************************************/
+uint8_t format_uint( uint8_t* buffer_out, uint16_t value, uint8_t width )
+{
+  uint8_t* start = buffer_out;
+  uint8_t power;
+  uint8_t digit;
+
+  for( power = 0; power < sizeof(powers_of_ten) / sizeof(uint16_t); power++ )
+  {
+    digit = '0';
+    while( value >= powers_of_ten[power] )
+    {
+      value -= powers_of_ten[power];
+      digit++;
+    }
+
+    // Skip leading zeros unless they are needed for the width
+    if( (buffer_out != start) || (digit != '0') || (width >= (5 - power)) )
+    {
+      *buffer_out++ = digit;
+    }
+  }
+
+  *buffer_out++ = '0' + (uint8_t)value;
+
+  return (uint8_t)( buffer_out - start );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t format_int( uint8_t* buffer_out, int16_t value )
+ * @brief  write signed value in decimal
+ * @return Number of characters written
+ * ****************************************************************************/
+uint8_t format_int( uint8_t* buffer_out, int16_t value )
+{
+  if( value < 0 )
+  {
+    *buffer_out = '-';
+    return 1 + format_uint( buffer_out + 1, -(uint16_t)value, 0 );
+  }
+
+  return format_uint( buffer_out, (uint16_t)value, 0 );
+}
+
+/*******************************************************************************
+ * @fn     int16_t format_rssi_dbm( uint8_t rssi_raw, uint8_t offset )
+ * @brief  convert a raw RSSI register value (signed, half dB steps) to dBm,
+ *         [offset] is one of the RADIO_RSSI_OFFSET values. Rounds towards
+ *         zero, same as rssi_raw / 2 in C.
+ * ****************************************************************************/
+int16_t format_rssi_dbm( uint8_t rssi_raw, uint8_t offset )
+{
+  int16_t half_db = (int8_t)rssi_raw;
+
+  if( half_db < 0 )
+  {
+    return -((-half_db) >> 1) - offset;
+  }
+
+  return (half_db >> 1) - offset;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t format_dbm( uint8_t* buffer_out, uint8_t rssi_raw,
+ *                                                    uint8_t offset )
+ * @brief  write a raw RSSI value in dBm (see format_rssi_dbm)
+ * @return Number of characters written
+ * ****************************************************************************/
+uint8_t format_dbm( uint8_t* buffer_out, uint8_t rssi_raw, uint8_t offset )
+{
+  return format_int( buffer_out, format_rssi_dbm( rssi_raw, offset ) );
+}
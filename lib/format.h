@@ -0,0 +1,27 @@
+/** @file format.h
+*
+* @brief Number to text conversion without printf
+*
+* @author Alvaro Prieto
+*/
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+// Only stdint is needed so host tools can produce the same text
+#include <stdint.h>
+
+// Longest output of format_uint/format_int without padding ("-32768")
+#define FORMAT_INT_MAX (6)
+
+uint8_t format_hex( uint8_t*, uint8_t*, uint8_t );
+
+uint8_t format_uint( uint8_t*, uint16_t, uint8_t );
+
+uint8_t format_int( uint8_t*, int16_t );
+
+int16_t format_rssi_dbm( uint8_t, uint8_t );
+
+uint8_t format_dbm( uint8_t*, uint8_t, uint8_t );
+
+#endif /* _FORMAT_H */\
+
@@ -0,0 +1,1170 @@
+/** @file hal_host.c
+*
+* @brief Peripheral model behind hal_host.h, only built for the host
+*
+*   Models what lib/ relies on: the RF1A instruction interface and enough of
+*   the radio core to send and receive packets, Timer0_A in up, continuous
+*   and up/down modes, USCI_A0 as a UART, single conversions on ADC12_A and
+*   a PMM that always reaches the requested core voltage.
+*
+*   Interrupt handlers are found by name. Handlers a program doesn't link in
+*   are weak references that resolve to 0 and are never called.
+*
+* @author Alvaro Prieto
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal_host.h"
+
+// Value held by write-only registers once the model has acted on the write.
+// Every valid write is 0x7FFF or less.
+#define HAL_HOST_EMPTY (0xFFFF)
+
+#define RADIO_FIFO_SIZE (64)
+#define RADIO_PATABLE_SIZE (8)
+#define UART_OUTPUT_SIZE (4096)
+
+// Status byte read as RF_SNOP and the MARCSTATE value for each state
+#define MARCSTATE_IDLE (0x01)
+#define MARCSTATE_RX (0x0D)
+#define MARCSTATE_TX (0x13)
+
+// Handlers, by the names lib/ and the applications give them
+void uart_isr( void ) __attribute__((weak));
+void ADC12ISR( void ) __attribute__((weak));
+void timerA0Interrupt( void ) __attribute__((weak));
+void timerA1Interrupt( void ) __attribute__((weak));
+void radio_isr( void ) __attribute__((weak));
+
+static uint8_t uart_pending( void );
+static uint8_t adc12_pending( void );
+static uint8_t ta0_ccr0_pending( void );
+static uint8_t ta0_pending( void );
+static uint8_t radio_pending( void );
+
+static void uart_sync( void );
+static void adc12_sync( void );
+static void timer_sync( void );
+static void rf1a_sync( void );
+
+typedef struct
+{
+  void (*handler)( void );
+  uint8_t (*pending)( void );
+} hal_host_vector_t;
+
+// Highest priority first, as in the CC430F613x vector table
+static const hal_host_vector_t vectors[] =
+{
+  { uart_isr, uart_pending },
+  { ADC12ISR, adc12_pending },
+  { timerA0Interrupt, ta0_ccr0_pending },
+  { timerA1Interrupt, ta0_pending },
+  { radio_isr, radio_pending },
+};
+
+#define TOTAL_VECTORS (sizeof(vectors) / sizeof(vectors[0]))
+
+//
+// Plain registers
+//
+volatile uint16_t WDTCTL;
+volatile uint16_t SFRIFG1;
+volatile uint8_t P1DIR;
+volatile uint8_t P1OUT;
+volatile uint8_t P1SEL;
+volatile uint8_t P5SEL;
+volatile uint16_t PJDIR;
+volatile uint16_t PJOUT;
+volatile uint16_t PMAPPWD;
+volatile uint8_t P1MAP5;
+volatile uint8_t P1MAP6;
+volatile uint16_t UCSCTL0;
+volatile uint16_t UCSCTL1;
+volatile uint16_t UCSCTL2;
+volatile uint16_t UCSCTL3;
+volatile uint16_t UCSCTL4;
+volatile uint16_t UCSCTL5;
+volatile uint16_t UCSCTL6;
+volatile uint16_t UCSCTL7;
+volatile uint16_t PMMCTL0;
+volatile uint16_t PMMRIE;
+volatile uint16_t SVSMHCTL;
+volatile uint16_t SVSMLCTL;
+volatile uint8_t UCA0CTL0;
+volatile uint8_t UCA0CTL1;
+volatile uint8_t UCA0BR0;
+volatile uint8_t UCA0BR1;
+volatile uint8_t UCA0MCTL;
+volatile uint8_t UCA0STAT;
+volatile uint16_t UCA0IE;
+volatile uint16_t ADC12CTL0;
+volatile uint16_t ADC12CTL1;
+volatile uint8_t ADC12MCTL0;
+volatile uint16_t ADC12IE;
+volatile uint16_t ADC12IFG;
+volatile uint16_t REFCTL0;
+volatile uint16_t RTCCTL01;
+volatile uint16_t RTCCTL23;
+volatile uint16_t RTCPS0CTL;
+volatile uint16_t RTCPS1CTL;
+volatile uint16_t RTCIV;
+volatile uint8_t RTCSEC;
+volatile uint8_t RTCMIN;
+volatile uint8_t RTCHOUR;
+volatile uint8_t RTCDOW;
+volatile uint8_t RTCDAY;
+volatile uint8_t RTCMON;
+volatile uint16_t RTCYEAR;
+volatile uint8_t RTCAMIN;
+volatile uint8_t RTCAHOUR;
+volatile uint8_t RTCADOW;
+volatile uint8_t RTCADAY;
+
+volatile uint16_t hal_host_sr;
+
+uint8_t hal_host_address;
+
+// Initialised, so it isn't in .bss next to the firmware's own variables
+int32_t hal_host_node = -1;
+
+uint32_t hal_host_delay_cycles;
+
+uint8_t (*hal_host_idle)( void );
+void (*hal_host_uart_tx)( uint8_t );
+void (*hal_host_radio_tx)( uint8_t*, uint8_t );
+
+// Status register to restore when the running handler returns
+static uint16_t isr_sr;
+static uint8_t in_isr;
+
+//
+// Model state
+//
+static volatile uint16_t pmm_ifg;
+
+hal_host_timer_t hal_host_ta0;
+hal_host_timer_t hal_host_ta1;
+static uint8_t timer_down;
+
+static volatile uint16_t uca0_ifg = UCTXIFG;
+static volatile uint16_t uca0_iv;
+static volatile uint16_t uca0_rxbuf;
+static volatile uint16_t uca0_txbuf = HAL_HOST_EMPTY;
+static uint8_t uart_output[UART_OUTPUT_SIZE];
+static uint16_t uart_output_head;
+static uint16_t uart_output_tail;
+
+static volatile uint16_t adc12_iv;
+static volatile uint16_t adc12_mem0;
+static uint16_t adc12_input;
+
+hal_host_rf1a_t hal_host_rf1a =
+{
+  .ifctl1 = RFINSTRIFG,
+  .instrw = HAL_HOST_EMPTY,
+  .instrb = HAL_HOST_EMPTY,
+  .instr1b = HAL_HOST_EMPTY,
+  .dinb = HAL_HOST_EMPTY,
+};
+
+static uint8_t radio_config[0x30];
+static uint8_t radio_patable[RADIO_PATABLE_SIZE];
+static uint8_t patable_index;
+static uint8_t radio_state;
+static uint8_t tx_fifo[RADIO_FIFO_SIZE];
+static uint8_t tx_length;
+static uint8_t tx_packet[RADIO_FIFO_SIZE];
+static uint8_t rx_fifo[RADIO_FIFO_SIZE];
+static uint8_t rx_read;
+static uint8_t rx_length;
+static uint8_t radio_rssi;
+static uint8_t radio_lqi;
+
+// Instruction in progress on the RF1A interface
+static uint8_t rf1a_address;
+static uint8_t rf1a_burst;
+static uint8_t rf1a_writing;
+static uint8_t rf1a_reading;
+static uint8_t rf1a_dout;
+
+/*******************************************************************************
+ * @fn     void hal_host_service( void )
+ * @brief  call the highest priority pending handler until none are left
+ * ****************************************************************************/
+void hal_host_service( void )
+{
+  uint8_t index;
+
+  // Handlers don't nest, GIE is clear while they run
+  if( in_isr )
+  {
+    return;
+  }
+
+  for(;;)
+  {
+    uart_sync();
+    adc12_sync();
+    timer_sync();
+    rf1a_sync();
+
+    if( !(hal_host_sr & GIE) )
+    {
+      return;
+    }
+
+    for( index = 0; index < TOTAL_VECTORS; index++ )
+    {
+      if( vectors[index].handler && vectors[index].pending() )
+      {
+        break;
+      }
+    }
+
+    if( index == TOTAL_VECTORS )
+    {
+      return;
+    }
+
+    // CCR0 has its own vector, its flag is cleared on entry
+    if( timerA0Interrupt == vectors[index].handler )
+    {
+      hal_host_ta0.cctl[0] &= ~CCIFG;
+    }
+
+    // Entry clears everything but SCG0, RETI restores the saved copy
+    isr_sr = hal_host_sr;
+    hal_host_sr &= SCG0;
+    in_isr = 1;
+
+    vectors[index].handler();
+
+    in_isr = 0;
+    hal_host_sr = isr_sr;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_eint( void )
+ * @brief  set GIE, anything already pending is serviced right away
+ * ****************************************************************************/
+void hal_host_eint( void )
+{
+  hal_host_sr |= GIE;
+  hal_host_service();
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_bis_sr( uint16_t bits )
+ * @brief  set status register bits. Low power modes last until a handler
+ *         clears CPUOFF on exit or hal_host_idle gives up.
+ * ****************************************************************************/
+void hal_host_bis_sr( uint16_t bits )
+{
+  hal_host_sr |= bits;
+  hal_host_service();
+
+  while( hal_host_sr & CPUOFF )
+  {
+    // A simulator always sets the hook, without it the node would spin
+    // forever in what looks like a wake up
+    if( !hal_host_idle && hal_host_node >= 0 )
+    {
+      fprintf( stderr, "node %d: hal_host_idle was overwritten, the firmware "
+               "corrupted its own memory\n", hal_host_node );
+      abort();
+    }
+
+    if( !hal_host_idle || !hal_host_idle() )
+    {
+      hal_host_sr &= ~LPM4_bits;
+      break;
+    }
+    hal_host_service();
+  }
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_bic_sr_on_exit( uint16_t bits )
+ * @brief  clear bits in the status register restored when the handler returns
+ * ****************************************************************************/
+void hal_host_bic_sr_on_exit( uint16_t bits )
+{
+  if( in_isr )
+  {
+    isr_sr &= ~bits;
+  }
+  else
+  {
+    hal_host_sr &= ~bits;
+  }
+}
+
+/*******************************************************************************
+ * @fn     volatile uint16_t* hal_host_pmmifg( void )
+ * @brief  PMMIFG, supervisor delays have always elapsed
+ * ****************************************************************************/
+volatile uint16_t* hal_host_pmmifg( void )
+{
+  pmm_ifg |= SVSMLDLYIFG | SVMLVLRIFG | SVSMHDLYIFG | SVMHVLRIFG;
+
+  return &pmm_ifg;
+}
+
+//
+// Timer0_A
+//
+
+/*******************************************************************************
+ * @fn     void timer_sync( void )
+ * @brief  act on TACLR
+ * ****************************************************************************/
+static void timer_sync( void )
+{
+  if( hal_host_ta0.ctl & TACLR )
+  {
+    hal_host_ta0.ctl &= ~TACLR;
+    hal_host_ta0.r = 0;
+    timer_down = 0;
+  }
+}
+
+/*******************************************************************************
+ * @fn     volatile uint16_t* hal_host_ta0_reg( volatile uint16_t* reg )
+ * @brief  TA0CTL, TA0R and TA0IV. Reading TA0IV clears the flag it reports.
+ * ****************************************************************************/
+volatile uint16_t* hal_host_ta0_reg( volatile uint16_t* reg )
+{
+  uint8_t ccr;
+
+  timer_sync();
+
+  if( &hal_host_ta0.iv == reg )
+  {
+    hal_host_ta0.iv = 0;
+
+    for( ccr = 1; ccr <= 4; ccr++ )
+    {
+      if( (hal_host_ta0.cctl[ccr] & (CCIE | CCIFG)) == (CCIE | CCIFG) )
+      {
+        hal_host_ta0.cctl[ccr] &= ~CCIFG;
+        hal_host_ta0.iv = ccr << 1;
+        return reg;
+      }
+    }
+
+    if( (hal_host_ta0.ctl & (TAIE | TAIFG)) == (TAIE | TAIFG) )
+    {
+      hal_host_ta0.ctl &= ~TAIFG;
+      hal_host_ta0.iv = TIV_OVERFLOW;
+    }
+  }
+
+  return reg;
+}
+
+/*******************************************************************************
+ * @fn     uint32_t timer_period( void )
+ * @brief  counts in one cycle of up or continuous mode, 0 when stopped
+ * ****************************************************************************/
+static uint32_t timer_period( void )
+{
+  switch( hal_host_ta0.ctl & MC_3 )
+  {
+    case MC_1: return (uint32_t)hal_host_ta0.ccr[0] + 1;
+    case MC_2: return 0x10000;
+    default: return 0;
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint32_t timer_wrap( uint32_t period )
+ * @brief  count at which TAR goes back to zero. In up mode a TAR already past
+ *         a lowered CCR0 carries on to 0xFFFF first.
+ * ****************************************************************************/
+static uint32_t timer_wrap( uint32_t period )
+{
+  return ( hal_host_ta0.r < period ) ? period : 0x10000;
+}
+
+/*******************************************************************************
+ * @fn     void timer_compare( void )
+ * @brief  set the flags for the count TAR just reached
+ * ****************************************************************************/
+static void timer_compare( void )
+{
+  uint8_t ccr;
+
+  for( ccr = 0; ccr <= 4; ccr++ )
+  {
+    if( hal_host_ta0.r == hal_host_ta0.ccr[ccr] )
+    {
+      hal_host_ta0.cctl[ccr] |= CCIFG;
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint32_t hal_host_timer_next( void )
+ * @brief  ticks until the next compare or overflow, 0 if the timer is stopped
+ * ****************************************************************************/
+uint32_t hal_host_timer_next( void )
+{
+  uint32_t period;
+  uint32_t next;
+  uint32_t distance;
+  uint8_t ccr;
+
+  timer_sync();
+
+  // Up/down reverses on CCR0, step it one count at a time
+  if( MC_3 == (hal_host_ta0.ctl & MC_3) )
+  {
+    return hal_host_ta0.ccr[0] ? 1 : 0;
+  }
+
+  period = timer_period();
+  if( period <= 1 )
+  {
+    return 0;
+  }
+
+  // Counting back to zero sets TAIFG
+  next = timer_wrap( period ) - hal_host_ta0.r;
+
+  for( ccr = 0; ccr <= 4; ccr++ )
+  {
+    if( hal_host_ta0.ccr[ccr] < period )
+    {
+      distance = ( hal_host_ta0.ccr[ccr] + period - hal_host_ta0.r ) % period;
+      if( 0 == distance )
+      {
+        distance = period;
+      }
+      if( distance < next )
+      {
+        next = distance;
+      }
+    }
+  }
+
+  return next;
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_timer_advance( uint32_t ticks )
+ * @brief  run the timer for [ticks] counts, servicing handlers at each event
+ * ****************************************************************************/
+void hal_host_timer_advance( uint32_t ticks )
+{
+  uint32_t next;
+  uint32_t wrap;
+
+  while( ticks )
+  {
+    next = hal_host_timer_next();
+    if( 0 == next )
+    {
+      return;
+    }
+
+    if( MC_3 == (hal_host_ta0.ctl & MC_3) )
+    {
+      if( timer_down )
+      {
+        if( 0 == --hal_host_ta0.r )
+        {
+          hal_host_ta0.ctl |= TAIFG;
+          timer_down = 0;
+        }
+      }
+      else if( ++hal_host_ta0.r >= hal_host_ta0.ccr[0] )
+      {
+        timer_down = 1;
+      }
+      timer_compare();
+      ticks--;
+    }
+    else
+    {
+      wrap = timer_wrap( timer_period() );
+
+      if( next > ticks )
+      {
+        // Nothing happens before the time runs out
+        hal_host_ta0.r += ticks;
+        return;
+      }
+
+      hal_host_ta0.r = ( hal_host_ta0.r + next ) % wrap;
+      if( 0 == hal_host_ta0.r )
+      {
+        hal_host_ta0.ctl |= TAIFG;
+      }
+      timer_compare();
+      ticks -= next;
+    }
+
+    hal_host_service();
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t ta0_ccr0_pending( void )
+ * @brief  TIMER0_A0 vector
+ * ****************************************************************************/
+static uint8_t ta0_ccr0_pending( void )
+{
+  return (hal_host_ta0.cctl[0] & (CCIE | CCIFG)) == (CCIE | CCIFG);
+}
+
+/*******************************************************************************
+ * @fn     uint8_t ta0_pending( void )
+ * @brief  TIMER0_A1 vector, CCR1-4 and overflow
+ * ****************************************************************************/
+static uint8_t ta0_pending( void )
+{
+  uint8_t ccr;
+
+  for( ccr = 1; ccr <= 4; ccr++ )
+  {
+    if( (hal_host_ta0.cctl[ccr] & (CCIE | CCIFG)) == (CCIE | CCIFG) )
+    {
+      return 1;
+    }
+  }
+
+  return (hal_host_ta0.ctl & (TAIE | TAIFG)) == (TAIE | TAIFG);
+}
+
+//
+// USCI_A0
+//
+
+/*******************************************************************************
+ * @fn     void uart_sync( void )
+ * @brief  send a character written to UCA0TXBUF
+ * ****************************************************************************/
+static void uart_sync( void )
+{
+  uint16_t next;
+
+  if( HAL_HOST_EMPTY == uca0_txbuf )
+  {
+    return;
+  }
+
+  if( hal_host_uart_tx )
+  {
+    hal_host_uart_tx( (uint8_t)uca0_txbuf );
+  }
+  else
+  {
+    // Characters nobody collects are dropped once the buffer is full
+    next = (uart_output_head + 1) % UART_OUTPUT_SIZE;
+    if( next != uart_output_tail )
+    {
+      uart_output[uart_output_head] = (uint8_t)uca0_txbuf;
+      uart_output_head = next;
+    }
+  }
+
+  uca0_txbuf = HAL_HOST_EMPTY;
+  uca0_ifg |= UCTXIFG;
+}
+
+/*******************************************************************************
+ * @fn     volatile uint16_t* hal_host_uca0_reg( uint8_t reg )
+ * @brief  UCA0IFG, UCA0IV, UCA0RXBUF and UCA0TXBUF
+ * ****************************************************************************/
+volatile uint16_t* hal_host_uca0_reg( uint8_t reg )
+{
+  uart_sync();
+
+  switch( reg )
+  {
+    case HAL_HOST_UCA0IV:
+    {
+      uca0_iv = 0;
+      if( uca0_ifg & UCA0IE & UCRXIFG )
+      {
+        uca0_ifg &= ~UCRXIFG;
+        uca0_iv = 2;
+      }
+      else if( uca0_ifg & UCA0IE & UCTXIFG )
+      {
+        uca0_ifg &= ~UCTXIFG;
+        uca0_iv = 4;
+      }
+      return &uca0_iv;
+    }
+
+    case HAL_HOST_UCA0RXBUF:
+    {
+      uca0_ifg &= ~UCRXIFG;
+      return &uca0_rxbuf;
+    }
+
+    case HAL_HOST_UCA0TXBUF:
+    {
+      uca0_ifg &= ~UCTXIFG;
+      return &uca0_txbuf;
+    }
+
+    default:
+    {
+      return &uca0_ifg;
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_uart_receive( uint8_t character )
+ * @brief  character arriving on UCA0RXD, the last one is lost if it wasn't
+ *         read in time
+ * ****************************************************************************/
+void hal_host_uart_receive( uint8_t character )
+{
+  uca0_rxbuf = character;
+  uca0_ifg |= UCRXIFG;
+
+  hal_host_service();
+}
+
+/*******************************************************************************
+ * @fn     uint16_t hal_host_uart_output( uint8_t* buffer, uint16_t size )
+ * @brief  take up to [size] characters the firmware sent
+ * @return number of characters copied
+ * ****************************************************************************/
+uint16_t hal_host_uart_output( uint8_t* buffer, uint16_t size )
+{
+  uint16_t count = 0;
+
+  uart_sync();
+
+  while( (count < size) && (uart_output_tail != uart_output_head) )
+  {
+    buffer[count++] = uart_output[uart_output_tail];
+    uart_output_tail = (uart_output_tail + 1) % UART_OUTPUT_SIZE;
+  }
+
+  return count;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t uart_pending( void )
+ * @brief  USCI_A0 vector
+ * ****************************************************************************/
+static uint8_t uart_pending( void )
+{
+  return (uca0_ifg & UCA0IE & (UCRXIFG | UCTXIFG)) != 0;
+}
+
+//
+// ADC12_A
+//
+
+/*******************************************************************************
+ * @fn     void adc12_sync( void )
+ * @brief  finish a conversion started with ADC12SC
+ * ****************************************************************************/
+static void adc12_sync( void )
+{
+  if( (ADC12CTL0 & (ADC12SC | ADC12ENC)) == (ADC12SC | ADC12ENC) )
+  {
+    ADC12CTL0 &= ~ADC12SC;
+    adc12_mem0 = adc12_input;
+    ADC12IFG |= BIT0;
+  }
+}
+
+/*******************************************************************************
+ * @fn     volatile uint16_t* hal_host_adc12_reg( uint8_t reg )
+ * @brief  ADC12IV and ADC12MEM0. Reading ADC12MEM0 clears ADC12IFG0.
+ * ****************************************************************************/
+volatile uint16_t* hal_host_adc12_reg( uint8_t reg )
+{
+  uint8_t index;
+
+  adc12_sync();
+
+  if( HAL_HOST_ADC12MEM0 == reg )
+  {
+    ADC12IFG &= ~BIT0;
+    return &adc12_mem0;
+  }
+
+  adc12_iv = 0;
+  for( index = 0; index < 16; index++ )
+  {
+    if( ADC12IFG & ADC12IE & (1 << index) )
+    {
+      adc12_iv = 6 + (index << 1);
+      break;
+    }
+  }
+
+  return &adc12_iv;
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_adc_input( uint16_t value )
+ * @brief  result of the following conversions
+ * ****************************************************************************/
+void hal_host_adc_input( uint16_t value )
+{
+  adc12_input = value & 0x0FFF;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t adc12_pending( void )
+ * @brief  ADC12 vector
+ * ****************************************************************************/
+static uint8_t adc12_pending( void )
+{
+  return (ADC12IFG & ADC12IE) != 0;
+}
+
+//
+// RF1A
+//
+
+/*******************************************************************************
+ * @fn     uint8_t radio_status( void )
+ * @brief  chip status byte, state and RX FIFO bytes available
+ * ****************************************************************************/
+static uint8_t radio_status( void )
+{
+  uint8_t available = rx_length - rx_read;
+
+  return (radio_state << 4) | ( (available > 15) ? 15 : available );
+}
+
+/*******************************************************************************
+ * @fn     void radio_end_of_packet( void )
+ * @brief  GDO end of packet signal, RFIFG9 on the falling edge
+ * ****************************************************************************/
+static void radio_end_of_packet( void )
+{
+  if( hal_host_rf1a.ies & BIT9 )
+  {
+    hal_host_rf1a.ifg |= BIT9;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void radio_strobe( uint8_t strobe )
+ * @brief  radio core command strobes, RX and TX go back to IDLE at the end of
+ *         a packet (MCSM1 reset value)
+ * ****************************************************************************/
+static void radio_strobe( uint8_t strobe )
+{
+  uint8_t length;
+
+  switch( strobe )
+  {
+    case RF_SRES:
+    {
+      memset( radio_config, 0, sizeof(radio_config) );
+      memset( radio_patable, 0, sizeof(radio_patable) );
+      patable_index = 0;
+      tx_length = 0;
+      rx_read = 0;
+      rx_length = 0;
+      radio_state = HAL_HOST_RADIO_IDLE;
+      break;
+    }
+
+    case RF_SRX:
+    {
+      radio_state = HAL_HOST_RADIO_RX;
+      break;
+    }
+
+    case RF_STX:
+    {
+      if( 0 == tx_length )
+      {
+        break;
+      }
+
+      radio_state = HAL_HOST_RADIO_TX;
+      length = tx_length;
+      memcpy( tx_packet, tx_fifo, length );
+      tx_length = 0;
+
+      // Rising edge, sync word sent
+      if( !(hal_host_rf1a.ies & BIT9) )
+      {
+        hal_host_rf1a.ifg |= BIT9;
+      }
+
+      if( hal_host_radio_tx )
+      {
+        hal_host_radio_tx( tx_packet, length );
+      }
+      else
+      {
+        hal_host_radio_tx_done();
+      }
+      break;
+    }
+
+    case RF_SIDLE:
+    case RF_SXOFF:
+    case RF_SPWD:
+    case RF_SWOR:
+    {
+      radio_state = HAL_HOST_RADIO_IDLE;
+      break;
+    }
+
+    case RF_SFRX:
+    {
+      rx_read = 0;
+      rx_length = 0;
+      break;
+    }
+
+    case RF_SFTX:
+    {
+      tx_length = 0;
+      break;
+    }
+
+    case RF_SNOP:
+    {
+      patable_index = 0;
+      break;
+    }
+
+    default: break;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void radio_write( uint8_t address, uint8_t value )
+ * @brief  configuration register, PATABLE or TX FIFO write
+ * ****************************************************************************/
+static void radio_write( uint8_t address, uint8_t value )
+{
+  if( address < sizeof(radio_config) )
+  {
+    radio_config[address] = value;
+  }
+  else if( PATABLE == address )
+  {
+    radio_patable[patable_index] = value;
+    patable_index = (patable_index + 1) % RADIO_PATABLE_SIZE;
+  }
+  else if( TXFIFO == address && tx_length < RADIO_FIFO_SIZE )
+  {
+    tx_fifo[tx_length++] = value;
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t radio_read( uint8_t address )
+ * @brief  configuration or status register, PATABLE or RX FIFO read
+ * ****************************************************************************/
+static uint8_t radio_read( uint8_t address )
+{
+  uint8_t value;
+
+  if( address < sizeof(radio_config) )
+  {
+    return radio_config[address];
+  }
+
+  switch( address )
+  {
+    case PARTNUM: return 0x00;
+    case VERSION: return 0x06;
+    case LQI: return radio_lqi;
+    case RSSI: return radio_rssi;
+    case TXBYTES: return tx_length;
+    case RXBYTES: return rx_length - rx_read;
+    case MARCSTATE:
+    {
+      switch( radio_state )
+      {
+        case HAL_HOST_RADIO_RX: return MARCSTATE_RX;
+        case HAL_HOST_RADIO_TX: return MARCSTATE_TX;
+        default: return MARCSTATE_IDLE;
+      }
+    }
+    case PATABLE:
+    {
+      value = radio_patable[patable_index];
+      patable_index = (patable_index + 1) % RADIO_PATABLE_SIZE;
+      return value;
+    }
+    case RXFIFO:
+    {
+      if( rx_read == rx_length )
+      {
+        return 0;
+      }
+      value = rx_fifo[rx_read++];
+      if( rx_read == rx_length )
+      {
+        rx_read = 0;
+        rx_length = 0;
+      }
+      return value;
+    }
+    default: return 0;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void rf1a_instruction( uint8_t instruction )
+ * @brief  start an instruction written to RF1AINSTRx
+ * ****************************************************************************/
+static void rf1a_instruction( uint8_t instruction )
+{
+  uint8_t address = instruction & 0x3F;
+
+  rf1a_writing = 0;
+  rf1a_reading = 0;
+  hal_host_rf1a.ifctl1 |= RFINSTRIFG | RFSTATIFG;
+
+  // Strobes are the 0x30-0x3D addresses without the burst bit
+  if( (address >= RF_SRES) && (address <= RF_SNOP) &&
+      !(instruction & RF_REGWR) )
+  {
+    radio_strobe( address );
+    return;
+  }
+
+  // Status registers are single reads with the burst bit set
+  rf1a_address = address;
+  rf1a_burst = (instruction & RF_REGWR) && (address < RF_SRES ||
+                                            address > RF_SNOP);
+
+  if( instruction & RF_SNGLREGRD )
+  {
+    rf1a_reading = 1;
+    rf1a_dout = radio_read( rf1a_address );
+    hal_host_rf1a.ifctl1 |= RFDOUTIFG;
+  }
+  else
+  {
+    rf1a_writing = 1;
+    hal_host_rf1a.ifctl1 |= RFDINIFG;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void rf1a_data( uint8_t value )
+ * @brief  data byte written to RF1ADINB (or with RF1AINSTRW)
+ * ****************************************************************************/
+static void rf1a_data( uint8_t value )
+{
+  if( rf1a_writing )
+  {
+    radio_write( rf1a_address, value );
+
+    if( !rf1a_burst )
+    {
+      rf1a_writing = 0;
+    }
+    else if( rf1a_address < sizeof(radio_config) )
+    {
+      rf1a_address++;
+    }
+  }
+
+  // DOUT holds the status byte after each byte written
+  rf1a_dout = radio_status();
+  hal_host_rf1a.ifctl1 |= RFDINIFG | RFDOUTIFG;
+}
+
+/*******************************************************************************
+ * @fn     void rf1a_sync( void )
+ * @brief  act on the write to an instruction or data register, there is at
+ *         most one since every access comes through here first
+ * ****************************************************************************/
+static void rf1a_sync( void )
+{
+  uint16_t value;
+
+  if( HAL_HOST_EMPTY != hal_host_rf1a.instrw )
+  {
+    value = hal_host_rf1a.instrw;
+    hal_host_rf1a.instrw = HAL_HOST_EMPTY;
+    rf1a_instruction( value >> 8 );
+    rf1a_data( value & 0xFF );
+  }
+
+  if( HAL_HOST_EMPTY != hal_host_rf1a.instrb )
+  {
+    value = hal_host_rf1a.instrb;
+    hal_host_rf1a.instrb = HAL_HOST_EMPTY;
+    rf1a_instruction( value );
+  }
+
+  if( HAL_HOST_EMPTY != hal_host_rf1a.instr1b )
+  {
+    value = hal_host_rf1a.instr1b;
+    hal_host_rf1a.instr1b = HAL_HOST_EMPTY;
+    rf1a_instruction( value );
+  }
+
+  if( HAL_HOST_EMPTY != hal_host_rf1a.dinb )
+  {
+    value = hal_host_rf1a.dinb;
+    hal_host_rf1a.dinb = HAL_HOST_EMPTY;
+    rf1a_data( value );
+  }
+}
+
+/*******************************************************************************
+ * @fn     volatile uint16_t* hal_host_rf1a_reg( volatile uint16_t* reg )
+ * @brief  RF1A interface registers. RF1ADOUT1B returns the current byte and
+ *         fetches the next one of a burst, RF1ADOUTB and RF1ADOUT0B end it.
+ * ****************************************************************************/
+volatile uint16_t* hal_host_rf1a_reg( volatile uint16_t* reg )
+{
+  uint16_t pending;
+  uint8_t index;
+
+  rf1a_sync();
+
+  if( &hal_host_rf1a.doutb == reg || &hal_host_rf1a.dout0b == reg )
+  {
+    *reg = rf1a_dout;
+    rf1a_reading = 0;
+    hal_host_rf1a.ifctl1 &= ~RFDOUTIFG;
+  }
+  else if( &hal_host_rf1a.dout1b == reg )
+  {
+    *reg = rf1a_dout;
+    if( rf1a_reading && rf1a_burst )
+    {
+      if( rf1a_address < sizeof(radio_config) )
+      {
+        rf1a_address++;
+      }
+      rf1a_dout = radio_read( rf1a_address );
+    }
+    else
+    {
+      hal_host_rf1a.ifctl1 &= ~RFDOUTIFG;
+    }
+  }
+  else if( &hal_host_rf1a.statb == reg )
+  {
+    *reg = radio_status();
+    hal_host_rf1a.ifctl1 &= ~RFSTATIFG;
+  }
+  else if( &hal_host_rf1a.iv == reg )
+  {
+    // Highest priority enabled flag, which reading clears
+    pending = hal_host_rf1a.ifg & hal_host_rf1a.ie;
+    *reg = RF1AIV_NONE;
+    for( index = 0; index < 16; index++ )
+    {
+      if( pending & (1 << index) )
+      {
+        hal_host_rf1a.ifg &= ~(1 << index);
+        *reg = (index + 1) << 1;
+        break;
+      }
+    }
+  }
+
+  return reg;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t hal_host_radio_receive( uint8_t* packet, uint8_t rssi,
+ *                                         uint8_t crc_ok )
+ * @brief  put a packet in the RX FIFO followed by the RSSI and LQI/CRC_OK
+ *         status bytes, as with PKTCTRL1.APPEND_STATUS
+ * @return 1 if the radio was listening and the packet fit in the FIFO
+ * ****************************************************************************/
+uint8_t hal_host_radio_receive( uint8_t* packet, uint8_t rssi, uint8_t crc_ok )
+{
+  uint8_t length = packet[0] + 1;
+
+  rf1a_sync();
+
+  if( (HAL_HOST_RADIO_RX != radio_state) ||
+      (rx_length + length + 2 > RADIO_FIFO_SIZE) )
+  {
+    return 0;
+  }
+
+  if( !(hal_host_rf1a.ies & BIT9) )
+  {
+    hal_host_rf1a.ifg |= BIT9;
+  }
+
+  memcpy( &rx_fifo[rx_length], packet, length );
+  rx_length += length;
+  radio_rssi = rssi;
+  radio_lqi = crc_ok ? 0x80 : 0x00;
+  rx_fifo[rx_length++] = radio_rssi;
+  rx_fifo[rx_length++] = radio_lqi;
+
+  radio_state = HAL_HOST_RADIO_IDLE;
+  radio_end_of_packet();
+
+  hal_host_service();
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     void hal_host_radio_tx_done( void )
+ * @brief  end the transmission started with STX
+ * ****************************************************************************/
+void hal_host_radio_tx_done( void )
+{
+  if( HAL_HOST_RADIO_TX != radio_state )
+  {
+    return;
+  }
+
+  radio_state = HAL_HOST_RADIO_IDLE;
+  radio_end_of_packet();
+}
+
+/*******************************************************************************
+ * @fn     uint8_t hal_host_radio_state( void )
+ * @brief  HAL_HOST_RADIO_IDLE, HAL_HOST_RADIO_RX or HAL_HOST_RADIO_TX
+ * ****************************************************************************/
+uint8_t hal_host_radio_state( void )
+{
+  rf1a_sync();
+
+  return radio_state;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t hal_host_radio_register( uint8_t address )
+ * @brief  configuration register value, PATABLE gives the first entry
+ * ****************************************************************************/
+uint8_t hal_host_radio_register( uint8_t address )
+{
+  rf1a_sync();
+
+  if( PATABLE == address )
+  {
+    return radio_patable[0];
+  }
+
+  return ( address < sizeof(radio_config) ) ? radio_config[address] : 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t radio_pending( void )
+ * @brief  CC1101 vector
+ * ****************************************************************************/
+static uint8_t radio_pending( void )
+{
+  return (hal_host_rf1a.ifg & hal_host_rf1a.ie) != 0;
+}
@@ -0,0 +1,564 @@
+/** @file hal_host.h
+*
+* @brief Peripheral model used in place of <io.h> when lib/ is built for a
+*        development machine (HOST_BUILD)
+*
+*   Registers lib/ only writes and reads back are plain variables. Registers
+*   with side effects (RF1A instruction/data, TA0CTL, TA0IV, UCA0TXBUF,
+*   UCA0RXBUF, UCA0IV, ADC12IV, ADC12MEM0, PMMIFG) expand to a call that
+*   updates the model and returns the register's address, so lib/ code reads
+*   and writes them exactly as it does on the CC430.
+*
+*   A write to one of these is acted on at the next access to the same
+*   peripheral, which is always before the firmware could have observed the
+*   result on real hardware.
+*
+*   Interrupt handlers become plain functions. hal_host_service() calls the
+*   ones with an enabled pending flag while GIE is set, highest priority
+*   first, the same as the interrupt controller would.
+*
+* @author Alvaro Prieto
+*/
+#ifndef _HAL_HOST_H
+#define _HAL_HOST_H
+
+#include <stdint.h>
+
+//
+// Status register
+//
+#define GIE (0x0008)
+#define CPUOFF (0x0010)
+#define OSCOFF (0x0020)
+#define SCG0 (0x0040)
+#define SCG1 (0x0080)
+
+#define LPM0_bits (CPUOFF)
+#define LPM1_bits (SCG0 + CPUOFF)
+#define LPM2_bits (SCG1 + CPUOFF)
+#define LPM3_bits (SCG1 + SCG0 + CPUOFF)
+#define LPM4_bits (SCG1 + SCG0 + OSCOFF + CPUOFF)
+
+extern volatile uint16_t hal_host_sr;
+
+void hal_host_eint( void );
+void hal_host_bis_sr( uint16_t );
+void hal_host_bic_sr_on_exit( uint16_t );
+
+#define READ_SR (hal_host_sr)
+#define eint() hal_host_eint()
+#define dint() (hal_host_sr &= ~GIE)
+#define nop()
+#define __no_operation()
+#define _BIS_SR( x ) hal_host_bis_sr( x )
+#define _BIC_SR( x ) (hal_host_sr &= ~(x))
+#define __bis_SR_register( x ) hal_host_bis_sr( x )
+#define __bic_SR_register( x ) (hal_host_sr &= ~(x))
+#define __bic_SR_register_on_exit( x ) hal_host_bic_sr_on_exit( x )
+#define _BIC_SR_IRQ( x ) hal_host_bic_sr_on_exit( x )
+
+// Handlers are ordinary functions, hal_host.c knows them by name
+#define interrupt( vector ) void
+#define wakeup
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+//
+// Watchdog, special function registers, ports
+//
+extern volatile uint16_t WDTCTL;
+#define WDTPW (0x5A00)
+#define WDTHOLD (0x0080)
+
+extern volatile uint16_t SFRIFG1;
+#define OFIFG (0x0002)
+
+extern volatile uint8_t P1DIR;
+extern volatile uint8_t P1OUT;
+extern volatile uint8_t P1SEL;
+extern volatile uint8_t P5SEL;
+extern volatile uint16_t PJDIR;
+extern volatile uint16_t PJOUT;
+
+extern volatile uint16_t PMAPPWD;
+extern volatile uint8_t P1MAP5;
+extern volatile uint8_t P1MAP6;
+#define PM_UCA0RXD (5)
+#define PM_UCA0TXD (6)
+
+//
+// Unified clock system
+//
+extern volatile uint16_t UCSCTL0;
+extern volatile uint16_t UCSCTL1;
+extern volatile uint16_t UCSCTL2;
+extern volatile uint16_t UCSCTL3;
+extern volatile uint16_t UCSCTL4;
+extern volatile uint16_t UCSCTL5;
+extern volatile uint16_t UCSCTL6;
+extern volatile uint16_t UCSCTL7;
+#define DCORSEL_3 (0x0030)
+#define DCORSEL_4 (0x0040)
+#define DCORSEL_5 (0x0050)
+#define DCORSEL_6 (0x0060)
+#define FLLD_1 (0x1000)
+#define SELA__XT1CLK (0x0000)
+#define SELS__DCOCLKDIV (0x0040)
+#define SELM__DCOCLKDIV (0x0004)
+#define XT1OFF (0x0001)
+#define XCAP_3 (0x000C)
+#define XT1DRIVE_3 (0x00C0)
+#define DCOFFG (0x0001)
+#define XT1LFOFFG (0x0002)
+#define XT1HFOFFG (0x0004)
+#define XT2OFFG (0x0008)
+
+//
+// Power management module. The supervisor delays always read as elapsed and
+// supply faults never occur, so SetVCore steps straight through.
+//
+extern volatile uint16_t PMMCTL0;
+#define PMMCTL0_L (((volatile uint8_t*)&PMMCTL0)[0])
+#define PMMCTL0_H (((volatile uint8_t*)&PMMCTL0)[1])
+extern volatile uint16_t PMMRIE;
+extern volatile uint16_t SVSMHCTL;
+extern volatile uint16_t SVSMLCTL;
+volatile uint16_t* hal_host_pmmifg( void );
+#define PMMIFG (*hal_host_pmmifg())
+
+#define PMMCOREV0 (0x0001)
+#define PMMCOREV_3 (0x0003)
+#define PMMHPMRE (0x0080)
+#define SVSMHRRL0 (0x0001)
+#define SVSHRVL0 (0x0100)
+#define SVMHE (0x0400)
+#define SVMHFP (0x0800)
+#define SVSHE (0x4000)
+#define SVSHFP (0x8000)
+#define SVSMLRRL0 (0x0001)
+#define SVSLRVL0 (0x0100)
+#define SVMLE (0x0400)
+#define SVMLFP (0x0800)
+#define SVSLE (0x4000)
+#define SVSLFP (0x8000)
+#define SVSMLDLYIFG (0x0001)
+#define SVMLIFG (0x0002)
+#define SVMLVLRIFG (0x0004)
+#define SVSMHDLYIFG (0x0010)
+#define SVMHIFG (0x0020)
+#define SVMHVLRIFG (0x0040)
+#define SVSLIFG (0x1000)
+#define SVSHIFG (0x2000)
+#define SVSMLDLYIE (0x0001)
+#define SVMLVLRIE (0x0004)
+#define SVSMHDLYIE (0x0010)
+#define SVMHVLRIE (0x0040)
+#define SVMHVLRPE (0x2000)
+
+//
+// Timer0_A5, laid out as on the CC430 (TA0CTL at 0x0340) so that TA0CCTLn
+// and TA0CCRn can be indexed from TA0CCTL0 and TA0CCR0
+//
+typedef struct
+{
+  volatile uint16_t ctl;
+  volatile uint16_t cctl[7];
+  volatile uint16_t r;
+  volatile uint16_t ccr[7];
+  volatile uint16_t ex0;
+  volatile uint16_t reserved[6];
+  volatile uint16_t iv;
+} hal_host_timer_t;
+
+extern hal_host_timer_t hal_host_ta0;
+
+volatile uint16_t* hal_host_ta0_reg( volatile uint16_t* );
+
+#define TA0CTL (*hal_host_ta0_reg( &hal_host_ta0.ctl ))
+#define TA0R (*hal_host_ta0_reg( &hal_host_ta0.r ))
+#define TA0IV (*hal_host_ta0_reg( &hal_host_ta0.iv ))
+#define TA0EX0 (hal_host_ta0.ex0)
+#define TA0CCTL0 (hal_host_ta0.cctl[0])
+#define TA0CCTL1 (hal_host_ta0.cctl[1])
+#define TA0CCTL2 (hal_host_ta0.cctl[2])
+#define TA0CCTL3 (hal_host_ta0.cctl[3])
+#define TA0CCTL4 (hal_host_ta0.cctl[4])
+#define TA0CCR0 (hal_host_ta0.ccr[0])
+#define TA0CCR1 (hal_host_ta0.ccr[1])
+#define TA0CCR2 (hal_host_ta0.ccr[2])
+#define TA0CCR3 (hal_host_ta0.ccr[3])
+#define TA0CCR4 (hal_host_ta0.ccr[4])
+
+//
+// Timer1_A3, plain storage. It doesn't count and raises no interrupts.
+//
+extern hal_host_timer_t hal_host_ta1;
+
+#define TA1CTL (hal_host_ta1.ctl)
+#define TA1R (hal_host_ta1.r)
+#define TA1IV (hal_host_ta1.iv)
+#define TA1EX0 (hal_host_ta1.ex0)
+#define TA1CCTL0 (hal_host_ta1.cctl[0])
+#define TA1CCTL1 (hal_host_ta1.cctl[1])
+#define TA1CCTL2 (hal_host_ta1.cctl[2])
+#define TA1CCR0 (hal_host_ta1.ccr[0])
+#define TA1CCR1 (hal_host_ta1.ccr[1])
+#define TA1CCR2 (hal_host_ta1.ccr[2])
+
+#define TAIFG (0x0001)
+#define TAIE (0x0002)
+#define TACLR (0x0004)
+#define MC_0 (0x0000)
+#define MC_1 (0x0010)
+#define MC_2 (0x0020)
+#define MC_3 (0x0030)
+#define TASSEL__TACLK (0x0000)
+#define TASSEL__ACLK (0x0100)
+#define TASSEL__SMCLK (0x0200)
+#define ID_3 (0x00C0)
+#define TAIDEX_7 (0x0007)
+#define CCIFG (0x0001)
+#define CCIE (0x0010)
+
+#define TIV_CCR1 (0x0002)
+#define TIV_CCR2 (0x0004)
+#define TIV_CCR3 (0x0006)
+#define TIV_CCR4 (0x0008)
+#define TIV_OVERFLOW (0x000E)
+
+//
+// RTC_A, plain storage. The calendar doesn't advance and raises no
+// interrupts.
+//
+extern volatile uint16_t RTCCTL01;
+extern volatile uint16_t RTCCTL23;
+extern volatile uint16_t RTCPS0CTL;
+extern volatile uint16_t RTCPS1CTL;
+extern volatile uint16_t RTCIV;
+extern volatile uint8_t RTCSEC;
+extern volatile uint8_t RTCMIN;
+extern volatile uint8_t RTCHOUR;
+extern volatile uint8_t RTCDOW;
+extern volatile uint8_t RTCDAY;
+extern volatile uint8_t RTCMON;
+extern volatile uint16_t RTCYEAR;
+extern volatile uint8_t RTCAMIN;
+extern volatile uint8_t RTCAHOUR;
+extern volatile uint8_t RTCADOW;
+extern volatile uint8_t RTCADAY;
+
+#define RTCBCD (0x8000)
+#define RTCHOLD (0x4000)
+#define RTCMODE (0x2000)
+#define RTCRDY (0x1000)
+#define RTCSSEL_0 (0x0000)
+#define RTCTEV_0 (0x0000)
+#define RTCTEVIE (0x0040)
+#define RTCAIE (0x0020)
+#define RTCRDYIE (0x0010)
+#define RTCTEVIFG (0x0004)
+#define RTCAIFG (0x0002)
+#define RTCRDYIFG (0x0001)
+#define RTCAE (0x80)
+
+#define RTC_NONE (0x0000)
+#define RTC_RTCRDYIFG (0x0002)
+#define RTC_RTCTEVIFG (0x0004)
+#define RTC_RTCAIFG (0x0006)
+
+//
+// USCI_A0 in UART mode. Characters leave as soon as they are written.
+//
+extern volatile uint8_t UCA0CTL0;
+extern volatile uint8_t UCA0CTL1;
+extern volatile uint8_t UCA0BR0;
+extern volatile uint8_t UCA0BR1;
+extern volatile uint8_t UCA0MCTL;
+extern volatile uint8_t UCA0STAT;
+extern volatile uint16_t UCA0IE;
+
+volatile uint16_t* hal_host_uca0_reg( uint8_t );
+
+#define HAL_HOST_UCA0IFG (0)
+#define HAL_HOST_UCA0IV (1)
+#define HAL_HOST_UCA0RXBUF (2)
+#define HAL_HOST_UCA0TXBUF (3)
+
+#define UCA0IFG (*hal_host_uca0_reg( HAL_HOST_UCA0IFG ))
+#define UCA0IV (*hal_host_uca0_reg( HAL_HOST_UCA0IV ))
+#define UCA0RXBUF (*hal_host_uca0_reg( HAL_HOST_UCA0RXBUF ))
+#define UCA0TXBUF (*hal_host_uca0_reg( HAL_HOST_UCA0TXBUF ))
+
+#define UCSWRST (0x01)
+#define UCSSEL_2 (0x80)
+#define UCOS16 (0x01)
+#define UCBRS0 (0x02)
+#define UCBRF0 (0x10)
+#define UCRXIE (0x0001)
+#define UCTXIE (0x0002)
+#define UCRXIFG (0x0001)
+#define UCTXIFG (0x0002)
+#define UCBUSY (0x01)
+
+//
+// ADC12_A and REF. A conversion finishes as soon as ADC12SC is seen, with
+// the value last given to hal_host_adc_input.
+//
+extern volatile uint16_t ADC12CTL0;
+extern volatile uint16_t ADC12CTL1;
+extern volatile uint8_t ADC12MCTL0;
+extern volatile uint16_t ADC12IE;
+extern volatile uint16_t ADC12IFG;
+extern volatile uint16_t REFCTL0;
+
+volatile uint16_t* hal_host_adc12_reg( uint8_t );
+
+#define HAL_HOST_ADC12IV (0)
+#define HAL_HOST_ADC12MEM0 (1)
+
+#define ADC12IV (*hal_host_adc12_reg( HAL_HOST_ADC12IV ))
+#define ADC12MEM0 (*hal_host_adc12_reg( HAL_HOST_ADC12MEM0 ))
+
+#define ADC12SC (0x0001)
+#define ADC12ENC (0x0002)
+#define ADC12ON (0x0010)
+#define ADC12SHP (0x0200)
+#define ADC12SHT0_10 (0x0A00)
+#define ADC12INCH_0 (0x0000)
+#define REFON (0x0001)
+#define REFTCOFF (0x0008)
+#define REFVSEL_2 (0x0020)
+#define REFMSTR (0x0080)
+
+//
+// RF1A radio interface and radio core
+//
+typedef struct
+{
+  volatile uint16_t ifctl1;
+  volatile uint16_t ifg;
+  volatile uint16_t ie;
+  volatile uint16_t ies;
+  volatile uint16_t in;
+  volatile uint16_t iv;
+  volatile uint16_t instrw;
+  volatile uint16_t instrb;
+  volatile uint16_t instr1b;
+  volatile uint16_t dinb;
+  volatile uint16_t statb;
+  volatile uint16_t doutb;
+  volatile uint16_t dout0b;
+  volatile uint16_t dout1b;
+} hal_host_rf1a_t;
+
+extern hal_host_rf1a_t hal_host_rf1a;
+
+volatile uint16_t* hal_host_rf1a_reg( volatile uint16_t* );
+
+#define RF1AIFCTL1 (*hal_host_rf1a_reg( &hal_host_rf1a.ifctl1 ))
+#define RF1AIFG (*hal_host_rf1a_reg( &hal_host_rf1a.ifg ))
+#define RF1AIE (*hal_host_rf1a_reg( &hal_host_rf1a.ie ))
+#define RF1AIES (*hal_host_rf1a_reg( &hal_host_rf1a.ies ))
+#define RF1AIN (*hal_host_rf1a_reg( &hal_host_rf1a.in ))
+#define RF1AIV (*hal_host_rf1a_reg( &hal_host_rf1a.iv ))
+#define RF1AINSTRW (*hal_host_rf1a_reg( &hal_host_rf1a.instrw ))
+#define RF1AINSTRB (*hal_host_rf1a_reg( &hal_host_rf1a.instrb ))
+#define RF1AINSTR1B (*hal_host_rf1a_reg( &hal_host_rf1a.instr1b ))
+#define RF1ADINB (*hal_host_rf1a_reg( &hal_host_rf1a.dinb ))
+#define RF1ASTATB (*hal_host_rf1a_reg( &hal_host_rf1a.statb ))
+#define RF1ADOUTB (*hal_host_rf1a_reg( &hal_host_rf1a.doutb ))
+#define RF1ADOUT0B (*hal_host_rf1a_reg( &hal_host_rf1a.dout0b ))
+#define RF1ADOUT1B (*hal_host_rf1a_reg( &hal_host_rf1a.dout1b ))
+
+#define RFINSTRIFG (0x0010)
+#define RFDINIFG (0x0020)
+#define RFSTATIFG (0x0040)
+#define RFDOUTIFG (0x0080)
+
+#define RF1AIV_NONE (0x0000)
+#define RF1AIV_RFIFG0 (0x0002)
+#define RF1AIV_RFIFG1 (0x0004)
+#define RF1AIV_RFIFG2 (0x0006)
+#define RF1AIV_RFIFG3 (0x0008)
+#define RF1AIV_RFIFG4 (0x000A)
+#define RF1AIV_RFIFG5 (0x000C)
+#define RF1AIV_RFIFG6 (0x000E)
+#define RF1AIV_RFIFG7 (0x0010)
+#define RF1AIV_RFIFG8 (0x0012)
+#define RF1AIV_RFIFG9 (0x0014)
+#define RF1AIV_RFIFG10 (0x0016)
+#define RF1AIV_RFIFG11 (0x0018)
+#define RF1AIV_RFIFG12 (0x001A)
+#define RF1AIV_RFIFG13 (0x001C)
+#define RF1AIV_RFIFG14 (0x001E)
+#define RF1AIV_RFIFG15 (0x0020)
+
+// Radio core configuration registers
+#define IOCFG2 (0x00)
+#define IOCFG1 (0x01)
+#define IOCFG0 (0x02)
+#define FIFOTHR (0x03)
+#define SYNC1 (0x04)
+#define SYNC0 (0x05)
+#define PKTLEN (0x06)
+#define PKTCTRL1 (0x07)
+#define PKTCTRL0 (0x08)
+#define ADDR (0x09)
+#define CHANNR (0x0A)
+#define FSCTRL1 (0x0B)
+#define FSCTRL0 (0x0C)
+#define FREQ2 (0x0D)
+#define FREQ1 (0x0E)
+#define FREQ0 (0x0F)
+#define MDMCFG4 (0x10)
+#define MDMCFG3 (0x11)
+#define MDMCFG2 (0x12)
+#define MDMCFG1 (0x13)
+#define MDMCFG0 (0x14)
+#define DEVIATN (0x15)
+#define MCSM2 (0x16)
+#define MCSM1 (0x17)
+#define MCSM0 (0x18)
+#define FOCCFG (0x19)
+#define BSCFG (0x1A)
+#define AGCCTRL2 (0x1B)
+#define AGCCTRL1 (0x1C)
+#define AGCCTRL0 (0x1D)
+#define WOREVT1 (0x1E)
+#define WOREVT0 (0x1F)
+#define WORCTRL (0x20)
+#define FREND1 (0x21)
+#define FREND0 (0x22)
+#define FSCAL3 (0x23)
+#define FSCAL2 (0x24)
+#define FSCAL1 (0x25)
+#define FSCAL0 (0x26)
+#define FSTEST (0x29)
+#define PTEST (0x2A)
+#define AGCTEST (0x2B)
+#define TEST2 (0x2C)
+#define TEST1 (0x2D)
+#define TEST0 (0x2E)
+
+// Radio core status registers
+#define PARTNUM (0x30)
+#define VERSION (0x31)
+#define FREQEST (0x32)
+#define LQI (0x33)
+#define RSSI (0x34)
+#define MARCSTATE (0x35)
+#define PKTSTATUS (0x38)
+#define TXBYTES (0x3A)
+#define RXBYTES (0x3B)
+
+#define PATABLE (0x3E)
+#define TXFIFO (0x3F)
+#define RXFIFO (0x3F)
+
+// Radio core instructions
+#define RF_SNGLREGRD (0x80)
+#define RF_SNGLREGWR (0x00)
+#define RF_REGRD (0xC0)
+#define RF_REGWR (0x40)
+#define RF_STATREGRD (0xC0)
+#define RF_SNGLPATABRD (RF_SNGLREGRD + PATABLE)
+#define RF_SNGLPATABWR (RF_SNGLREGWR + PATABLE)
+#define RF_PATABRD (RF_REGRD + PATABLE)
+#define RF_PATABWR (RF_REGWR + PATABLE)
+#define RF_SNGLRXRD (RF_SNGLREGRD + RXFIFO)
+#define RF_RXFIFORD (RF_REGRD + RXFIFO)
+#define RF_SNGLTXWR (RF_SNGLREGWR + TXFIFO)
+#define RF_TXFIFOWR (RF_REGWR + TXFIFO)
+
+// Radio core strobes
+#define RF_SRES (0x30)
+#define RF_SFSTXON (0x31)
+#define RF_SXOFF (0x32)
+#define RF_SCAL (0x33)
+#define RF_SRX (0x34)
+#define RF_STX (0x35)
+#define RF_SIDLE (0x36)
+#define RF_SWOR (0x38)
+#define RF_SPWD (0x39)
+#define RF_SFRX (0x3A)
+#define RF_SFTX (0x3B)
+#define RF_SWORRST (0x3C)
+#define RF_SNOP (0x3D)
+
+// Radio core states, as in the status byte
+#define HAL_HOST_RADIO_IDLE (0)
+#define HAL_HOST_RADIO_RX (1)
+#define HAL_HOST_RADIO_TX (2)
+
+//
+// Model control, for host programs driving lib/ code
+//
+
+// Device address for code built with -DDEVICE_ADDRESS=hal_host_address, so
+// one build can run as several devices
+extern uint8_t hal_host_address;
+
+
+// Call every pending interrupt handler that GIE and its enable bit allow
+void hal_host_service( void );
+
+// Called while the firmware sleeps in a low power mode. Return 0 if nothing
+// will ever wake it up, the sleep then ends straight away.
+extern uint8_t (*hal_host_idle)( void );
+
+// Index of the node in a simulator that sets hal_host_idle, -1 otherwise.
+// Sleeping with the hook cleared then aborts instead of carrying on.
+extern int32_t hal_host_node;
+
+// Timer0_A counts [ticks] of its clock, handlers run as each event happens
+void hal_host_timer_advance( uint32_t );
+
+// Ticks until the next event that sets a flag, 0 if the timer is stopped
+uint32_t hal_host_timer_next( void );
+
+// Characters from the host to UCA0RXD
+void hal_host_uart_receive( uint8_t );
+
+// Characters the firmware sent, removed from the model's buffer
+uint16_t hal_host_uart_output( uint8_t*, uint16_t );
+
+// Called with each character the firmware sends instead of buffering it
+extern void (*hal_host_uart_tx)( uint8_t );
+
+void hal_host_adc_input( uint16_t );
+
+// Deliver [packet] (length byte first) if the radio is in RX
+uint8_t hal_host_radio_receive( uint8_t*, uint8_t, uint8_t );
+
+// Called with the TX FIFO (length byte first) on STX. When set, the
+// transmission ends once hal_host_radio_tx_done is called, otherwise it ends
+// immediately.
+extern void (*hal_host_radio_tx)( uint8_t*, uint8_t );
+
+void hal_host_radio_tx_done( void );
+
+uint8_t hal_host_radio_state( void );
+
+// Configuration register, or PATABLE[0] for PATABLE
+uint8_t hal_host_radio_register( uint8_t );
+
+// Cycles the busy waits in delay.h would have taken on the CC430
+extern uint32_t hal_host_delay_cycles;
+
+#endif /* _HAL_HOST_H */\
+
@@ -66,7 +66,7 @@
 * You may not use the Program in non-TI devices.
 * ********************************************************* */
 
-#include <io.h>
+#include "common.h"
 #include "hal_pmm.h"
 
 #define _HAL_PMM_DISABLE_SVML_
@@ -7,21 +7,6 @@
 */
 #include "intrinsics.h"
 
-/*******************************************************************************
- * @fn     void _delay_cycles( void )
- * @brief  delay for 'cycles' number of cycles
- * used by: rf1a.c, bsp_board.c 
- * ****************************************************************************/
-void __delay_cycles(unsigned long cycles)
-{
-   
-   for( ; cycles > 0; cycles-- ) {
-      nop();
-      nop();
-   }
-
-}
-
 /*******************************************************************************
  * @fn     void __set_interrupt_state( void )
  * @brief  set interrupt to state
@@ -29,7 +14,11 @@ void __delay_cycles(unsigned long cycles)
  * ****************************************************************************/
 void  __set_interrupt_state(unsigned short state)
 {
+#ifdef HOST_BUILD
+   hal_host_sr |= state;
+#else
    __asm__("bis %0,r2" : : "ir" ((uint16_t) state));
+#endif
 }
 
 /*******************************************************************************
@@ -8,8 +8,11 @@
 #define _INTRINSICS_H
 
 #include "common.h"
+#include "delay.h"
+
+// Exact for constant counts, see delay_cycles
+#define __delay_cycles( cycles ) delay_cycles( cycles )
 
-void __delay_cycles(unsigned long cycles);
 void  __set_interrupt_state(unsigned short state);
 unsigned short __even_in_range(unsigned short value, unsigned short bound);
 unsigned short __get_interrupt_state(void);
@@ -2,11 +2,106 @@
 *
 * @brief Oscillator configuration functions
 *
+*   The FLL locks DCOCLKDIV to a multiple of the 32768Hz crystal. clock_set
+*   moves MCLK and SMCLK between profiles at runtime. The core voltage has
+*   to be high enough for the clock at all times, so the clock's need in
+*   power.c is raised before speeding up and lowered after slowing down.
+*   Drivers that depend on SMCLK, like the UART divisors, register a
+*   listener. It is called with 0 just before the clock changes, to finish or
+*   pause whatever is running from SMCLK, and with the new frequency once it
+*   has settled.
+*
+*   Nothing waits for a fixed worst case. The DCO and crystal fault flags
+*   are polled until they clear or a timeout runs out, and the radio core
+*   resets while the clocks settle. boot_stats has the time each stage took.
+*
 * @author Alvaro Prieto
 *         derived from work by Corey Provencher
 */
 #include "oscillator.h"
+#include "boot.h"
+#include "delay.h"
 #include "intrinsics.h"
+#include "power.h"
+#include "radio.h"
+
+typedef struct
+{
+  uint16_t multiplier;      // FLLN, DCOCLKDIV = (FLLN + 1) x 32768Hz
+  uint16_t range;           // DCORSEL, DCOCLK is twice DCOCLKDIV
+  uint8_t vcore;            // Lowest PMMCOREV for this MCLK
+} clock_profile_t;
+
+static const clock_profile_t profiles[CLOCK_PROFILES] =
+{
+  {  30, DCORSEL_3, 0 },    // 1015808Hz
+  { 121, DCORSEL_4, 0 },    // 3997696Hz
+  { 243, DCORSEL_5, 0 },    // 7995392Hz
+  { 366, DCORSEL_5, 1 },    // 12025856Hz
+  { 609, DCORSEL_6, 3 },    // 19988480Hz
+};
+
+static void notify( uint32_t );
+
+static uint8_t current_profile = CLOCK_PROFILES;
+static void (*listeners[CLOCK_LISTENERS])( uint32_t );
+
+/*******************************************************************************
+ * @fn     uint32_t profile_frequency( uint8_t profile )
+ * @brief  MCLK and SMCLK frequency of [profile] in Hz
+ * ****************************************************************************/
+static uint32_t profile_frequency( uint8_t profile )
+{
+  return ( (uint32_t)profiles[profile].multiplier + 1 ) * 32768;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t set_dco( uint8_t profile )
+ * @brief  lock the DCO to the frequency of [profile]. The worst case settling
+ *         time after a range change is 32 x 32 reference clocks (31ms), but
+ *         the fault flag usually clears long before that. The FLL trims the
+ *         last few percent while the program carries on.
+ * @return 0 if the DCO settled, DCOFFG if it was still faulty at the timeout
+ * ****************************************************************************/
+static uint8_t set_dco( uint8_t profile )
+{
+  // A poll takes around 16 cycles, the timeout is the worst case above
+  uint16_t polls = profile_frequency( profile ) >> 9;
+
+  _BIS_SR(SCG0);                  // Disable the FLL control loop
+  UCSCTL0 = 0x0000;          // Set lowest possible DCOx, MODx
+  UCSCTL1 = profiles[profile].range;
+  UCSCTL2 = FLLD_1 + profiles[profile].multiplier;
+  _BIC_SR(SCG0);                  // Enable the FLL control loop
+
+  do
+  {
+    UCSCTL7 &= ~DCOFFG;
+  } while( ( UCSCTL7 & DCOFFG ) && --polls );
+
+  // Set again by the hardware if any oscillator is still faulty
+  SFRIFG1 &= ~OFIFG;
+
+  return UCSCTL7 & DCOFFG;
+}
+
+/*******************************************************************************
+ * @fn     void notify( uint32_t frequency )
+ * @brief  call every listener with [frequency]
+ * ****************************************************************************/
+static void notify( uint32_t frequency )
+{
+  uint8_t index;
+
+  for( index = 0; index < CLOCK_LISTENERS; index++ )
+  {
+    if( listeners[index] )
+    {
+      listeners[index]( frequency );
+    }
+  }
+}
+
 /*******************************************************************************
  * @fn     void setup_oscillator( void )
  * @brief  configures oscillator for 12MHz operation derived from 32.768kHz
@@ -14,6 +109,11 @@
  * ****************************************************************************/
 void setup_oscillator( void )
 {
+  uint16_t start;
+
+  // Times every stage from here
+  boot_start();
+
   // ---------------------------------------------------------------------
   // Enable 32kHz ACLK
   P5SEL |= 0x03;                            // Select XIN, XOUT on P5.0 and P5.1
@@ -24,24 +124,132 @@ void setup_oscillator( void )
   UCSCTL4 = SELA__XT1CLK | SELS__DCOCLKDIV | SELM__DCOCLKDIV; // SMCLK == MCLK
 
   // ---------------------------------------------------------------------
-  // Configure CPU clock for 12MHz
-  _BIS_SR(SCG0);                  // Disable the FLL control loop
-  UCSCTL0 = 0x0000;          // Set lowest possible DCOx, MODx
-  UCSCTL1 = DCORSEL_5;       // Select suitable range
-  UCSCTL2 = FLLD_1 + 0x16E;  // Set DCO Multiplier
-  _BIC_SR(SCG0);                  // Enable the FLL control loop
+  // Core voltage for 12MHz and the radio, then reset the radio core while
+  // the clocks settle. setup_radio waits for it to be ready.
+  power_require( POWER_NEED_CLOCK, profiles[CLOCK_12MHZ].vcore );
+  power_require( POWER_NEED_RADIO, RADIO_VCORE );
+  boot_mark( BOOT_VCORE );
 
-  // Worst-case settling time for the DCO when the DCO range bits have been
-  // changed is n x 32 x 32 x f_MCLK / f_FLL_reference. See UCS chapter in 5xx
-  // UG for optimization.
-  // 32 x 32 x 8 MHz / 32,768 Hz = 250000 = MCLK cycles for DCO to settle
-  __delay_cycles(250000); // CHANGE
+  radio_reset_start();
 
-  // Loop until XT1 & DCO stabilizes, use do-while to insure that
-  // body is executed at least once
+  // ---------------------------------------------------------------------
+  // Configure CPU clock for 12MHz
+  clock_set( CLOCK_12MHZ );
+  boot_mark( BOOT_DCO );
+
+  // The crystal takes a few hundred ms to start, ACLK and the FLL run from
+  // REFO until then. Give up after BOOT_XT1_TIMEOUT and carry on with it.
+  start = boot_now();
   do
   {
-        UCSCTL7 &= ~(XT2OFFG + XT1LFOFFG + XT1HFOFFG + DCOFFG);
+    UCSCTL7 &= ~(XT2OFFG + XT1LFOFFG + XT1HFOFFG + DCOFFG);
     SFRIFG1 &= ~OFIFG;                      // Clear fault flags
-  } while ((SFRIFG1 & OFIFG));
+  } while( ( SFRIFG1 & OFIFG ) &&
+           ( (uint16_t)( boot_now() - start ) < BOOT_XT1_TIMEOUT ) );
+
+  boot_stats.clock_faults = UCSCTL7 & (XT1LFOFFG + DCOFFG);
+  boot_mark( BOOT_XT1 );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t clock_set( uint8_t profile )
+ * @brief  switch MCLK and SMCLK to [profile] and tell the listeners. Data
+ *         the UART is sending carries on at the new divisors.
+ * @return 1 if the clock is running at [profile], 0 if the core voltage
+ *         couldn't be raised for it (the clock is left as it was)
+ * ****************************************************************************/
+uint8_t clock_set( uint8_t profile )
+{
+  uint8_t vcore;
+  uint8_t old_vcore = 0;
+
+  if( profile >= CLOCK_PROFILES )
+  {
+    return 0;
+  }
+
+  if( profile == current_profile )
+  {
+    return 1;
+  }
+
+  vcore = profiles[profile].vcore;
+  if( current_profile < CLOCK_PROFILES )
+  {
+    old_vcore = profiles[current_profile].vcore;
+  }
+
+  // Voltage first when going faster
+  if( ( vcore > old_vcore ) && !power_require( POWER_NEED_CLOCK, vcore ) )
+  {
+    return 0;
+  }
+
+  notify( 0 );
+  set_dco( profile );
+  current_profile = profile;
+  delay_calibrate( profile_frequency( profile ) );
+
+  // Voltage last when going slower
+  if( vcore < old_vcore )
+  {
+    power_require( POWER_NEED_CLOCK, vcore );
+  }
+
+  notify( profile_frequency( profile ) );
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t clock_profile( void )
+ * @return profile MCLK and SMCLK are running at
+ * ****************************************************************************/
+uint8_t clock_profile( void )
+{
+  return current_profile;
+}
+
+/*******************************************************************************
+ * @fn     uint32_t clock_frequency( void )
+ * @return MCLK and SMCLK frequency in Hz
+ * ****************************************************************************/
+uint32_t clock_frequency( void )
+{
+  if( current_profile >= CLOCK_PROFILES )
+  {
+    return SMCLK_FREQUENCY;
+  }
+
+  return profile_frequency( current_profile );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t clock_register_listener( void (*listener)( uint32_t ) )
+ * @brief  call [listener] with 0 before every SMCLK change and with the new
+ *         frequency after it
+ * @return 1 if registered, 0 if there is no room left
+ * ****************************************************************************/
+uint8_t clock_register_listener( void (*listener)( uint32_t ) )
+{
+  uint8_t index;
+
+  for( index = 0; index < CLOCK_LISTENERS; index++ )
+  {
+    if( listener == listeners[index] )
+    {
+      return 1;
+    }
+  }
+
+  for( index = 0; index < CLOCK_LISTENERS; index++ )
+  {
+    if( !listeners[index] )
+    {
+      listeners[index] = listener;
+      return 1;
+    }
+  }
+
+  return 0;
 }
@@ -10,7 +10,25 @@
 
 #include "common.h"
 
+// DCOCLKDIV set up by setup_oscillator, (366 + 1) x 32768Hz
+#define SMCLK_FREQUENCY (12025856)
+
+// Clock profiles for clock_set, MCLK == SMCLK == DCOCLKDIV
+#define CLOCK_1MHZ (0)
+#define CLOCK_4MHZ (1)
+#define CLOCK_8MHZ (2)
+#define CLOCK_12MHZ (3)
+#define CLOCK_20MHZ (4)
+#define CLOCK_PROFILES (5)
+
+// Functions told about every SMCLK change
+#define CLOCK_LISTENERS (4)
+
 void setup_oscillator( void );
+uint8_t clock_set( uint8_t );
+uint8_t clock_profile( void );
+uint32_t clock_frequency( void );
+uint8_t clock_register_listener( void (*)( uint32_t ) );
 
 #endif /* _OSCILLATOR_H */\
 
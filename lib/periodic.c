@@ -0,0 +1,262 @@
+/** @file periodic.c
+*
+* @brief Periodic callbacks put on whichever timer wakes the CPU the least
+*
+*   periodic_start looks at the period and the timers that are running and
+*   picks, in this order:
+*     - the RTC once a minute event, for whole minutes. All of them share it
+*       and count minutes down. The first period can be up to a minute short,
+*       it starts counting at the next minute boundary.
+*     - a free Timer1_A CCR in continuous mode, for multiples of
+*       TIMER1_DIVIDER ticks up to 65535 Timer1_A counts.
+*     - a virtual timer on Timer0_A for anything else, vtimer_init has to
+*       have been called.
+*   RTC_EVENT_MINUTE and the Timer1_A CCRs it uses belong to this module
+*   while any period is on them.
+*
+*   Callbacks run in interrupt context and return 1 to wake up the main loop.
+*
+* @author Alvaro Prieto
+*/
+#include "periodic.h"
+#include "intrinsics.h"
+#include "rtc.h"
+#include "timers.h"
+#include "vtimer.h"
+
+#define SOURCE_RTC (1)
+#define SOURCE_TA1 (2)
+#define SOURCE_VTIMER (3)
+
+typedef struct
+{
+  uint8_t (*callback)( void );  // 0 when the entry is free
+  uint8_t source;
+  uint8_t ccr;                  // Timer1_A CCR
+  uint16_t reload;              // Minutes or Timer1_A counts per period
+  uint16_t count;               // Minutes left
+} periodic_t;
+
+static periodic_t entries[PERIODIC_MAX];
+static vtimer_t vtimers[PERIODIC_MAX];
+
+// Entry on each Timer1_A CCR
+static uint8_t ta1_entries[TOTAL_TA1_CCRS];
+
+static uint8_t rtc_users;
+
+/*******************************************************************************
+ * @fn     uint8_t rtc_minute( void )
+ * @brief  RTC_EVENT_MINUTE callback, counts down the minute periods
+ * ****************************************************************************/
+static uint8_t rtc_minute( void )
+{
+  uint8_t wake_up = 0;
+  uint8_t index;
+
+  for( index = 0; index < PERIODIC_MAX; index++ )
+  {
+    if( entries[index].callback && ( SOURCE_RTC == entries[index].source ) &&
+        ( 0 == --entries[index].count ) )
+    {
+      entries[index].count = entries[index].reload;
+      wake_up |= entries[index].callback();
+    }
+  }
+
+  return wake_up;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t ta1_period( uint8_t ccr )
+ * @brief  move TA1CCR[ccr] on by one period and run its callback
+ * ****************************************************************************/
+static uint8_t ta1_period( uint8_t ccr )
+{
+  periodic_t* entry = &entries[ta1_entries[ccr]];
+
+  increment_ta1_ccr( ccr, entry->reload );
+
+  return entry->callback();
+}
+
+static uint8_t ta1_ccr0( void )
+{
+  return ta1_period( 0 );
+}
+
+static uint8_t ta1_ccr1( void )
+{
+  return ta1_period( 1 );
+}
+
+static uint8_t ta1_ccr2( void )
+{
+  return ta1_period( 2 );
+}
+
+static uint8_t (* const ta1_callbacks[TOTAL_TA1_CCRS])( void ) =
+{
+  ta1_ccr0, ta1_ccr1, ta1_ccr2
+};
+
+/*******************************************************************************
+ * @fn     uint8_t free_ta1_ccr( void )
+ * @return a Timer1_A CCR nobody uses, TOTAL_TA1_CCRS if there is none or the
+ *         timer isn't running in continuous mode
+ * ****************************************************************************/
+static uint8_t free_ta1_ccr( void )
+{
+  uint8_t ccr;
+
+  if( MODE_CONTINUOUS != ( TA1CTL & MC_3 ) )
+  {
+    return TOTAL_TA1_CCRS;
+  }
+
+  for( ccr = 0; ccr < TOTAL_TA1_CCRS; ccr++ )
+  {
+    if( !ta1_ccr_active( ccr ) )
+    {
+      break;
+    }
+  }
+
+  return ccr;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t periodic_start( uint32_t period, uint8_t (*callback)( void ) )
+ * @brief  run [callback] every [period] ticks on the cheapest timer that can
+ *         do it
+ * @return handle for periodic_stop, PERIODIC_NONE if all entries are in use
+ * ****************************************************************************/
+uint8_t periodic_start( uint32_t period, uint8_t (*callback)( void ) )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  periodic_t* entry;
+  uint8_t handle;
+  uint8_t ccr;
+  uint16_t tar;
+
+  if( !period || !callback )
+  {
+    return PERIODIC_NONE;
+  }
+
+  dint();
+
+  for( handle = 0; handle < PERIODIC_MAX; handle++ )
+  {
+    if( !entries[handle].callback )
+    {
+      break;
+    }
+  }
+
+  if( handle < PERIODIC_MAX )
+  {
+    entry = &entries[handle];
+    entry->callback = callback;
+    ccr = free_ta1_ccr();
+
+    if( rtc_running() && !( period % PERIODIC_MINUTE_TICKS ) &&
+        ( period / PERIODIC_MINUTE_TICKS ) <= 0xFFFF )
+    {
+      entry->source = SOURCE_RTC;
+      entry->reload = period / PERIODIC_MINUTE_TICKS;
+      entry->count = entry->reload;
+
+      if( 0 == rtc_users++ )
+      {
+        register_rtc_callback( rtc_minute, RTC_EVENT_MINUTE );
+      }
+    }
+    else if( ( ccr < TOTAL_TA1_CCRS ) && !( period % TIMER1_DIVIDER ) &&
+             ( period / TIMER1_DIVIDER ) <= 0xFFFF )
+    {
+      entry->source = SOURCE_TA1;
+      entry->ccr = ccr;
+      entry->reload = period / TIMER1_DIVIDER;
+      ta1_entries[ccr] = handle;
+
+      // TA1R runs from ACLK, read until two reads agree
+      do
+      {
+        tar = TA1R;
+      } while( tar != TA1R );
+
+      register_timer_a1_callback( ta1_callbacks[ccr], ccr );
+      set_ta1_ccr( ccr, tar + entry->reload );
+    }
+    else
+    {
+      entry->source = SOURCE_VTIMER;
+      vtimer_start( &vtimers[handle], period, period, callback );
+    }
+  }
+  else
+  {
+    handle = PERIODIC_NONE;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+
+  return handle;
+}
+
+/*******************************************************************************
+ * @fn     void periodic_stop( uint8_t handle )
+ * @brief  stop the callback started as [handle]
+ * ****************************************************************************/
+void periodic_stop( uint8_t handle )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  periodic_t* entry;
+
+  if( handle >= PERIODIC_MAX )
+  {
+    return;
+  }
+
+  dint();
+
+  entry = &entries[handle];
+
+  if( entry->callback )
+  {
+    switch( entry->source )
+    {
+      case ( SOURCE_RTC ):
+      {
+        if( 0 == --rtc_users )
+        {
+          register_rtc_callback( 0, RTC_EVENT_MINUTE );
+        }
+        break;
+      }
+
+      case ( SOURCE_TA1 ):
+      {
+        clear_ta1_ccr( entry->ccr );
+        break;
+      }
+
+      default:
+      {
+        vtimer_stop( &vtimers[handle] );
+        break;
+      }
+    }
+
+    entry->callback = 0;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
@@ -0,0 +1,22 @@
+/** @file periodic.h
+*
+* @brief Periodic callbacks put on whichever timer wakes the CPU the least
+*
+* @author Alvaro Prieto
+*/
+#ifndef _PERIODIC_H
+#define _PERIODIC_H
+
+#include "common.h"
+
+#define PERIODIC_MAX (6)
+#define PERIODIC_NONE (0xFF)
+
+// Periods are in Timer0_A ticks, TIMER_FREQUENCY per second
+#define PERIODIC_MINUTE_TICKS ( 60UL * TIMER_FREQUENCY )
+
+uint8_t periodic_start( uint32_t, uint8_t (*)( void ) );
+void periodic_stop( uint8_t );
+
+#endif /* _PERIODIC_H */\
+
@@ -0,0 +1,147 @@
+/** @file pipeline.c
+*
+* @brief Sample block pipeline between a producer ISR and a consumer
+*
+*   Samples are written into a ring of N equally sized blocks. A block is
+*   owned by one side at a time: the producer fills FREE blocks and marks them
+*   READY, the consumer takes READY blocks in order, reads them in place and
+*   hands them back. Every block gets a sequence number when the producer
+*   starts it, including blocks that had to be dropped, so gaps are visible
+*   downstream.
+*
+*   The producer never waits. If the next block in the ring is still owned by
+*   the consumer, the samples for that block are discarded and an overrun is
+*   counted. Asking for a block when none is READY counts an underrun.
+*
+*   State changes are single byte writes, so the producer and consumer may
+*   run in different ISRs or in the main loop without disabling interrupts.
+*
+* @author Alvaro Prieto
+*/
+#include "pipeline.h"
+
+/*******************************************************************************
+ * @fn     void pipeline_init( pipeline_t* pipe, uint16_t* storage,
+ *                                  uint8_t block_count, uint8_t block_size )
+ * @brief  set up a pipeline over [storage], which must hold
+ *         block_count * block_size samples
+ * ****************************************************************************/
+void pipeline_init( pipeline_t* pipe, uint16_t* storage, uint8_t block_count,
+                                                          uint8_t block_size )
+{
+  uint8_t index;
+
+  if( block_count > PIPELINE_MAX_BLOCKS )
+  {
+    block_count = PIPELINE_MAX_BLOCKS;
+  }
+
+  pipe->storage = storage;
+  pipe->block_count = block_count;
+  pipe->block_size = block_size;
+
+  for( index = 0; index < PIPELINE_MAX_BLOCKS; index++ )
+  {
+    pipe->state[index] = BLOCK_FREE;
+    pipe->sequence[index] = 0;
+  }
+
+  pipe->fill_block = 0;
+  pipe->fill_index = 0;
+  pipe->send_block = 0;
+  pipe->next_sequence = 0;
+  pipe->dropping = 0;
+  pipe->overruns = 0;
+  pipe->underruns = 0;
+}
+
+/*******************************************************************************
+ * @fn     void pipeline_put( pipeline_t* pipe, uint16_t sample )
+ * @brief  add a sample (producer side, normally called from an ISR)
+ * ****************************************************************************/
+void pipeline_put( pipeline_t* pipe, uint16_t sample )
+{
+  uint8_t block = pipe->fill_block;
+
+  // Claim the next block when starting one
+  if( 0 == pipe->fill_index )
+  {
+    if( BLOCK_FREE == pipe->state[block] )
+    {
+      pipe->state[block] = BLOCK_FILLING;
+      pipe->sequence[block] = pipe->next_sequence;
+      pipe->dropping = 0;
+    }
+    else
+    {
+      // Consumer hasn't given it back yet, discard this block's samples
+      pipe->dropping = 1;
+    }
+  }
+
+  if( !pipe->dropping )
+  {
+    pipe->storage[ (uint16_t)block * pipe->block_size + pipe->fill_index ] =
+                                                                       sample;
+  }
+
+  if( ++pipe->fill_index == pipe->block_size )
+  {
+    pipe->fill_index = 0;
+    pipe->next_sequence++;
+
+    if( pipe->dropping )
+    {
+      pipe->overruns++;
+    }
+    else
+    {
+      pipe->state[block] = BLOCK_READY;
+      if( ++pipe->fill_block == pipe->block_count )
+      {
+        pipe->fill_block = 0;
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint16_t* pipeline_acquire( pipeline_t* pipe, uint8_t* sequence )
+ * @brief  take the oldest complete block (consumer side). The block stays in
+ *         place until pipeline_release is called, so it can be read without
+ *         copying.
+ * @return Pointer to block_size samples, or 0 if no block is ready
+ * ****************************************************************************/
+uint16_t* pipeline_acquire( pipeline_t* pipe, uint8_t* sequence )
+{
+  uint8_t block = pipe->send_block;
+
+  if( BLOCK_READY != pipe->state[block] )
+  {
+    pipe->underruns++;
+    return 0;
+  }
+
+  pipe->state[block] = BLOCK_BUSY;
+  *sequence = pipe->sequence[block];
+
+  return &pipe->storage[ (uint16_t)block * pipe->block_size ];
+}
+
+/*******************************************************************************
+ * @fn     void pipeline_release( pipeline_t* pipe )
+ * @brief  give the block returned by pipeline_acquire back to the producer
+ * ****************************************************************************/
+void pipeline_release( pipeline_t* pipe )
+{
+  uint8_t block = pipe->send_block;
+
+  if( BLOCK_BUSY == pipe->state[block] )
+  {
+    pipe->state[block] = BLOCK_FREE;
+    if( ++pipe->send_block == pipe->block_count )
+    {
+      pipe->send_block = 0;
+    }
+  }
+}
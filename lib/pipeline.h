@@ -0,0 +1,42 @@
+/** @file pipeline.h
+*
+* @brief Sample block pipeline between a producer ISR and a consumer
+*
+* @author Alvaro Prieto
+*/
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+#include "common.h"
+
+#define PIPELINE_MAX_BLOCKS (8)
+
+// Block ownership
+#define BLOCK_FREE 0      // Owned by producer, not in use
+#define BLOCK_FILLING 1   // Owned by producer, being written
+#define BLOCK_READY 2     // Complete, waiting for consumer
+#define BLOCK_BUSY 3      // Owned by consumer
+
+typedef struct
+{
+  uint16_t* storage;
+  uint8_t block_count;
+  uint8_t block_size;
+  volatile uint8_t state[PIPELINE_MAX_BLOCKS];
+  uint8_t sequence[PIPELINE_MAX_BLOCKS];
+  uint8_t fill_block;
+  uint8_t fill_index;
+  uint8_t send_block;
+  uint8_t next_sequence;
+  uint8_t dropping;
+  uint16_t overruns;
+  uint16_t underruns;
+} pipeline_t;
+
+void pipeline_init( pipeline_t*, uint16_t*, uint8_t, uint8_t );
+void pipeline_put( pipeline_t*, uint16_t );
+uint16_t* pipeline_acquire( pipeline_t*, uint8_t* );
+void pipeline_release( pipeline_t* );
+
+#endif /* _PIPELINE_H */\
+
@@ -0,0 +1,109 @@
+/** @file power.c
+*
+* @brief Core voltage (PMMCOREV) management, the level follows what the
+*        clock and the radio need
+*
+*   Each part of the system states the lowest level it can run at, and the
+*   core runs at the highest of them. The level is cached so that asking
+*   for the one already set costs a comparison instead of the PMM register
+*   sequence. Steps go through SetVCoreUp and SetVCoreDown one level at a
+*   time, as the PMM requires.
+*
+* @author Alvaro Prieto
+*/
+#include "power.h"
+#include "hal_pmm.h"
+#include "intrinsics.h"
+
+#define LEVEL_UNKNOWN (0xFF)
+
+static uint8_t needs[POWER_NEEDS];
+static uint8_t level = LEVEL_UNKNOWN;
+
+volatile power_stats_t power_stats;
+
+/*******************************************************************************
+ * @fn     uint8_t power_require( uint8_t need, uint8_t new_level )
+ * @brief  set the lowest core level [need] can run at and move the core to
+ *         the highest level any need asks for
+ * @return 1 if the core is now at that level, 0 if the supply is too low to
+ *         raise it (the need isn't recorded and the level stays as it was)
+ * ****************************************************************************/
+uint8_t power_require( uint8_t need, uint8_t new_level )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint8_t previous;
+  uint8_t target = 0;
+  uint8_t index;
+  uint8_t done = 1;
+
+  if( need >= POWER_NEEDS )
+  {
+    return 0;
+  }
+
+  dint();
+
+  previous = needs[need];
+  needs[need] = new_level & PMMCOREV_3;
+
+  for( index = 0; index < POWER_NEEDS; index++ )
+  {
+    if( needs[index] > target )
+    {
+      target = needs[index];
+    }
+  }
+
+  // Only read once, after that the cache is kept up to date
+  if( LEVEL_UNKNOWN == level )
+  {
+    level = PMMCTL0 & PMMCOREV_3;
+  }
+
+  if( target == level )
+  {
+    power_stats.skipped++;
+  }
+
+  while( level < target )
+  {
+    if( PMM_STATUS_OK != SetVCoreUp( level + 1 ) )
+    {
+      power_stats.failed++;
+      needs[need] = previous;
+      done = 0;
+      break;
+    }
+    level++;
+    power_stats.raised++;
+  }
+
+  while( level > target )
+  {
+    SetVCoreDown( level - 1 );
+    level--;
+    power_stats.lowered++;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+
+  return done;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t power_level( void )
+ * @return current core level
+ * ****************************************************************************/
+uint8_t power_level( void )
+{
+  if( LEVEL_UNKNOWN == level )
+  {
+    return PMMCTL0 & PMMCOREV_3;
+  }
+
+  return level;
+}
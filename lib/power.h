@@ -0,0 +1,32 @@
+/** @file power.h
+*
+* @brief Core voltage (PMMCOREV) management, the level follows what the
+*        clock and the radio need
+*
+* @author Alvaro Prieto
+*/
+#ifndef _POWER_H
+#define _POWER_H
+
+#include "common.h"
+
+// Parts of the system with a core voltage requirement
+#define POWER_NEED_CLOCK (0)
+#define POWER_NEED_RADIO (1)
+#define POWER_NEEDS (2)
+
+typedef struct
+{
+  uint16_t raised;          // Single level steps up
+  uint16_t lowered;         // Single level steps down
+  uint16_t skipped;         // Requests that didn't change the level
+  uint16_t failed;          // Steps up refused, supply too low
+} power_stats_t;
+
+extern volatile power_stats_t power_stats;
+
+uint8_t power_require( uint8_t, uint8_t );
+uint8_t power_level( void );
+
+#endif /* _POWER_H */\
+
@@ -5,6 +5,10 @@
 * @author Alvaro Prieto
 */
 #include "radio.h"
+#include "boot.h"
+#include "energy.h"
+#include "power.h"
+#include "task.h"
 #include <signal.h>
 
 static uint8_t dummy_callback( uint8_t*, uint8_t );
@@ -18,11 +22,30 @@ static uint8_t rx_buffer[RX_BUFFER_SIZE];
 // Radio mode holds whether or not radio is transmitting or receiving
 volatile uint8_t radio_mode = RADIO_RX;
 
+// Packets received with a good CRC and packets sent, for tasks to wait on
+volatile uint8_t radio_rx_count = 0;
+volatile uint8_t radio_tx_count = 0;
+
 extern RF_SETTINGS rfSettings;
 
 // Holds pointers to all callback functions for CCR registers (and overflow)
 static uint8_t (*rx_callback)( uint8_t*, uint8_t ) = dummy_callback;
 
+// Set by radio_reset_start, setup_radio then only waits for the reset
+static uint8_t reset_started = 0;
+
+/*******************************************************************************
+ * @fn     void radio_reset_start( void )
+ * @brief  send the reset strobe without waiting for the radio core to come
+ *         back, so something else can be done meanwhile
+ * ****************************************************************************/
+void radio_reset_start( void )
+{
+  power_require( POWER_NEED_RADIO, RADIO_VCORE );
+  Strobe( RF_SRES );
+  reset_started = 1;
+}
+
 /*******************************************************************************
  * @fn     void setup_radio( uint8_t (*callback)(void) )
  * @brief  Initialize radio at tx power of 0 dBm register Rx Callback function
@@ -41,9 +64,16 @@ void setup_radio_pwr( uint8_t (*callback)(uint8_t*, uint8_t), uint8_t power_pata
   rx_callback = callback;
   
   // Increase PMMCOREV level to 2 for proper radio operation
-  SetVCore(2);
+  power_require( POWER_NEED_RADIO, RADIO_VCORE );
   
-  ResetRadioCore();
+  // Reset the radio core unless radio_reset_start did already, the first
+  // strobe after it waits until the core is ready
+  if( !reset_started )
+  {
+    Strobe( RF_SRES );
+  }
+  reset_started = 0;
+  Strobe( RF_SNOP );                        // Reset Radio Pointer
   
   // Set the High-Power Mode Request Enable bit so LPM3 can be entered
   // with active radio enabled
@@ -56,6 +86,8 @@ void setup_radio_pwr( uint8_t (*callback)(uint8_t*, uint8_t), uint8_t power_pata
   WriteSinglePATable(power_patable);
 
   rx_enable();
+
+  boot_mark( BOOT_RADIO );
 }
 
 /*******************************************************************************
@@ -74,7 +106,74 @@ void radio_tx( uint8_t* buffer, uint8_t size )
   WriteBurstReg(RF_TXFIFOWR, buffer, size);
   
   Strobe( RF_STX ); // Strobe STX
+  ENERGY_ON( ENERGY_RADIO_TX );
+  
+}
+
+/*******************************************************************************
+ * @fn     uint8_t radio_set_channel( uint8_t channel )
+ * @brief  Change radio channel. Only done while receiving so that a packet
+ *         being sent isn't cut off.
+ * @return 1 if changed, 0 if radio is busy transmitting
+ * ****************************************************************************/
+uint8_t radio_set_channel( uint8_t channel )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  
+  // A timer ISR could start a transmission half way through
+  dint();
+  
+  if( radio_mode != RADIO_RX )
+  {
+    if( interrupt_state )
+    {
+      eint();
+    }
+    return 0;
+  }
   
+  // Channel can only be changed in IDLE, frequency synthesizer is calibrated
+  // again on the way back to RX
+  rx_disable();
+  WriteSingleReg( CHANNR, channel );
+  rx_enable();
+  
+  if( interrupt_state )
+  {
+    eint();
+  }
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t radio_set_power( uint8_t power_patable )
+ * @brief  Change tx power. Only done while receiving.
+ * @return 1 if changed, 0 if radio is busy transmitting
+ * ****************************************************************************/
+uint8_t radio_set_power( uint8_t power_patable )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  
+  dint();
+  
+  if( radio_mode != RADIO_RX )
+  {
+    if( interrupt_state )
+    {
+      eint();
+    }
+    return 0;
+  }
+  
+  rx_disable();
+  WriteSinglePATable( power_patable );
+  rx_enable();
+  
+  if( interrupt_state )
+  {
+    eint();
+  }
+  return 1;
 }
 
 /*******************************************************************************
@@ -101,6 +200,7 @@ inline void rx_enable()
   
   // Radio is in IDLE following a TX, so strobe SRX to enter Receive Mode
   Strobe( RF_SRX );
+  ENERGY_ON( ENERGY_RADIO_RX );
 }
 
 /*******************************************************************************
@@ -110,14 +210,14 @@ inline void rx_enable()
 inline void rx_disable()
 {
   RF1AIE &= ~BIT9; // Disable RX interrupts
-  RF1AIFG &= ~BIT9; // Clear pending IFG  // Increase PMMCOREV level to 2 for proper radio operation
-  SetVCore(2);
+  RF1AIFG &= ~BIT9; // Clear pending IFG
 
   // It is possible that ReceiveOff is called while radio is receiving a packet.
   // Therefore, it is necessary to flush the RX FIFO after issuing IDLE strobe
   // such that the RXFIFO is empty prior to receiving a packet.
   Strobe( RF_SIDLE );
   Strobe( RF_SFRX );
+  ENERGY_OFF( ENERGY_RADIO_RX );
 }
 
 /*******************************************************************************
@@ -137,78 +237,54 @@ static uint8_t dummy_callback( uint8_t* buffer, uint8_t size )
  * ****************************************************************************/
 wakeup interrupt (CC1101_VECTOR) radio_isr (void)
 {
-  uint16_t vector_flag;
   uint8_t rx_message_size;
-  //
-  // NOTE: For some reason, the switch statement with argument RF1AIV does not
-  // work. Adding the temporary variable 'vector_flag' fixes the problem
-  //
-  vector_flag = RF1AIV;
-  
-  // CHANGED from __even_in_range(RF1AIV,32)
-  switch(vector_flag) // Prioritizing Radio Core Interrupt
+
+  // End of packet (RFIFG9) is the only radio core interrupt ever enabled, so
+  // there is nothing else to decode. Reading RF1AIV clears it.
+  if( RF1AIV_RFIFG9 != RF1AIV )
   {
-    case RF1AIV_NONE: break; // No RF core interrupt pending
-    case RF1AIV_RFIFG0: break; // RFIFG0
-    case RF1AIV_RFIFG1: break; // RFIFG1
-    case RF1AIV_RFIFG2: break; // RFIFG2
-    case RF1AIV_RFIFG3: break; // RFIFG3
-    case RF1AIV_RFIFG4: break; // RFIFG4
-    case RF1AIV_RFIFG5: break; // RFIFG5
-    case RF1AIV_RFIFG6: break; // RFIFG6
-    case RF1AIV_RFIFG7: break; // RFIFG7
-    case RF1AIV_RFIFG8: break; // RFIFG8
-    case RF1AIV_RFIFG9: // RFIFG9
+    return;
+  }
+
+  if( radio_mode == RADIO_RX )
+  {
+    // Read the length byte from the FIFO
+    rx_message_size = ReadSingleReg( RXBYTES );
+    ReadBurstReg(RF_RXFIFORD, rx_buffer, rx_message_size);
+
+    // Check the CRC results
+    if(rx_buffer[rx_message_size + CRC_LQI_IDX_OFFSET] & CRC_OK)
     {
-      
-      if(radio_mode == RADIO_RX) 
-      {
-        // Read the length byte from the FIFO
-        rx_message_size = ReadSingleReg( RXBYTES );
-        ReadBurstReg(RF_RXFIFORD, rx_buffer, rx_message_size);
-        
-        // Stop here to see contents of RxBuffer
-        __no_operation();
-        
-        // Check the CRC results
-        if(rx_buffer[rx_message_size + CRC_LQI_IDX_OFFSET] & CRC_OK)
-        {
-          if ( rx_callback(rx_buffer, rx_message_size) )
-          {
-            // If callback function returns 1, wake up after interrupt
-            // Otherwise, stay in whatever mode it is in.
-            __bic_SR_register_on_exit(LPM3_bits);
-          }
-                    
-        }
-        
-        // Not sure why this is needed, but it fixes a problem of not
-        // receiving messages after the first one comes in
-        rx_enable();
-        
-      }
-      else if(radio_mode == RADIO_TX)
+      radio_rx_count++;
+
+      // Tasks waiting for a packet need the main loop too
+      if ( rx_callback(rx_buffer, rx_message_size) | task_notify() )
       {
-        RF1AIE &= ~BIT9; // Disable TX end-of-packet interrupt        
-        
-        // Shouldn't be sleeping if it just transmitted, but in case it is
-        // wake up after transmission
+        // If callback function returns 1, wake up after interrupt
+        // Otherwise, stay in whatever mode it is in.
         __bic_SR_register_on_exit(LPM3_bits);
-        
-        // Clean up if needed
-        tx_done();
       }
-      else while(1); // trap
-      break;
     }
-    case RF1AIV_RFIFG10: break; // RFIFG10
-    case RF1AIV_RFIFG11: break; // RFIFG11
-    case RF1AIV_RFIFG12: break; // RFIFG12
-    case RF1AIV_RFIFG13: break; // RFIFG13
-    case RF1AIV_RFIFG14: break; // RFIFG14
-    case RF1AIV_RFIFG15: break; // RFIFG15
-    default: break;
+
+    // Not sure why this is needed, but it fixes a problem of not
+    // receiving messages after the first one comes in
+    rx_enable();
   }
-  
+  else if( radio_mode == RADIO_TX )
+  {
+    RF1AIE &= ~BIT9; // Disable TX end-of-packet interrupt
+    ENERGY_OFF( ENERGY_RADIO_TX );
+
+    // Shouldn't be sleeping if it just transmitted, but in case it is
+    // wake up after transmission
+    __bic_SR_register_on_exit(LPM3_bits);
+
+    // Clean up if needed
+    tx_done();
+
+    radio_tx_count++;
+    task_notify();
+  }
+  else while(1); // trap
 }
 
@@ -24,6 +24,9 @@
 #define RADIO_RX 0
 #define RADIO_TX 1
 
+// PMMCOREV level the radio core needs
+#define RADIO_VCORE (2)
+
 #define RX_BUFFER_SIZE 255
 
 // Packet type and flag definitions
@@ -34,9 +37,16 @@
 
 #define POWER_PACKET (0x05)
 
+// Packets received with a good CRC and packets sent
+extern volatile uint8_t radio_rx_count;
+extern volatile uint8_t radio_tx_count;
+
+void radio_reset_start( void );
 void setup_radio( uint8_t (*)(uint8_t*, uint8_t) );
 void setup_radio_pwr( uint8_t (*)(uint8_t*, uint8_t), uint8_t power_patable );
 void radio_tx( uint8_t*, uint8_t );
+uint8_t radio_set_channel( uint8_t );
+uint8_t radio_set_power( uint8_t );
 
 
 #endif /* _RADIO_H */\
@@ -1,5 +1,16 @@
 #include "radio_ext.h"
 
+// Output format, the default comes from DEBUG as before
+#if DEBUG > 99
+static uint8_t rssi_output = RSSI_OUTPUT_DEBUG;
+#else
+static uint8_t rssi_output = RSSI_OUTPUT_CSV;
+#endif
+
+// Burst being filled by print_rssi_binary
+static uint8_t rssi_burst[2 + RSSI_BURST_RECORDS * sizeof(rssi_record_t)];
+static uint8_t rssi_burst_count = 0;
+
 /*******************************************************************************
  * @fn     uint8_t hex_to_string( uint8_t* buffer_out, uint8_t* buffer_in, 
  *                                          uint8_t buffer_in_size  )
@@ -8,19 +19,7 @@
 uint8_t hex_to_string( uint8_t* buffer_out, uint8_t* buffer_in, 
                                     uint8_t buffer_in_size  )
 {
-  static const uint8_t hex_char[16] = { '0', '1', '2', '3', '4', '5', '6', '7', 
-                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-  uint8_t counter = 0;
-  
-  while(counter < buffer_in_size*2 )
-  {
-    buffer_out[counter] = hex_char[((buffer_in[(counter>>1)]>>4) & 0xF)];
-    counter++;
-    buffer_out[counter] = hex_char[(buffer_in[(counter>>1)] & 0xF)];
-    counter++;
-  }
-  
-  return counter;
+  return format_hex( buffer_out, buffer_in, buffer_in_size );
 }
 
 
@@ -34,17 +33,12 @@ uint8_t rssi_to_string( uint8_t* buffer_out, uint8_t* buffer_in,
                                     uint8_t buffer_in_size  )
 {
   uint8_t counter = 0;
+  uint8_t index;
   
-  while(counter < buffer_in_size*2 )
+  for( index = 0; index < buffer_in_size; index++ )
   {
-    int rssi_dbm;
-    int rssi_raw = buffer_in[(counter>>1)] & 0xFF;
-    if( rssi_raw >= 128 ){
-	rssi_raw = ( rssi_raw - 256 );
-    }
-    rssi_dbm = rssi_raw / 2 - RADIO_RSSI_OFFSET_868MHZ;
-    
-    counter += sprintf( &buffer_out[counter], "%d", rssi_dbm );
+    counter += format_dbm( &buffer_out[counter], buffer_in[index],
+                                                RADIO_RSSI_OFFSET_868MHZ );
   }
   return counter;
 }
@@ -60,10 +54,11 @@ uint8_t int_to_string( uint8_t* buffer_out, uint8_t* buffer_in,
                                     uint8_t buffer_in_size  )
 {
   uint8_t cnt = 0;
+  uint8_t index;
   
-  while(cnt < buffer_in_size*2 )
+  for( index = 0; index < buffer_in_size; index++ )
   {  
-    cnt += sprintf( &buffer_out[cnt], "%d", buffer_in[cnt>>1] & 0xFF );
+    cnt += format_uint( &buffer_out[cnt], buffer_in[index], 0 );
   }
   return cnt;
 }
@@ -76,18 +71,77 @@ uint8_t print_rssi( uint8_t pkt_reciever, uint8_t* pkt_source,
     return 0;
   }
   
-  #if DEBUG > 99
-    //Human Readable
-    print_rssi_debug(pkt_reciever, pkt_source, pkt_rssi, pkt_id, pkt_grp);
-  #else
-    //CSV Output
-    print_rssi_csv(pkt_reciever, pkt_source, pkt_rssi, pkt_id, pkt_grp);
-  #endif  
+  switch( rssi_output )
+  {
+    case RSSI_OUTPUT_DEBUG:
+      //Human Readable
+      print_rssi_debug(pkt_reciever, pkt_source, pkt_rssi, pkt_id, pkt_grp);
+      break;
+    case RSSI_OUTPUT_BINARY:
+      //Batched binary records
+      print_rssi_binary(pkt_reciever, pkt_source, pkt_rssi, pkt_id, pkt_grp);
+      break;
+    default:
+      //CSV Output
+      print_rssi_csv(pkt_reciever, pkt_source, pkt_rssi, pkt_id, pkt_grp);
+      break;
+  }
   
   return 1;
 }
 
 
+/*******************************************************************************
+ * @fn     void set_rssi_output( uint8_t output )
+ * @brief  select the print_rssi format, RSSI_OUTPUT_DEBUG, RSSI_OUTPUT_CSV or
+ *         RSSI_OUTPUT_BINARY. Records waiting from binary mode are sent first.
+ * ****************************************************************************/
+void set_rssi_output( uint8_t output )
+{
+  flush_rssi_records();
+  rssi_output = output;
+}
+
+
+/*******************************************************************************
+ * @fn     uint8_t get_rssi_output( void )
+ * @brief  current print_rssi format
+ * ****************************************************************************/
+uint8_t get_rssi_output( void )
+{
+  return rssi_output;
+}
+
+
+/*******************************************************************************
+ * @fn     void flush_rssi_records( void )
+ * @brief  queue the binary records collected so far as one burst. Bursts are
+ *         also sent whenever RSSI_BURST_RECORDS are waiting, call this
+ *         periodically so records don't wait too long on a quiet network.
+ * ****************************************************************************/
+void flush_rssi_records( void )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+
+  // print_rssi runs from the radio ISR
+  dint();
+
+  if( rssi_burst_count )
+  {
+    rssi_burst[0] = RSSI_BURST_TYPE;
+    rssi_burst[1] = rssi_burst_count;
+    uart_queue_cobs( rssi_burst,
+                      2 + rssi_burst_count * sizeof(rssi_record_t) );
+    rssi_burst_count = 0;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+
 inline void print_rssi_debug( uint8_t pkt_reciever, uint8_t* pkt_source, 
 		    uint8_t* pkt_rssi, uint8_t pkt_id, uint8_t pkt_grp ){
   uint8_t* buf = &print_buffer[0];
@@ -102,9 +156,9 @@ inline void print_rssi_debug( uint8_t pkt_reciever, uint8_t* pkt_source,
   uart_write( print_buffer, 2 );
   
   uart_write( " PID: ", 6 );
-  hex_to_string( print_buffer, &pkt_grp, 1 );
-  hex_to_string( print_buffer, &pkt_id, 1 );
-  uart_write( print_buffer, 2 );
+  format_hex( print_buffer, &pkt_grp, 1 );
+  format_hex( print_buffer + 2, &pkt_id, 1 );
+  uart_write( print_buffer, 4 );
   
   uart_write( " RSSI: 0x", 9 );
   hex_to_string( print_buffer, pkt_rssi, 1 );
@@ -128,16 +182,16 @@ inline void print_rssi_csv( uint8_t pkt_reciever, uint8_t* pkt_source,
   uint8_t* buf = &print_buffer[0];
   
   //Packet ID
-  buf += hex_to_string( buf, &pkt_grp, 1 );
-  buf += hex_to_string( buf, &pkt_id, 1 );
+  buf += format_hex( buf, &pkt_grp, 1 );
+  buf += format_hex( buf, &pkt_id, 1 );
   *buf++ = ',';
 
   //AP which recv beacon from wban
-  buf += hex_to_string( buf, &pkt_reciever, 1 );
+  buf += format_hex( buf, &pkt_reciever, 1 );
   *buf++ = ',';
   
   //RSSI of beacon seen by AP
-  buf += rssi_to_string( buf, pkt_rssi, 1 );
+  buf += format_dbm( buf, *pkt_rssi, RADIO_RSSI_OFFSET_868MHZ );
   *buf++ = '\n';
   
   //Flush buffer
@@ -145,6 +199,26 @@ inline void print_rssi_csv( uint8_t pkt_reciever, uint8_t* pkt_source,
 }
 
 
+inline void print_rssi_binary( uint8_t pkt_reciever, uint8_t* pkt_source, 
+		    uint8_t* pkt_rssi, uint8_t pkt_id, uint8_t pkt_grp ){
+  rssi_record_t* record;
+  
+  record = (rssi_record_t*)&rssi_burst[2 + rssi_burst_count * 
+                                                    sizeof(rssi_record_t)];
+  record->group = pkt_grp;
+  record->id = pkt_id;
+  record->receiver = pkt_reciever;
+  record->source = *pkt_source;
+  record->rssi = *pkt_rssi;
+  rssi_burst_count++;
+  
+  //Queued without waiting, the UART interrupt sends it
+  if( rssi_burst_count == RSSI_BURST_RECORDS ){
+    flush_rssi_records();
+  }
+}
+
+
 void print_rx_debug(uint8_t* buffer, uint8_t size, packet_header_t* header, 
 			     packet_footer_t* footer){
   // Print incoming packet information for debugging
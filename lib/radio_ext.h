@@ -2,7 +2,7 @@
 #define _RADIO_EXT_H
 
 #include "uart.h"
-#include <stdio.h>
+#include "format.h"
 
 //TI supplied offsets at Ta = 25 deg C, Vcc = 3V with EM430F6137RF90
 //CC430F613x, CC430F612x, CC430F513x MSP430 SoC with RF Core (Rev. F) pg86
@@ -10,6 +10,25 @@
 #define RADIO_RSSI_OFFSET_433MHZ (74)
 #define TOTAL_SAMPLES (50)
 uint8_t print_buffer[200];
+
+// print_rssi output formats
+#define RSSI_OUTPUT_DEBUG (0)   // Human readable
+#define RSSI_OUTPUT_CSV (1)     // One line per observation
+#define RSSI_OUTPUT_BINARY (2)  // rssi_record_t bursts, see print_rssi_binary
+
+// Binary records, sent in bursts of up to RSSI_BURST_RECORDS as one COBS
+// frame (uart_queue_cobs): [RSSI_BURST_TYPE][record count][records...]
+#define RSSI_BURST_TYPE (0xB5)
+#define RSSI_BURST_RECORDS (16)
+
+typedef struct
+{
+  uint8_t group;      // Packet group (wave of packet ids)
+  uint8_t id;         // Packet id
+  uint8_t receiver;   // Device that measured the RSSI
+  uint8_t source;     // Device that sent the packet
+  uint8_t rssi;       // Raw RSSI register value
+} rssi_record_t;
 typedef struct
 {
   uint8_t length;
@@ -60,6 +79,12 @@ uint8_t int_to_string( uint8_t* buffer_out, uint8_t* buffer_in,
 uint8_t print_rssi( uint8_t pkt_reciever, uint8_t* pkt_source, 
 		    uint8_t* pkt_rssi, uint8_t pkt_id, uint8_t pkt_grp );
 
+void set_rssi_output( uint8_t output );
+
+uint8_t get_rssi_output( void );
+
+void flush_rssi_records( void );
+
 
 inline void print_rssi_debug( uint8_t pkt_reciever, uint8_t* pkt_source, 
 		    uint8_t* pkt_rssi, uint8_t pkt_id, uint8_t pkt_grp );
@@ -68,6 +93,10 @@ inline void print_rssi_debug( uint8_t pkt_reciever, uint8_t* pkt_source,
 inline void print_rssi_csv( uint8_t pkt_reciever, uint8_t* pkt_source, 
 		    uint8_t* pkt_rssi, uint8_t pkt_id, uint8_t pkt_grp );
 
+
+inline void print_rssi_binary( uint8_t pkt_reciever, uint8_t* pkt_source, 
+		    uint8_t* pkt_rssi, uint8_t pkt_id, uint8_t pkt_grp );
+
 /*******************************************************************************
  * @fn     void print_rx_debug
  * @brief  Prints detailed incoming packet info. Size, headers, entire packet
@@ -0,0 +1,182 @@
+/** @file rtc.c
+*
+* @brief RTC_A calendar, wall clock time and once a second, once a minute
+*        and alarm callbacks
+*
+*   The RTC counts the 32768Hz crystal in calendar mode with binary fields,
+*   so it keeps going in LPM3 and only interrupts for the events that have a
+*   callback. Callbacks run in the RTC interrupt and return 1 to wake up the
+*   main loop, like the timer ones.
+*
+*   The calendar is held until rtc_set_time is called the first time.
+*
+* @author Alvaro Prieto
+*/
+#include "rtc.h"
+#include "intrinsics.h"
+#include <signal.h>
+
+static uint8_t dummy_callback( void );
+
+static uint8_t (*rtc_callbacks[RTC_EVENTS])( void ) =
+{
+  dummy_callback, dummy_callback, dummy_callback
+};
+
+// Interrupt enable bit for each event
+static const uint16_t rtc_enables[RTC_EVENTS] =
+{
+  RTCRDYIE, RTCTEVIE, RTCAIE
+};
+
+/*******************************************************************************
+ * @fn     void setup_rtc( void )
+ * @brief  calendar mode from ACLK, held, with every interrupt off
+ * ****************************************************************************/
+void setup_rtc( void )
+{
+  // Once a minute event, prescalers are set up by calendar mode
+  RTCCTL01 = RTCHOLD + RTCMODE + RTCSSEL_0 + RTCTEV_0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t rtc_running( void )
+ * @return 1 if the calendar is counting
+ * ****************************************************************************/
+uint8_t rtc_running( void )
+{
+  return RTCMODE == ( RTCCTL01 & ( RTCMODE + RTCHOLD ) );
+}
+
+/*******************************************************************************
+ * @fn     void rtc_set_time( const rtc_time_t* time )
+ * @brief  set the calendar to [time] and start it
+ * ****************************************************************************/
+void rtc_set_time( const rtc_time_t* time )
+{
+  RTCCTL01 |= RTCHOLD;
+
+  RTCSEC = time->second;
+  RTCMIN = time->minute;
+  RTCHOUR = time->hour;
+  RTCDOW = time->day_of_week;
+  RTCDAY = time->day;
+  RTCMON = time->month;
+  RTCYEAR = time->year;
+
+  RTCCTL01 &= ~RTCHOLD;
+}
+
+/*******************************************************************************
+ * @fn     void rtc_get_time( rtc_time_t* time )
+ * @brief  copy the calendar into [time]. The fields are read again if the
+ *         seconds changed in the middle, so they all belong to one second.
+ * ****************************************************************************/
+void rtc_get_time( rtc_time_t* time )
+{
+  do
+  {
+    time->second = RTCSEC;
+    time->minute = RTCMIN;
+    time->hour = RTCHOUR;
+    time->day_of_week = RTCDOW;
+    time->day = RTCDAY;
+    time->month = RTCMON;
+    time->year = RTCYEAR;
+  } while( time->second != RTCSEC );
+}
+
+/*******************************************************************************
+ * @fn     void register_rtc_callback( uint8_t (*callback)( void ),
+ *                                                              uint8_t event )
+ * @brief  run [callback] on RTC_EVENT_SECOND, RTC_EVENT_MINUTE or
+ *         RTC_EVENT_ALARM and enable that interrupt. A null [callback]
+ *         disables it again.
+ * ****************************************************************************/
+void register_rtc_callback( uint8_t (*callback)( void ), uint8_t event )
+{
+  if( event >= RTC_EVENTS )
+  {
+    return;
+  }
+
+  if( callback )
+  {
+    rtc_callbacks[event] = callback;
+    RTCCTL01 |= rtc_enables[event];
+  }
+  else
+  {
+    RTCCTL01 &= ~rtc_enables[event];
+    rtc_callbacks[event] = dummy_callback;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void rtc_set_alarm( uint8_t minute, uint8_t hour )
+ * @brief  raise RTC_EVENT_ALARM at [minute] past [hour]. Either one can be
+ *         RTC_ANY, both RTC_ANY turns the alarm off.
+ * ****************************************************************************/
+void rtc_set_alarm( uint8_t minute, uint8_t hour )
+{
+  uint16_t alarm_enabled = RTCCTL01 & RTCAIE;
+
+  // The alarm registers are only written with the interrupt off
+  RTCCTL01 &= ~( RTCAIE + RTCAIFG );
+
+  RTCAMIN = ( RTC_ANY == minute ) ? 0 : ( minute | RTCAE );
+  RTCAHOUR = ( RTC_ANY == hour ) ? 0 : ( hour | RTCAE );
+  RTCADOW = 0;
+  RTCADAY = 0;
+
+  RTCCTL01 |= alarm_enabled;
+}
+
+/*******************************************************************************
+ * @fn     void dummy_callback( void )
+ * @brief  empty function works as default callback
+ * ****************************************************************************/
+static uint8_t dummy_callback( void )
+{
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     void rtcInterrupt( void )
+ * @brief  RTC_A interrupt vector for ready, time event and alarm
+ * ****************************************************************************/
+interrupt (RTC_VECTOR) rtcInterrupt(void)
+{
+  uint8_t wake_up = 0;
+
+  switch ( RTCIV )
+  {
+    case ( RTC_RTCRDYIFG ):
+    {
+      wake_up = rtc_callbacks[RTC_EVENT_SECOND]();
+      break;
+    }
+
+    case ( RTC_RTCTEVIFG ):
+    {
+      wake_up = rtc_callbacks[RTC_EVENT_MINUTE]();
+      break;
+    }
+
+    case ( RTC_RTCAIFG ):
+    {
+      wake_up = rtc_callbacks[RTC_EVENT_ALARM]();
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  }
+
+  if( wake_up )
+  {
+    __bic_SR_register_on_exit(LPM3_bits);
+  }
+}
@@ -0,0 +1,40 @@
+/** @file rtc.h
+*
+* @brief RTC_A calendar, wall clock time and once a second, once a minute
+*        and alarm callbacks
+*
+* @author Alvaro Prieto
+*/
+#ifndef _RTC_H
+#define _RTC_H
+
+#include "common.h"
+
+#define RTC_EVENT_SECOND (0)
+#define RTC_EVENT_MINUTE (1)
+#define RTC_EVENT_ALARM (2)
+#define RTC_EVENTS (3)
+
+// Alarm field that matches any value
+#define RTC_ANY (0xFF)
+
+typedef struct
+{
+  uint8_t second;
+  uint8_t minute;
+  uint8_t hour;
+  uint8_t day_of_week;      // 0 to 6
+  uint8_t day;              // 1 to 31
+  uint8_t month;            // 1 to 12
+  uint16_t year;
+} rtc_time_t;
+
+void setup_rtc( void );
+uint8_t rtc_running( void );
+void rtc_set_time( const rtc_time_t* );
+void rtc_get_time( rtc_time_t* );
+void register_rtc_callback( uint8_t (*)( void ), uint8_t );
+void rtc_set_alarm( uint8_t, uint8_t );
+
+#endif /* _RTC_H */\
+
@@ -0,0 +1,155 @@
+/** @file task.c
+*
+* @brief Stackless cooperative tasks
+*
+*   Tasks run from the event loop, as the handler of EVENT_TASKS. Each run
+*   calls every task once, so a task only costs its task_t and whatever
+*   statics it keeps. EVENT_TASKS is posted by:
+*     - the vtimer set for the earliest TASK_SLEEP among the tasks
+*     - radio.c, for every packet received and sent
+*     - task_notify, for anything else a TASK_WAIT_UNTIL depends on
+*
+*   Needs vtimer_init (after setup_timer_a) and event_loop.
+*
+* @author Alvaro Prieto
+*/
+#include "task.h"
+#include "event.h"
+#include "vtimer.h"
+
+static void task_run_all( void );
+
+static task_t* tasks;
+static vtimer_t task_timer;
+
+/*******************************************************************************
+ * @fn     uint8_t task_timer_expired( void )
+ * @brief  vtimer callback, a sleeping task is due
+ * ****************************************************************************/
+static uint8_t task_timer_expired( void )
+{
+  event_post( EVENT_TASKS );
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     void task_start( task_t* task, uint8_t (*thread)( task_t* ) )
+ * @brief  run [thread] from the beginning as [task]
+ * ****************************************************************************/
+void task_start( task_t* task, uint8_t (*thread)( task_t* ) )
+{
+  task_t* search;
+
+  task->thread = thread;
+  task->resume = 0;
+  task->flags = 0;
+
+  for( search = tasks; search && search != task; search = search->next )
+  {
+  }
+
+  if( !search )
+  {
+    task->next = tasks;
+    tasks = task;
+  }
+
+  event_register( EVENT_TASKS, task_run_all );
+  task_notify();
+}
+
+/*******************************************************************************
+ * @fn     void task_stop( task_t* task )
+ * @brief  stop running [task], it can be started again with task_start
+ * ****************************************************************************/
+void task_stop( task_t* task )
+{
+  task_t** link;
+
+  for( link = &tasks; *link; link = &(*link)->next )
+  {
+    if( *link == task )
+    {
+      *link = task->next;
+      break;
+    }
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t task_sleeping( task_t* task )
+ * @brief  check the deadline in task->wake, used by the wait macros
+ * @return 1 if it hasn't been reached, the task is then woken up for it
+ * ****************************************************************************/
+uint8_t task_sleeping( task_t* task )
+{
+  if( (int32_t)( task->wake - timebase_now() ) > 0 )
+  {
+    task->flags |= TASK_SLEEPING;
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t task_notify( void )
+ * @brief  have the tasks check their wait conditions, safe from interrupts
+ * @return 1 if there are tasks, an interrupt handler should then wake up the
+ *         main loop
+ * ****************************************************************************/
+uint8_t task_notify( void )
+{
+  if( tasks )
+  {
+    event_post( EVENT_TASKS );
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @fn     void task_run_all( void )
+ * @brief  EVENT_TASKS handler, run every task once and set the timer for the
+ *         first one that sleeps
+ * ****************************************************************************/
+static void task_run_all( void )
+{
+  task_t* task;
+  task_t* next;
+  uint32_t wake = 0;
+  int32_t delay;
+  uint8_t sleeping = 0;
+
+  for( task = tasks; task; task = next )
+  {
+    next = task->next;
+    task->flags = 0;
+
+    if( TASK_DONE == task->thread( task ) )
+    {
+      task_stop( task );
+    }
+    else if( task->flags & TASK_SLEEPING )
+    {
+      if( !sleeping || (int32_t)( task->wake - wake ) < 0 )
+      {
+        wake = task->wake;
+      }
+      sleeping = 1;
+    }
+  }
+
+  if( sleeping )
+  {
+    delay = (int32_t)( wake - timebase_now() );
+    vtimer_start( &task_timer, ( delay > 0 ) ? delay : 0, 0,
+                                                        task_timer_expired );
+  }
+  else
+  {
+    vtimer_stop( &task_timer );
+  }
+}
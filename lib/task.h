@@ -0,0 +1,101 @@
+/** @file task.h
+*
+* @brief Stackless cooperative tasks
+*
+*   A task is a function written as straight line code between TASK_BEGIN
+*   and TASK_END, which can wait in the middle:
+*
+*     uint8_t blink( task_t* task )
+*     {
+*       TASK_BEGIN( task );
+*       for(;;)
+*       {
+*         led1_toggle();
+*         TASK_SLEEP( task, TIMER_FREQUENCY / 2 );
+*       }
+*       TASK_END( task );
+*     }
+*
+*   Waiting returns from the function and the next call resumes at the same
+*   line, so local variables don't survive a wait, use statics. Only one
+*   wait fits on a line, and waits can't be inside a switch statement of the
+*   task itself.
+*
+* @author Alvaro Prieto
+*/
+#ifndef _TASK_H
+#define _TASK_H
+
+#include "common.h"
+#include "timers.h"
+#include "radio.h"
+
+// Return values of a task function
+#define TASK_WAITING (0)
+#define TASK_DONE (1)
+
+// task_t flags
+#define TASK_SLEEPING (0x01)  // Has to run again at [wake]
+
+typedef struct task
+{
+  struct task* next;
+  uint8_t (*thread)( struct task* );
+  uint16_t resume;      // Line to continue from, 0 to start over
+  uint32_t wake;        // Deadline of the current TASK_SLEEP or timeout
+  uint8_t count;        // Radio event count when the wait started
+  uint8_t flags;
+} task_t;
+
+#define TASK_BEGIN( task ) switch( (task)->resume ) { case 0:
+
+#define TASK_END( task ) } (task)->resume = 0; return TASK_DONE
+
+// Continue from here on the next run
+#define TASK_RESUME_HERE( task ) (task)->resume = __LINE__; case __LINE__:
+
+// Wait until [condition] holds. It is checked whenever tasks run: on timer
+// and radio events and after task_notify.
+#define TASK_WAIT_UNTIL( task, condition ) \
+  TASK_RESUME_HERE( task ) \
+  if( !(condition) ) return TASK_WAITING
+
+// Let the other tasks run
+#define TASK_YIELD( task ) \
+  task_notify(); \
+  (task)->resume = __LINE__; return TASK_WAITING; case __LINE__:
+
+// Wait until timebase_now reaches [time]. Adding a period to (task)->wake
+// and sleeping until it gives drift-free periodic tasks.
+#define TASK_SLEEP_UNTIL( task, time ) \
+  (task)->wake = (time); \
+  TASK_RESUME_HERE( task ) \
+  if( task_sleeping( task ) ) return TASK_WAITING
+
+// Wait for [ticks] timer ticks
+#define TASK_SLEEP( task, ticks ) \
+  TASK_SLEEP_UNTIL( task, timebase_now() + (ticks) )
+
+// Send a packet and wait until it is out
+#define TASK_RADIO_TX( task, buffer, size ) \
+  (task)->count = radio_tx_count; \
+  radio_tx( (buffer), (size) ); \
+  TASK_WAIT_UNTIL( task, (task)->count != radio_tx_count )
+
+// Wait up to [ticks] for a packet with a good CRC, TASK_RX_RECEIVED tells
+// whether one came in
+#define TASK_WAIT_RX( task, ticks ) \
+  (task)->count = radio_rx_count; \
+  (task)->wake = timebase_now() + (ticks); \
+  TASK_RESUME_HERE( task ) \
+  if( !TASK_RX_RECEIVED( task ) && task_sleeping( task ) ) return TASK_WAITING
+
+#define TASK_RX_RECEIVED( task ) ( (task)->count != radio_rx_count )
+
+void task_start( task_t*, uint8_t (*)( task_t* ) );
+void task_stop( task_t* );
+uint8_t task_sleeping( task_t* );
+uint8_t task_notify( void );
+
+#endif /* _TASK_H */\
+
@@ -2,37 +2,144 @@
 *
 * @brief TIMER functions
 *
+*   The timebase extends TA0R with the ticks counted at every overflow, so
+*   timestamps don't wrap for as long as the device runs. Each overflow adds
+*   the timer period at that moment, which keeps it right in up mode when
+*   CCR0 changes and across setup_timer_a and clear_timer. Up/down mode isn't
+*   supported, TA0R alone doesn't tell which half of the period it is in.
+*
+*   Timer1_A counts ACLK/64 for intervals of seconds to minutes, with its own
+*   callbacks registered the same way as the Timer0_A ones. It isn't part of
+*   the timebase.
+*
 * @author Alvaro Prieto
 */
 #include "timers.h"
+#include "intrinsics.h"
 #include <signal.h>
 
 
 static uint8_t dummy_callback( void );
 
-// Holds pointers to all callback functions for CCR registers (and overflow)
-static uint8_t (*ccr_callbacks[TOTAL_CCRS + 1])( void ) ;
+// TAxIV / 2 for the A1 vectors: nothing, CCR1 to CCR6 and overflow
+#define TIMER_VECTORS (8)
+#define TIMER_VECTOR_OVERFLOW ( TIV_OVERFLOW >> 1 )
+
+// The CCRs and their control registers follow each other in memory
+#define TA0_CCR( index ) ( (&TA0CCR0)[index] )
+#define TA0_CCTL( index ) ( (&TA0CCTL0)[index] )
+#define TA1_CCR( index ) ( (&TA1CCR0)[index] )
+#define TA1_CCTL( index ) ( (&TA1CCTL0)[index] )
+
+// CCR0 has a vector of its own, the rest of the callbacks are looked up with
+// TA0IV / 2 so that the interrupt handler doesn't have to decode it
+static uint8_t (*ccr0_callback)( void ) = dummy_callback;
+static uint8_t (*vector_callbacks[TIMER_VECTORS])( void ) =
+{
+  dummy_callback, dummy_callback, dummy_callback, dummy_callback,
+  dummy_callback, dummy_callback, dummy_callback, dummy_callback
+};
 static uint8_t timer_mode;
 
+// Ticks counted before the current timer period started
+static volatile uint64_t timebase_base;
+
+// CCRs set by set_ccr_deadline, clear_timer keeps them on time
+static uint8_t deadline_ccrs;
+
+// Timer1_A callbacks, laid out the same way
+static uint8_t (*ta1_ccr0_callback)( void ) = dummy_callback;
+static uint8_t (*ta1_vector_callbacks[TIMER_VECTORS])( void ) =
+{
+  dummy_callback, dummy_callback, dummy_callback, dummy_callback,
+  dummy_callback, dummy_callback, dummy_callback, dummy_callback
+};
+
+/*******************************************************************************
+ * @fn     uint32_t timer_period( void )
+ * @brief  number of counts from one overflow to the next, in up or
+ *         continuous mode
+ * ****************************************************************************/
+static uint32_t timer_period( void )
+{
+  if( MODE_UP == ( TA0CTL & MC_3 ) )
+  {
+    return (uint32_t)TA0CCR0 + 1;
+  }
+
+  return 0x10000;
+}
+
+/*******************************************************************************
+ * @fn     uint16_t read_tar( void )
+ * @brief  TA0R runs from ACLK, read until two reads agree
+ * ****************************************************************************/
+static uint16_t read_tar( void )
+{
+  uint16_t tar;
+
+  do
+  {
+    tar = TA0R;
+  } while( tar != TA0R );
+
+  return tar;
+}
+
+/*******************************************************************************
+ * @fn     uint64_t timebase_read( uint16_t* count )
+ * @brief  timestamp and the TA0R value it came from. Interrupts have to be
+ *         off. An overflow the ISR hasn't counted yet shows up in TAIFG, TA0R
+ *         is read again after it so that both belong to the same period.
+ * ****************************************************************************/
+static uint64_t timebase_read( uint16_t* count )
+{
+  uint64_t base = timebase_base;
+  uint16_t tar = read_tar();
+
+  if( TA0CTL & TAIFG )
+  {
+    tar = read_tar();
+    base += timer_period();
+  }
+
+  *count = tar;
+
+  return base + tar;
+}
+
 /*******************************************************************************
  * @fn     void setup_timer_a( uint8_t mode )
  * @brief  Initialize callback functions and start timer in up mode
  * ****************************************************************************/
 void setup_timer_a( uint8_t mode )
 {
+    uint16_t interrupt_state = READ_SR & GIE;
+    uint16_t tar;
     uint8_t index;
     timer_mode = mode;
     
     // Make sure all callback functions are pointing somewhere
-    for( index = 0; index <= TOTAL_CCRS; index++ )
+    ccr0_callback = dummy_callback;
+    for( index = 0; index < TIMER_VECTORS; index++ )
     {
-      ccr_callbacks[index] = dummy_callback;
+      vector_callbacks[index] = dummy_callback;
     }
 
+    dint();
+
+    // Keep the timebase going from wherever TAR was
+    timebase_base = timebase_read( &tar );
+
     // ACLK, continuos mode, clear TAR
 		// ACLK used so that counter remains active in LPM
   	TA0CTL = TASSEL__ACLK + timer_mode + TAIE + TACLR;	
 
+    if( interrupt_state )
+    {
+      eint();
+    }
+
 }
 
 /*******************************************************************************
@@ -41,11 +148,19 @@ void setup_timer_a( uint8_t mode )
  * ****************************************************************************/
 void register_timer_callback( uint8_t (*callback)(void), uint8_t ccr_number )
 {
-  if( ccr_number <= (TOTAL_CCRS) )
+  if( 0 == ccr_number )
   {
-    ccr_callbacks[ccr_number] = callback;
+    ccr0_callback = callback;
+  }
+  else if( ccr_number < TOTAL_CCRS )
+  {
+    // TIV_CCRn is 2 * n
+    vector_callbacks[ccr_number] = callback;
+  }
+  else if( TOTAL_CCRS == ccr_number )
+  {
+    vector_callbacks[TIMER_VECTOR_OVERFLOW] = callback;
   }
-  return;
 }
 
 /*******************************************************************************
@@ -54,42 +169,11 @@ void register_timer_callback( uint8_t (*callback)(void), uint8_t ccr_number )
  * ****************************************************************************/
 void set_ccr( uint8_t ccr_index, uint16_t value )
 {
-  // (TA0CCR0_ + (ccr_index << 2)) = value;
-  // NOTE, this could be done in a simpler way by adding the ccr_index/2 to the
-  // address of TA0CCR0. The compiler is angry and I can't figure out why, so
-  // this is a temporary fix...
-  switch (ccr_index)
+  if( ccr_index < TOTAL_CCRS )
   {
-    case (0):
-    {
-      TA0CCR0 = value;
-      TA0CCTL0 = CCIE;
-      break;
-    }
-    case (1):
-    {
-      TA0CCR1 = value;
-      TA0CCTL1 = CCIE;
-      break;
-    }
-    case (2):
-    {
-      TA0CCR2 = value;
-      TA0CCTL2 = CCIE;
-      break;
-    }
-    case (3):
-    {
-      TA0CCR3 = value;
-      TA0CCTL3 = CCIE;
-      break;
-    }
-    case (4):
-    {
-      TA0CCR4 = value;
-      TA0CCTL4 = CCIE;
-      break;
-    }
+    deadline_ccrs &= ~( 1 << ccr_index );
+    TA0_CCR( ccr_index ) = value;
+    TA0_CCTL( ccr_index ) = CCIE;
   }
 }
 
@@ -99,43 +183,11 @@ void set_ccr( uint8_t ccr_index, uint16_t value )
  * ****************************************************************************/
 void clear_ccr( uint8_t ccr_index )
 {
-  switch (ccr_index)
+  if( ccr_index < TOTAL_CCRS )
   {
-    case (0):
-    {
-      TA0CCR0 = 0;
-      TA0CCTL0 &= ~CCIE;
-      break;
-    }
-    case (1):
-    {
-      TA0CCR1 = 0;
-      TA0CCTL1 &= ~CCIE;
-      break;
-    }
-    case (2):
-    {
-      TA0CCR2 = 0;
-      TA0CCTL2 &= ~CCIE;
-      break;
-    }
-    case (3):
-    {
-      TA0CCR3 = 0;
-      TA0CCTL3 &= ~CCIE;
-      break;
-    }
-    case (4):
-    {
-      TA0CCR4 = 0;
-      TA0CCTL4 &= ~CCIE;
-      break;
-    }
-    default:
-    {
-      //Shouldn't happen... 
-      break;   
-    }
+    deadline_ccrs &= ~( 1 << ccr_index );
+    TA0_CCR( ccr_index ) = 0;
+    TA0_CCTL( ccr_index ) &= ~CCIE;
   }
 }
 
@@ -145,48 +197,234 @@ void clear_ccr( uint8_t ccr_index )
  * ****************************************************************************/
 void increment_ccr( uint8_t ccr_index, uint16_t value )
 {
-  switch (ccr_index)
+  if( ccr_index < TOTAL_CCRS )
   {
-    case (0):
-    {
-      TA0CCR0 += value;
-      break;
-    }
-    case (1):
-    {
-      TA0CCR1 += value;
-      break;
-    }
-    case (2):
-    {
-      TA0CCR2 += value;
-      break;
-    }
-    case (3):
-    {
-      TA0CCR3 += value;
-      break;
-    }
-    case (4):
+    TA0_CCR( ccr_index ) += value;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void clear_timer( void )
+ * @brief  restart TAR from 0 in up mode. The ticks counted so far, and an
+ *         overflow that hasn't been serviced yet, go into the timebase.
+ * ****************************************************************************/
+inline void clear_timer()
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint32_t old_period = timer_period();
+  uint32_t period;
+  uint32_t distance;
+  uint16_t tar;
+  uint8_t index;
+
+  dint();
+
+  timebase_base = timebase_read( &tar );
+
+  // Writing TA0CTL also clears TAIFG, the overflow was counted above
+  TA0CTL = TASSEL__ACLK + MC_1 + TAIE + TACLR;
+
+  // Deadlines stay the same number of ticks away
+  period = timer_period();
+  for( index = 0; index < TOTAL_CCRS; index++ )
+  {
+    if( ( deadline_ccrs & ( 1 << index ) ) &&
+        !( TA0_CCTL( index ) & CCIFG ) )
     {
-      TA0CCR4 += value;
-      break;
+      distance = ( TA0_CCR( index ) + old_period - tar ) % old_period;
+      TA0_CCR( index ) = ( distance ? distance : 1 ) % period;
     }
-    default:
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t set_ccr_deadline( uint8_t ccr_index, uint32_t time )
+ * @brief  set CCR[ccr_index] to match when timebase_now reaches [time].
+ *         Deadlines a timer period or more away are cut short, the compare
+ *         then happens early. clear_timer moves the compare with TAR.
+ * @return 1 if set, 0 if [time] has already passed
+ * ****************************************************************************/
+uint8_t set_ccr_deadline( uint8_t ccr_index, uint32_t time )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint32_t period;
+  uint32_t now;
+  int32_t delay;
+  uint16_t tar;
+  uint8_t armed = 0;
+
+  dint();
+
+  now = (uint32_t)timebase_read( &tar );
+  delay = (int32_t)( time - now );
+
+  if( delay > 0 )
+  {
+    period = timer_period();
+    if( (uint32_t)delay >= period )
     {
-      //Shouldn't happen...  
-      break;  
+      delay = period - 1;
     }
+
+    set_ccr( ccr_index, ( tar + delay ) % period );
+    deadline_ccrs |= ( 1 << ccr_index );
+
+    // TA0R may have gone past the compare value while it was being set
+    armed = (int32_t)( (uint32_t)timebase_read( &tar ) - now ) < delay;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+
+  return armed;
+}
+
+/*******************************************************************************
+ * @fn     uint64_t timebase_now64( void )
+ * @return ticks since the device started
+ * ****************************************************************************/
+uint64_t timebase_now64( void )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint64_t now;
+  uint16_t tar;
+
+  dint();
+
+  now = timebase_read( &tar );
+
+  if( interrupt_state )
+  {
+    eint();
   }
+
+  return now;
 }
 
 /*******************************************************************************
- * @fn     void dummy_callback( void )
- * @brief  empty function works as default callback
+ * @fn     uint32_t timebase_now( void )
+ * @return ticks since the device started, wraps after 36 hours. Differences
+ *         between two timestamps are right as long as they are less than that.
  * ****************************************************************************/
-inline void clear_timer()
+uint32_t timebase_now( void )
 {
-  TA0CTL = TASSEL__ACLK + MC_1 + TAIE + TACLR;
+  return (uint32_t)timebase_now64();
+}
+
+/*******************************************************************************
+ * @fn     uint64_t timebase_ticks_to_us( uint32_t ticks )
+ * @brief  convert timer ticks to microseconds
+ * ****************************************************************************/
+uint64_t timebase_ticks_to_us( uint32_t ticks )
+{
+  return ( (uint64_t)ticks * 1000000 ) / TIMER_FREQUENCY;
+}
+
+/*******************************************************************************
+ * @fn     uint32_t timebase_us_to_ticks( uint32_t us )
+ * @brief  convert microseconds to timer ticks, rounded up so that a delay is
+ *         never shorter than asked for
+ * ****************************************************************************/
+uint32_t timebase_us_to_ticks( uint32_t us )
+{
+  return ( (uint64_t)us * TIMER_FREQUENCY + 999999 ) / 1000000;
+}
+
+/*******************************************************************************
+ * @fn     void setup_timer_a1( uint8_t mode )
+ * @brief  reset the Timer1_A callbacks and start it from ACLK/64 in [mode]
+ * ****************************************************************************/
+void setup_timer_a1( uint8_t mode )
+{
+  uint8_t index;
+
+  ta1_ccr0_callback = dummy_callback;
+  for( index = 0; index < TIMER_VECTORS; index++ )
+  {
+    ta1_vector_callbacks[index] = dummy_callback;
+  }
+
+  // ACLK/8 from ID, /8 more from TAIDEX. Counts in LPM3 as well.
+  TA1CTL = TACLR;
+  TA1EX0 = TAIDEX_7;
+  TA1CTL = TASSEL__ACLK + ID_3 + mode + TAIE + TACLR;
+}
+
+/*******************************************************************************
+ * @fn     register_timer_a1_callback( uint8_t (*callback)(void),
+ *                                                          uint8_t ccr_number )
+ * @brief  add callback function for TA1CCR[ccr_number], TOTAL_TA1_CCRS for
+ *         the overflow
+ * ****************************************************************************/
+void register_timer_a1_callback( uint8_t (*callback)(void), uint8_t ccr_number )
+{
+  if( 0 == ccr_number )
+  {
+    ta1_ccr0_callback = callback;
+  }
+  else if( ccr_number < TOTAL_TA1_CCRS )
+  {
+    ta1_vector_callbacks[ccr_number] = callback;
+  }
+  else if( TOTAL_TA1_CCRS == ccr_number )
+  {
+    ta1_vector_callbacks[TIMER_VECTOR_OVERFLOW] = callback;
+  }
+}
+
+/*******************************************************************************
+ * @fn     set_ta1_ccr( uint8_t ccr_index, uint16_t value )
+ * @brief  set the TA1CCR value and enable interrupts on it
+ * ****************************************************************************/
+void set_ta1_ccr( uint8_t ccr_index, uint16_t value )
+{
+  if( ccr_index < TOTAL_TA1_CCRS )
+  {
+    TA1_CCR( ccr_index ) = value;
+    TA1_CCTL( ccr_index ) = CCIE;
+  }
+}
+
+/*******************************************************************************
+ * @fn     clear_ta1_ccr( uint8_t ccr_index )
+ * @brief  clear the TA1CCR value and disable interrupts on it
+ * ****************************************************************************/
+void clear_ta1_ccr( uint8_t ccr_index )
+{
+  if( ccr_index < TOTAL_TA1_CCRS )
+  {
+    TA1_CCR( ccr_index ) = 0;
+    TA1_CCTL( ccr_index ) &= ~CCIE;
+  }
+}
+
+/*******************************************************************************
+ * @fn     increment_ta1_ccr( uint8_t ccr_index, uint16_t value )
+ * @brief  increment the TA1CCR by [value]
+ * ****************************************************************************/
+void increment_ta1_ccr( uint8_t ccr_index, uint16_t value )
+{
+  if( ccr_index < TOTAL_TA1_CCRS )
+  {
+    TA1_CCR( ccr_index ) += value;
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t ta1_ccr_active( uint8_t ccr_index )
+ * @return 1 if interrupts are enabled on TA1CCR[ccr_index]
+ * ****************************************************************************/
+uint8_t ta1_ccr_active( uint8_t ccr_index )
+{
+  return ( ccr_index < TOTAL_TA1_CCRS ) &&
+         ( TA1_CCTL( ccr_index ) & CCIE );
 }
 
 /*******************************************************************************
@@ -207,7 +445,11 @@ static uint8_t dummy_callback( void )
 interrupt (TIMER0_A0_VECTOR) timerA0Interrupt(void)
 {  
 
-  ccr_callbacks[0]();
+  // Same as the other CCRs, the callback decides whether to exit LPM3
+  if( ccr0_callback() )
+  {
+    __bic_SR_register_on_exit(LPM3_bits);
+  }
 
 }
 
@@ -215,56 +457,43 @@ interrupt (TIMER0_A0_VECTOR) timerA0Interrupt(void)
  * @fn     void timerA1Interrupt( void )
  * @brief  Timer0 A1 Interrupt vector for CCR1-4 and overflow
  * ****************************************************************************/
-interrupt (TIMER0_A1_VECTOR) timerA1Interrupt(void) // CHANGE
+interrupt (TIMER0_A1_VECTOR) timerA1Interrupt(void)
 {
-  uint8_t wake_up = 0;
-	//
-	// Figure out what caused the interrupt and respond accordingly
-	//
-	switch ( TA0IV )
-	{
-
-		case ( TIV_CCR1 ):
-    {
-      wake_up = ccr_callbacks[1]();
-		  break;
-    }
-    
-    case ( TIV_CCR2 ):
-    {
-      wake_up = ccr_callbacks[2]();
-		  break;
-    }
-    
-    case ( TIV_CCR3 ):
-    {
-      wake_up = ccr_callbacks[3]();
-		  break;
-    }
-    
-    case ( TIV_CCR4 ):
-    {
-      wake_up = ccr_callbacks[4]();
-		  break;
-    }
-    
-		case ( TIV_OVERFLOW ):
-    { 
-      wake_up = ccr_callbacks[5]();
-			break;
-    }
-    
-		default:
-    {
-			break;
-		}
-	}
-	
-	// Depending on the return value of the callback function, exit LPM3
-	if( wake_up )
-	{
-	  __bic_SR_register_on_exit(LPM3_bits);
-	}
+  // Reading TA0IV clears the flag it reports, it is only read once
+  uint16_t vector = TA0IV;
+
+  if( TIV_OVERFLOW == vector )
+  {
+    timebase_base += timer_period();
+  }
+
+  // Depending on the return value of the callback function, exit LPM3
+  if( vector_callbacks[vector >> 1]() )
+  {
+    __bic_SR_register_on_exit(LPM3_bits);
+  }
+}
 
+/*******************************************************************************
+ * @fn     void timer1A0Interrupt( void )
+ * @brief  Timer1 A0 Interrupt vector for CCR0
+ * ****************************************************************************/
+interrupt (TIMER1_A0_VECTOR) timer1A0Interrupt(void)
+{
+  if( ta1_ccr0_callback() )
+  {
+    __bic_SR_register_on_exit(LPM3_bits);
+  }
 }
 
+/*******************************************************************************
+ * @fn     void timer1A1Interrupt( void )
+ * @brief  Timer1 A1 Interrupt vector for CCR1-2 and overflow
+ * ****************************************************************************/
+interrupt (TIMER1_A1_VECTOR) timer1A1Interrupt(void)
+{
+  if( ta1_vector_callbacks[TA1IV >> 1]() )
+  {
+    __bic_SR_register_on_exit(LPM3_bits);
+  }
+}
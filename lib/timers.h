@@ -10,17 +10,37 @@
 #include "common.h"
 
 #define TOTAL_CCRS 5 // Number of capture compare registers
+#define TOTAL_TA1_CCRS 3 // Timer1_A capture compare registers
 
 #define MODE_OFF MC_0
 #define MODE_UP MC_1
 #define MODE_CONTINUOUS MC_2
 #define MODE_UPDOWN MC_3
 
+// Timer0_A runs from ACLK (32768Hz crystal)
+#define TIMER_FREQUENCY (32768UL)
+
+// Timer1_A runs from ACLK divided by 64, it wraps every 128 seconds
+#define TIMER1_DIVIDER (64)
+#define TIMER1_FREQUENCY ( TIMER_FREQUENCY / TIMER1_DIVIDER )
+
 void setup_timer_a( uint8_t );
 void register_timer_callback( uint8_t (*)(void), uint8_t);
 void set_ccr( uint8_t, uint16_t );
 void clear_ccr( uint8_t );
 void increment_ccr( uint8_t, uint16_t );
 inline void clear_timer();
+uint8_t set_ccr_deadline( uint8_t, uint32_t );
+uint64_t timebase_now64( void );
+uint32_t timebase_now( void );
+uint64_t timebase_ticks_to_us( uint32_t );
+uint32_t timebase_us_to_ticks( uint32_t );
+
+void setup_timer_a1( uint8_t );
+void register_timer_a1_callback( uint8_t (*)(void), uint8_t );
+void set_ta1_ccr( uint8_t, uint16_t );
+void clear_ta1_ccr( uint8_t );
+void increment_ta1_ccr( uint8_t, uint16_t );
+uint8_t ta1_ccr_active( uint8_t );
 #endif /* _TIMERS_H */\
 
@@ -5,12 +5,51 @@
 * @author Alvaro Prieto
 */
 #include "uart.h"
+#include "crc.h"
+#include "energy.h"
+#include "oscillator.h"
+
+#define UART_TX_RING_MASK (UART_TX_RING_SIZE - 1)
+#define UART_RX_RING_MASK (UART_RX_RING_SIZE - 1)
+
+static void tx_ring_put( uint8_t );
+static uint8_t tx_ring_free( void );
+static void tx_ring_start( uint8_t );
+static uint8_t cobs_put( uint8_t, uint8_t );
+
+// Transmit ring, head is only moved by the queue functions and tail only by
+// the TX interrupt
+static uint8_t tx_ring[UART_TX_RING_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
+volatile uart_tx_stats_t uart_tx_stats;
+
+static uint8_t tx_framing = UART_FRAMING_ESCAPED;
+
+// Sequence number of the next COBS frame
+static uint8_t tx_sequence = 0;
+
+// Receive ring, head is only moved by the RX interrupt and tail only by
+// uart_read
+static uint8_t rx_ring[UART_RX_RING_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+
+volatile uint16_t uart_rx_dropped = 0;
+
+// Baud rate asked for in the last uart_set_baud, kept across clock changes
+static uint32_t uart_baud = 0;
+
+static void uart_clock_changed( uint32_t );
 
 /*******************************************************************************
- * @fn     void setup_uart( void )
- * @brief  configure uart for 115200BAUD on ports 1.6 and 1.7
+ * @fn     int16_t setup_uart( uint32_t baud, uint32_t smclk )
+ * @brief  configure uart on ports 1.5 and 1.6 for [baud] given the SMCLK
+ *         frequency in Hz
+ * @return Baud rate error in hundredths of a percent (see uart_set_baud)
  * ****************************************************************************/
-void setup_uart( void )
+int16_t setup_uart( uint32_t baud, uint32_t smclk )
 {
   //Set up UART TX RX Pins for CC430
   PMAPPWD = 0x02D52;                        // Get write-access to port mapping regs 
@@ -21,13 +60,118 @@ void setup_uart( void )
   P1DIR |= BIT6;                            // Set P2.7 as TX output
   P1SEL |= BIT5 + BIT6;                     // Select P2.6 & P2.7 to UART function 
 
+  // Divisors follow clock_set
+  clock_register_listener( uart_clock_changed );
+
+  return uart_set_baud( baud, smclk );
+}
+
+/*******************************************************************************
+ * @fn     int16_t uart_set_baud( uint32_t baud, uint32_t smclk )
+ * @brief  compute the USCI_A0 divisors for [baud] from SMCLK and restart the
+ *         UART with them. Follows the 5xx User's Guide: oversampling mode
+ *         (UCBR, UCBRF) when SMCLK is at least 16x the baud rate, low
+ *         frequency mode (UCBR, UCBRS) otherwise, which covers up to 1 Mbaud
+ *         from 8 MHz and up. A character being sent is finished first
+ *         and whatever is queued goes out at the new rate.
+ * @return Baud rate error of the resulting divisor in hundredths of a percent
+ *         (positive means faster than requested), UART_BAUD_UNREACHABLE if
+ *         SMCLK is slower than [baud]
+ * ****************************************************************************/
+int16_t uart_set_baud( uint32_t baud, uint32_t smclk )
+{
+  uint32_t divisor;
+  uint32_t remainder;
+  uint32_t actual;
+  uint32_t divisor_eighths;
+  uint8_t modulation;
+  uint8_t fraction;
+  uint8_t unreachable = 0;
+
+  uart_baud = baud;
+
+  // Fastest the divisor can go, only to have something to program
+  if( (0 == baud) || (smclk < baud) )
+  {
+    baud = smclk;
+    unreachable = 1;
+  }
+
+  if( smclk >= (baud << 4) )
+  {
+    // Oversampling, UCBRF is the rounded fractional part of N/16 in 16ths
+    divisor = smclk / (baud << 4);
+    remainder = smclk - divisor * (baud << 4);
+    fraction = (uint8_t)( (remainder + (baud >> 1)) / baud );
+    if( fraction > 15 )
+    {
+      divisor++;
+      fraction = 0;
+    }
+    modulation = (UCBRF0 * fraction) | UCOS16;
+    divisor_eighths = ((divisor << 4) + fraction) << 3;
+  }
+  else
+  {
+    // Low frequency, UCBRS is the rounded fractional part of N in 8ths
+    divisor = smclk / baud;
+    remainder = smclk - divisor * baud;
+    fraction = (uint8_t)( ((remainder << 3) + (baud >> 1)) / baud );
+    if( fraction > 7 )
+    {
+      divisor++;
+      fraction = 0;
+    }
+    modulation = UCBRS0 * fraction;
+    divisor_eighths = (divisor << 3) + fraction;
+  }
+
+  // Nothing new starts from the ring while the last character goes out
+  UCA0IE &= ~UCTXIE;
+  while( UCA0STAT & UCBUSY );
+
   UCA0CTL1 |= UCSWRST;                      // **Put state machine in reset**
   UCA0CTL1 |= UCSSEL_2;                     // CLK = SMCLK
-  UCA0BR0 = 104;                            // 12MHz/115200=104.167 (see User's Guide)
-  UCA0BR1 = 0x00;                           //
-  UCA0MCTL = UCBRS_1+UCBRF_0;               // Modulation UCBRSx=3, UCBRFx=0
+  UCA0BR0 = (uint8_t)divisor;
+  UCA0BR1 = (uint8_t)(divisor >> 8);
+  UCA0MCTL = modulation;
   UCA0CTL1 &= ~UCSWRST;                     // **Initialize USCI state machine**
   UCA0IE |= UCRXIE;                         // Enable USCI_A0 RX interrupt
+
+  // Reset cleared the interrupt enables and set UCTXIFG again
+  if( uart_tx_pending() )
+  {
+    UCA0IE |= UCTXIE;
+  }
+
+  if( unreachable )
+  {
+    return UART_BAUD_UNREACHABLE;
+  }
+
+  // Average baud rate produced by the divisor
+  actual = (smclk << 3) / divisor_eighths;
+
+  return (int16_t)( ((int32_t)(actual - baud) * 10000) / (int32_t)baud );
+}
+
+/*******************************************************************************
+ * @fn     void uart_clock_changed( uint32_t smclk )
+ * @brief  clock_set listener, keeps the baud rate when SMCLK changes. The
+ *         character being sent is finished at the old rate, the ring is
+ *         held until the new divisors are in.
+ * ****************************************************************************/
+static void uart_clock_changed( uint32_t smclk )
+{
+  if( 0 == smclk )
+  {
+    UCA0IE &= ~UCTXIE;
+    while( UCA0STAT & UCBUSY );
+  }
+  else
+  {
+    uart_set_baud( uart_baud, smclk );
+  }
 }
 
 /*******************************************************************************
@@ -80,11 +224,287 @@ void uart_write_escaped( uint8_t* buffer, uint16_t length )
   uart_put_char( 0x7e );
 }
 
+/*******************************************************************************
+ * @fn     uint8_t uart_queue( uint8_t* buffer, uint16_t length )
+ * @brief  queue whole buffer for transmission without waiting. The buffer is
+ *         either queued completely or dropped (and counted in uart_tx_stats)
+ * @return 1 if queued, 0 if dropped
+ * ****************************************************************************/
+uint8_t uart_queue( uint8_t* buffer, uint16_t length )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint16_t buffer_index;
+
+  dint();
+
+  if( length > tx_ring_free() )
+  {
+    uart_tx_stats.dropped_frames++;
+    uart_tx_stats.dropped_bytes += length;
+    
+    if( interrupt_state )
+    {
+      eint();
+    }
+    return 0;
+  }
+
+  for( buffer_index = 0; buffer_index < length; buffer_index++ )
+  {
+    tx_ring_put( buffer[buffer_index] );
+  }
+
+  tx_ring_start( interrupt_state );
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t uart_queue_escaped( uint8_t* buffer, uint16_t length )
+ * @brief  queue whole buffer as an escaped frame (same format as
+ *         uart_write_escaped) without waiting. Frames that don't fit in the
+ *         ring are dropped and counted in uart_tx_stats
+ * @return 1 if queued, 0 if dropped
+ * ****************************************************************************/
+uint8_t uart_queue_escaped( uint8_t* buffer, uint16_t length )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint16_t frame_length = length + 2;
+  uint16_t buffer_index;
+
+  // Worst case is twice the size, so count what actually needs escaping
+  for( buffer_index = 0; buffer_index < length; buffer_index++ )
+  {
+    if( (buffer[buffer_index] == 0x7e) | (buffer[buffer_index] == 0x7d) )
+    {
+      frame_length++;
+    }
+  }
+
+  dint();
+
+  if( frame_length > tx_ring_free() )
+  {
+    uart_tx_stats.dropped_frames++;
+    uart_tx_stats.dropped_bytes += frame_length;
+    
+    if( interrupt_state )
+    {
+      eint();
+    }
+    return 0;
+  }
+
+  tx_ring_put( 0x7e );
+  for( buffer_index = 0; buffer_index < length; buffer_index++ )
+  {
+    if( (buffer[buffer_index] == 0x7e) | (buffer[buffer_index] == 0x7d) )
+    {
+      tx_ring_put( 0x7d ); // Escape byte
+      tx_ring_put( buffer[buffer_index] ^ 0x20 );
+    }
+    else
+    {
+      tx_ring_put( buffer[buffer_index] );
+    }
+  }
+  tx_ring_put( 0x7e );
+
+  tx_ring_start( interrupt_state );
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t uart_queue_cobs( uint8_t* buffer, uint16_t length )
+ * @brief  queue whole buffer as a COBS frame without waiting. The frame
+ *         carries a sequence number and a CRC-16 (see crc.c):
+ *           COBS( [sequence][buffer...][CRC H][CRC L] ) 0x00
+ *         Frames that don't fit in the ring are dropped and counted in
+ *         uart_tx_stats. They still use up a sequence number, so the host
+ *         sees every dropped frame as a gap.
+ * @return 1 if queued, 0 if dropped
+ * ****************************************************************************/
+uint8_t uart_queue_cobs( uint8_t* buffer, uint16_t length )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint16_t frame_length;
+  uint16_t crc;
+  uint16_t buffer_index;
+  uint8_t sequence;
+  uint8_t code_index;
+
+  // Sequence, data and CRC, one COBS code byte per 254 bytes (at least one),
+  // and the delimiter
+  frame_length = length + 3;
+  frame_length += 1 + (frame_length / 254) + 1;
+
+  dint();
+
+  sequence = tx_sequence++;
+
+  if( frame_length > tx_ring_free() )
+  {
+    uart_tx_stats.dropped_frames++;
+    uart_tx_stats.dropped_bytes += frame_length;
+
+    if( interrupt_state )
+    {
+      eint();
+    }
+    return 0;
+  }
+
+  crc = crc16( CRC16_INIT, &sequence, 1 );
+  crc = crc16( crc, buffer, length );
+
+  // The first code byte is filled in once the end of its block is known
+  code_index = tx_head;
+  tx_ring_put( 0 );
+
+  code_index = cobs_put( code_index, sequence );
+  for( buffer_index = 0; buffer_index < length; buffer_index++ )
+  {
+    code_index = cobs_put( code_index, buffer[buffer_index] );
+  }
+  code_index = cobs_put( code_index, (uint8_t)(crc >> 8) );
+  code_index = cobs_put( code_index, (uint8_t)crc );
+
+  tx_ring[code_index] = (uint8_t)( (tx_head - code_index) & UART_TX_RING_MASK );
+  tx_ring_put( 0x00 );
+
+  tx_ring_start( interrupt_state );
+  return 1;
+}
+
+/*******************************************************************************
+ * @fn     void uart_set_framing( uint8_t framing )
+ * @brief  select the frame format used by uart_queue_frame,
+ *         UART_FRAMING_ESCAPED (default) or UART_FRAMING_COBS
+ * ****************************************************************************/
+void uart_set_framing( uint8_t framing )
+{
+  tx_framing = framing;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t uart_queue_frame( uint8_t* buffer, uint16_t length )
+ * @brief  queue whole buffer as a frame in the format picked with
+ *         uart_set_framing
+ * @return 1 if queued, 0 if dropped
+ * ****************************************************************************/
+uint8_t uart_queue_frame( uint8_t* buffer, uint16_t length )
+{
+  if( UART_FRAMING_COBS == tx_framing )
+  {
+    return uart_queue_cobs( buffer, length );
+  }
+
+  return uart_queue_escaped( buffer, length );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t uart_tx_pending( void )
+ * @brief  number of bytes still waiting in the transmit ring
+ * ****************************************************************************/
+uint8_t uart_tx_pending( void )
+{
+  return (uint8_t)( (tx_head - tx_tail) & UART_TX_RING_MASK );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t tx_ring_free( void )
+ * @brief  space left in the transmit ring (one slot is always kept empty)
+ * ****************************************************************************/
+static uint8_t tx_ring_free( void )
+{
+  return (uint8_t)( UART_TX_RING_MASK - uart_tx_pending() );
+}
+
+/*******************************************************************************
+ * @fn     void tx_ring_put( uint8_t character )
+ * @brief  add character to the transmit ring, caller checks for space
+ * ****************************************************************************/
+static void tx_ring_put( uint8_t character )
+{
+  tx_ring[tx_head] = character;
+  tx_head = (tx_head + 1) & UART_TX_RING_MASK;
+}
+
+/*******************************************************************************
+ * @fn     void tx_ring_start( uint8_t interrupt_state )
+ * @brief  update the high water mark, enable the TX interrupt to drain the
+ *         ring and restore the interrupt state saved by the caller
+ * ****************************************************************************/
+static void tx_ring_start( uint8_t interrupt_state )
+{
+  uint8_t pending = uart_tx_pending();
+
+  if( pending > uart_tx_stats.high_water )
+  {
+    uart_tx_stats.high_water = pending;
+  }
+
+  // TXIFG is set while the TX buffer is empty, so this fires right away if
+  // the UART is idle
+  ENERGY_ON( ENERGY_UART );
+  UCA0IE |= UCTXIE;
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t cobs_put( uint8_t code_index, uint8_t character )
+ * @brief  add character to the COBS block whose code byte is at code_index.
+ *         Zeros and full (254 byte) blocks close the block and reserve the
+ *         code byte of the next one.
+ * @return Ring index of the current code byte
+ * ****************************************************************************/
+static uint8_t cobs_put( uint8_t code_index, uint8_t character )
+{
+  uint8_t code;
+
+  if( character )
+  {
+    tx_ring_put( character );
+  }
+
+  code = (uint8_t)( (tx_head - code_index) & UART_TX_RING_MASK );
+
+  if( (0 == character) || (0xFF == code) )
+  {
+    tx_ring[code_index] = code;
+    code_index = tx_head;
+    tx_ring_put( 0 );
+  }
+
+  return code_index;
+}
+
+/*******************************************************************************
+ * @fn     uint8_t uart_read( uint8_t* character )
+ * @brief  take the next received character from the receive ring
+ * @return 1 if a character was read, 0 if nothing has been received
+ * ****************************************************************************/
+uint8_t uart_read( uint8_t* character )
+{
+  if( rx_head == rx_tail )
+  {
+    return 0;
+  }
+
+  *character = rx_ring[rx_tail];
+  rx_tail = (rx_tail + 1) & UART_RX_RING_MASK;
+
+  return 1;
+}
+
 /*******************************************************************************
  * @fn     void uart_isr( void )
  * @brief  UART ISR
  * ****************************************************************************/
-wakeup interrupt ( USCI_A0_VECTOR ) uart_isr(void) // CHANGE
+interrupt ( USCI_A0_VECTOR ) uart_isr(void) // CHANGE
 {
   //PJOUT ^= 0x2;
 
@@ -96,15 +516,42 @@ wakeup interrupt ( USCI_A0_VECTOR ) uart_isr(void) // CHANGE
     }
     case 2:	// Vector 2 - RXIFG
     {
-
-      //while (!(UCA0IFG&UCTXIFG));	// USCI_A0 TX buffer ready?
-      //UCA0TXBUF = UCA0RXBUF;		// TX -> RXed character
+      uint8_t character = UCA0RXBUF;
+      uint8_t next = (rx_head + 1) & UART_RX_RING_MASK;
+      
+      if( next == rx_tail )
+      {
+        // Ring full, main loop isn't keeping up
+        uart_rx_dropped++;
+      }
+      else
+      {
+        rx_ring[rx_head] = character;
+        rx_head = next;
+      }
+      
+      // Only wake up the main loop at frame boundaries (see uart_write_escaped)
+      if( 0x7e == character )
+      {
+        __bic_SR_register_on_exit(LPM3_bits);
+      }
       break;
     }
     case 4:	// Vector 4 - TXIFG
     {
+      // Send next queued byte, stop interrupts once the ring is empty.
+      // Doesn't wake up the main loop, nothing there waits on TX.
+      if( tx_head != tx_tail )
+      {
+        UCA0TXBUF = tx_ring[tx_tail];
+        tx_tail = (tx_tail + 1) & UART_TX_RING_MASK;
+      }
       
-      
+      if( tx_head == tx_tail )
+      {
+        UCA0IE &= ~UCTXIE;
+        ENERGY_OFF( ENERGY_UART );
+      }
       break;
     }
 
@@ -10,7 +10,43 @@
 #include "common.h"
 #include <signal.h>
 
-void setup_uart( void );
+#define UART_DEFAULT_BAUD (115200)
+
+// Transmit ring, must be a power of two no larger than 256
+#define UART_TX_RING_SIZE (256)
+
+typedef struct
+{
+  uint16_t dropped_frames;  // Frames rejected because the ring was full
+  uint16_t dropped_bytes;   // Bytes in those frames
+  uint8_t high_water;       // Most bytes ever waiting in the ring
+} uart_tx_stats_t;
+
+extern volatile uart_tx_stats_t uart_tx_stats;
+
+// Frame formats for uart_queue_frame
+//   UART_FRAMING_ESCAPED - 0x7e delimited, 0x7e/0x7d escaped (same as
+//                          uart_write_escaped), up to twice the frame size
+//   UART_FRAMING_COBS    - COBS encoded [sequence][data...][CRC-16 H,L]
+//                          followed by 0x00, UART_COBS_OVERHEAD extra bytes
+//                          for frames up to 250 bytes
+#define UART_FRAMING_ESCAPED (0)
+#define UART_FRAMING_COBS (1)
+#define UART_COBS_OVERHEAD (5)
+
+// Receive ring, must be a power of two no larger than 256
+#define UART_RX_RING_SIZE (64)
+
+// Characters lost because the receive ring was full
+extern volatile uint16_t uart_rx_dropped;
+
+// uart_set_baud result when SMCLK is slower than the baud rate asked for
+// (or it was 0). The UART then runs at SMCLK / 1, nowhere near the rate.
+#define UART_BAUD_UNREACHABLE (-32768)
+
+int16_t setup_uart( uint32_t, uint32_t );
+
+int16_t uart_set_baud( uint32_t, uint32_t );
 
 void uart_put_char( uint8_t );
 
@@ -18,5 +54,21 @@ void uart_write( uint8_t*, uint16_t );
 
 void uart_write_escaped( uint8_t*, uint16_t );
 
+// Non-blocking versions. Data is queued and sent from the TX interrupt.
+// Don't mix with the blocking functions above while data is still queued.
+uint8_t uart_queue( uint8_t*, uint16_t );
+
+uint8_t uart_queue_escaped( uint8_t*, uint16_t );
+
+uint8_t uart_queue_cobs( uint8_t*, uint16_t );
+
+void uart_set_framing( uint8_t );
+
+uint8_t uart_queue_frame( uint8_t*, uint16_t );
+
+uint8_t uart_tx_pending( void );
+
+uint8_t uart_read( uint8_t* );
+
 #endif /* _UART_H */\
 
@@ -0,0 +1,373 @@
+/** @file vtimer.c
+*
+* @brief Virtual timers multiplexed on one Timer0_A capture compare register
+*
+*   Any number of one-shot and periodic timers share VTIMER_CCR. Timers are
+*   kept in a hashed timer wheel: the slot is picked from the deadline, each
+*   slot is a circular doubly linked list, so starting and stopping a timer
+*   take constant time. Deadlines further away than one revolution of the
+*   wheel share slots with nearer ones and are skipped until their turn.
+*
+*   Times come from timebase_now. The compare register is set to the
+*   nearest deadline, or as far ahead as the timer can go when that is
+*   further. With no timers running its interrupt is off. vtimer_start only
+*   moves the compare earlier, when the new deadline comes before the one
+*   armed, and the interrupt looks for the next deadline, so the search over
+*   the wheel never happens when a timer is started. Periodic timers are
+*   rescheduled from their previous deadline, not from the time the callback
+*   ran, so they don't drift.
+*
+*   Callbacks run in the timer interrupt and return 1 to wake up the main
+*   loop, the same as register_timer_callback ones. They may start and stop
+*   timers, including their own.
+*
+* @author Alvaro Prieto
+*/
+#include "vtimer.h"
+#include "intrinsics.h"
+#include "timers.h"
+
+#define VTIMER_SPAN ( (uint32_t)VTIMER_SLOTS << VTIMER_SLOT_SHIFT )
+#define VTIMER_SLOT( time ) \
+  ( ( (time) >> VTIMER_SLOT_SHIFT ) & ( VTIMER_SLOTS - 1 ) )
+
+// Distance for 'no deadline found'
+#define VTIMER_NONE ( 0x7FFFFFFFL )
+
+static uint8_t vtimer_isr( void );
+
+static vtimer_link_t slots[VTIMER_SLOTS];
+
+// Everything due up to this time has been taken off the wheel
+static uint32_t wheel_time;
+
+// Timers on the wheel
+static uint16_t timer_count;
+
+// Deadline the compare register is set for, valid while armed is set. A
+// timer stopped or restarted later can leave it early, the interrupt then
+// finds nothing due and arms the next one.
+static uint32_t armed_deadline;
+static uint8_t armed;
+
+/*******************************************************************************
+ * @fn     void link_insert( vtimer_link_t* head, vtimer_link_t* link )
+ * @brief  add [link] at the end of the list at [head]
+ * ****************************************************************************/
+static void link_insert( vtimer_link_t* head, vtimer_link_t* link )
+{
+  link->next = head;
+  link->prev = head->prev;
+  head->prev->next = link;
+  head->prev = link;
+}
+
+/*******************************************************************************
+ * @fn     void link_remove( vtimer_link_t* link )
+ * @brief  take [link] out of whatever list it is in
+ * ****************************************************************************/
+static void link_remove( vtimer_link_t* link )
+{
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->next = 0;
+  link->prev = 0;
+}
+
+/*******************************************************************************
+ * @fn     void wheel_insert( vtimer_t* timer )
+ * @brief  put [timer] in the slot for its deadline. Deadlines that already
+ *         passed go in the slot that is looked at next.
+ * ****************************************************************************/
+static void wheel_insert( vtimer_t* timer )
+{
+  if( (int32_t)( timer->deadline - wheel_time ) < 0 )
+  {
+    link_insert( &slots[VTIMER_SLOT( wheel_time )], &timer->link );
+  }
+  else
+  {
+    link_insert( &slots[VTIMER_SLOT( timer->deadline )], &timer->link );
+  }
+}
+
+/*******************************************************************************
+ * @fn     int32_t nearest_beyond_span( void )
+ * @brief  nearest deadline when none is due within one revolution, every
+ *         timer has to be looked at
+ * @return Distance from wheel_time, VTIMER_NONE if the wheel is empty
+ * ****************************************************************************/
+static int32_t nearest_beyond_span( void )
+{
+  int32_t nearest = VTIMER_NONE;
+  int32_t distance;
+  vtimer_link_t* head;
+  vtimer_link_t* link;
+  uint8_t index;
+
+  for( index = 0; index < VTIMER_SLOTS; index++ )
+  {
+    head = &slots[index];
+    for( link = head->next; link != head; link = link->next )
+    {
+      distance = (int32_t)( ((vtimer_t*)link)->deadline - wheel_time );
+      if( distance < nearest )
+      {
+        nearest = distance;
+      }
+    }
+  }
+
+  return nearest;
+}
+
+/*******************************************************************************
+ * @fn     void arm_deadline( uint32_t deadline )
+ * @brief  set the compare register for [deadline]
+ * ****************************************************************************/
+static void arm_deadline( uint32_t deadline )
+{
+  armed_deadline = deadline;
+  armed = 1;
+
+  // Already due, interrupt right away
+  if( !set_ccr_deadline( VTIMER_CCR, deadline ) )
+  {
+    VTIMER_CCTL |= CCIFG;
+  }
+}
+
+/*******************************************************************************
+ * @fn     void arm( void )
+ * @brief  set the compare register for the nearest deadline. Slots are
+ *         checked in time order from wheel_time, the first one holding a
+ *         deadline inside its window for this revolution has the nearest one.
+ *         Later deadlines are cut short at the timer's horizon by
+ *         set_ccr_deadline. An empty wheel turns the interrupt off.
+ * ****************************************************************************/
+static void arm( void )
+{
+  int32_t window_end;
+  int32_t nearest = VTIMER_NONE;
+  int32_t distance;
+  vtimer_link_t* head;
+  vtimer_link_t* link;
+  uint8_t slot = VTIMER_SLOT( wheel_time );
+  uint8_t index;
+
+  window_end = ( 1L << VTIMER_SLOT_SHIFT ) -
+               ( wheel_time & ( ( 1L << VTIMER_SLOT_SHIFT ) - 1 ) );
+
+  for( index = 0; index < VTIMER_SLOTS; index++ )
+  {
+    head = &slots[slot];
+    for( link = head->next; link != head; link = link->next )
+    {
+      distance = (int32_t)( ((vtimer_t*)link)->deadline - wheel_time );
+      if( distance < window_end && distance < nearest )
+      {
+        nearest = distance;
+      }
+    }
+
+    if( nearest < window_end )
+    {
+      break;
+    }
+
+    window_end += ( 1L << VTIMER_SLOT_SHIFT );
+    slot = ( slot + 1 ) & ( VTIMER_SLOTS - 1 );
+  }
+
+  if( VTIMER_NONE == nearest && timer_count )
+  {
+    nearest = nearest_beyond_span();
+  }
+
+  // Nothing to wait for, no interrupts until the next vtimer_start
+  if( VTIMER_NONE == nearest )
+  {
+    clear_ccr( VTIMER_CCR );
+    armed = 0;
+    return;
+  }
+
+  arm_deadline( wheel_time + nearest );
+}
+
+/*******************************************************************************
+ * @fn     void vtimer_init( void )
+ * @brief  empty the wheel and take over VTIMER_CCR. Call after setup_timer_a.
+ * ****************************************************************************/
+void vtimer_init( void )
+{
+  uint8_t index;
+
+  for( index = 0; index < VTIMER_SLOTS; index++ )
+  {
+    slots[index].next = &slots[index];
+    slots[index].prev = &slots[index];
+  }
+
+  wheel_time = timebase_now();
+  timer_count = 0;
+  armed = 0;
+
+  register_timer_callback( vtimer_isr, VTIMER_CCR );
+
+  arm();
+}
+
+/*******************************************************************************
+ * @fn     void vtimer_start( vtimer_t* timer, uint32_t delay, uint32_t period,
+ *                                                uint8_t (*callback)( void ) )
+ * @brief  run [callback] in [delay] ticks and then every [period] ticks, or
+ *         only once if [period] is 0. A running timer is restarted. Timers
+ *         have to be zeroed before they are first started.
+ * ****************************************************************************/
+void vtimer_start( vtimer_t* timer, uint32_t delay, uint32_t period,
+                                                  uint8_t (*callback)( void ) )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+  uint32_t now;
+
+  dint();
+
+  if( timer->link.next )
+  {
+    link_remove( &timer->link );
+    timer_count--;
+  }
+
+  now = timebase_now();
+
+  // The wheel may have been idle for longer than timebase differences
+  // stay right, start it from now. Whatever is still armed is out of date.
+  if( 0 == timer_count )
+  {
+    wheel_time = now;
+    armed = 0;
+  }
+
+  timer->deadline = now + delay;
+  timer->period = period;
+  timer->callback = callback;
+  wheel_insert( timer );
+  timer_count++;
+
+  // Constant time, the interrupt finds the next deadline after this one
+  if( !armed || (int32_t)( timer->deadline - armed_deadline ) < 0 )
+  {
+    arm_deadline( timer->deadline );
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     void vtimer_stop( vtimer_t* timer )
+ * @brief  cancel [timer], nothing happens if it isn't running
+ * ****************************************************************************/
+void vtimer_stop( vtimer_t* timer )
+{
+  uint16_t interrupt_state = READ_SR & GIE;
+
+  dint();
+
+  // The compare register is left alone, an early interrupt finds nothing due
+  // and turns it off if this was the last timer
+  if( timer->link.next )
+  {
+    link_remove( &timer->link );
+    timer_count--;
+  }
+
+  if( interrupt_state )
+  {
+    eint();
+  }
+}
+
+/*******************************************************************************
+ * @fn     uint8_t vtimer_active( vtimer_t* timer )
+ * @return 1 if [timer] is waiting for its deadline
+ * ****************************************************************************/
+uint8_t vtimer_active( vtimer_t* timer )
+{
+  return ( 0 != timer->link.next );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t vtimer_isr( void )
+ * @brief  VTIMER_CCR callback, runs every timer that is due
+ * @return 1 if any callback asked to wake up the main loop
+ * ****************************************************************************/
+static uint8_t vtimer_isr( void )
+{
+  vtimer_link_t expired;
+  vtimer_link_t* head;
+  vtimer_link_t* link;
+  vtimer_link_t* next;
+  vtimer_t* timer;
+  uint32_t now = timebase_now();
+  uint8_t slot = VTIMER_SLOT( wheel_time );
+  uint8_t slot_count;
+  uint8_t wake_up = 0;
+
+  expired.next = &expired;
+  expired.prev = &expired;
+
+  // Every slot between wheel_time and now, the whole wheel at most
+  if( ( now - wheel_time ) >= VTIMER_SPAN )
+  {
+    slot_count = VTIMER_SLOTS;
+  }
+  else
+  {
+    slot_count = ( ( VTIMER_SLOT( now ) - slot ) & ( VTIMER_SLOTS - 1 ) ) + 1;
+  }
+
+  while( slot_count-- )
+  {
+    head = &slots[slot];
+    for( link = head->next; link != head; link = next )
+    {
+      next = link->next;
+      if( (int32_t)( ((vtimer_t*)link)->deadline - now ) <= 0 )
+      {
+        link_remove( link );
+        link_insert( &expired, link );
+      }
+    }
+    slot = ( slot + 1 ) & ( VTIMER_SLOTS - 1 );
+  }
+
+  wheel_time = now;
+
+  // Periodic timers go back on the wheel before their callback, so the
+  // callback can stop them
+  while( expired.next != &expired )
+  {
+    timer = (vtimer_t*)expired.next;
+    link_remove( &timer->link );
+
+    if( timer->period )
+    {
+      timer->deadline += timer->period;
+      wheel_insert( timer );
+    }
+    else
+    {
+      timer_count--;
+    }
+
+    wake_up |= timer->callback();
+  }
+
+  arm();
+
+  return wake_up;
+}
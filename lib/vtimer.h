@@ -0,0 +1,40 @@
+/** @file vtimer.h
+*
+* @brief Virtual timers multiplexed on one Timer0_A capture compare register
+*
+* @author Alvaro Prieto
+*/
+#ifndef _VTIMER_H
+#define _VTIMER_H
+
+#include "common.h"
+
+// Capture compare register driving all virtual timers
+#define VTIMER_CCR (4)
+#define VTIMER_CCTL TA0CCTL4
+
+// Timer wheel, VTIMER_SLOTS buckets of 2^VTIMER_SLOT_SHIFT ticks each
+#define VTIMER_SLOTS (32)
+#define VTIMER_SLOT_SHIFT (8)
+
+typedef struct vtimer_link
+{
+  struct vtimer_link* next;
+  struct vtimer_link* prev;
+} vtimer_link_t;
+
+typedef struct
+{
+  vtimer_link_t link;       // Must stay first
+  uint32_t deadline;
+  uint32_t period;          // 0 for one-shot timers
+  uint8_t (*callback)( void );
+} vtimer_t;
+
+void vtimer_init( void );
+void vtimer_start( vtimer_t*, uint32_t, uint32_t, uint8_t (*)( void ) );
+void vtimer_stop( vtimer_t* );
+uint8_t vtimer_active( vtimer_t* );
+
+#endif /* _VTIMER_H */\
+
@@ -0,0 +1,304 @@
+/** @file perfbench.c
+*
+* @brief Cycle counts for lib/ hot paths
+*
+*   Timer1_A counts SMCLK (== MCLK) cycles around each routine in
+*   perfbench.h. The cost of the measurement itself, taken from an empty
+*   routine, is subtracted. Interrupt handlers are entered the way the
+*   interrupt controller does it, so their RETI and register saves count.
+*   The _entry benchmarks stop at the first instruction of the callback the
+*   handler dispatches to instead of at its return, which is the latency
+*   the dispatch adds before the application sees the interrupt.
+*   Results end up in perfbench_cycles, then perfbench_done is called.
+*
+*   On the board the results are sent over the UART as "routine cycles"
+*   lines. Radio routines then include the time spent waiting on the radio
+*   core and uart_write_escaped the time to shift the characters out.
+*
+*   Built with PERFBENCH_SIM for the mspdebug simulator (perfbench.sim),
+*   which has no radio core or USCI. The flags those would set are written
+*   here instead, so each routine only takes its own cycles. perfbench.sim
+*   stops at perfbench_done and dumps perfbench_cycles for perfcompare.
+*
+* @author Alvaro Prieto
+*/
+#include "common.h"
+#include <stdio.h>
+
+#include "delay.h"
+#include "intrinsics.h"
+#include "oscillator.h"
+#include "radio.h"
+#include "radio_ext.h"
+#include "timers.h"
+#include "uart.h"
+#include "perfbench.h"
+
+#define BENCH_SIZE (16)
+
+// Enter [handler] as an interrupt would: return address, then SR
+#define PERFBENCH_INTERRUPT( handler ) \
+  __asm__ __volatile__( "push #1f \n\t push r2 \n\t br #" #handler " \n1:" \
+                        : : : "memory" )
+
+#define PERFBENCH( name ) static void bench_##name( void );
+PERFBENCH_ROUTINES
+#undef PERFBENCH
+
+void perfbench_done( void ) __attribute__((noinline));
+uint8_t rssi_to_string_sprintf( uint8_t*, uint8_t*, uint8_t )
+                                                __attribute__((noinline));
+
+static const char* names[] =
+{
+#define PERFBENCH( name ) #name,
+  PERFBENCH_ROUTINES
+#undef PERFBENCH
+};
+
+static void (*benchmarks[])( void ) =
+{
+#define PERFBENCH( name ) bench_##name,
+  PERFBENCH_ROUTINES
+#undef PERFBENCH
+};
+
+#define PERFBENCH_TOTAL ( sizeof(benchmarks) / sizeof(benchmarks[0]) )
+
+uint16_t perfbench_cycles[PERFBENCH_TOTAL];
+
+static uint8_t bench_in[BENCH_SIZE] = { 0x00, 0x7e, 0x12, 0x7d, 0xa5, 0xff,
+                                        0x30, 0x80, 0x7e, 0x01, 0xc8, 0x64,
+                                        0x7f, 0x40, 0x9c, 0x55 };
+static uint8_t bench_out[BENCH_SIZE * 8];
+
+// TA1R as bench_callback is entered, used instead of the end of the
+// benchmark while to_callback is set
+static volatile uint16_t callback_entry;
+static uint8_t to_callback;
+
+/*******************************************************************************
+ * @fn     uint16_t measure( void (*benchmark)( void ) )
+ * @brief  fastest of PERFBENCH_RUNS calls, in cycles
+ * ****************************************************************************/
+static uint16_t measure( void (*benchmark)( void ) )
+{
+  uint16_t fastest = 0xFFFF;
+  uint16_t start;
+  uint16_t cycles;
+  uint8_t run;
+
+  for( run = 0; run < PERFBENCH_RUNS; run++ )
+  {
+    start = TA1R;
+    benchmark();
+    cycles = ( to_callback ? callback_entry : TA1R ) - start;
+
+    if( cycles < fastest )
+    {
+      fastest = cycles;
+    }
+  }
+
+  return fastest;
+}
+
+static void bench_empty( void )
+{
+}
+
+static void bench_radio_isr( void )
+{
+  // End of packet in RX, the common case
+  RF1AIE |= BIT9;
+  RF1AIFG |= BIT9;
+#ifdef PERFBENCH_SIM
+  RF1AIV = RF1AIV_RFIFG9;
+#endif
+
+  PERFBENCH_INTERRUPT( radio_isr );
+}
+
+static void bench_ReadBurstReg( void )
+{
+  ReadBurstReg( IOCFG2, bench_out, BENCH_SIZE );
+}
+
+static void bench_WriteBurstReg( void )
+{
+  // Writes back what bench_ReadBurstReg read
+  WriteBurstReg( IOCFG2, bench_out, BENCH_SIZE );
+}
+
+static void bench_Strobe( void )
+{
+  Strobe( RF_SNOP );
+}
+
+static void bench_uart_write_escaped( void )
+{
+  uart_write_escaped( bench_in, BENCH_SIZE );
+}
+
+static void bench_hex_to_string( void )
+{
+  hex_to_string( bench_out, bench_in, BENCH_SIZE );
+}
+
+static void bench_rssi_to_string( void )
+{
+  rssi_to_string( bench_out, bench_in, BENCH_SIZE );
+}
+
+/*******************************************************************************
+ * @fn     uint8_t rssi_to_string_sprintf( uint8_t* buffer_out,
+ *                                  uint8_t* buffer_in, uint8_t buffer_in_size )
+ * @brief  rssi_to_string as it was before lib/format.c, kept as the
+ *         reference for its cycle count and code size
+ * @return Size of string in buffer_out, excluding \0
+ * ****************************************************************************/
+uint8_t rssi_to_string_sprintf( uint8_t* buffer_out, uint8_t* buffer_in,
+                                                    uint8_t buffer_in_size )
+{
+  uint8_t counter = 0;
+  uint8_t index;
+  int rssi_raw;
+
+  for( index = 0; index < buffer_in_size; index++ )
+  {
+    rssi_raw = buffer_in[index];
+    if( rssi_raw >= 128 )
+    {
+      rssi_raw -= 256;
+    }
+
+    counter += sprintf( (char*)&buffer_out[counter], "%d",
+                        rssi_raw / 2 - RADIO_RSSI_OFFSET_868MHZ );
+  }
+
+  return counter;
+}
+
+static void bench_rssi_to_string_sprintf( void )
+{
+  rssi_to_string_sprintf( bench_out, bench_in, BENCH_SIZE );
+}
+
+static uint8_t bench_callback( void )
+{
+  callback_entry = TA1R;
+
+  return 0;
+}
+
+static uint8_t bench_rx( uint8_t* buffer, uint8_t size )
+{
+  return 0;
+}
+
+static void bench_timerA1Interrupt( void )
+{
+  TA0CCTL1 |= CCIFG;
+#ifdef PERFBENCH_SIM
+  TA0IV = TIV_CCR1;
+#endif
+
+  PERFBENCH_INTERRUPT( timerA1Interrupt );
+}
+
+static void bench_timerA1Interrupt_entry( void )
+{
+  to_callback = 1;
+  TA0CCTL1 |= CCIFG;
+#ifdef PERFBENCH_SIM
+  TA0IV = TIV_CCR1;
+#endif
+
+  PERFBENCH_INTERRUPT( timerA1Interrupt );
+}
+
+static void bench_delay_cycles( void )
+{
+  delay_cycles( PERFBENCH_DELAY_CYCLES );
+}
+
+static void bench_delay_us( void )
+{
+  delay_us( PERFBENCH_DELAY_US );
+}
+
+/*******************************************************************************
+ * @fn     void perfbench_done( void )
+ * @brief  all results are in perfbench_cycles, the simulator stops here
+ * ****************************************************************************/
+void perfbench_done( void )
+{
+  __no_operation();
+}
+
+int main( void )
+{
+  uint8_t line[32];
+  uint8_t length;
+  uint16_t overhead;
+  uint8_t index;
+
+  // Stop watchdog timer to prevent time out reset
+  WDTCTL = WDTPW + WDTHOLD;
+
+  // Make sure processor is running at 12MHz
+  setup_oscillator();
+
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+
+  // Callbacks and timer setup as the applications use them
+  set_ccr( 0, 0xFFFF );
+  setup_timer_a( MODE_CONTINUOUS );
+  register_timer_callback( bench_callback, 1 );
+
+#ifdef PERFBENCH_SIM
+  // Registers the simulator doesn't produce. perfbench.sim keeps the radio
+  // core ready flags set.
+  UCA0IFG |= UCTXIFG;
+  RF1ADOUTB = BENCH_SIZE;
+#else
+  setup_radio( bench_rx );
+#endif
+
+  // Interrupts stay off, handlers are only entered by PERFBENCH_INTERRUPT
+  dint();
+
+  // SMCLK cycles, continuous mode
+  TA1CTL = TASSEL__SMCLK + MC_2 + TACLR;
+
+  overhead = measure( bench_empty );
+  for( index = 0; index < PERFBENCH_TOTAL; index++ )
+  {
+    perfbench_cycles[index] = measure( benchmarks[index] ) - overhead;
+    to_callback = 0;
+  }
+
+  perfbench_done();
+
+  for( index = 0; index < PERFBENCH_TOTAL; index++ )
+  {
+    length = 0;
+    while( names[index][length] )
+    {
+      line[length] = names[index][length];
+      length++;
+    }
+    line[length++] = ' ';
+    length += format_uint( &line[length], perfbench_cycles[index], 0 );
+    line[length++] = '\r';
+    line[length++] = '\n';
+    uart_write( line, length );
+  }
+
+  for(;;)
+  {
+    __no_operation();
+  }
+
+  return 0;
+}
@@ -0,0 +1,38 @@
+/** @file perfbench.h
+*
+* @brief Routines measured by perfbench, shared with the host comparison tool
+*
+*   Each entry is the symbol of the routine, which is also the name used for
+*   its code size and in the baseline. perfbench_cycles holds the results in
+*   this order.
+*
+* @author Alvaro Prieto
+*/
+#ifndef _PERFBENCH_H
+#define _PERFBENCH_H
+
+#define PERFBENCH_ROUTINES \
+  PERFBENCH( radio_isr ) \
+  PERFBENCH( ReadBurstReg ) \
+  PERFBENCH( WriteBurstReg ) \
+  PERFBENCH( Strobe ) \
+  PERFBENCH( uart_write_escaped ) \
+  PERFBENCH( hex_to_string ) \
+  PERFBENCH( rssi_to_string ) \
+  PERFBENCH( rssi_to_string_sprintf ) \
+  PERFBENCH( timerA1Interrupt ) \
+  PERFBENCH( timerA1Interrupt_entry ) \
+  PERFBENCH( delay_cycles ) \
+  PERFBENCH( delay_us ) \
+
+// What the delay benchmarks ask for. delay_cycles should come out exactly
+// at PERFBENCH_DELAY_CYCLES, delay_us at PERFBENCH_DELAY_US microseconds of
+// SMCLK_FREQUENCY or a little over.
+#define PERFBENCH_DELAY_CYCLES (1000)
+#define PERFBENCH_DELAY_US (100)
+
+// Calls per routine, the fastest one is kept
+#define PERFBENCH_RUNS (4)
+
+#endif /* _PERFBENCH_H */\
+
@@ -0,0 +1,46 @@
+# Cycle counts and code size of lib/ hot paths, see perfbench/perfbench.c
+# 'make perfbench' builds the board version, results are sent over the UART
+# 'make perfbench-sim' runs in the mspdebug simulator and reports the
+# results, compared with perfbench/baseline.txt once there is one.
+# 'make perfbench-baseline' saves a new baseline.
+NM = $(patsubst %gcc, %nm, $(CC))
+MSPDEBUG = mspdebug
+PERFBENCH_BASELINE = perfbench/baseline.txt
+
+PERFBENCH_OBJS += \
+	$(LIB_OBJS) \
+	perfbench/perfbench.o
+
+perfbench: $(addprefix $(BUILD_DIR)/, $(PERFBENCH_OBJS))
+	$(CC) $(CFLAGS) $(addprefix $(BUILD_DIR)/, $(PERFBENCH_OBJS)) -o \
+		$(addprefix $(BUILD_DIR)/, program.elf) $(LFLAGS)
+
+PERFBENCH_SIM_OBJS += \
+	$(LIB_OBJS) \
+	perfbench/perfbench_sim.o
+
+$(BUILD_DIR)/perfbench/perfbench_sim.o: perfbench/perfbench.c perfbench/perfbench.h
+	@echo
+	@echo [$<]
+	@mkdir -p $(dir $@)
+	@$(CC) $(CFLAGS) -DPERFBENCH_SIM -c $< -o $@
+
+$(BUILD_DIR)/perfbench.elf: $(addprefix $(BUILD_DIR)/, $(PERFBENCH_SIM_OBJS))
+	$(CC) $(CFLAGS) $(addprefix $(BUILD_DIR)/, $(PERFBENCH_SIM_OBJS)) -o $@ \
+		$(LFLAGS)
+
+$(BUILD_DIR)/perfbench.log: $(BUILD_DIR)/perfbench.elf perfbench/perfbench.sim
+	$(MSPDEBUG) -q sim "prog $(BUILD_DIR)/perfbench.elf" \
+		"read perfbench/perfbench.sim" > $@
+	$(NM) -S $(BUILD_DIR)/perfbench.elf > $(BUILD_DIR)/perfbench.nm
+
+# No baseline has been recorded with the real toolchain yet, the results are
+# only reported until 'make perfbench-baseline' writes one
+perfbench-sim: $(BUILD_DIR)/perfbench.log perfcompare
+	$(HOST_DIR)/perfcompare \
+		$(if $(wildcard $(PERFBENCH_BASELINE)), -b $(PERFBENCH_BASELINE)) \
+		$(BUILD_DIR)/perfbench.log $(BUILD_DIR)/perfbench.nm
+
+perfbench-baseline: $(BUILD_DIR)/perfbench.log perfcompare
+	$(HOST_DIR)/perfcompare -w $(PERFBENCH_BASELINE) \
+		$(BUILD_DIR)/perfbench.log $(BUILD_DIR)/perfbench.nm
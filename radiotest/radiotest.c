@@ -15,6 +15,7 @@
 #include "uart.h"
 #include "timers.h"
 #include "radio.h"
+#include "format.h"
 
 uint8_t tx_buffer[PACKET_LEN+1];
 uint8_t buttonPressed = 0;
@@ -42,7 +43,6 @@ typedef struct
   uint8_t lqi_crcok;
 } packet_footer_t;
 
-uint8_t hex_to_string( uint8_t*, uint8_t*, uint8_t );
 uint8_t fake_button_press();
 uint8_t process_rx( uint8_t*, uint8_t );
 
@@ -74,7 +74,7 @@ int main( void )
   setup_oscillator();
   
   // Initialize UART for communications at 115200baud
-  setup_uart();
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
    
   // Initialize LEDs
   setup_leds();
@@ -112,29 +112,6 @@ int main( void )
   return 0;
 }
 
-/*******************************************************************************
- * @fn     uint8_t hex_to_string( uint8_t* buffer_out, uint8_t* buffer_in, 
- *                                          uint8_t buffer_in_size  )
- * @brief  Used to convert hex values to [hex]string format
- * ****************************************************************************/
-uint8_t hex_to_string( uint8_t* buffer_out, uint8_t* buffer_in, 
-                                    uint8_t buffer_in_size  )
-{
-  static const uint8_t hex_char[16] = { '0', '1', '2', '3', '4', '5', '6', '7', 
-                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-  uint8_t counter = 0;
-  
-  while(counter < buffer_in_size*2 )
-  {
-    buffer_out[counter] = hex_char[((buffer_in[(counter>>1)]>>4) & 0xF)];
-    counter++;
-    buffer_out[counter] = hex_char[(buffer_in[(counter>>1)] & 0xF)];
-    counter++;
-  }
-  
-  return counter;
-}
-
 /*******************************************************************************
  * @fn     uint8_t fake_button_press()
  * @brief  Instead of using buttons, this function is called from a timer isr
@@ -161,32 +138,32 @@ uint8_t process_rx( uint8_t* buffer, uint8_t size )
   
   // Print incoming packet information for debugging
   uart_write( "Size: ", 6 );
-  hex_to_string( print_buffer, &header->length, 1 );
+  format_hex( print_buffer, &header->length, 1 );
   uart_write( print_buffer, 2 );
   uart_write( "\r\n", 2 );
   
   uart_write( "From: ", 6 );
-  hex_to_string( print_buffer, &header->source, 1 );
+  format_hex( print_buffer, &header->source, 1 );
   uart_write( print_buffer, 2 );
   uart_write( "\r\n", 2 );
   
   uart_write( "Type: ", 6 );
-  hex_to_string( print_buffer, &header->type, 1 );
+  format_hex( print_buffer, &header->type, 1 );
   uart_write( print_buffer, 2 );
   uart_write( "\r\n", 2 );
   
   uart_write( "Flags: ", 7 );
-  hex_to_string( print_buffer, &header->flags, 1 );
+  format_hex( print_buffer, &header->flags, 1 );
   uart_write( print_buffer, 2 );
   uart_write( "\r\n", 2 );
   
   uart_write( "Rssi: ", 6 );
-  hex_to_string( print_buffer, &footer->rssi, 1 );
+  format_hex( print_buffer, &footer->rssi, 1 );
   uart_write( print_buffer, 2 );
   uart_write( "\r\n", 2 );
  
   // Print whole packet in hex
-  //hex_to_string( print_buffer, buffer, size );  
+  //format_hex( print_buffer, buffer, size );  
   //uart_write( print_buffer, (size)*2 );
   //uart_write( "\r\n", 2 );
   
@@ -1,65 +1,101 @@
-/** @file rssitest.c
-*
-* @brief  Simple test of radio functions.
-*         A timer interrupt sends a message every ~2 seconds and prints out 
-*         received RSSI.
-*
-* @author Puey Wei Tan
-* @author Alvaro Prieto
-*       derived from work by M. Morales/D. Dang of Texas Instruments
-*/
-#include <stdio.h>
-#include <string.h>
-
-#include "common.h"
-#include "intrinsics.h"
-#include "leds.h"
-#include "timers.h"
-#include <signal.h>
-#include "oscillator.h"
-#include "uart.h"
-#include "radio.h"
-#include "radio_ext.h"
-
-#define DEBUG 0
-#define DEVICE_ADDRESS 0x01
-
-#define RADIO_NUM_APS (4)
-#define PACKET_ID_MAX (255)
-
-uint8_t tx_buffer[PACKET_LEN+1];
-volatile uint8_t timerCalls = 1;
-uint8_t tx_buffer_cnt = 0;
-uint8_t packet_id_tx = 0;
-uint8_t packet_id_rx = 0;
-uint8_t packet_group = 0;
-uint8_t packet_rssi[RADIO_NUM_APS];	//Current rx packet's RSSIs
-uint8_t hex_to_string( uint8_t*, uint8_t*, uint8_t );
-uint8_t process_rx( uint8_t*, uint8_t );
-int num_tx;
-
-inline uint8_t wban_tx();
-
-//Initialize all rssi vals to below noise floor: -138 dBm
-inline void init_rssi_array();
-
-inline void signal_rx();
-inline void signal_tx();
-inline void signal_yellow();
-
-int main( void );
-
-void pack_recv_rssi_in_tx( packet_header_t* header, packet_footer_t* footer,
-			   uint8_t* tx_data, uint8_t* buffer );
-
-inline uint8_t process_rx_wban(uint8_t* buffer, uint8_t size, packet_header_t* header, 
-			     packet_footer_t* footer, uint8_t* tx_data);
-
-inline uint8_t process_rx_ap(uint8_t* buffer, uint8_t size, packet_header_t* header, 
-			     packet_footer_t* footer, uint8_t* tx_data);
-
-/*******************************************************************************
- * @fn     uint8_t process_rx( uint8_t* buffer, uint8_t size )
- * @brief  callback function called when new message is received
- * ****************************************************************************/
-uint8_t process_rx( uint8_t* buffer, uint8_t size );
+/** @file rssitest.c
+*
+* @brief  Simple test of radio functions.
+*         A timer interrupt sends a message every ~2 seconds and prints out 
+*         received RSSI.
+*
+* @author Puey Wei Tan
+* @author Alvaro Prieto
+*       derived from work by M. Morales/D. Dang of Texas Instruments
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "intrinsics.h"
+#include "leds.h"
+#include "timers.h"
+#include <signal.h>
+#include "oscillator.h"
+#include "uart.h"
+#include "radio.h"
+#include "radio_ext.h"
+#include "event.h"
+#include "defer.h"
+#include "vtimer.h"
+#include "task.h"
+
+#define DEBUG 0
+#ifndef DEVICE_ADDRESS
+#define DEVICE_ADDRESS 0x01
+#endif
+
+// RSSI_OUTPUT_CSV, RSSI_OUTPUT_DEBUG or RSSI_OUTPUT_BINARY (see radio_ext.h),
+// e.g. make rssitest CFLAGS+=-DRSSI_OUTPUT=RSSI_OUTPUT_BINARY
+#ifndef RSSI_OUTPUT
+#define RSSI_OUTPUT RSSI_OUTPUT_CSV
+#endif
+
+#define RADIO_NUM_APS (4)
+#define PACKET_ID_MAX (255)
+
+// Relay slot per device address, 100 ms
+#define RELAY_SLOT (TIMER_FREQUENCY / 10)
+
+// Received packets waiting for handle_rx. The deferred work queue holds
+// DEFER_QUEUE_SIZE - 1 of them, one more is being handled and process_rx
+// copies into one more before defer accepts it, so none of those in use is
+// ever overwritten.
+#define RX_SLOTS (DEFER_QUEUE_SIZE + 1)
+
+typedef struct
+{
+  uint8_t size;
+  uint8_t data[PACKET_LEN + 3];	//Length byte, packet, RSSI and LQI
+} rx_slot_t;
+
+rx_slot_t rx_slots[RX_SLOTS];
+uint8_t rx_slot_next = 0;
+
+uint8_t tx_buffer[PACKET_LEN+1];
+uint8_t tx_buffer_cnt = 0;
+
+// Payload bytes after the header, packet_data_t is larger than the packet
+#define TX_DATA_SIZE ( sizeof(tx_buffer) - sizeof(packet_header_t) )
+uint8_t relay_requested = 1;
+task_t relay_task;
+uint8_t packet_id_tx = 0;
+uint8_t packet_id_rx = 0;
+uint8_t packet_group = 0;
+uint8_t packet_rssi[RADIO_NUM_APS];	//Current rx packet's RSSIs
+uint8_t hex_to_string( uint8_t*, uint8_t*, uint8_t );
+uint8_t process_rx( uint8_t*, uint8_t );
+void handle_rx( void* );
+int num_tx;
+
+inline uint8_t wban_tx();
+
+//Initialize all rssi vals to below noise floor: -138 dBm
+inline void init_rssi_array();
+
+inline void signal_rx();
+inline void signal_tx();
+inline void signal_yellow();
+
+uint8_t relay_rssi( task_t* );
+int main( void );
+
+void pack_recv_rssi_in_tx( packet_header_t* header, packet_footer_t* footer,
+			   uint8_t* tx_data, uint8_t* buffer );
+
+inline uint8_t process_rx_wban(uint8_t* buffer, uint8_t size, packet_header_t* header, 
+			     packet_footer_t* footer, uint8_t* tx_data);
+
+inline uint8_t process_rx_ap(uint8_t* buffer, uint8_t size, packet_header_t* header, 
+			     packet_footer_t* footer, uint8_t* tx_data);
+
+/*******************************************************************************
+ * @fn     uint8_t process_rx( uint8_t* buffer, uint8_t size )
+ * @brief  callback function called when new message is received
+ * ****************************************************************************/
+uint8_t process_rx( uint8_t* buffer, uint8_t size );
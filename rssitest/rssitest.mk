@@ -1,3 +1,6 @@
+# Default address, e.g. 'make rssitest ADDRESS=0x02' for other access points
+rssitest: ADDRESS = 0x01
+
 RSSITEST_OBJS += \
 	$(LIB_OBJS) \
 	rssitest/rssitest.o
@@ -46,16 +46,26 @@ inline void signal_yellow(){
 
 
 /*******************************************************************************
- * @fn     uint8_t fake_button_press()
+ * @fn     uint8_t timer_callback( void )
  * @brief  Timer isr. Releases the radio transmission
  * ****************************************************************************/
 uint8_t timer_callback (void)
 {
-  timerCalled = 1;
+  event_post( EVENT_BEACON );
   return 1;
 }
 
 
+/*******************************************************************************
+ * @fn     void send_beacon( void )
+ * @brief  EVENT_BEACON handler, sends the next beacon
+ * ****************************************************************************/
+void send_beacon( void )
+{
+  process_tx( ( (packet_data_t*)(tx_buffer + sizeof(packet_header_t)) )->samples );
+}
+
+
 int main( void )
 {
   uint8_t j;
@@ -74,8 +84,8 @@ int main( void )
   header->type = 0xAB;
   header->flags = 0x55;
   
-  // Fill in dummy values for the buffer
-  for( j=0; j < TOTAL_SAMPLES; j++ ){
+  // Fill in dummy values for the buffer, only PACKET_LEN bytes are sent
+  for( j=0; j < TX_DATA_SIZE; j++ ){
     tx_data[j] = 0;
   }
   
@@ -92,19 +102,22 @@ int main( void )
   // Init radio at +10dBm; enable receive callback
   setup_radio_pwr( process_rx, PATABLE_VAL_10DBM );
   
-  eint();
-
   tx_data[0] = 0x7A;	//Data preamble
   tx_data[1] = 3;	//Set bytes used to 3 bytes
   
-  for(;;) {
-    //__bis_SR_register(LPM1_bits);
-   
-    if (timerCalled){
-      process_tx(tx_data); 
-      timerCalled = 0;
-    }
-  }  
+  event_register( EVENT_BEACON, send_beacon );
+  
+#ifdef ENERGY_PROFILE
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+  uart_set_framing( UART_FRAMING_COBS );
+  setup_timer_a1( MODE_CONTINUOUS );
+  energy_start( ENERGY_ROLE_BEACON, ENERGY_REPORT_TICKS );
+#endif
+  
+  // Sleeps in LPM3 between beacons
+  event_loop();
+  
+  return 0;
 }
 
 
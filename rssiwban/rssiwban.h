@@ -11,14 +11,21 @@
 #include <signal.h>
 #include "oscillator.h"
 #include "radio.h"
+#include "event.h"
+#include "energy.h"
+#include "uart.h"
 
+#ifndef DEVICE_ADDRESS
 #define DEVICE_ADDRESS 0xA
+#endif
 
 #define TOTAL_SAMPLES (50)
 #define PACKET_ID_MAX (255)
 
+// Events
+#define EVENT_BEACON (0)
+
 uint8_t tx_buffer[PACKET_LEN+1];
-volatile uint8_t timerCalled = 0;
 uint8_t packet_id_tx = 0;
 
 typedef struct
@@ -34,6 +41,9 @@ typedef struct
   uint8_t samples[TOTAL_SAMPLES];
 } packet_data_t;
 
+// Payload bytes after the header, packet_data_t is larger than the packet
+#define TX_DATA_SIZE ( sizeof(tx_buffer) - sizeof(packet_header_t) )
+
 typedef struct
 {
   uint8_t rssi;
@@ -56,6 +66,7 @@ inline void signal_rx();
 inline void signal_tx();
 inline void signal_yellow();
 uint8_t timer_callback (void);
+void send_beacon( void );
 int main( void );
 
 
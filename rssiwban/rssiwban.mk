@@ -1,3 +1,6 @@
+# Default address, e.g. 'make rssiwban ADDRESS=0x02' for other beacons
+rssiwban: ADDRESS = 0x0A
+
 RSSIWBAN_OBJS += \
 	$(LIB_OBJS) \
 	rssiwban/rssiwban.o
@@ -10,6 +10,32 @@
 #include "oscillator.h"
 #include "leds.h"
 #include "uart.h"
+#include "timers.h"
+#include "vtimer.h"
+#include "event.h"
+#include "task.h"
+
+// LED1 toggle interval, about the old 0x40000 cycle delay
+#define BLINK_TICKS (715)
+
+task_t blink_task;
+
+/*******************************************************************************
+ * @fn     uint8_t blink( task_t* task )
+ * @brief  toggle LED1 while the program runs
+ * ****************************************************************************/
+uint8_t blink( task_t* task )
+{
+  TASK_BEGIN( task );
+
+  for(;;)
+  {
+    led1_toggle();
+    TASK_SLEEP( task, BLINK_TICKS );
+  }
+
+  TASK_END( task );
+}
 
 int main( void )
 {
@@ -21,19 +47,20 @@ int main( void )
 
   setup_leds();
   
-  setup_uart();
+  setup_uart( UART_DEFAULT_BAUD, SMCLK_FREQUENCY );
+  
+  setup_timer_a(MODE_CONTINUOUS);
+  vtimer_init();
   
   __bis_SR_register(GIE);		// enable general interrupts
   
   uart_write( string, sizeof(string) );
   
-  for (;;) {
-    
-    led1_toggle();
-    
-    __delay_cycles(0x40000);
-    
-  }  /* while */
+  task_start( &blink_task, blink );
+  
+  event_loop();
+  
+  return 0;
 }
 
 